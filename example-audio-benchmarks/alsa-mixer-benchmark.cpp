@@ -0,0 +1,225 @@
+// Benchmark for the shared ALSA output (src/OMXAlsaMixer), runs on any Linux
+// box with alsa-lib
+//
+//   alsa-mixer-benchmark [device] [seconds of audio]
+//   alsa-mixer-benchmark --verify
+//
+// Plays 1, 2, 4 and 8 players of 48kHz S16 stereo, each a thread pushing
+// 8KB blocks (the sink's OMX buffer size) the way omxalsasink_worker does,
+// two ways:
+//   private   every player opens the device and writes it with its own
+//             ALSA writer, what the sinks do without sharedAudioOutput
+//   shared    every player writes into a mixer input, one mix thread sums
+//             them and writes the device
+// Defaults to the null device, which throws audio away as fast as it comes
+// so the numbers are CPU per second of audio rather than playback time.
+// On a real card, private needs dmix (or fails with the device busy) while
+// shared opens it once.
+//
+// --verify mixes four players with different gains through the file plugin
+// into /tmp and checks every sample that went in came out, scaled by its
+// gain, and nothing else did.
+
+#include "OMXAlsaMixer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const unsigned int rate = 48000;
+static const int channels = 2;
+static const int frameSize = channels*2;
+static const int blockFrames = 8*1024/frameSize;
+
+static double now(clockid_t clock)
+{
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+static snd_pcm_t* openDevice(const char* name, bool* mmap)
+{
+    snd_pcm_t* dev = NULL;
+    snd_pcm_hw_params_t* hwp;
+    snd_pcm_uframes_t bufferSize = rate/5, periodSize = bufferSize/4;
+    unsigned int actualRate = rate;
+
+    int err = snd_pcm_open(&dev, name, SND_PCM_STREAM_PLAYBACK, 0);
+    if(err < 0)
+    {
+        fprintf(stderr, "snd_pcm_open %s: %s\n", name, snd_strerror(err));
+        return NULL;
+    }
+    snd_pcm_hw_params_alloca(&hwp);
+    snd_pcm_hw_params_any(dev, hwp);
+    if(snd_pcm_hw_params_set_channels(dev, hwp, channels) < 0 ||
+       alsa_writer_set_access(dev, hwp, true, true, mmap) < 0 ||
+       snd_pcm_hw_params_set_rate_near(dev, hwp, &actualRate, 0) < 0 ||
+       snd_pcm_hw_params_set_format(dev, hwp, SND_PCM_FORMAT_S16_LE) < 0 ||
+       snd_pcm_hw_params_set_buffer_size_near(dev, hwp, &bufferSize) < 0 ||
+       snd_pcm_hw_params_set_period_size_near(dev, hwp, &periodSize, 0) < 0 ||
+       snd_pcm_hw_params(dev, hwp) < 0)
+    {
+        fprintf(stderr, "%s: could not configure 48kHz S16 stereo\n", name);
+        snd_pcm_close(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+static void playPrivate(const char* name, const std::vector<int16_t>& audio, bool* ok)
+{
+    bool mmap;
+    snd_pcm_t* dev = openDevice(name, &mmap);
+    *ok = dev != NULL;
+    if(!dev) return;
+
+    ALSA_WRITER writer;
+    alsa_writer_init(&writer, dev, frameSize, mmap, blockFrames*2);
+    int totalFrames = audio.size()/channels;
+    for(int offset = 0; offset + blockFrames <= totalFrames; offset += blockFrames)
+    {
+        alsa_writer_write(&writer, (const uint8_t*)&audio[offset*channels], blockFrames);
+    }
+    snd_pcm_drain(dev);
+    alsa_writer_fini(&writer);
+    snd_pcm_close(dev);
+}
+
+static void playShared(OMXALSA_MIXER_INPUT* in, const std::vector<int16_t>& audio)
+{
+    int totalFrames = audio.size()/channels;
+    for(int offset = 0; offset + blockFrames <= totalFrames; offset += blockFrames)
+    {
+        omxalsa_mixer_write(in, (const uint8_t*)&audio[offset*channels], blockFrames);
+    }
+    omxalsa_mixer_drain(in);
+}
+
+//returns CPU seconds spent, or -1
+static double run(const char* name, bool shared, int players, const std::vector<int16_t>& audio, const float* gains = NULL)
+{
+    std::vector<std::thread> threads;
+    std::vector<OMXALSA_MIXER_INPUT*> inputs(players, (OMXALSA_MIXER_INPUT*)NULL);
+    bool ok[8];
+
+    double start = now(CLOCK_PROCESS_CPUTIME_ID);
+    for(int p=0; p<players; p++)
+    {
+        ok[p] = true;
+        if(shared)
+        {
+            unsigned int actualRate = rate;
+            snd_pcm_uframes_t periodSize;
+            inputs[p] = omxalsa_mixer_attach(name, channels, &actualRate, &periodSize, 0, 0);
+            if(!inputs[p])
+            {
+                fprintf(stderr, "%s: could not attach player %d\n", name, p);
+                ok[p] = false;
+                continue;
+            }
+            if(gains) omxalsa_mixer_set_gain(inputs[p], gains[p]);
+            threads.emplace_back(playShared, inputs[p], std::cref(audio));
+        }else
+        {
+            threads.emplace_back(playPrivate, name, std::cref(audio), &ok[p]);
+        }
+    }
+    for(size_t i=0; i<threads.size(); i++) threads[i].join();
+    //the last detach closes the device, that is part of the cost
+    for(int p=0; p<players; p++)
+    {
+        if(inputs[p]) omxalsa_mixer_detach(inputs[p]);
+    }
+    double cpu = now(CLOCK_PROCESS_CPUTIME_ID)-start;
+
+    for(int p=0; p<players; p++)
+    {
+        if(!ok[p]) return -1;
+    }
+    return cpu;
+}
+
+static bool verify(const std::vector<int16_t>& audio)
+{
+    const int players = 4;
+    const float gains[players] = {1.0f, 0.5f, 0.25f, 0.125f};
+    std::string file = "/tmp/alsa-mixer.raw";
+    std::string name = "file:FILE=" + file + ",FORMAT=raw";
+    remove(file.c_str());
+    if(run(name.c_str(), true, players, audio, gains) < 0) return false;
+
+    //every player plays the same constant, so whatever mixes the inputs went
+    //in together, each output sample is a sum of some of the scaled values
+    //and the total has to come out the same
+    FILE* f = fopen(file.c_str(), "rb");
+    if(!f) return false;
+    std::vector<int16_t> out;
+    int16_t sample;
+    while(fread(&sample, sizeof(sample), 1, f) == 1) out.push_back(sample);
+    fclose(f);
+
+    long long expected = 0, got = 0;
+    int stray = 0;
+    for(int p=0; p<players; p++)
+    {
+        expected += (long long)(audio.size()/(blockFrames*channels)*blockFrames*channels)*(long long)(audio[0]*gains[p]);
+    }
+    for(size_t i=0; i<out.size(); i++)
+    {
+        got += out[i];
+        bool possible = false;
+        for(int mask=0; mask<(1<<players) && !possible; mask++)
+        {
+            int sum = 0;
+            for(int p=0; p<players; p++) if(mask & (1<<p)) sum += audio[0]*gains[p];
+            possible = out[i] == sum;
+        }
+        if(!possible) stray++;
+    }
+    printf("%d players, gains 1 .. 1/8: %zu frames out, sum %lld expected %lld, %d stray samples: %s\n",
+           players, out.size()/channels, got, expected, stray, got == expected && !stray ? "ok" : "MISMATCH");
+    return got == expected && !stray;
+}
+
+int main(int argc, char** argv)
+{
+    bool check = argc > 1 && strcmp(argv[1], "--verify") == 0;
+    const char* device = argc > 1 && !check ? argv[1] : "null";
+    double seconds = argc > 2 ? atof(argv[2]) : (check ? 2 : 30);
+
+    std::vector<int16_t> audio((size_t)(seconds*rate)*channels);
+    if(check)
+    {
+        for(size_t i=0; i<audio.size(); i++) audio[i] = 4096;
+        return verify(audio) ? 0 : 1;
+    }
+    srand(1);
+    for(size_t i=0; i<audio.size(); i++)
+    {
+        audio[i] = rand()%16384-8192;
+    }
+
+    printf("%s, %gs of 48kHz S16 stereo per player in %d frame blocks, CPU ms per second of audio\n", device, seconds, blockFrames);
+    printf("%8s %10s %10s\n", "players", "private", "shared");
+    int counts[] = {1, 2, 4, 8};
+    for(size_t i=0; i<sizeof(counts)/sizeof(counts[0]); i++)
+    {
+        double separate = run(device, false, counts[i], audio);
+        double shared = run(device, true, counts[i], audio);
+        if(shared < 0) return 1;
+        if(separate < 0)
+        {
+            printf("%8d %10s %10.3f   (device cannot be opened %d times)\n", counts[i], "-", shared*1000/seconds, counts[i]);
+        }else
+        {
+            printf("%8d %10.3f %10.3f\n", counts[i], separate*1000/seconds, shared*1000/seconds);
+        }
+    }
+    return 0;
+}
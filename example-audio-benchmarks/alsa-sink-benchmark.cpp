@@ -0,0 +1,219 @@
+// Benchmark for the OMX ALSA sink's transfer path (src/OMXAlsaWriter), runs
+// on any Linux box with alsa-lib and swresample
+//
+//   alsa-sink-benchmark [device] [seconds of audio]
+//   alsa-sink-benchmark --verify
+//
+// Pushes 48kHz S16 stereo through the writer the way omxalsasink_worker
+// does, in 8KB blocks (the sink's default OMX buffer size), once with
+// snd_pcm_writei from a bounce buffer and once with mmap straight into the
+// device ring.
+// Three kinds of audio the sink sees:
+//   bypass      PCM passed through as is, what the sink does at nominal
+//               clock speed now that it bypasses the resampler
+//   swr nominal swresample with no compensation, what it did before
+//   swr drift   swresample compensating a slightly fast clock
+// Defaults to the null device, which throws audio away as fast as it comes
+// so the numbers are CPU per second of audio rather than playback time.
+//
+// --verify writes every case through the file plugin into /tmp and checks
+// the writei and mmap captures are byte identical.
+
+#include "OMXAlsaWriter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libswresample/swresample.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+}
+
+static const unsigned int rate = 48000;
+static const int channels = 2;
+static const int frameSize = channels*2;
+static const int blockFrames = 8*1024/frameSize;
+
+static double now(clockid_t clock)
+{
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+struct Resample
+{
+    SwrContext* resampler;
+    const uint8_t* in;
+    int inLength;
+};
+
+//omxalsasink_resample without the flush
+static snd_pcm_uframes_t resample(void* ctx, uint8_t* dst, snd_pcm_uframes_t frames)
+{
+    Resample* rs = (Resample*)ctx;
+    int n = swr_convert(rs->resampler, &dst, frames, &rs->in, rs->inLength);
+    rs->inLength = 0;
+    return n > 0 ? n : 0;
+}
+
+static snd_pcm_t* openDevice(const char* name, bool tryMmap, bool* mmap)
+{
+    snd_pcm_t* dev = NULL;
+    snd_pcm_hw_params_t* hwp;
+    snd_pcm_uframes_t bufferSize = rate/5, periodSize = bufferSize/4;
+    unsigned int actualRate = rate;
+
+    int err = snd_pcm_open(&dev, name, SND_PCM_STREAM_PLAYBACK, 0);
+    if(err < 0)
+    {
+        fprintf(stderr, "snd_pcm_open %s: %s\n", name, snd_strerror(err));
+        return NULL;
+    }
+    snd_pcm_hw_params_alloca(&hwp);
+    snd_pcm_hw_params_any(dev, hwp);
+    if(snd_pcm_hw_params_set_channels(dev, hwp, channels) < 0 ||
+       alsa_writer_set_access(dev, hwp, true, tryMmap, mmap) < 0 ||
+       snd_pcm_hw_params_set_rate_near(dev, hwp, &actualRate, 0) < 0 ||
+       snd_pcm_hw_params_set_format(dev, hwp, SND_PCM_FORMAT_S16_LE) < 0 ||
+       snd_pcm_hw_params_set_buffer_size_near(dev, hwp, &bufferSize) < 0 ||
+       snd_pcm_hw_params_set_period_size_near(dev, hwp, &periodSize, 0) < 0 ||
+       snd_pcm_hw_params(dev, hwp) < 0)
+    {
+        fprintf(stderr, "%s: could not configure 48kHz S16 stereo\n", name);
+        snd_pcm_close(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+enum Mode
+{
+    BYPASS,
+    SWR_NOMINAL,
+    SWR_DRIFT
+};
+
+//returns CPU seconds spent, or -1
+static double run(const char* name, bool tryMmap, Mode mode, const std::vector<int16_t>& audio, bool* usedMmap)
+{
+    snd_pcm_t* dev = openDevice(name, tryMmap, usedMmap);
+    if(!dev) return -1;
+
+    ALSA_WRITER writer;
+    if(alsa_writer_init(&writer, dev, frameSize, *usedMmap, blockFrames*2) < 0)
+    {
+        snd_pcm_close(dev);
+        return -1;
+    }
+
+    SwrContext* resampler = NULL;
+    if(mode != BYPASS)
+    {
+        int64_t layout = av_get_default_channel_layout(channels);
+        resampler = swr_alloc_set_opts(NULL, layout, AV_SAMPLE_FMT_S16, rate, layout, AV_SAMPLE_FMT_S16, rate, 0, NULL);
+        av_opt_set_double(resampler, "cutoff", 0.985, 0);
+        av_opt_set_int(resampler, "filter_size", 64, 0);
+        swr_init(resampler);
+    }
+
+    int totalFrames = audio.size()/channels;
+    double start = now(CLOCK_PROCESS_CPUTIME_ID);
+    for(int offset = 0; offset + blockFrames <= totalFrames; offset += blockFrames)
+    {
+        const uint8_t* block = (const uint8_t*)&audio[offset*channels];
+        if(resampler)
+        {
+            //a slightly fast clock, what the sink sees while tracking drift
+            int delta = mode == SWR_DRIFT ? ((int64_t)blockFrames*(0x10000-0x10040))>>16 : 0;
+            swr_set_compensation(resampler, delta, blockFrames);
+            Resample rs = {resampler, block, blockFrames};
+            alsa_writer_fill(&writer, resample, &rs);
+        }else
+        {
+            alsa_writer_write(&writer, block, blockFrames);
+        }
+    }
+    double cpu = now(CLOCK_PROCESS_CPUTIME_ID)-start;
+
+    snd_pcm_drain(dev);
+    if(writer.xruns) printf("    (%u xruns)\n", writer.xruns);
+    alsa_writer_fini(&writer);
+    if(resampler) swr_free(&resampler);
+    snd_pcm_close(dev);
+    return cpu;
+}
+
+static bool sameFile(const std::string& a, const std::string& b)
+{
+    FILE* fa = fopen(a.c_str(), "rb");
+    FILE* fb = fopen(b.c_str(), "rb");
+    bool same = fa && fb;
+    while(same)
+    {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        same = ca == cb;
+        if(ca == EOF) break;
+    }
+    if(fa) fclose(fa);
+    if(fb) fclose(fb);
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    bool verify = argc > 1 && strcmp(argv[1], "--verify") == 0;
+    const char* device = argc > 1 && !verify ? argv[1] : "null";
+    double seconds = argc > 2 ? atof(argv[2]) : (verify ? 2 : 60);
+
+    std::vector<int16_t> audio((size_t)(seconds*rate)*channels);
+    srand(1);
+    for(size_t i=0; i<audio.size(); i++)
+    {
+        audio[i] = rand()%16384-8192;
+    }
+
+    const char* modes[] = {"bypass", "swr nominal", "swr drift"};
+    int numModes = sizeof(modes)/sizeof(modes[0]);
+    if(verify)
+    {
+        bool ok = true;
+        for(int m=0; m<numModes; m++)
+        {
+            std::string files[2];
+            bool mmap[2];
+            for(int i=0; i<2; i++)
+            {
+                files[i] = std::string("/tmp/alsa-sink-") + std::to_string(m) + (i ? "-mmap.raw" : "-writei.raw");
+                remove(files[i].c_str());
+                std::string name = "file:FILE=" + files[i] + ",FORMAT=raw";
+                run(name.c_str(), i == 1, (Mode)m, audio, &mmap[i]);
+            }
+            bool same = sameFile(files[0], files[1]);
+            printf("%-12s writei vs %s: %s\n", modes[m], mmap[1] ? "mmap" : "writei (no mmap support)", same ? "identical" : "MISMATCH");
+            ok = ok && same;
+        }
+        return ok ? 0 : 1;
+    }
+
+    printf("%s, %.0fs of 48kHz S16 stereo in %d frame blocks, CPU ms per second of audio\n", device, seconds, blockFrames);
+    printf("%-12s %10s %10s   %s\n", "", "writei", "mmap", "speedup");
+    double bypass = 0, nominal = 0;
+    for(int m=0; m<numModes; m++)
+    {
+        bool mmap;
+        double writei = run(device, false, (Mode)m, audio, &mmap);
+        double direct = run(device, true, (Mode)m, audio, &mmap);
+        if(writei < 0 || direct < 0) return 1;
+        printf("%-12s %10.3f %10.3f   x%.2f%s\n", modes[m], writei*1000/seconds, direct*1000/seconds, writei/direct, mmap ? "" : " (device has no mmap, both writei)");
+        if(m == BYPASS) bypass = direct;
+        if(m == SWR_NOMINAL) nominal = direct;
+    }
+    printf("bypassing the resampler at nominal speed: x%.1f less CPU\n", nominal/bypass);
+    return 0;
+}
@@ -0,0 +1,309 @@
+// Benchmark for src/utils/AudioKernels, runs on any Linux box
+//
+//   audio-kernels-benchmark [samples] [channels] [seconds]
+//
+// For every conversion the audio path uses, times a plain per-sample loop
+// (what the compiler makes of the code the kernels replace), the kernel and,
+// when built with make SWR=1, swresample doing the same conversion. Outputs
+// are compared sample by sample, so a kernel that is fast but wrong shows up
+// as a MISMATCH. Defaults to 1024 samples (one AAC frame) of stereo, 0.5s
+// per measurement.
+
+#include "utils/AudioKernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <functional>
+
+#ifdef HAVE_SWRESAMPLE
+extern "C" {
+#include <libswresample/swresample.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+#endif
+
+static double seconds = 0.5;
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+//returns millions of samples (across all channels) per second
+static double measure(std::function<void()> run, int samplesPerRun)
+{
+    run();
+    long runs = 0;
+    double start = now();
+    double elapsed = 0;
+    while(elapsed < seconds)
+    {
+        for(int i=0; i<64; i++) run();
+        runs += 64;
+        elapsed = now()-start;
+    }
+    return runs*(double)samplesPerRun/elapsed/1e6;
+}
+
+static void report(const char* name, double reference, double kernel, double swr, bool matches)
+{
+    printf("%-22s %10.1f %10.1f", name, reference, kernel);
+    if(swr > 0) printf(" %10.1f", swr); else printf(" %10s", "-");
+    printf("   x%-5.1f %s\n", kernel/reference, matches ? "" : "MISMATCH");
+}
+
+#ifdef HAVE_SWRESAMPLE
+static SwrContext* createConverter(int channels, AVSampleFormat from, AVSampleFormat to)
+{
+    int64_t layout = av_get_default_channel_layout(channels);
+    SwrContext* context = swr_alloc_set_opts(NULL, layout, to, 48000, layout, from, 48000, 0, NULL);
+    if(!context || swr_init(context) < 0)
+    {
+        fprintf(stderr, "swr_init failed\n");
+        exit(1);
+    }
+    return context;
+}
+
+static double measureSwr(int channels, int samples, AVSampleFormat from, AVSampleFormat to, const void* const* in, void* const* out)
+{
+    SwrContext* context = createConverter(channels, from, to);
+    double result = measure([&]{
+        swr_convert(context, (uint8_t**)out, samples, (const uint8_t**)in, samples);
+    }, samples*channels);
+    swr_free(&context);
+    return result;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    int samples = argc > 1 ? atoi(argv[1]) : 1024;
+    int channels = argc > 2 ? atoi(argv[2]) : 2;
+    if(argc > 3) seconds = atof(argv[3]);
+    int count = samples*channels;
+
+    //slightly over full scale so the saturating paths are exercised
+    srand(1);
+    std::vector<float> floats(count);
+    std::vector<int16_t> shorts(count);
+    std::vector<int32_t> ints(count);
+    for(int i=0; i<count; i++)
+    {
+        floats[i] = (rand()/(float)RAND_MAX*2.0f-1.0f)*1.1f;
+        shorts[i] = rand()%65536-32768;
+        ints[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+    }
+    floats[0] = 1.0f;
+    floats[1%count] = -1.0f;
+
+    std::vector<float> referenceOut(count), kernelOut(count);
+    std::vector<int16_t> referenceShorts(count), kernelShorts(count);
+    std::vector<int32_t> referenceInts(count), kernelInts(count);
+    std::vector<const void*> inPlanes(channels);
+    std::vector<void*> referencePlanes(channels), kernelPlanes(channels);
+
+    printf("audio kernels: %s, %d samples x %d channels, Msamples/s\n", AudioKernels::GetImplementation(), samples, channels);
+    printf("%-22s %10s %10s %10s   %s\n", "", "loop", "kernel", "swr", "speedup");
+
+    //FLTP -> FLT
+    for(int c=0; c<channels; c++) inPlanes[c] = &floats[c*samples];
+    double reference = measure([&]{
+        for(int c=0; c<channels; c++)
+        {
+            const float* plane = (const float*)inPlanes[c];
+            for(int i=0; i<samples; i++) referenceOut[i*channels+c] = plane[i];
+        }
+    }, count);
+    double kernel = measure([&]{ AudioKernels::Interleave32(inPlanes.data(), kernelOut.data(), channels, samples); }, count);
+    double swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    void* swrOut[] = {kernelOut.data()};
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT, inPlanes.data(), swrOut);
+    AudioKernels::Interleave32(inPlanes.data(), kernelOut.data(), channels, samples);
+#endif
+    report("fltp -> flt", reference, kernel, swr, referenceOut == kernelOut);
+
+    //FLT -> FLTP
+    for(int c=0; c<channels; c++)
+    {
+        referencePlanes[c] = &referenceOut[c*samples];
+        kernelPlanes[c] = &kernelOut[c*samples];
+    }
+    reference = measure([&]{
+        for(int c=0; c<channels; c++)
+        {
+            float* plane = (float*)referencePlanes[c];
+            for(int i=0; i<samples; i++) plane[i] = floats[i*channels+c];
+        }
+    }, count);
+    kernel = measure([&]{ AudioKernels::Deinterleave32(floats.data(), kernelPlanes.data(), channels, samples); }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    const void* swrIn[] = {floats.data()};
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP, swrIn, kernelPlanes.data());
+    AudioKernels::Deinterleave32(floats.data(), kernelPlanes.data(), channels, samples);
+#endif
+    report("flt -> fltp", reference, kernel, swr, referenceOut == kernelOut);
+
+    //S16 -> FLTP
+    reference = measure([&]{
+        for(int c=0; c<channels; c++)
+        {
+            float* plane = (float*)referencePlanes[c];
+            for(int i=0; i<samples; i++) plane[i] = shorts[i*channels+c]*(1.0f/(1<<15));
+        }
+    }, count);
+    kernel = measure([&]{ AudioKernels::S16ToFloatPlanar(shorts.data(), (float* const*)kernelPlanes.data(), channels, samples); }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    const void* swrShorts[] = {shorts.data()};
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLTP, swrShorts, kernelPlanes.data());
+    AudioKernels::S16ToFloatPlanar(shorts.data(), (float* const*)kernelPlanes.data(), channels, samples);
+#endif
+    report("s16 -> fltp", reference, kernel, swr, referenceOut == kernelOut);
+
+    //S16P -> FLTP
+    for(int c=0; c<channels; c++) inPlanes[c] = &shorts[c*samples];
+    reference = measure([&]{
+        for(int c=0; c<channels; c++)
+        {
+            const int16_t* in = (const int16_t*)inPlanes[c];
+            float* plane = (float*)referencePlanes[c];
+            for(int i=0; i<samples; i++) plane[i] = in[i]*(1.0f/(1<<15));
+        }
+    }, count);
+    kernel = measure([&]{
+        for(int c=0; c<channels; c++) AudioKernels::S16ToFloat((const int16_t*)inPlanes[c], (float*)kernelPlanes[c], samples);
+    }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLTP, inPlanes.data(), kernelPlanes.data());
+    for(int c=0; c<channels; c++) AudioKernels::S16ToFloat((const int16_t*)inPlanes[c], (float*)kernelPlanes[c], samples);
+#endif
+    report("s16p -> fltp", reference, kernel, swr, referenceOut == kernelOut);
+
+    //S32P -> FLTP
+    for(int c=0; c<channels; c++) inPlanes[c] = &ints[c*samples];
+    reference = measure([&]{
+        for(int c=0; c<channels; c++)
+        {
+            const int32_t* in = (const int32_t*)inPlanes[c];
+            float* plane = (float*)referencePlanes[c];
+            for(int i=0; i<samples; i++) plane[i] = in[i]*(1.0f/(1U<<31));
+        }
+    }, count);
+    kernel = measure([&]{
+        for(int c=0; c<channels; c++) AudioKernels::S32ToFloat((const int32_t*)inPlanes[c], (float*)kernelPlanes[c], samples);
+    }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, inPlanes.data(), kernelPlanes.data());
+    for(int c=0; c<channels; c++) AudioKernels::S32ToFloat((const int32_t*)inPlanes[c], (float*)kernelPlanes[c], samples);
+#endif
+    report("s32p -> fltp", reference, kernel, swr, referenceOut == kernelOut);
+
+    //FLT -> S16
+    reference = measure([&]{
+        for(int i=0; i<count; i++)
+        {
+            long value = lrintf(floats[i]*(1<<15));
+            referenceShorts[i] = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+        }
+    }, count);
+    kernel = measure([&]{ AudioKernels::FloatToS16(floats.data(), kernelShorts.data(), count); }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    const void* swrFloats[] = {floats.data()};
+    void* swrShortsOut[] = {kernelShorts.data()};
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, swrFloats, swrShortsOut);
+    AudioKernels::FloatToS16(floats.data(), kernelShorts.data(), count);
+#endif
+    report("flt -> s16", reference, kernel, swr, referenceShorts == kernelShorts);
+
+    //FLT -> S32
+    reference = measure([&]{
+        for(int i=0; i<count; i++)
+        {
+            long long value = llrintf(floats[i]*(1U<<31));
+            referenceInts[i] = value > 2147483647LL ? 2147483647 : (value < -2147483648LL ? (int32_t)-2147483648LL : value);
+        }
+    }, count);
+    kernel = measure([&]{ AudioKernels::FloatToS32(floats.data(), kernelInts.data(), count); }, count);
+    swr = 0;
+#ifdef HAVE_SWRESAMPLE
+    void* swrIntsOut[] = {kernelInts.data()};
+    swr = measureSwr(channels, samples, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S32, swrFloats, swrIntsOut);
+    AudioKernels::FloatToS32(floats.data(), kernelInts.data(), count);
+#endif
+    report("flt -> s32", reference, kernel, swr, referenceInts == kernelInts);
+
+    //gain, swresample has no equivalent
+    float gain = 0.7f;
+    reference = measure([&]{
+        for(int i=0; i<count; i++) referenceOut[i] = floats[i]*gain;
+    }, count);
+    kernel = measure([&]{ AudioKernels::ApplyGain(floats.data(), kernelOut.data(), count, gain); }, count);
+    report("gain flt", reference, kernel, 0, referenceOut == kernelOut);
+
+    gain = 1.4f;
+    reference = measure([&]{
+        for(int i=0; i<count; i++)
+        {
+            long value = lrintf(shorts[i]*gain);
+            referenceShorts[i] = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+        }
+    }, count);
+    kernel = measure([&]{ AudioKernels::ApplyGainS16(shorts.data(), kernelShorts.data(), count, gain); }, count);
+    report("gain s16", reference, kernel, 0, referenceShorts == kernelShorts);
+
+    //summing a stream into the mix, what the shared ALSA output does per player
+    gain = 0.7f;
+    reference = measure([&]{
+        for(int i=0; i<count; i++) referenceOut[i] += shorts[i]*(gain/(1<<15));
+    }, count);
+    kernel = measure([&]{ AudioKernels::AccumulateS16(shorts.data(), kernelOut.data(), count, gain); }, count);
+    //the timed runs pile up, compare one pass over the same starting mix
+    referenceOut = floats;
+    kernelOut = floats;
+    for(int i=0; i<count; i++) referenceOut[i] += shorts[i]*(gain/(1<<15));
+    AudioKernels::AccumulateS16(shorts.data(), kernelOut.data(), count, gain);
+    report("mix s16", reference, kernel, 0, referenceOut == kernelOut);
+
+    //per channel levels, what the audio tap computes for every block
+    if(channels <= 8)
+    {
+        float referencePeak[8], referenceRms[8], kernelPeak[8], kernelRms[8];
+        reference = measure([&]{
+            for(int c=0; c<channels; c++)
+            {
+                float peak = 0, sum = 0;
+                for(int i=0; i<samples; i++)
+                {
+                    float x = floats[i*channels+c];
+                    peak = fmaxf(peak, fabsf(x));
+                    sum += x*x;
+                }
+                referencePeak[c] = peak;
+                referenceRms[c] = sqrtf(sum/samples);
+            }
+        }, count);
+        kernel = measure([&]{ AudioKernels::Levels(floats.data(), channels, samples, kernelPeak, kernelRms); }, count);
+        //the sums are added up in a different order, so RMS only matches closely
+        bool matches = true;
+        for(int c=0; c<channels; c++)
+        {
+            matches = matches && referencePeak[c] == kernelPeak[c] && fabsf(referenceRms[c]-kernelRms[c]) <= 1e-5f*referenceRms[c];
+        }
+        report("levels flt", reference, kernel, 0, matches);
+    }
+
+    return 0;
+}
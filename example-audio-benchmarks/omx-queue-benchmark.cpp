@@ -0,0 +1,281 @@
+// Benchmark for the buffer handoff in the software OMX components
+// (src/OMXGeneric.h), runs on any Linux box with the OpenMAX IL headers
+//
+//   omx-queue-benchmark [seconds]
+//
+// A null sink built on the same framework as the ALSA sink takes buffers
+// through OMX_EmptyThisBuffer, its worker picks them up and hands them
+// straight back through EmptyBufferDone, and the client submits them again.
+// No hardware or ALSA involved, so the rate is what the handoff itself
+// costs. Runs the sink two ways:
+//   locked      every step under the component mutex, with the worker
+//               dropping and retaking it around its work and the callback,
+//               the way the gomx components used to exchange buffers
+//   lock-free   the port queues and worker wakeup as they are now
+// with as few and with more buffers in flight than the ALSA sink uses.
+
+#include "utils/log.h"
+#include "OMXGeneric.h"
+
+#include <sched.h>
+#include <vector>
+
+//the real CLog needs openFrameworks
+void CLog::Log(int loglevel, const char *format, ...)
+{
+}
+
+static double seconds = 2;
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+struct NullSink
+{
+    GOMX_COMPONENT gcomp;
+    GOMX_PORT port;
+    GOMX_QUEUE playq;
+    bool locked;
+    size_t played;
+};
+
+static bool nullSinkReady(GOMX_COMPONENT* comp)
+{
+    NullSink* sink = (NullSink*)comp;
+    return gomxq_size(&sink->playq) != 0;
+}
+
+static void* nullSinkWorker(void* ptr)
+{
+    GOMX_COMPONENT* comp = (GOMX_COMPONENT*)ptr;
+    NullSink* sink = (NullSink*)comp;
+    OMX_BUFFERHEADERTYPE* buf;
+
+    if(sink->locked)
+    {
+        pthread_mutex_lock(&comp->mutex);
+        while(comp->wanted_state == OMX_StateExecuting)
+        {
+            buf = (OMX_BUFFERHEADERTYPE*)gomxq_dequeue(&sink->playq);
+            if(!buf)
+            {
+                pthread_cond_wait(&comp->worker_cond, &comp->mutex);
+                continue;
+            }
+            //around the clock update and the device write
+            pthread_mutex_unlock(&comp->mutex);
+            sink->played += buf->nFilledLen;
+            pthread_mutex_lock(&comp->mutex);
+            //around the callback
+            pthread_mutex_unlock(&comp->mutex);
+            __gomx_process_mark(comp, buf);
+            __gomx_empty_buffer_done(comp, buf);
+            pthread_mutex_lock(&comp->mutex);
+        }
+        pthread_mutex_unlock(&comp->mutex);
+        return 0;
+    }
+
+    while(__atomic_load_n(&comp->wanted_state, __ATOMIC_ACQUIRE) == OMX_StateExecuting)
+    {
+        buf = (OMX_BUFFERHEADERTYPE*)gomxq_dequeue(&sink->playq);
+        if(!buf)
+        {
+            gomx_worker_sleep(comp, nullSinkReady, 0);
+            continue;
+        }
+        sink->played += buf->nFilledLen;
+        __gomx_process_mark(comp, buf);
+        __gomx_empty_buffer_done(comp, buf);
+    }
+    return 0;
+}
+
+static OMX_ERRORTYPE nullSinkDoBuffer(GOMX_COMPONENT* comp, GOMX_PORT* port, OMX_BUFFERHEADERTYPE* buf)
+{
+    NullSink* sink = (NullSink*)comp;
+    if(sink->locked)
+    {
+        pthread_mutex_lock(&comp->mutex);
+        gomxq_enqueue(&sink->playq, buf);
+        pthread_cond_signal(&comp->worker_cond);
+        pthread_mutex_unlock(&comp->mutex);
+        return OMX_ErrorNone;
+    }
+    if(!gomxq_enqueue(&sink->playq, buf)) return OMX_ErrorInsufficientResources;
+    gomx_worker_wake(comp);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE nullSinkDeinit(OMX_HANDLETYPE hComponent)
+{
+    NullSink* sink = (NullSink*)hComponent;
+    gomx_fini(&sink->gcomp);
+    return OMX_ErrorNone;
+}
+
+struct Client
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int completed;
+    //buffers the sink has handed back, the client resubmits from here
+    GOMX_QUEUE returned;
+};
+
+static OMX_ERRORTYPE eventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+    Client* client = (Client*)pAppData;
+    if(eEvent == OMX_EventCmdComplete)
+    {
+        pthread_mutex_lock(&client->mutex);
+        client->completed++;
+        pthread_cond_signal(&client->cond);
+        pthread_mutex_unlock(&client->mutex);
+    }else if(eEvent == OMX_EventError)
+    {
+        fprintf(stderr, "component error %x\n", nData1);
+    }
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE emptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    Client* client = (Client*)pBuffer->pAppPrivate;
+    gomxq_enqueue(&client->returned, pBuffer);
+    return OMX_ErrorNone;
+}
+
+static void waitState(Client* client, int completed)
+{
+    pthread_mutex_lock(&client->mutex);
+    while(client->completed < completed)
+    {
+        pthread_cond_wait(&client->cond, &client->mutex);
+    }
+    pthread_mutex_unlock(&client->mutex);
+}
+
+//returns buffers per second
+static double run(bool locked, int numBuffers)
+{
+    static const OMX_U32 bufferSize = 8*1024;
+    Client client;
+    pthread_mutex_init(&client.mutex, 0);
+    pthread_cond_init(&client.cond, 0);
+    client.completed = 0;
+    gomxq_init(&client.returned);
+
+    OMX_CALLBACKTYPE callbacks;
+    callbacks.EventHandler = eventHandler;
+    callbacks.EmptyBufferDone = emptyBufferDone;
+    callbacks.FillBufferDone = 0;
+
+    NullSink* sink = (NullSink*)calloc(1, sizeof(NullSink));
+    sink->locked = locked;
+    gomxq_init(&sink->playq);
+    GOMX_PORT* port = &sink->port;
+    port->def.nSize = sizeof port->def;
+    port->def.nVersion.nVersion = OMX_VERSION;
+    port->def.nPortIndex = 0;
+    port->def.eDir = OMX_DirInput;
+    port->def.nBufferCountMin = numBuffers;
+    port->def.nBufferCountActual = numBuffers;
+    port->def.nBufferSize = bufferSize;
+    port->def.bEnabled = OMX_TRUE;
+    port->def.eDomain = OMX_PortDomainAudio;
+    port->def.nBufferAlignment = 4;
+    port->do_buffer = nullSinkDoBuffer;
+    gomx_init(&sink->gcomp, "OMX.null.audio_render", &client, &callbacks, port, 1);
+    sink->gcomp.omx.ComponentDeInit = nullSinkDeinit;
+    sink->gcomp.worker = nullSinkWorker;
+    OMX_HANDLETYPE handle = (OMX_HANDLETYPE)sink;
+
+    std::vector<OMX_BUFFERHEADERTYPE*> buffers(numBuffers);
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateIdle, 0);
+    for(int i=0; i<numBuffers; i++)
+    {
+        //refused until the command thread has picked up the state change
+        while(OMX_AllocateBuffer(handle, &buffers[i], 0, &client, bufferSize) == OMX_ErrorIncorrectStateOperation)
+        {
+            sched_yield();
+        }
+        buffers[i]->nFilledLen = bufferSize;
+    }
+    waitState(&client, 1);
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateExecuting, 0);
+    waitState(&client, 2);
+
+    for(int i=0; i<numBuffers; i++)
+    {
+        gomxq_enqueue(&client.returned, buffers[i]);
+    }
+    long submitted = 0;
+    double start = now();
+    double elapsed = 0;
+    while(elapsed < seconds)
+    {
+        for(int i=0; i<1024; i++)
+        {
+            OMX_BUFFERHEADERTYPE* buf = (OMX_BUFFERHEADERTYPE*)gomxq_dequeue(&client.returned);
+            if(!buf)
+            {
+                sched_yield();
+                continue;
+            }
+            OMX_EmptyThisBuffer(handle, buf);
+            submitted++;
+        }
+        elapsed = now()-start;
+    }
+    //let everything in flight come back before stopping
+    while(gomxq_size(&client.returned) != (size_t)numBuffers)
+    {
+        sched_yield();
+    }
+    elapsed = now()-start;
+
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateIdle, 0);
+    waitState(&client, 3);
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateLoaded, 0);
+    //freeing before the command thread is on its way to Loaded is an error
+    while(__atomic_load_n(&sink->gcomp.wanted_state, __ATOMIC_ACQUIRE) != OMX_StateLoaded)
+    {
+        sched_yield();
+    }
+    for(int i=0; i<numBuffers; i++)
+    {
+        OMX_FreeBuffer(handle, 0, buffers[i]);
+    }
+    waitState(&client, 4);
+
+    if(sink->played != (size_t)submitted*bufferSize)
+    {
+        printf("MISMATCH: submitted %ld buffers, sink played %zu\n", submitted, sink->played/bufferSize);
+    }
+    ((OMX_COMPONENTTYPE*)handle)->ComponentDeInit(handle);
+    free(sink);
+    pthread_mutex_destroy(&client.mutex);
+    pthread_cond_destroy(&client.cond);
+    return submitted/elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1) seconds = atof(argv[1]);
+
+    printf("EmptyThisBuffer -> worker -> EmptyBufferDone, 8KB buffers, thousands of buffers/s\n");
+    printf("%8s %10s %10s   %s\n", "buffers", "locked", "lock-free", "speedup");
+    int counts[] = {1, 4, 16};
+    for(size_t i=0; i<sizeof(counts)/sizeof(counts[0]); i++)
+    {
+        double locked = run(true, counts[i]);
+        double lockFree = run(false, counts[i]);
+        printf("%8d %10.1f %10.1f   x%.2f\n", counts[i], locked/1e3, lockFree/1e3, lockFree/locked);
+    }
+    return 0;
+}
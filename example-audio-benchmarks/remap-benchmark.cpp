@@ -0,0 +1,157 @@
+// Benchmark for the software downmix in CPCMRemap::Remap, runs on any Linux box
+//
+//   remap-benchmark [seconds]
+//
+// Downmixes 5.1 and 7.1 float audio to stereo at several buffer sizes with
+// the matrix CPCMRemap builds, comparing Remap() against a plain loop over
+// the same matrix and, when built with make SWR=1, swresample's rematrix.
+// Runs once with normalized levels and once with boostOnDownmix style
+// unnormalized levels, which is the case the limiter is there for.
+
+#include "utils/PCMRemap.h"
+#include "utils/log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <functional>
+
+#ifdef HAVE_SWRESAMPLE
+extern "C" {
+#include <libswresample/swresample.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+#endif
+
+//the real CLog needs openFrameworks
+void CLog::Log(int loglevel, const char *format, ...)
+{
+}
+
+static double seconds = 0.5;
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+//returns millions of input frames per second
+static double measure(std::function<void()> run, int frames)
+{
+    run();
+    long runs = 0;
+    double start = now();
+    double elapsed = 0;
+    while(elapsed < seconds)
+    {
+        for(int i=0; i<16; i++) run();
+        runs += 16;
+        elapsed = now()-start;
+    }
+    return runs*(double)frames/elapsed/1e6;
+}
+
+static void run(const char* name, enum PCMChannels* inMap, int inChannels, bool dontnormalize)
+{
+    enum PCMChannels outMap[] = {PCM_FRONT_LEFT, PCM_FRONT_RIGHT};
+    CPCMRemap remap;
+    remap.SetInputFormat(inChannels, inMap, sizeof(float), 48000, PCM_LAYOUT_2_0, dontnormalize);
+    remap.SetOutputFormat(2, outMap);
+    if(!remap.CanRemap())
+    {
+        printf("%s: CanRemap() failed\n", name);
+        return;
+    }
+    float downmix[8*8];
+    remap.GetMixMatrix(downmix);
+
+    printf("%s %s, Mframes/s\n", name, dontnormalize ? "unnormalized (limiter on)" : "normalized");
+    printf("%8s %10s %10s %10s   %-7s %s\n", "frames", "loop", "remap", "swr", "speedup", dontnormalize ? "lowest attenuation" : "max diff");
+
+    int sizes[] = {64, 256, 1024, 4096};
+    for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++)
+    {
+        int frames = sizes[s];
+        std::vector<float> in(frames*inChannels);
+        std::vector<float> reference(frames*2), out(frames*2);
+        srand(1);
+        for(size_t i=0; i<in.size(); i++)
+        {
+            in[i] = (rand()/(float)RAND_MAX*2.0f-1.0f)*0.5f;
+        }
+
+        double loop = measure([&]{
+            for(int f=0; f<frames; f++)
+            {
+                for(int o=0; o<2; o++)
+                {
+                    float sum = 0;
+                    for(int i=0; i<inChannels; i++) sum += in[f*inChannels+i]*downmix[o*8+i];
+                    reference[f*2+o] = sum < -1.0f ? -1.0f : (sum > 1.0f ? 1.0f : sum);
+                }
+            }
+        }, frames);
+
+        //a fresh remapper per size so limiter state from earlier runs does not carry over
+        CPCMRemap measured;
+        measured.SetInputFormat(inChannels, inMap, sizeof(float), 48000, PCM_LAYOUT_2_0, dontnormalize);
+        measured.SetOutputFormat(2, outMap);
+        double remapped = measure([&]{ measured.Remap(in.data(), out.data(), frames); }, frames);
+
+        double swr = 0;
+#ifdef HAVE_SWRESAMPLE
+        int64_t inLayout = inChannels == 6 ? AV_CH_LAYOUT_5POINT1_BACK : AV_CH_LAYOUT_7POINT1;
+        SwrContext* context = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 48000, inLayout, AV_SAMPLE_FMT_FLT, 48000, 0, NULL);
+        double matrix[2*8];
+        for(int o=0; o<2; o++) for(int i=0; i<inChannels; i++) matrix[o*inChannels+i] = downmix[o*8+i];
+        swr_set_matrix(context, matrix, inChannels);
+        swr_init(context);
+        std::vector<float> swrOut(frames*2);
+        uint8_t* swrOutPlanes[] = {(uint8_t*)swrOut.data()};
+        const uint8_t* swrInPlanes[] = {(const uint8_t*)in.data()};
+        swr = measure([&]{ swr_convert(context, swrOutPlanes, frames, swrInPlanes, frames); }, frames);
+        swr_free(&context);
+#endif
+
+        //the loop result is unlimited, so with the limiter on report how hard it worked instead
+        CPCMRemap check;
+        check.SetInputFormat(inChannels, inMap, sizeof(float), 48000, PCM_LAYOUT_2_0, dontnormalize);
+        check.SetOutputFormat(2, outMap);
+        check.Remap(in.data(), out.data(), frames);
+        float maxDiff = 0;
+        for(int i=0; i<frames*2; i++)
+        {
+            maxDiff = fmaxf(maxDiff, fabsf(out[i]-reference[i]));
+        }
+
+        printf("%8d %10.1f %10.1f", frames, loop, remapped);
+        if(swr > 0) printf(" %10.1f", swr); else printf(" %10s", "-");
+        if(dontnormalize)
+        {
+            printf("   x%-6.1f %g\n", remapped/loop, check.GetCurrentAttenuation());
+        }else
+        {
+            printf("   x%-6.1f %g%s\n", remapped/loop, maxDiff, maxDiff > 1e-5f ? " MISMATCH" : "");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1) seconds = atof(argv[1]);
+
+    enum PCMChannels layout51[] = {PCM_FRONT_LEFT, PCM_FRONT_RIGHT, PCM_FRONT_CENTER, PCM_LOW_FREQUENCY, PCM_BACK_LEFT, PCM_BACK_RIGHT};
+    enum PCMChannels layout71[] = {PCM_FRONT_LEFT, PCM_FRONT_RIGHT, PCM_FRONT_CENTER, PCM_LOW_FREQUENCY, PCM_BACK_LEFT, PCM_BACK_RIGHT, PCM_SIDE_LEFT, PCM_SIDE_RIGHT};
+
+    run("5.1 -> 2.0", layout51, 6, false);
+    run("5.1 -> 2.0", layout51, 6, true);
+    run("7.1 -> 2.0", layout71, 8, false);
+    run("7.1 -> 2.0", layout71, 8, true);
+    return 0;
+}
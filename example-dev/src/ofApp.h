@@ -75,25 +75,25 @@ public:
                 
                 
                 ofxOMXPlayer* player = new ofxOMXPlayer();
-                //player->engine.m_config_video.aspectMode = 3;
-                /*player->engine.m_config_video.dst_rect.SetRect(settings.drawRectangle.x,
+                //player->engine->m_config_video.aspectMode = 3;
+                /*player->engine->m_config_video.dst_rect.SetRect(settings.drawRectangle.x,
                                                                settings.drawRectangle.y,
                                                                settings.drawRectangle.x+settings.drawRectangle.width,*/
                     
                 imageFilters = player->imageFilters;
                 if(!settings.enableTexture)
                 {
-                    player->engine.m_config_audio.device = "omx:alsa";
-                    //omxPlayer.engine.m_config_audio.subdevice = "default";
-                    player->engine.m_config_audio.subdevice = "hw:1,0";
+                    player->engine->m_config_audio.device = "omx:alsa";
+                    //omxPlayer.engine->m_config_audio.subdevice = "default";
+                    player->engine->m_config_audio.subdevice = "hw:1,0";
                 }
                 
                 player->setup(settings); 
                 omxPlayers.push_back(player);
                 
                 
-                //player->engine.m_config_audio.device = "omx:alsa";
-                //player->engine.m_config_audio.subdevice = "hw:1,0";
+                //player->engine->m_config_audio.device = "omx:alsa";
+                //player->engine->m_config_audio.subdevice = "hw:1,0";
 
                 //
                 //
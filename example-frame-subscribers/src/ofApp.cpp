@@ -0,0 +1,51 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup()
+{
+	string videoPath = ofToDataPath("../../../video/Timecoded_Big_bunny_1.mov", true);
+	
+	ofxOMXPlayerSettings settings;
+	settings.videoPath = videoPath;
+	settings.enableAudio = false;
+	//luma thumbnails are all the meters need
+	settings.pixelRequest = ofxOMXPixelRequest(320, 180, ofRectangle(), OF_PIXELS_GRAY);
+	omxPlayer.setup(settings);
+	
+	slowMeter.workMillis = 100;
+	omxPlayer.subscribeFrames(&fastMeter, 2);
+	omxPlayer.subscribeFrames(&slowMeter, 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::update()
+{
+	
+}
+
+//--------------------------------------------------------------
+void ofApp::draw()
+{
+	omxPlayer.draw(0, 0, ofGetWidth(), ofGetHeight());
+	
+	ofxOMXFrameSubscriberStats fastStats = omxPlayer.getFrameSubscriberStats(&fastMeter);
+	ofxOMXFrameSubscriberStats slowStats = omxPlayer.getFrameSubscriberStats(&slowMeter);
+	
+	stringstream info;
+	info << "decoded frame: " << omxPlayer.getDecodedFrameNumber() << "\n";
+	info << "fast meter frame: " << fastMeter.frameNumber << " brightness: " << fastMeter.brightness
+	<< " delivered: " << fastStats.numDelivered << " dropped: " << fastStats.numDropped
+	<< " latency ms: " << fastStats.averageLatencyMillis << "\n";
+	info << "slow meter frame: " << slowMeter.frameNumber << " brightness: " << slowMeter.brightness
+	<< " delivered: " << slowStats.numDelivered << " dropped: " << slowStats.numDropped
+	<< " latency ms: " << slowStats.averageLatencyMillis << "\n";
+	info << "pooled frames: " << omxPlayer.frameDispatcher.getPool()->getNumAllocated();
+	ofDrawBitmapStringHighlight(info.str(), 60, 60, ofColor(ofColor::black, 90), ofColor::yellow);
+}
+
+//--------------------------------------------------------------
+void ofApp::exit()
+{
+	omxPlayer.unsubscribeFrames(&fastMeter);
+	omxPlayer.unsubscribeFrames(&slowMeter);
+}
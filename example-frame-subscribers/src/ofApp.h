@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayer.h"
+
+//Averages luma on its own thread, takes a configurable time per frame to
+//show the drop-oldest policy
+class BrightnessMeter : public ofxOMXFrameSubscriber
+{
+public:
+	BrightnessMeter()
+	{
+		brightness = 0;
+		frameNumber = 0;
+		workMillis = 0;
+	}
+	void onFrame(ofxOMXFrameRef frame)
+	{
+		ofPixels& pixels = frame->pixels;
+		unsigned char* data = pixels.getData();
+		uint64_t sum = 0;
+		int numPixels = pixels.getWidth()*pixels.getHeight();
+		for(int i=0; i<numPixels; i++)
+		{
+			sum += data[i];
+		}
+		if(workMillis)
+		{
+			ofSleepMillis(workMillis);
+		}
+		brightness = numPixels ? sum/numPixels : 0;
+		frameNumber = frame->frameNumber;
+	}
+	volatile int brightness;
+	volatile int frameNumber;
+	int workMillis;
+};
+
+class ofApp : public ofBaseApp{
+	
+public:
+	
+	void setup();
+	void update();
+	void draw();
+	void exit();
+	
+	ofxOMXPlayer omxPlayer;
+	BrightnessMeter fastMeter;
+	BrightnessMeter slowMeter;
+};
@@ -18,6 +18,8 @@ void ofApp::setup()
 			settings.enableLooping = true;		//default true
 			settings.enableAudio = true;		//default true, save resources by disabling
 			settings.enableTexture = i==1;		//default true
+			//settings.alsaDevice = "default";	//play through ALSA instead of HDMI
+			//settings.sharedAudioOutput = true;	//and mix every player into one ALSA output
             
 			
 			ofxOMXPlayer* player = new ofxOMXPlayer();
@@ -0,0 +1,138 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup()
+{
+	string videoPath = ofToDataPath("../../../video/Timecoded_Big_bunny_1.mov", true);
+	
+	ofxOMXPlayerSettings settings;
+	settings.videoPath = videoPath;
+	settings.enableAudio = false;
+	settings.numPixelBuffers = 3;
+	omxPlayer.setup(settings);
+	
+	string names[] = {"RGBA", "RGB", "GRAY"};
+	ofPixelFormat formats[] = {OF_PIXELS_RGBA, OF_PIXELS_RGB, OF_PIXELS_GRAY};
+	for(int i=0; i<3; i++)
+	{
+		PixelFormatCase fullFrame;
+		fullFrame.name = names[i] + " full frame";
+		fullFrame.request.format = formats[i];
+		cases.push_back(fullFrame);
+		
+		PixelFormatCase thumbnail;
+		thumbnail.name = names[i] + " 320x180";
+		thumbnail.request = ofxOMXPixelRequest(320, 180, ofRectangle(), formats[i]);
+		cases.push_back(thumbnail);
+	}
+	
+	framesPerCase = 250;
+	currentCase = -1;
+	benchmarkCPUConversion();
+}
+
+//--------------------------------------------------------------
+void ofApp::benchmarkCPUConversion()
+{
+	int numPixels = 1920*1080;
+	vector<unsigned char> rgba(numPixels*4);
+	vector<unsigned char> converted(numPixels*3);
+	for(size_t i=0; i<rgba.size(); i++)
+	{
+		rgba[i] = ofRandom(255);
+	}
+	int iterations = 20;
+	
+	uint64_t start = ofGetElapsedTimeMicros();
+	for(int i=0; i<iterations; i++)
+	{
+		ofxOMXPixelConverter::convertRGBAToGray(&rgba[0], &converted[0], numPixels);
+	}
+	float grayMillis = (ofGetElapsedTimeMicros()-start)/1000.0f/iterations;
+	
+	start = ofGetElapsedTimeMicros();
+	for(int i=0; i<iterations; i++)
+	{
+		ofxOMXPixelConverter::convertRGBAToRGB(&rgba[0], &converted[0], numPixels);
+	}
+	float rgbMillis = (ofGetElapsedTimeMicros()-start)/1000.0f/iterations;
+	
+	report << "CPU 1920x1080 RGBA->GRAY: " << grayMillis << "ms RGBA->RGB: " << rgbMillis << "ms\n";
+	ofLogNotice(__func__) << report.str();
+}
+
+//--------------------------------------------------------------
+void ofApp::startCase(int index)
+{
+	currentCase = index;
+	framesRead = 0;
+	lastFrameNumber = omxPlayer.getDecodedFrameNumber();
+	omxPlayer.setPixelRequest(cases[index].request);
+}
+
+//--------------------------------------------------------------
+void ofApp::finishCase()
+{
+	PixelFormatCase& pixelCase = cases[currentCase];
+	pixelCase.stats = omxPlayer.getReadbackStats();
+	pixelCase.bytesPerFrame = omxPlayer.getPixelsWidth()*omxPlayer.getPixelsHeight()*ofxOMXPixelConverter::getNumChannels(pixelCase.request.format);
+	
+	stringstream line;
+	line << pixelCase.name
+	<< " bytes: " << pixelCase.bytesPerFrame
+	<< " readback ms avg: " << pixelCase.stats.averageMillis
+	<< " max: " << pixelCase.stats.maxMillis
+	<< " fps: " << ofGetFrameRate();
+	ofLogNotice(__func__) << line.str();
+	report << line.str() << "\n";
+}
+
+//--------------------------------------------------------------
+void ofApp::update()
+{
+	if(!omxPlayer.isOpen() || omxPlayer.getDecodedFrameNumber() == 0)
+	{
+		return;
+	}
+	if(currentCase < 0)
+	{
+		startCase(0);
+	}
+	if(currentCase >= (int)cases.size())
+	{
+		return;
+	}
+	
+	if(omxPlayer.isFrameNew())
+	{
+		omxPlayer.updatePixels();
+		framesRead++;
+	}
+	if(framesRead >= framesPerCase)
+	{
+		finishCase();
+		if(currentCase+1 < (int)cases.size())
+		{
+			startCase(currentCase+1);
+		}else
+		{
+			currentCase++;
+			ofLogNotice(__func__) << "DONE\n" << report.str();
+		}
+	}
+}
+
+
+//--------------------------------------------------------------
+void ofApp::draw()
+{
+	omxPlayer.draw(0, 0, ofGetWidth(), ofGetHeight());
+	
+	stringstream info;
+	if(currentCase >= 0 && currentCase < (int)cases.size())
+	{
+		info << "case: " << cases[currentCase].name << " " << framesRead << "/" << framesPerCase << "\n";
+	}
+	info << report.str();
+	ofDrawBitmapStringHighlight(info.str(), 60, 60, ofColor(ofColor::black, 90), ofColor::yellow);
+}
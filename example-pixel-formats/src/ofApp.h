@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayer.h"
+
+/*
+ Benchmarks getPixels() formats and sizes. Each case reads back
+ framesPerCase decoded frames, then the readback stats are logged and the
+ next case starts. The CPU conversion kernels used when the packing shader
+ is unavailable are timed once at startup.
+ */
+
+struct PixelFormatCase
+{
+	string name;
+	ofxOMXPixelRequest request;
+	ofxOMXReadbackStats stats;
+	int bytesPerFrame;
+};
+
+class ofApp : public ofBaseApp{
+	
+public:
+	
+	void setup();
+	void update();
+	void draw();
+	
+	void benchmarkCPUConversion();
+	void startCase(int index);
+	void finishCase();
+	
+	ofxOMXPlayer omxPlayer;
+	vector<PixelFormatCase> cases;
+	int currentCase;
+	int framesPerCase;
+	int framesRead;
+	int lastFrameNumber;
+	stringstream report;
+};
@@ -5,9 +5,12 @@ void ofApp::setup()
 {
 	doSaveImage = false;
 	doUpdatePixels = true;
+	doThumbnail = false;
+	doSnapshots = false;
 	string videoPath = ofToDataPath("../../../video/Timecoded_Big_bunny_1.mov", true);
 
 	consoleListener.setup(this);
+	omxPlayer.listener = this;
 	omxPlayer.loadMovie(videoPath);
 	
 }
@@ -30,11 +33,17 @@ void ofApp::update()
             //since updatePixels() is expensive it is not automatically called in the player        
             omxPlayer.updatePixels();
             
-            if (!pixelOutput.isAllocated()) 
+            //NULL until the first readback has completed
+            if(omxPlayer.getPixels())
             {
-                pixelOutput.allocate(omxPlayer.getWidth(), omxPlayer.getHeight(), GL_RGBA);
+                int pixelsWidth = omxPlayer.getPixelsWidth();
+                int pixelsHeight = omxPlayer.getPixelsHeight();
+                if (pixelOutput.getWidth() != pixelsWidth || pixelOutput.getHeight() != pixelsHeight) 
+                {
+                    pixelOutput.allocate(pixelsWidth, pixelsHeight, GL_RGBA);
+                }
+                pixelOutput.loadData(omxPlayer.getPixels(), pixelsWidth, pixelsHeight, GL_RGBA);
             }
-            pixelOutput.loadData(omxPlayer.getPixels(), omxPlayer.getWidth(), omxPlayer.getHeight(), GL_RGBA);
         }
 		
 	}
@@ -59,6 +68,15 @@ void ofApp::draw(){
 	
 	stringstream info;
 	info <<"\n" <<	"Press u to toggle doUpdatePixels: " << doUpdatePixels;
+	info <<"\n" <<	"Press t to toggle 320x180 center crop readback: " << doThumbnail;
+	ofxOMXReadbackStats& readbackStats = omxPlayer.getReadbackStats();
+	info <<"\n" << "readback ms last/avg/max: " << readbackStats.lastMillis << " / " << readbackStats.averageMillis << " / " << readbackStats.maxMillis;
+	info <<"\n" << "readback latency frames: " << readbackStats.latencyFrames;
+	info <<"\n" << "decoded frame: " << omxPlayer.getDecodedFrameNumber() << " pixels frame: " << omxPlayer.getPixelsFrameNumber() << " skipped: " << readbackStats.numSkipped;
+	info <<"\n" <<	"Press s to save an image, p to toggle a snapshot every 5 seconds: " << doSnapshots;
+	ofxOMXImageSaverStats saverStats = omxPlayer.getImageSaverStats();
+	info <<"\n" << "saved: " << saverStats.numSaved << " failed: " << saverStats.numFailed << " rejected: " << saverStats.numRejected << " encode ms: " << saverStats.averageEncodeMillis;
+	info <<"\n" << "last saved: " << lastSavedImage;
 	
 	ofDrawBitmapStringHighlight(omxPlayer.getInfo() + info.str(), 60, 60, ofColor(ofColor::black, 90), ofColor::yellow);
 
@@ -74,10 +92,30 @@ void ofApp::keyPressed  (int key)
 		doSaveImage = true;	
 	}
 	
+	if(key == 'p')
+	{
+		doSnapshots = !doSnapshots;
+		omxPlayer.setSnapshotInterval(doSnapshots ? 5 : 0, "snapshots");
+	}
+	
 	if(key == 'u')
 	{
 		doUpdatePixels = !doUpdatePixels;	
 	}
+	
+	if(key == 't')
+	{
+		doThumbnail = !doThumbnail;
+		if(doThumbnail)
+		{
+			//center half of the frame, scaled down on the GPU before readback
+			ofRectangle crop(omxPlayer.getWidth()/4, omxPlayer.getHeight()/4, omxPlayer.getWidth()/2, omxPlayer.getHeight()/2);
+			omxPlayer.setPixelRequest(ofxOMXPixelRequest(320, 180, crop));
+		}else
+		{
+			omxPlayer.setPixelRequest(ofxOMXPixelRequest());
+		}
+	}
     
     if(key == ' ')
     {
@@ -85,6 +123,16 @@ void ofApp::keyPressed  (int key)
     }
 }
 
+//encoding happens on a worker, this arrives on the next update once the file is written
+void ofApp::onImageSaved(ofxOMXPlayer* player, ofxOMXSavedImage& image)
+{
+	if(image.success)
+	{
+		lastSavedImage = image.path + " frame " + ofToString(image.frameNumber) + " pts " + ofToString(image.pts);
+		ofLog() << "proof of play: " << image.requestTime << " " << lastSavedImage;
+	}
+}
+
 void ofApp::onCharacterReceived(KeyListenerEventData& e)
 {
 	keyPressed((int)e.character);
@@ -4,7 +4,7 @@
 #include "ofxOMXPlayer.h"
 
 #include "TerminalListener.h"
-class ofApp : public ofBaseApp, public KeyListener{
+class ofApp : public ofBaseApp, public KeyListener, public ofxOMXPlayerListener{
 	
 public:
 	
@@ -19,8 +19,15 @@ public:
 	
 	TerminalListener consoleListener;
 	void onCharacterReceived(KeyListenerEventData& e);
+	
+	void onVideoEnd(ofxOMXPlayer* player){};
+	void onVideoLoop(ofxOMXPlayer* player){};
+	void onImageSaved(ofxOMXPlayer* player, ofxOMXSavedImage& image);
+	string lastSavedImage;
+	bool doSnapshots;
 
 	ofTexture pixelOutput;
 	bool doUpdatePixels;
+	bool doThumbnail;
 };
 
@@ -2,11 +2,12 @@
 
 //This app is a demo of the ability to play multiple files with the Non-Texture Player
 //It requires multiple video files to be in /home/pi/videos/current
-//There is a bit of glitching while the files switch
+//The next file is queued with setNextMovie so files that match (same codec,
+//size and audio format) play on without a gap, others are reopened
 
 //This also demonstrates the ofxOMXPlayerListener pattern available
 
-//If your app extends ofxOMXPlayerListener you will receive an event when the video ends or loops
+//If your app extends ofxOMXPlayerListener you will receive an event when the video ends, loops or moves to the next file
 
 
 
@@ -27,6 +28,13 @@ void ofApp::onVideoLoop(ofxOMXPlayer* player)
     
 }
 
+void ofApp::onVideoNext(ofxOMXPlayer* player)
+{
+	videoCounter = getNextIndex();
+	ofLog() << "onVideoNext: " << files[videoCounter].path();
+	omxPlayer.setNextMovie(files[getNextIndex()].path());
+}
+
 
 void ofApp::onCharacterReceived(KeyListenerEventData& e)
 {
@@ -63,7 +71,9 @@ void ofApp::setup()
 			settings.enableLooping = false;		//default true
 			settings.enableTexture = true;		//default true
 			settings.listener = this;			//this app extends ofxOMXPlayerListener so it will receive events ;
+			settings.gaplessCrossfade = 0.05;	//default 0, seconds matching files overlap
 			omxPlayer.setup(settings);
+			omxPlayer.setNextMovie(files[getNextIndex()].path());
 		}		
 	}else
     {
@@ -72,17 +82,22 @@ void ofApp::setup()
 }
 
 
-void ofApp::loadNextMovie()
+int ofApp::getNextIndex()
 {
 	if(videoCounter+1<files.size())
 	{
-		videoCounter++;
-	}else
-	{
-		videoCounter = 0;
+		return videoCounter+1;
 	}
+	return 0;
+}
+
+void ofApp::loadNextMovie()
+{
+	videoCounter = getNextIndex();
 	skipTimeStart = ofGetElapsedTimeMillis();
     ofLog() << "LOADING MOVIE" << files[videoCounter].path();
+	//queued before loading so the new file does not play on into itself
+	omxPlayer.setNextMovie(files[getNextIndex()].path());
 	omxPlayer.loadMovie(files[videoCounter].path());
 	skipTimeEnd = ofGetElapsedTimeMillis();
 	amountSkipped = skipTimeEnd-skipTimeStart;
@@ -0,0 +1,172 @@
+// Throughput benchmark for ofxOMXSharedFrameRing, runs on any Linux box
+//
+//   shm-benchmark [width] [height] [channels] [readers] [seconds] [fps]
+//
+// Forks one process per reader, then publishes frames as fast as possible
+// (or at fps if given). Every frame is filled with a pattern derived from
+// its sequence so readers can verify that what endRead() accepted was not
+// torn. Defaults to 1920x1080 RGBA, 2 readers, 5 seconds, unthrottled.
+
+#include "ofxOMXSharedFrameRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+
+static const char* ringName = "/ofxomxplayer-benchmark";
+
+static void fillFrame(unsigned char* data, int size, uint32_t sequence)
+{
+    uint32_t* words = (uint32_t*)data;
+    int numWords = size/4;
+    for(int i=0; i<numWords; i++)
+    {
+        words[i] = sequence*2654435761u + i;
+    }
+}
+
+//samples a few hundred words, enough to catch a frame overwritten half way
+static bool checkFrame(const unsigned char* data, int size, uint32_t sequence)
+{
+    const uint32_t* words = (const uint32_t*)data;
+    int numWords = size/4;
+    int step = numWords/256 > 0 ? numWords/256 : 1;
+    for(int i=0; i<numWords; i+=step)
+    {
+        if(words[i] != sequence*2654435761u + i) return false;
+    }
+    return words[numWords-1] == sequence*2654435761u + numWords-1;
+}
+
+static int runReader(int index)
+{
+    ofxOMXSharedFrameRing ring;
+    for(int i=0; i<1000 && !ring.open(ringName); i++)
+    {
+        usleep(1000);
+    }
+    if(!ring.isOpen())
+    {
+        fprintf(stderr, "reader %d could not open %s\n", index, ringName);
+        return 1;
+    }
+
+    uint32_t lastSequence = ring.getPublished();
+    uint64_t numRead = 0;
+    uint64_t numTorn = 0;
+    uint64_t numSkipped = 0;
+    uint64_t numCorrupt = 0;
+    double totalLatency = 0;
+    double maxLatency = 0;
+    std::vector<unsigned char> copy;
+
+    while(ring.isWriterAlive())
+    {
+        uint32_t sequence = ring.waitForFrame(lastSequence, 100);
+        if(sequence == lastSequence) continue;
+        if(lastSequence) numSkipped += sequence-lastSequence-1;
+        lastSequence = sequence;
+
+        ofxOMXSharedFrameView view;
+        if(!ring.beginRead(sequence, view))
+        {
+            numTorn++;
+            continue;
+        }
+        //copy out like a consumer handing frames to another library would
+        copy.assign(view.data, view.data+view.size);
+        if(!ring.endRead(view))
+        {
+            numTorn++;
+            continue;
+        }
+        if(!checkFrame(&copy[0], copy.size(), sequence))
+        {
+            numCorrupt++;
+        }
+        numRead++;
+        double latency = (ofxOMXSharedFrameRing::getMonotonicMicros()-view.writeTimeMicros)/1000.0;
+        totalLatency += latency;
+        if(latency > maxLatency) maxLatency = latency;
+    }
+
+    printf("reader %d: read %llu torn %llu skipped %llu corrupt %llu latency avg %.3f ms max %.3f ms\n",
+           index, (unsigned long long)numRead, (unsigned long long)numTorn, (unsigned long long)numSkipped,
+           (unsigned long long)numCorrupt, numRead ? totalLatency/numRead : 0, maxLatency);
+    fflush(stdout);
+    return numCorrupt ? 2 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int channels = argc > 3 ? atoi(argv[3]) : 4;
+    int numReaders = argc > 4 ? atoi(argv[4]) : 2;
+    int seconds = argc > 5 ? atoi(argv[5]) : 5;
+    int fps = argc > 6 ? atoi(argv[6]) : 0;
+    int frameBytes = width*height*channels;
+
+    ofxOMXSharedFrameRing ring;
+    if(!ring.create(ringName, 4, frameBytes))
+    {
+        fprintf(stderr, "could not create %s: %s\n", ringName, ring.getLastError().c_str());
+        return 1;
+    }
+
+    std::vector<pid_t> readers;
+    for(int i=0; i<numReaders; i++)
+    {
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            _exit(runReader(i));
+        }
+        readers.push_back(pid);
+    }
+    usleep(100000);
+
+    //pre-render a handful of frames so the benchmark measures the ring, not the fill
+    std::vector<std::vector<unsigned char> > frames(8, std::vector<unsigned char>(frameBytes));
+    uint64_t startTime = ofxOMXSharedFrameRing::getMonotonicMicros();
+    uint64_t endTime = startTime + (uint64_t)seconds*1000000;
+    uint64_t publishMicros = 0;
+    uint32_t sequence = 0;
+    uint64_t now = startTime;
+    while(now < endTime)
+    {
+        sequence++;
+        std::vector<unsigned char>& frame = frames[sequence % frames.size()];
+        fillFrame(&frame[0], frameBytes, sequence);
+
+        uint64_t before = ofxOMXSharedFrameRing::getMonotonicMicros();
+        ring.publish(&frame[0], width, height, channels, sequence, sequence/30.0);
+        now = ofxOMXSharedFrameRing::getMonotonicMicros();
+        publishMicros += now-before;
+
+        if(fps > 0)
+        {
+            uint64_t due = startTime + (uint64_t)sequence*1000000/fps;
+            if(due > now) usleep(due-now);
+            now = ofxOMXSharedFrameRing::getMonotonicMicros();
+        }
+    }
+    double elapsed = (now-startTime)/1000000.0;
+    ring.close();
+
+    int status = 0;
+    for(size_t i=0; i<readers.size(); i++)
+    {
+        int readerStatus = 0;
+        waitpid(readers[i], &readerStatus, 0);
+        if(!WIFEXITED(readerStatus) || WEXITSTATUS(readerStatus) != 0) status = 1;
+    }
+
+    printf("writer: %dx%dx%d, %u frames in %.2f s = %.1f fps, publish avg %.3f ms, %.1f MB/s into the ring\n",
+           width, height, channels, sequence, elapsed, sequence/elapsed,
+           publishMicros/1000.0/sequence, (double)sequence*frameBytes/elapsed/(1024*1024));
+    return status;
+}
@@ -0,0 +1,138 @@
+// Reference consumer for ofxOMXPlayer::startSharedFrameExport
+//
+//   shm-consumer [name] [output.ppm|output.pgm]
+//
+// Waits for frames, prints their metadata and the average luma computed in
+// place on the mapped pixels, and optionally writes the last complete frame
+// to a PNM file on exit (Ctrl-C). Reopens the ring whenever the writer closes
+// or recreates it.
+
+#include "ofxOMXSharedFrameRing.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+#include <string.h>
+
+static volatile sig_atomic_t doStop = 0;
+
+static void onSignal(int)
+{
+    doStop = 1;
+}
+
+static int averageLuma(const ofxOMXSharedFrameView& view)
+{
+    uint64_t sum = 0;
+    int numPixels = view.width*view.height;
+    for(int i=0; i<numPixels; i++)
+    {
+        const unsigned char* px = view.data + i*view.channels;
+        sum += view.channels >= 3 ? (px[0]*77 + px[1]*150 + px[2]*29) >> 8 : px[0];
+    }
+    return numPixels ? sum/numPixels : 0;
+}
+
+static void writePNM(const char* path, const std::vector<unsigned char>& data, int width, int height, int channels)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file)
+    {
+        perror(path);
+        return;
+    }
+    fprintf(file, "P%d\n%d %d\n255\n", channels == 1 ? 5 : 6, width, height);
+    for(int i=0; i<width*height; i++)
+    {
+        fwrite(&data[i*channels], 1, channels == 1 ? 1 : 3, file);
+    }
+    fclose(file);
+    printf("wrote %s\n", path);
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = argc > 1 ? argv[1] : "/ofxomxplayer";
+    const char* outputPath = argc > 2 ? argv[2] : NULL;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::vector<unsigned char> lastFrame;
+    std::vector<unsigned char> frameCopy;
+    int lastWidth = 0;
+    int lastHeight = 0;
+    int lastChannels = 0;
+    int numRead = 0;
+    int numTorn = 0;
+    int numSkipped = 0;
+
+    //the writer recreates the ring when its frames outgrow it, follow it
+    ofxOMXSharedFrameRing ring;
+    while(!doStop)
+    {
+        while(!ring.open(name))
+        {
+            if(doStop) break;
+            printf("waiting for %s\n", name);
+            sleep(1);
+        }
+        if(doStop) break;
+        printf("%s: %d slots, %d bytes max\n", name, ring.getNumSlots(), ring.getMaxFrameBytes());
+
+        uint32_t lastSequence = ring.getPublished();
+        while(!doStop && ring.isWriterAlive())
+        {
+            uint32_t sequence = ring.waitForFrame(lastSequence, 500);
+            if(sequence == lastSequence)
+            {
+                continue;
+            }
+            if(lastSequence && sequence-lastSequence > 1)
+            {
+                numSkipped += sequence-lastSequence-1;
+            }
+            lastSequence = sequence;
+
+            ofxOMXSharedFrameView view;
+            if(!ring.beginRead(sequence, view))
+            {
+                numTorn++;
+                continue;
+            }
+            int luma = averageLuma(view);
+            if(outputPath)
+            {
+                frameCopy.assign(view.data, view.data+view.size);
+            }
+            if(!ring.endRead(view))
+            {
+                //overwritten while we were reading, nothing we computed is valid
+                numTorn++;
+                continue;
+            }
+            numRead++;
+            lastFrame.swap(frameCopy);
+            lastWidth = view.width;
+            lastHeight = view.height;
+            lastChannels = view.channels;
+
+            float latencyMillis = (ofxOMXSharedFrameRing::getMonotonicMicros()-view.writeTimeMicros)/1000.0f;
+            printf("seq %u frame %d pts %.3f %ux%ux%u luma %d latency %.2f ms\n",
+                   view.sequence, view.frameNumber, view.pts, view.width, view.height, view.channels, luma, latencyMillis);
+        }
+        ring.close();
+        if(!doStop)
+        {
+            printf("%s closed by the writer\n", name);
+        }
+    }
+
+    printf("read %d torn %d skipped %d\n", numRead, numTorn, numSkipped);
+    if(outputPath && numRead && lastChannels != 2)
+    {
+        writePNM(outputPath, lastFrame, lastWidth, lastHeight, lastChannels);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup()
+{
+	string videoPath = ofToDataPath("../../../video/Timecoded_Big_bunny_1.mov", true);
+	
+	ofxOMXPlayerSettings settings;
+	settings.videoPath = videoPath;
+	settings.enableAudio = false;
+	settings.pixelRequest = ofxOMXPixelRequest(640, 360, ofRectangle(), OF_PIXELS_RGB);
+	omxPlayer.setup(settings);
+	
+	omxPlayer.startSharedFrameExport("/ofxomxplayer", 4);
+}
+
+//--------------------------------------------------------------
+void ofApp::update()
+{
+	
+}
+
+//--------------------------------------------------------------
+void ofApp::draw()
+{
+	omxPlayer.draw(0, 0, ofGetWidth(), ofGetHeight());
+	
+	ofxOMXSharedFrameExportStats exportStats = omxPlayer.getSharedFrameExportStats();
+	ofxOMXFrameSubscriberStats queueStats = omxPlayer.getFrameSubscriberStats(&omxPlayer.sharedFrameExporter);
+	
+	stringstream info;
+	info << "decoded frame: " << omxPlayer.getDecodedFrameNumber() << "\n";
+	info << "published: " << exportStats.numPublished << " rejected: " << exportStats.numRejected
+	<< " publish ms: " << exportStats.averagePublishMillis << "\n";
+	info << "queue dropped: " << queueStats.numDropped << " latency ms: " << queueStats.averageLatencyMillis << "\n";
+	info << "run consumer/shm-consumer " << omxPlayer.sharedFrameExporter.getName();
+	ofDrawBitmapStringHighlight(info.str(), 60, 60, ofColor(ofColor::black, 90), ofColor::yellow);
+}
+
+//--------------------------------------------------------------
+void ofApp::exit()
+{
+	omxPlayer.stopSharedFrameExport();
+}
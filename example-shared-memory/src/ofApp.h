@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayer.h"
+
+//Publishes decoded frames to /dev/shm/ofxomxplayer, run consumer/shm-consumer
+//in another terminal to read them
+class ofApp : public ofBaseApp{
+	
+public:
+	
+	void setup();
+	void update();
+	void draw();
+	void exit();
+	
+	ofxOMXPlayer omxPlayer;
+};
@@ -0,0 +1,9 @@
+#include "ofMain.h"
+#include "ofApp.h"
+
+int main()
+{
+	ofSetLogLevel(OF_LOG_NOTICE);
+	ofSetupOpenGL(1280, 720, OF_WINDOW);
+	ofRunApp( new ofApp());
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup()
+{
+	string videoFolder = ofToDataPath("../../../video", true);
+	ofDirectory directory;
+	directory.allowExt("mov");
+	directory.allowExt("mp4");
+	directory.allowExt("mkv");
+	directory.allowExt("h264");
+	directory.listDir(videoFolder);
+	
+	thumbnailService.setup();
+	startTime = ofGetElapsedTimeMillis();
+	totalMillis = 0;
+	numRequested = 0;
+	for(size_t i=0; i<directory.size(); i++)
+	{
+		//a keyframe 10% in and one accurate frame at 5 seconds per file
+		ofxOMXThumbnailRequest request;
+		request.videoPath = directory.getPath(i);
+		request.timeMillis = -1;
+		request.width = 240;
+		thumbnailService.request(request, this);
+		
+		request.timeMillis = 5000;
+		request.accurate = true;
+		thumbnailService.request(request, this);
+		numRequested += 2;
+	}
+	ofLog() << numRequested << " thumbnails requested on " << thumbnailService.getNumWorkers() << " workers";
+}
+
+//--------------------------------------------------------------
+void ofApp::onThumbnail(ofxOMXThumbnailRef thumbnail)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	finished.push_back(thumbnail);
+}
+
+//--------------------------------------------------------------
+void ofApp::update()
+{
+	vector<ofxOMXThumbnailRef> ready;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		ready.swap(finished);
+	}
+	for(size_t i=0; i<ready.size(); i++)
+	{
+		if(!ready[i]->success)
+		{
+			ofLogError() << "no thumbnail for " << ready[i]->request.videoPath;
+			continue;
+		}
+		thumbnails.push_back(ready[i]);
+		textures.push_back(ofTexture());
+		textures.back().loadData(ready[i]->pixels);
+		if((int)thumbnails.size() == numRequested)
+		{
+			totalMillis = ofGetElapsedTimeMillis()-startTime;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::draw()
+{
+	ofBackground(0);
+	float x = 10;
+	float y = 120;
+	for(size_t i=0; i<thumbnails.size(); i++)
+	{
+		if(x + textures[i].getWidth() > ofGetWidth())
+		{
+			x = 10;
+			y += textures[i].getHeight() + 30;
+		}
+		textures[i].draw(x, y);
+		ofxOMXThumbnail& thumbnail = *thumbnails[i];
+		ofDrawBitmapString(ofFilePath::getFileName(thumbnail.request.videoPath) + " @" + ofToString(thumbnail.pts, 2) + "s "
+						   + ofToString(thumbnail.decodeMillis, 0) + "ms", x, y + textures[i].getHeight() + 14);
+		x += textures[i].getWidth() + 10;
+	}
+	
+	ofxOMXThumbnailStats stats = thumbnailService.getStats();
+	stringstream info;
+	info << "workers: " << thumbnailService.getNumWorkers() << " queued: " << thumbnailService.getNumQueued() << "\n";
+	info << "decoded: " << stats.numDecoded << " failed: " << stats.numFailed << " cache hits: " << stats.numCacheHits
+	<< " average ms: " << stats.averageDecodeMillis << "\n";
+	info << "all done in ms: " << totalMillis;
+	ofDrawBitmapStringHighlight(info.str(), 10, 20, ofColor(ofColor::black, 90), ofColor::yellow);
+}
+
+//--------------------------------------------------------------
+void ofApp::exit()
+{
+	thumbnailService.removeListener(this);
+	thumbnailService.close();
+}
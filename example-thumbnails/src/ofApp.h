@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXThumbnailService.h"
+
+//Software decoded poster frames for every video in a folder, no player needed
+class ofApp : public ofBaseApp, public ofxOMXThumbnailListener{
+	
+public:
+	
+	void setup();
+	void update();
+	void draw();
+	void exit();
+	
+	void onThumbnail(ofxOMXThumbnailRef thumbnail);
+	
+	ofxOMXThumbnailService thumbnailService;
+	uint64_t startTime;
+	
+	std::mutex mutex;
+	vector<ofxOMXThumbnailRef> finished;	//from the workers, waiting for upload
+	
+	vector<ofxOMXThumbnailRef> thumbnails;
+	vector<ofTexture> textures;
+	int numRequested;
+	float totalMillis;
+};
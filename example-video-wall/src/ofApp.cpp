@@ -0,0 +1,73 @@
+#include "ofApp.h"
+
+//--------------------------------------------------------------
+void ofApp::setup()
+{
+	//direct mode composites the tiles in hardware, textured draws them from one texture
+	useTexture = true;
+	
+	string videoPath = ofToDataPath("../../../video/Timecoded_Big_bunny_1.mov", true);
+	
+	ofxOMXPlayerSettings settings;
+	settings.videoPath = videoPath;
+	settings.enableTexture = useTexture;
+	settings.enableAudio = false;
+	omxPlayer.setup(settings);
+	
+	//crops are in video pixels so they need the size the decoder reported
+	omxPlayer.setRegions(createWall(2, 2, 20));
+	if(!useTexture)
+	{
+		//going from one render to a splitter rebuilds the pipeline
+		omxPlayer.reopen();
+	}
+}
+
+//--------------------------------------------------------------
+vector<ofxOMXVideoRegion> ofApp::createWall(int columns, int rows, float bezel)
+{
+	vector<ofxOMXVideoRegion> regions;
+	float cropWidth = omxPlayer.getWidth()/columns;
+	float cropHeight = omxPlayer.getHeight()/rows;
+	float tileWidth = (ofGetWidth()-bezel*(columns+1))/columns;
+	float tileHeight = (ofGetHeight()-bezel*(rows+1))/rows;
+	for(int row=0; row<rows; row++)
+	{
+		for(int column=0; column<columns; column++)
+		{
+			ofRectangle crop(column*cropWidth, row*cropHeight, cropWidth, cropHeight);
+			ofRectangle destination(bezel+column*(tileWidth+bezel), bezel+row*(tileHeight+bezel), tileWidth, tileHeight);
+			regions.push_back(ofxOMXVideoRegion(crop, destination));
+		}
+	}
+	return regions;
+}
+
+//--------------------------------------------------------------
+void ofApp::update()
+{
+	
+}
+
+//--------------------------------------------------------------
+void ofApp::draw()
+{
+	ofBackground(0);
+	omxPlayer.drawRegions();
+	
+	stringstream info;
+	info << "regions: " << omxPlayer.getRegions().size() << " from one decoder, textured: " << useTexture << "\n";
+	info << "press 1-4 for an NxN wall";
+	ofDrawBitmapStringHighlight(info.str(), 40, ofGetHeight()-40, ofColor(ofColor::black, 90), ofColor::yellow);
+}
+
+//--------------------------------------------------------------
+void ofApp::keyPressed(int key)
+{
+	if(key >= '1' && key <= '4')
+	{
+		//direct mode is limited to 4 outputs of the video_splitter
+		int size = key-'0';
+		omxPlayer.setRegions(createWall(size, useTexture ? size : 1, 20));
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayer.h"
+
+//One decoder split into a 2x2 wall with bezels, compare with example-multiple-players
+class ofApp : public ofBaseApp{
+	
+public:
+	
+	void setup();
+	void update();
+	void draw();
+	void keyPressed(int key);
+	
+	vector<ofxOMXVideoRegion> createWall(int columns, int rows, float bezel);
+	
+	ofxOMXPlayer omxPlayer;
+	bool useTexture;
+};
@@ -0,0 +1,104 @@
+#pragma once
+/*
+ *      Copyright (C) 2005-2010 Team XBMC
+ *      http://www.xbmc.org
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#if (defined HAVE_CONFIG_H) && (!defined WIN32)
+  #include "config.h"
+#endif
+#include "DynamicDll.h"
+#include "DllAvUtil.h"
+#include "utils/log.h"
+
+extern "C" {
+
+#define USE_EXTERNAL_FFMPEG
+
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS
+#endif
+#ifndef __GNUC__
+#pragma warning(disable:4244)
+#endif
+
+#include <libswscale/swscale.h>
+}
+
+class DllSwScaleInterface
+{
+public:
+  virtual ~DllSwScaleInterface() {}
+  virtual struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW, int srcH, enum AVPixelFormat srcFormat, int dstW, int dstH, enum AVPixelFormat dstFormat, int flags, SwsFilter *srcFilter, SwsFilter *dstFilter, const double *param)=0;
+  virtual int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[], const int srcStride[], int srcSliceY, int srcSliceH, uint8_t *const dst[], const int dstStride[])=0;
+  virtual void sws_freeContext(struct SwsContext *swsContext)=0;
+};
+
+#if (defined USE_EXTERNAL_FFMPEG) || (defined TARGET_DARWIN)
+
+// Use direct mapping
+class DllSwScale : public DllDynamic, DllSwScaleInterface
+{
+public:
+  virtual ~DllSwScale() {}
+
+  // DLL faking.
+  virtual bool ResolveExports() { return true; }
+  virtual bool Load() {
+    CLog::Log(LOGDEBUG, "DllSwScale: Using libswscale system library");
+    return true;
+  }
+  virtual void Unload() {}
+  virtual struct SwsContext *sws_getCachedContext(struct SwsContext *context, int srcW, int srcH, enum AVPixelFormat srcFormat, int dstW, int dstH, enum AVPixelFormat dstFormat, int flags, SwsFilter *srcFilter, SwsFilter *dstFilter, const double *param) { return ::sws_getCachedContext(context, srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, srcFilter, dstFilter, param); }
+  virtual int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[], const int srcStride[], int srcSliceY, int srcSliceH, uint8_t *const dst[], const int dstStride[]) { return ::sws_scale(c, srcSlice, srcStride, srcSliceY, srcSliceH, dst, dstStride); }
+  virtual void sws_freeContext(struct SwsContext *swsContext) { ::sws_freeContext(swsContext); }
+};
+
+#else
+
+class DllSwScale : public DllDynamic, DllSwScaleInterface
+{
+  DECLARE_DLL_WRAPPER(DllSwScale, DLL_PATH_LIBSWSCALE)
+
+  LOAD_SYMBOLS()
+
+  DEFINE_METHOD11(struct SwsContext *, sws_getCachedContext, (struct SwsContext *p1, int p2, int p3, enum AVPixelFormat p4, int p5, int p6, enum AVPixelFormat p7, int p8, SwsFilter *p9, SwsFilter *p10, const double *p11))
+  DEFINE_METHOD7(int, sws_scale, (struct SwsContext *p1, const uint8_t *const p2[], const int p3[], int p4, int p5, uint8_t *const p6[], const int p7[]))
+  DEFINE_METHOD1(void, sws_freeContext, (struct SwsContext *p1))
+
+  BEGIN_METHOD_RESOLVE()
+    RESOLVE_METHOD(sws_getCachedContext)
+    RESOLVE_METHOD(sws_scale)
+    RESOLVE_METHOD(sws_freeContext)
+  END_METHOD_RESOLVE()
+
+  /* dependencies of libswscale */
+  DllAvUtil m_dllAvUtil;
+
+public:
+
+  virtual bool Load()
+  {
+    if (!m_dllAvUtil.Load())
+      return false;
+    return DllDynamic::Load();
+  }
+};
+
+#endif
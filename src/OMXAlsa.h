@@ -1,6 +1,49 @@
 #pragma once
 #include <IL/OMX_Core.h>
 
+/* Vendor config for OMX.alsa.audio_render: ALSA period and ring size in
+ * microseconds, 0 keeps the default (50ms periods in a 200ms ring). Takes
+ * effect the next time the component goes to OMX_StateExecuting. */
+#define OMXALSA_IndexConfigBufferTime ((OMX_INDEXTYPE) (OMX_IndexVendorStartUnused + 0x10000))
+
+typedef struct OMXALSA_CONFIG_BUFFERTIMETYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPeriodTime;
+    OMX_U32 nBufferTime;
+} OMXALSA_CONFIG_BUFFERTIMETYPE;
+
+/* Vendor config for OMX.alsa.audio_render (OMX_CONFIG_BOOLEANTYPE): mix into
+ * the process-wide output for the destination device (see OMXAlsaMixer.h)
+ * instead of opening it, so several players can share it. S16 interleaved
+ * only, other formats still open the device. Takes effect the next time the
+ * component goes to OMX_StateExecuting. */
+#define OMXALSA_IndexConfigSharedOutput ((OMX_INDEXTYPE) (OMX_IndexVendorStartUnused + 0x10001))
+
+/* Vendor config for OMX.alsa.audio_render: linear gain in 16.16 fixed point
+ * this sink is mixed into the shared output with, 0x10000 by default. No
+ * effect on a device of its own. */
+#define OMXALSA_IndexConfigMixGain ((OMX_INDEXTYPE) (OMX_IndexVendorStartUnused + 0x10002))
+
+typedef struct OMXALSA_CONFIG_MIXGAINTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nGain;
+} OMXALSA_CONFIG_MIXGAINTYPE;
+
+/* Vendor parameter for OMX.alsa.audio_render's audio port: the buffers it
+ * asks a tunnel for, 4 of 8KB by default. The other end of the tunnel can
+ * still raise both, read OMX_IndexParamPortDefinition after it is set up for
+ * what was agreed. Valid in OMX_StateLoaded or on the disabled port. */
+#define OMXALSA_IndexParamPortBuffers ((OMX_INDEXTYPE) (OMX_IndexVendorStartUnused + 0x10003))
+
+typedef struct OMXALSA_PARAM_PORTBUFFERSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nBufferCount;
+    OMX_U32 nBufferSize;
+} OMXALSA_PARAM_PORTBUFFERSTYPE;
+
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMXALSA_GetHandle(
     OMX_OUT OMX_HANDLETYPE* pHandle,
     OMX_IN  OMX_STRING cComponentName,
@@ -0,0 +1,449 @@
+#include "OMXAlsaMixer.h"
+#include "utils/AudioKernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+struct _OMXALSA_MIXER_INPUT {
+	OMXALSA_MIXER *mixer;
+	int16_t *ring;
+	size_t ring_frames;	/* power of two */
+	/* frames written and mixed so far, head only moves in the sink
+	 * and tail only in the mix thread */
+	size_t head, tail;
+	float gain;
+	/* sink sleeping until the mix thread takes something, under mutex */
+	bool waiting;
+};
+
+struct _OMXALSA_MIXER {
+	OMXALSA_MIXER *next;
+	char device_name[16];
+	int refs;
+	unsigned int rate, channels;
+	snd_pcm_uframes_t period_size, buffer_size;
+	snd_pcm_t *dev;
+	ALSA_WRITER writer;
+	pthread_t thread;
+	bool thread_started;
+	bool quit;
+
+	/* inputs only change, and are only mixed, under mutex */
+	pthread_mutex_t mutex;
+	pthread_cond_t data_cond, room_cond;
+	int mix_waiting;
+	OMXALSA_MIXER_INPUT *inputs[OMXALSA_MIXER_MAX_INPUTS];
+
+	/* updated by the mix thread, read by the sinks */
+	snd_pcm_sframes_t delay;
+	snd_pcm_state_t state;
+
+	float *mix;
+};
+
+/* one mixer per device name */
+static OMXALSA_MIXER *omxalsa_mixers;
+static pthread_mutex_t omxalsa_mixers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void omxalsa_mixer_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, long timeout_ns)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_nsec += timeout_ns % 1000000000;
+	ts.tv_sec += timeout_ns / 1000000000 + ts.tv_nsec / 1000000000;
+	ts.tv_nsec %= 1000000000;
+	pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+static long omxalsa_mixer_period_ns(OMXALSA_MIXER *m)
+{
+	return (int64_t) m->period_size * 1000000000 / m->rate;
+}
+
+/* Called with the mutex held */
+static bool omxalsa_mixer_has_data(OMXALSA_MIXER *m)
+{
+	OMXALSA_MIXER_INPUT *in;
+
+	for (int i = 0; i < OMXALSA_MIXER_MAX_INPUTS; i++) {
+		in = m->inputs[i];
+		if (in && __atomic_load_n(&in->head, __ATOMIC_ACQUIRE) != in->tail) return true;
+	}
+	return false;
+}
+
+/* ALSA_WRITER_FILL that mixes up to a period straight into the device ring */
+static snd_pcm_uframes_t omxalsa_mixer_mix(void *ctx, uint8_t *dst, snd_pcm_uframes_t frames)
+{
+	OMXALSA_MIXER *m = (OMXALSA_MIXER *) ctx;
+	OMXALSA_MIXER_INPUT *in;
+	bool mixing[OMXALSA_MIXER_MAX_INPUTS];
+	size_t avail, off, chunk, mask;
+	unsigned int ch = m->channels;
+	bool any = false, wake = false;
+	float gain;
+	int i;
+
+	if (frames > m->period_size) frames = m->period_size;
+
+	pthread_mutex_lock(&m->mutex);
+
+	/* Inputs with data go in step, so the mix is as long as the shortest
+	 * of them. Empty ones sit this round out rather than holding the
+	 * others back. */
+	for (i = 0; i < OMXALSA_MIXER_MAX_INPUTS; i++) {
+		in = m->inputs[i];
+		avail = in ? __atomic_load_n(&in->head, __ATOMIC_ACQUIRE) - in->tail : 0;
+		mixing[i] = avail != 0;
+		if (!avail) continue;
+		if (avail < frames) frames = avail;
+		any = true;
+	}
+	if (!any) {
+		pthread_mutex_unlock(&m->mutex);
+		return 0;
+	}
+
+	memset(m->mix, 0, frames * ch * sizeof(float));
+	for (i = 0; i < OMXALSA_MIXER_MAX_INPUTS; i++) {
+		if (!mixing[i]) continue;
+		in = m->inputs[i];
+		__atomic_load(&in->gain, &gain, __ATOMIC_RELAXED);
+		mask = in->ring_frames - 1;
+		off = in->tail & mask;
+		chunk = frames < in->ring_frames - off ? frames : in->ring_frames - off;
+		AudioKernels::AccumulateS16(in->ring + off * ch, m->mix, chunk * ch, gain);
+		if (chunk < frames)
+			AudioKernels::AccumulateS16(in->ring, m->mix + chunk * ch, (frames - chunk) * ch, gain);
+		__atomic_store_n(&in->tail, in->tail + frames, __ATOMIC_RELEASE);
+		if (in->waiting) wake = true;
+	}
+	if (wake) pthread_cond_broadcast(&m->room_cond);
+	pthread_mutex_unlock(&m->mutex);
+
+	AudioKernels::FloatToS16(m->mix, (int16_t *) dst, frames * ch);
+	return frames;
+}
+
+static void *omxalsa_mixer_thread(void *ptr)
+{
+	OMXALSA_MIXER *m = (OMXALSA_MIXER *) ptr;
+	long period_ns = omxalsa_mixer_period_ns(m);
+	snd_pcm_sframes_t delay, avail, r;
+	snd_pcm_state_t state;
+	struct timespec ts;
+
+	while (!__atomic_load_n(&m->quit, __ATOMIC_ACQUIRE)) {
+		state = snd_pcm_state(m->dev);
+		delay = 0;
+		snd_pcm_delay(m->dev, &delay);
+		__atomic_store_n(&m->state, state, __ATOMIC_RELAXED);
+		__atomic_store_n(&m->delay, delay, __ATOMIC_RELAXED);
+
+		/* Wait for data. While the device is still playing out, wake
+		 * once a period to keep the reported delay current */
+		pthread_mutex_lock(&m->mutex);
+		if (!omxalsa_mixer_has_data(m)) {
+			__atomic_store_n(&m->mix_waiting, 1, __ATOMIC_SEQ_CST);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (!omxalsa_mixer_has_data(m) && !__atomic_load_n(&m->quit, __ATOMIC_ACQUIRE)) {
+				if (state == SND_PCM_STATE_RUNNING)
+					omxalsa_mixer_timedwait(&m->data_cond, &m->mutex, period_ns);
+				else
+					pthread_cond_wait(&m->data_cond, &m->mutex);
+			}
+			__atomic_store_n(&m->mix_waiting, 0, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&m->mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&m->mutex);
+
+		/* a period at a time rather than whatever sliver the device has
+		 * just freed, that would mix a few frames per wakeup */
+		avail = snd_pcm_avail_update(m->dev);
+		if (avail >= 0 && (snd_pcm_uframes_t) avail < m->period_size && state == SND_PCM_STATE_RUNNING) {
+			snd_pcm_wait(m->dev, 1000);
+			continue;
+		}
+
+		r = alsa_writer_fill(&m->writer, omxalsa_mixer_mix, m);
+		if (r < 0) {
+			/* could not recover, start over after a period */
+			snd_pcm_prepare(m->dev);
+			ts.tv_sec = 0;
+			ts.tv_nsec = period_ns;
+			nanosleep(&ts, 0);
+		}
+	}
+	return 0;
+}
+
+static void omxalsa_mixer_close(OMXALSA_MIXER *m)
+{
+	if (m->thread_started) {
+		pthread_mutex_lock(&m->mutex);
+		__atomic_store_n(&m->quit, true, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&m->data_cond);
+		pthread_mutex_unlock(&m->mutex);
+		pthread_join(m->thread, 0);
+	}
+	if (m->dev) {
+		if (m->thread_started) snd_pcm_drain(m->dev);
+		snd_pcm_close(m->dev);
+	}
+	alsa_writer_fini(&m->writer);
+	pthread_cond_destroy(&m->data_cond);
+	pthread_cond_destroy(&m->room_cond);
+	pthread_mutex_destroy(&m->mutex);
+	free(m->mix);
+	free(m);
+}
+
+static OMXALSA_MIXER *omxalsa_mixer_open(const char *device, unsigned int channels, unsigned int rate,
+	unsigned int period_time, unsigned int buffer_time)
+{
+	OMXALSA_MIXER *m;
+	snd_pcm_hw_params_t *hwp;
+	snd_pcm_uframes_t buffer_size, period_size, period_size_max;
+	pthread_condattr_t attr;
+	bool use_mmap;
+
+	m = (OMXALSA_MIXER *) calloc(1, sizeof *m);
+	if (!m) return 0;
+	strncpy(m->device_name, device, sizeof m->device_name - 1);
+	m->channels = channels;
+
+	pthread_mutex_init(&m->mutex, 0);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&m->data_cond, &attr);
+	pthread_cond_init(&m->room_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (snd_pcm_open(&m->dev, device, SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+		m->dev = 0;
+		goto err;
+	}
+
+	/* same sizing as a sink with its own device */
+	buffer_size = buffer_time ? (uint64_t) rate * buffer_time / 1000000 : rate / 5;
+	period_size = period_time ? (uint64_t) rate * period_time / 1000000 : buffer_size / 4;
+	period_size_max = period_size > buffer_size / 3 ? period_size : buffer_size / 3;
+
+	snd_pcm_hw_params_alloca(&hwp);
+	snd_pcm_hw_params_any(m->dev, hwp);
+	if (snd_pcm_hw_params_set_channels(m->dev, hwp, channels) < 0 ||
+	    alsa_writer_set_access(m->dev, hwp, true, true, &use_mmap) < 0 ||
+	    snd_pcm_hw_params_set_rate_near(m->dev, hwp, &rate, 0) < 0 ||
+	    snd_pcm_hw_params_set_format(m->dev, hwp, SND_PCM_FORMAT_S16_LE) < 0 ||
+	    snd_pcm_hw_params_set_period_size_max(m->dev, hwp, &period_size_max, 0) < 0 ||
+	    snd_pcm_hw_params_set_buffer_size_near(m->dev, hwp, &buffer_size) < 0 ||
+	    snd_pcm_hw_params_set_period_size_near(m->dev, hwp, &period_size, 0) < 0 ||
+	    snd_pcm_hw_params(m->dev, hwp) < 0)
+		goto err;
+	snd_pcm_get_params(m->dev, &buffer_size, &period_size);
+
+	m->rate = rate;
+	m->buffer_size = buffer_size;
+	m->period_size = period_size;
+	m->state = SND_PCM_STATE_PREPARED;
+
+	m->mix = (float *) malloc(period_size * channels * sizeof(float));
+	if (!m->mix) goto err;
+	if (alsa_writer_init(&m->writer, m->dev, channels * sizeof(int16_t), use_mmap, period_size) < 0)
+		goto err;
+
+	if (pthread_create(&m->thread, 0, omxalsa_mixer_thread, m) != 0) goto err;
+	m->thread_started = true;
+	return m;
+
+err:
+	omxalsa_mixer_close(m);
+	return 0;
+}
+
+OMXALSA_MIXER_INPUT *omxalsa_mixer_attach(const char *device, unsigned int channels, unsigned int *rate,
+	snd_pcm_uframes_t *period_size, unsigned int period_time, unsigned int buffer_time)
+{
+	OMXALSA_MIXER *m;
+	OMXALSA_MIXER_INPUT *in = 0;
+	size_t ring_frames;
+	int i;
+
+	pthread_mutex_lock(&omxalsa_mixers_lock);
+	for (m = omxalsa_mixers; m; m = m->next)
+		if (strcmp(m->device_name, device) == 0) break;
+	if (!m) {
+		if (!(m = omxalsa_mixer_open(device, channels, *rate, period_time, buffer_time))) goto out;
+		m->next = omxalsa_mixers;
+		omxalsa_mixers = m;
+	}
+	if (m->channels != channels) goto out;
+
+	/* Two periods keep the mix thread fed without adding much latency
+	 * on top of the device ring */
+	for (ring_frames = 1; ring_frames < m->period_size * 2; ring_frames <<= 1);
+	in = (OMXALSA_MIXER_INPUT *) calloc(1, sizeof *in);
+	if (!in) goto out;
+	in->ring = (int16_t *) malloc(ring_frames * channels * sizeof(int16_t));
+	if (!in->ring) goto fail;
+	in->ring_frames = ring_frames;
+	in->gain = 1.0f;
+	in->mixer = m;
+
+	pthread_mutex_lock(&m->mutex);
+	for (i = 0; i < OMXALSA_MIXER_MAX_INPUTS && m->inputs[i]; i++);
+	if (i < OMXALSA_MIXER_MAX_INPUTS) {
+		m->inputs[i] = in;
+		m->refs++;
+	}
+	pthread_mutex_unlock(&m->mutex);
+	if (i == OMXALSA_MIXER_MAX_INPUTS) goto fail;
+
+	*rate = m->rate;
+	*period_size = m->period_size;
+out:
+	pthread_mutex_unlock(&omxalsa_mixers_lock);
+	return in;
+
+fail:
+	free(in->ring);
+	free(in);
+	in = 0;
+	goto out;
+}
+
+void omxalsa_mixer_detach(OMXALSA_MIXER_INPUT *in)
+{
+	OMXALSA_MIXER *m = in->mixer, **pm;
+
+	pthread_mutex_lock(&omxalsa_mixers_lock);
+	pthread_mutex_lock(&m->mutex);
+	for (int i = 0; i < OMXALSA_MIXER_MAX_INPUTS; i++)
+		if (m->inputs[i] == in) m->inputs[i] = 0;
+	m->refs--;
+	pthread_mutex_unlock(&m->mutex);
+
+	if (!m->refs) {
+		for (pm = &omxalsa_mixers; *pm != m; pm = &(*pm)->next);
+		*pm = m->next;
+		omxalsa_mixer_close(m);
+	}
+	pthread_mutex_unlock(&omxalsa_mixers_lock);
+
+	free(in->ring);
+	free(in);
+}
+
+typedef struct {
+	const uint8_t *data;
+	snd_pcm_uframes_t frames;
+	size_t frame_size;
+} OMXALSA_MIXER_COPY;
+
+static snd_pcm_uframes_t omxalsa_mixer_copy(void *ctx, uint8_t *dst, snd_pcm_uframes_t frames)
+{
+	OMXALSA_MIXER_COPY *c = (OMXALSA_MIXER_COPY *) ctx;
+
+	if (frames > c->frames) frames = c->frames;
+	memcpy(dst, c->data, frames * c->frame_size);
+	c->data += frames * c->frame_size;
+	c->frames -= frames;
+	return frames;
+}
+
+snd_pcm_sframes_t omxalsa_mixer_fill(OMXALSA_MIXER_INPUT *in, ALSA_WRITER_FILL fill, void *ctx)
+{
+	OMXALSA_MIXER *m = in->mixer;
+	unsigned int ch = m->channels;
+	size_t mask = in->ring_frames - 1;
+	size_t head, space, off, chunk, n;
+	snd_pcm_sframes_t total = 0;
+
+	for (;;) {
+		head = in->head;
+		space = in->ring_frames - (head - __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE));
+		if (!space) {
+			/* the mix thread takes a period per device period, a buffer's
+			 * worth without progress means the device is gone */
+			pthread_mutex_lock(&m->mutex);
+			in->waiting = true;
+			if (in->tail == head - in->ring_frames)
+				omxalsa_mixer_timedwait(&m->room_cond, &m->mutex, 1000000000);
+			in->waiting = false;
+			space = in->ring_frames - (head - in->tail);
+			pthread_mutex_unlock(&m->mutex);
+			if (!space) break;
+			continue;
+		}
+
+		off = head & mask;
+		chunk = space < in->ring_frames - off ? space : in->ring_frames - off;
+		n = fill(ctx, (uint8_t *) (in->ring + off * ch), chunk);
+		__atomic_store_n(&in->head, head + n, __ATOMIC_RELEASE);
+		total += n;
+
+		/* pairs with the fence in the mix thread before it sleeps */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (n && __atomic_load_n(&m->mix_waiting, __ATOMIC_RELAXED)) {
+			pthread_mutex_lock(&m->mutex);
+			pthread_cond_signal(&m->data_cond);
+			pthread_mutex_unlock(&m->mutex);
+		}
+		if (n < chunk) break;
+	}
+	return total;
+}
+
+snd_pcm_sframes_t omxalsa_mixer_write(OMXALSA_MIXER_INPUT *in, const uint8_t *data, snd_pcm_uframes_t frames)
+{
+	OMXALSA_MIXER_COPY c;
+
+	c.data = data;
+	c.frames = frames;
+	c.frame_size = in->mixer->channels * sizeof(int16_t);
+	return omxalsa_mixer_fill(in, omxalsa_mixer_copy, &c);
+}
+
+void omxalsa_mixer_drain(OMXALSA_MIXER_INPUT *in)
+{
+	OMXALSA_MIXER *m = in->mixer;
+	long period_ns = omxalsa_mixer_period_ns(m);
+	snd_pcm_sframes_t delay;
+	struct timespec ts;
+	int periods = 0;
+
+	/* the device keeps running for everyone else, so wait for this
+	 * input to be mixed and then for the device to play it */
+	pthread_mutex_lock(&m->mutex);
+	while (in->tail != in->head && periods++ < (int) (m->buffer_size / m->period_size) + 2) {
+		in->waiting = true;
+		omxalsa_mixer_timedwait(&m->room_cond, &m->mutex, period_ns);
+		in->waiting = false;
+	}
+	pthread_mutex_unlock(&m->mutex);
+
+	delay = __atomic_load_n(&m->delay, __ATOMIC_RELAXED);
+	if (delay > 0) {
+		ts.tv_sec = delay / m->rate;
+		ts.tv_nsec = (int64_t) (delay % m->rate) * 1000000000 / m->rate;
+		nanosleep(&ts, 0);
+	}
+}
+
+snd_pcm_sframes_t omxalsa_mixer_delay(OMXALSA_MIXER_INPUT *in, snd_pcm_state_t *state)
+{
+	OMXALSA_MIXER *m = in->mixer;
+	size_t queued = __atomic_load_n(&in->head, __ATOMIC_RELAXED) - __atomic_load_n(&in->tail, __ATOMIC_RELAXED);
+
+	*state = __atomic_load_n(&m->state, __ATOMIC_RELAXED);
+	return queued + __atomic_load_n(&m->delay, __ATOMIC_RELAXED);
+}
+
+void omxalsa_mixer_set_gain(OMXALSA_MIXER_INPUT *in, float gain)
+{
+	__atomic_store(&in->gain, &gain, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * Process-wide software mixer in front of an ALSA playback device, for OMX
+ * ALSA sinks that share one output.
+ *
+ * The first sink to attach to a device name opens it and starts the mix
+ * thread, the last one to detach closes it. Each sink gets an input: a
+ * single producer ring of S16 interleaved frames it writes (or resamples)
+ * straight into, the same way it would into the device ring. The mix thread
+ * sums every input with its gain into float, converts once and writes the
+ * result into the device with the ALSA writer, so there is one device
+ * handle and one period wakeup no matter how many players are running.
+ *
+ * An input that runs dry is left out of the mix until it has data again,
+ * inputs with data are mixed in step so none of them gains a gap. A sink's
+ * delay is what sits in its input plus what the device has queued, which
+ * is what it reports to its clock.
+ *
+ * Only S16 interleaved is mixed. The device runs at the rate and channel
+ * count of the first sink; later sinks must match the channel count and
+ * resample to the rate they are given.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <alsa/asoundlib.h>
+
+#include "OMXAlsaWriter.h"
+
+#define OMXALSA_MIXER_MAX_INPUTS	16
+
+typedef struct _OMXALSA_MIXER OMXALSA_MIXER;
+typedef struct _OMXALSA_MIXER_INPUT OMXALSA_MIXER_INPUT;
+
+/* Attaches to the shared output for device, opening it with channels and
+ * *rate and period_time/buffer_time in microseconds (0 = 50ms periods in a
+ * 200ms ring) if this is the first input. *rate and *period_size are set to
+ * what the device runs at. NULL if the device could not be opened, the
+ * channel count does not match or all inputs are taken. */
+OMXALSA_MIXER_INPUT *omxalsa_mixer_attach(const char *device, unsigned int channels, unsigned int *rate,
+	snd_pcm_uframes_t *period_size, unsigned int period_time, unsigned int buffer_time);
+void omxalsa_mixer_detach(OMXALSA_MIXER_INPUT *in);
+
+/* Runs fill until it is out of data, blocking while the input is full.
+ * Returns frames written. */
+snd_pcm_sframes_t omxalsa_mixer_fill(OMXALSA_MIXER_INPUT *in, ALSA_WRITER_FILL fill, void *ctx);
+snd_pcm_sframes_t omxalsa_mixer_write(OMXALSA_MIXER_INPUT *in, const uint8_t *data, snd_pcm_uframes_t frames);
+
+/* Waits until everything written so far has been played */
+void omxalsa_mixer_drain(OMXALSA_MIXER_INPUT *in);
+
+/* Frames written to this input that have not been played yet, and the
+ * device state */
+snd_pcm_sframes_t omxalsa_mixer_delay(OMXALSA_MIXER_INPUT *in, snd_pcm_state_t *state);
+
+/* Linear gain applied when the input is mixed, 1.0 by default */
+void omxalsa_mixer_set_gain(OMXALSA_MIXER_INPUT *in, float gain);
@@ -0,0 +1,206 @@
+#include "OMXAlsaWriter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int alsa_writer_set_access(snd_pcm_t *dev, snd_pcm_hw_params_t *hwp, bool interleaved, bool try_mmap, bool *mmap)
+{
+	snd_pcm_access_t rw = interleaved ? SND_PCM_ACCESS_RW_INTERLEAVED : SND_PCM_ACCESS_RW_NONINTERLEAVED;
+
+	/* Buffers arrive interleaved, a single area is all the fill callbacks
+	 * know how to write to */
+	*mmap = false;
+	if (try_mmap && interleaved &&
+	    snd_pcm_hw_params_test_access(dev, hwp, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0 &&
+	    snd_pcm_hw_params_set_access(dev, hwp, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0) {
+		*mmap = true;
+		return 0;
+	}
+	return snd_pcm_hw_params_set_access(dev, hwp, rw);
+}
+
+int alsa_writer_init(ALSA_WRITER *w, snd_pcm_t *dev, size_t frame_size, bool mmap, snd_pcm_uframes_t buf_frames)
+{
+	snd_pcm_sw_params_t *swp;
+	snd_pcm_uframes_t period_size;
+	int err;
+
+	memset(w, 0, sizeof *w);
+	w->dev = dev;
+	w->frame_size = frame_size;
+	w->mmap = mmap;
+
+	err = snd_pcm_get_params(dev, &w->buffer_size, &period_size);
+	if (err < 0) return err;
+
+	/* mmap_commit does not start the stream by itself, so honour the
+	 * start threshold the same way snd_pcm_writei would */
+	snd_pcm_sw_params_alloca(&swp);
+	err = snd_pcm_sw_params_current(dev, swp);
+	if (err < 0) return err;
+	err = snd_pcm_sw_params_get_start_threshold(swp, &w->start_threshold);
+	if (err < 0) return err;
+	if (w->start_threshold > w->buffer_size) w->start_threshold = w->buffer_size;
+	if (!w->start_threshold) w->start_threshold = 1;
+
+	if (!mmap) {
+		w->buf_frames = buf_frames;
+		w->buf = (uint8_t *) malloc(buf_frames * frame_size);
+		if (!w->buf) return -ENOMEM;
+	}
+	return 0;
+}
+
+void alsa_writer_fini(ALSA_WRITER *w)
+{
+	free(w->buf);
+	w->buf = 0;
+	w->buf_frames = 0;
+}
+
+static int alsa_writer_recover(ALSA_WRITER *w, int err)
+{
+	if (err == -EPIPE || err == -ESTRPIPE) w->xruns++;
+	return snd_pcm_recover(w->dev, err, 1);
+}
+
+/* Free space in the ring, waits for the device to make some when there is none */
+static snd_pcm_sframes_t alsa_writer_avail(ALSA_WRITER *w)
+{
+	snd_pcm_sframes_t avail;
+	int err;
+
+	for (;;) {
+		avail = snd_pcm_avail_update(w->dev);
+		if (avail < 0) {
+			if ((err = alsa_writer_recover(w, avail)) < 0) return err;
+			continue;
+		}
+		if (avail > 0) return avail;
+
+		/* full but not started, the start threshold is above what fits */
+		if (snd_pcm_state(w->dev) == SND_PCM_STATE_PREPARED) {
+			if ((err = snd_pcm_start(w->dev)) < 0) return err;
+		}
+		err = snd_pcm_wait(w->dev, 1000);
+		if (err < 0 && (err = alsa_writer_recover(w, err)) < 0) return err;
+	}
+}
+
+static void alsa_writer_autostart(ALSA_WRITER *w)
+{
+	snd_pcm_sframes_t avail;
+
+	if (snd_pcm_state(w->dev) != SND_PCM_STATE_PREPARED) return;
+	avail = snd_pcm_avail_update(w->dev);
+	if (avail >= 0 && w->buffer_size - avail >= w->start_threshold)
+		snd_pcm_start(w->dev);
+}
+
+static snd_pcm_sframes_t alsa_writer_writei(ALSA_WRITER *w, const uint8_t *data, snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t n, total = 0;
+	int err;
+
+	while (frames > 0) {
+		n = snd_pcm_writei(w->dev, data, frames);
+		if (n < 0) {
+			if ((err = alsa_writer_recover(w, n)) < 0) return err;
+			continue;
+		}
+		frames -= n;
+		total += n;
+		data += n * w->frame_size;
+	}
+	return total;
+}
+
+/* One mmap_begin/commit round, offered is the space fill was given */
+static snd_pcm_sframes_t alsa_writer_mmap(ALSA_WRITER *w, ALSA_WRITER_FILL fill, void *ctx, snd_pcm_uframes_t *offered)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames, n;
+	snd_pcm_sframes_t avail, r;
+	uint8_t *dst;
+	int err;
+
+	for (;;) {
+		if ((avail = alsa_writer_avail(w)) < 0) return avail;
+
+		frames = avail;
+		err = snd_pcm_mmap_begin(w->dev, &areas, &offset, &frames);
+		if (err >= 0) break;
+		if ((err = alsa_writer_recover(w, err)) < 0) return err;
+	}
+
+	dst = (uint8_t *) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+	n = fill(ctx, dst, frames);
+	*offered = frames;
+
+	r = snd_pcm_mmap_commit(w->dev, offset, n);
+	if (r < 0 || (snd_pcm_uframes_t) r != n) {
+		/* what fill produced is lost, playback carries on from the next block */
+		if ((err = alsa_writer_recover(w, r >= 0 ? -EPIPE : r)) < 0) return err;
+		return 0;
+	}
+	alsa_writer_autostart(w);
+	return n;
+}
+
+snd_pcm_sframes_t alsa_writer_fill(ALSA_WRITER *w, ALSA_WRITER_FILL fill, void *ctx)
+{
+	snd_pcm_uframes_t n, offered;
+	snd_pcm_sframes_t total = 0, r;
+
+	if (!w->mmap) {
+		do {
+			n = fill(ctx, w->buf, w->buf_frames);
+			if ((r = alsa_writer_writei(w, w->buf, n)) < 0) return r;
+			total += n;
+		} while (n == w->buf_frames);
+		return total;
+	}
+
+	do {
+		if ((r = alsa_writer_mmap(w, fill, ctx, &offered)) < 0) return r;
+		total += r;
+	} while ((snd_pcm_uframes_t) r == offered);
+	return total;
+}
+
+typedef struct {
+	const uint8_t *data;
+	snd_pcm_uframes_t frames;
+	size_t frame_size;
+} ALSA_WRITER_COPY;
+
+static snd_pcm_uframes_t alsa_writer_copy(void *ctx, uint8_t *dst, snd_pcm_uframes_t frames)
+{
+	ALSA_WRITER_COPY *c = (ALSA_WRITER_COPY *) ctx;
+
+	if (frames > c->frames) frames = c->frames;
+	memcpy(dst, c->data, frames * c->frame_size);
+	c->data += frames * c->frame_size;
+	c->frames -= frames;
+	return frames;
+}
+
+snd_pcm_sframes_t alsa_writer_write(ALSA_WRITER *w, const uint8_t *data, snd_pcm_uframes_t frames)
+{
+	ALSA_WRITER_COPY c;
+	snd_pcm_uframes_t offered;
+	snd_pcm_sframes_t r;
+
+	if (!w->mmap)
+		return alsa_writer_writei(w, data, frames);
+
+	c.data = data;
+	c.frames = frames;
+	c.frame_size = w->frame_size;
+	/* loop on what is left rather than on a short fill, so a block that
+	 * exactly fills the ring does not wait for room it will not use */
+	while (c.frames > 0) {
+		if ((r = alsa_writer_mmap(w, alsa_writer_copy, &c, &offered)) < 0) return r;
+	}
+	return frames;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * Moves frames into an ALSA playback device for the OMX ALSA sink.
+ *
+ * With mmap access the producer (swresample or a plain copy) writes straight
+ * into the device ring between snd_pcm_mmap_begin and snd_pcm_mmap_commit,
+ * so a period is touched once instead of being rendered into a bounce buffer
+ * and copied again by snd_pcm_writei. Devices or plugins without mmap
+ * support fall back to snd_pcm_writei from the bounce buffer.
+ *
+ * Only depends on alsa-lib, so it can be exercised against the null and
+ * file plugins on any Linux box (see example-audio-benchmarks).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <alsa/asoundlib.h>
+
+typedef struct _ALSA_WRITER {
+	snd_pcm_t *dev;
+	size_t frame_size;
+	bool mmap;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t start_threshold;
+
+	/* writei fallback only */
+	uint8_t *buf;
+	snd_pcm_uframes_t buf_frames;
+
+	unsigned int xruns;
+} ALSA_WRITER;
+
+/* Produces at most frames frames at dst and returns how many it wrote.
+ * Returning fewer than offered means the producer is out of data. */
+typedef snd_pcm_uframes_t (*ALSA_WRITER_FILL)(void *ctx, uint8_t *dst, snd_pcm_uframes_t frames);
+
+/* Picks mmap access when the device offers it (and try_mmap is set),
+ * read/write access otherwise. Call while setting up hw params. */
+int alsa_writer_set_access(snd_pcm_t *dev, snd_pcm_hw_params_t *hwp, bool interleaved, bool try_mmap, bool *mmap);
+
+/* Call after snd_pcm_hw_params. buf_frames sizes the writei bounce buffer. */
+int alsa_writer_init(ALSA_WRITER *w, snd_pcm_t *dev, size_t frame_size, bool mmap, snd_pcm_uframes_t buf_frames);
+void alsa_writer_fini(ALSA_WRITER *w);
+
+/* Runs fill until it is out of data, blocking for space in the device.
+ * Returns frames written or a negative ALSA error that could not be
+ * recovered from; xruns are recovered and counted in w->xruns. */
+snd_pcm_sframes_t alsa_writer_fill(ALSA_WRITER *w, ALSA_WRITER_FILL fill, void *ctx);
+
+/* Writes frames from data, copied into the ring with mmap and handed to
+ * snd_pcm_writei without a bounce otherwise. */
+snd_pcm_sframes_t alsa_writer_write(ALSA_WRITER *w, const uint8_t *data, snd_pcm_uframes_t frames);
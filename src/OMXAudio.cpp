@@ -25,6 +25,8 @@
 #endif
 
 #include "OMXAudio.h"
+#include "OMXGlobalInit.h"
+#include "OMXAlsa.h"
 #include "utils/log.h"
 
 #define CLASSNAME "COMXAudio"
@@ -70,7 +72,8 @@ COMXAudio::COMXAudio() :
   m_eEncoding       (OMX_AUDIO_CodingPCM),
   m_last_pts        (DVD_NOPTS_VALUE),
   m_submitted_eos   (false  ),
-  m_failed_eos      (false  )
+  m_failed_eos      (false  ),
+  m_dllAvUtil       (COMXGlobalInit::AvUtil())
 {
 }
 
@@ -253,6 +256,30 @@ bool COMXAudio::PortSettingsChanged()
       CLog::Log(LOGERROR, "%s::%s - m_omx_render_analog.SetConfig omx_err(0x%08x)", CLASSNAME, __func__, omx_err);
       return false;
     }
+
+    if (m_config.device == "omx:alsa" && (m_config.alsa_period_time || m_config.alsa_buffer_time))
+    {
+      OMXALSA_CONFIG_BUFFERTIMETYPE bufferTime;
+      OMX_INIT_STRUCTURE(bufferTime);
+      bufferTime.nPeriodTime = m_config.alsa_period_time;
+      bufferTime.nBufferTime = m_config.alsa_buffer_time;
+      omx_err = m_omx_render_analog.SetConfig(OMXALSA_IndexConfigBufferTime, &bufferTime);
+      if (omx_err != OMX_ErrorNone)
+        CLog::Log(LOGERROR, "%s::%s - period %u us, buffer %u us rejected omx_err(0x%08x), using defaults", CLASSNAME, __func__, m_config.alsa_period_time, m_config.alsa_buffer_time, omx_err);
+    }
+
+    SetAlsaPortBuffers();
+
+    if (m_config.device == "omx:alsa" && m_config.alsa_shared)
+    {
+      OMX_CONFIG_BOOLEANTYPE shared;
+      OMX_INIT_STRUCTURE(shared);
+      shared.bEnabled = OMX_TRUE;
+      omx_err = m_omx_render_analog.SetConfig(OMXALSA_IndexConfigSharedOutput, &shared);
+      if (omx_err != OMX_ErrorNone)
+        CLog::Log(LOGERROR, "%s::%s - shared output rejected omx_err(0x%08x), opening %s directly", CLASSNAME, __func__, omx_err, m_config.subdevice.c_str());
+      UpdateMixGain();
+    }
   }
 
   if( m_omx_render_hdmi.IsInitialized() )
@@ -355,6 +382,7 @@ bool COMXAudio::PortSettingsChanged()
       CLog::Log(LOGERROR, "%s::%s - m_omx_tunnel_decoder.Establish omx_err(0x%08x)", CLASSNAME, __func__, omx_err);
       return false;
     }
+    LogAlsaPortBuffers();
   }
 
   if( m_omx_splitter.IsInitialized() )
@@ -404,7 +432,7 @@ bool COMXAudio::Initialize(OMXClock *clock, const OMXAudioConfig &config, uint64
 
   Deinitialize();
 
-  if(!m_dllAvUtil.Load())
+  if(!COMXGlobalInit::Initialize())
     return false;
 
   m_config = config;
@@ -720,8 +748,6 @@ bool COMXAudio::Deinitialize()
 
   m_Initialized = false;
 
-  m_dllAvUtil.Unload();
-
   while(!m_ampqueue.empty())
     m_ampqueue.pop_front();
 
@@ -790,6 +816,84 @@ void COMXAudio::SetVolume(float fVolume)
     UpdateAttenuation();
 }
 
+void COMXAudio::SetMixGain(float gain)
+{
+  CSingleLock lock (m_critSection);
+  m_config.alsa_mix_gain = gain;
+  if (m_settings_changed)
+    UpdateMixGain();
+}
+
+void COMXAudio::UpdateMixGain()
+{
+  if (m_config.device != "omx:alsa" || !m_config.alsa_shared || !m_omx_render_analog.IsInitialized())
+    return;
+
+  OMXALSA_CONFIG_MIXGAINTYPE mixGain;
+  OMX_INIT_STRUCTURE(mixGain);
+  mixGain.nGain = (OMX_U32)(std::max(m_config.alsa_mix_gain, 0.0f) * 65536.0f + 0.5f);
+  OMX_ERRORTYPE omx_err = m_omx_render_analog.SetConfig(OMXALSA_IndexConfigMixGain, &mixGain);
+  if (omx_err != OMX_ErrorNone)
+    CLog::Log(LOGERROR, "%s::%s - mix gain %f rejected omx_err(0x%08x)", CLASSNAME, __func__, m_config.alsa_mix_gain, omx_err);
+}
+
+// sizes the mixer -> sink tunnel from m_config before it is set up, the
+// mixer output and the sink both get asked since the tunnel takes the larger
+void COMXAudio::SetAlsaPortBuffers()
+{
+  if (m_config.device != "omx:alsa" || !m_omx_render_analog.IsInitialized() || !m_omx_mixer.IsInitialized())
+    return;
+  if (!m_config.alsa_port_buffers && !m_config.alsa_port_buffer_time)
+    return;
+
+  unsigned int frame_size = m_pcm_output.nChannels * m_pcm_output.nBitPerSample >> 3;
+  unsigned int frames = (uint64_t)m_pcm_output.nSamplingRate * m_config.alsa_port_buffer_time / 1000000;
+
+  OMXALSA_PARAM_PORTBUFFERSTYPE buffers;
+  OMX_INIT_STRUCTURE(buffers);
+  buffers.nBufferCount = m_config.alsa_port_buffers ? m_config.alsa_port_buffers : 4;
+  buffers.nBufferSize = frames && frame_size ? frames * frame_size : 8 * 1024;
+  OMX_ERRORTYPE omx_err = m_omx_render_analog.SetParameter(OMXALSA_IndexParamPortBuffers, &buffers);
+  if (omx_err != OMX_ErrorNone)
+  {
+    CLog::Log(LOGERROR, "%s::%s - %u buffers of %u bytes rejected omx_err(0x%08x), using defaults", CLASSNAME, __func__,
+      (unsigned int)buffers.nBufferCount, (unsigned int)buffers.nBufferSize, omx_err);
+    return;
+  }
+
+  OMX_PARAM_PORTDEFINITIONTYPE port;
+  OMX_INIT_STRUCTURE(port);
+  port.nPortIndex = m_omx_mixer.GetOutputPort();
+  omx_err = m_omx_mixer.GetParameter(OMX_IndexParamPortDefinition, &port);
+  if (omx_err == OMX_ErrorNone && (port.nBufferSize > buffers.nBufferSize || port.nBufferCountActual > buffers.nBufferCount))
+  {
+    port.nBufferSize = buffers.nBufferSize;
+    port.nBufferCountActual = std::max(port.nBufferCountMin, buffers.nBufferCount);
+    omx_err = m_omx_mixer.SetParameter(OMX_IndexParamPortDefinition, &port);
+  }
+  if (omx_err != OMX_ErrorNone)
+    CLog::Log(LOGWARNING, "%s::%s - mixer output keeps its own buffers omx_err(0x%08x)", CLASSNAME, __func__, omx_err);
+}
+
+// what the mixer -> sink tunnel agreed on, which bounds the sink's port queue
+void COMXAudio::LogAlsaPortBuffers()
+{
+  if (m_config.device != "omx:alsa" || !m_omx_render_analog.IsInitialized())
+    return;
+
+  OMX_PARAM_PORTDEFINITIONTYPE port;
+  OMX_INIT_STRUCTURE(port);
+  port.nPortIndex = m_omx_render_analog.GetInputPort();
+  if (m_omx_render_analog.GetParameter(OMX_IndexParamPortDefinition, &port) != OMX_ErrorNone)
+    return;
+
+  unsigned int bytes_per_sec = m_pcm_output.nSamplingRate * m_pcm_output.nChannels * m_pcm_output.nBitPerSample >> 3;
+  CLog::Log(LOGINFO, "%s::%s - %u buffers of %u bytes, %.1fms, period %u us buffer %u us", CLASSNAME, __func__,
+    (unsigned int)port.nBufferCountActual, (unsigned int)port.nBufferSize,
+    bytes_per_sec ? 1000.0 * port.nBufferCountActual * port.nBufferSize / bytes_per_sec : 0.0,
+    m_config.alsa_period_time, m_config.alsa_buffer_time);
+}
+
 float COMXAudio::GetVolume() 
 {
   return m_Mute ? VOLUME_MINIMUM : m_CurrentVolume;
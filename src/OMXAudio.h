@@ -40,6 +40,8 @@
 
 #define AUDIO_BUFFER_SECONDS 3
 
+class OMXAudioTap;
+
 class OMXAudioConfig
 {
 public:
@@ -54,6 +56,15 @@ public:
   bool is_live;
   float queue_size;
   float fifo_size;
+  float pcm_queue_seconds;  // decoded audio buffered between the decode and submit threads
+  unsigned int alsa_period_time;  // omx:alsa only, in microseconds, 0 = 50ms periods
+  unsigned int alsa_buffer_time;  // omx:alsa only, in microseconds, 0 = 200ms ring
+  unsigned int alsa_port_buffers;  // omx:alsa only, OMX buffers between the mixer and the sink, 0 = 4
+  unsigned int alsa_port_buffer_time;  // omx:alsa only, in microseconds each, 0 = 8KB
+  OMXAudioTap *tap;  // decoded PCM is copied here when set, not owned
+  bool alsa_shared;  // omx:alsa only, mix into one process-wide output per device
+  float alsa_mix_gain;  // alsa_shared only, linear gain into the shared mix
+  float crossfade;  // seconds of overlap at a gapless transition, 0 = end to end
 
   OMXAudioConfig()
   {
@@ -65,6 +76,38 @@ public:
     is_live = false;
     queue_size = 3.0f;
     fifo_size = 2.0f;
+    pcm_queue_seconds = 0.5f;
+    alsa_period_time = 0;
+    alsa_buffer_time = 0;
+    alsa_port_buffers = 0;
+    alsa_port_buffer_time = 0;
+    tap = NULL;
+    alsa_shared = false;
+    alsa_mix_gain = 1.0f;
+    crossfade = 0.0f;
+  }
+
+  // 5ms periods in a 20ms ALSA ring, fed by two 5ms OMX buffers instead of
+  // four 8KB ones (~170ms at 48kHz stereo), and a short decode queue, for
+  // interactive use. Needs a device and enough CPU to keep a 20ms ring fed.
+  // OMXAudioPipelineStats::render_latency_ms reports what it comes to.
+  void SetLowLatency()
+  {
+    alsa_period_time = 5000;
+    alsa_buffer_time = 20000;
+    alsa_port_buffers = 2;
+    alsa_port_buffer_time = 5000;
+    pcm_queue_seconds = 0.05f;
+  }
+
+  // back to the defaults above
+  void ClearLowLatency()
+  {
+    alsa_period_time = 0;
+    alsa_buffer_time = 0;
+    alsa_port_buffers = 0;
+    alsa_port_buffer_time = 0;
+    pcm_queue_seconds = 0.5f;
   }
 };
 
@@ -99,6 +142,7 @@ public:
   void SetVolume(float nVolume);
   float GetVolume();
   void SetMute(bool bOnOff);
+  void SetMixGain(float gain);
   void SetDynamicRangeCompression(long drc);
   bool ApplyVolume();
   void SubmitEOS();
@@ -116,6 +160,9 @@ public:
   void PrintChannels(OMX_AUDIO_CHANNELTYPE eChannelMapping[]);
   void PrintPCM(OMX_AUDIO_PARAM_PCMMODETYPE *pcm, std::string direction);
   void UpdateAttenuation();
+  void UpdateMixGain();
+  void SetAlsaPortBuffers();
+  void LogAlsaPortBuffers();
   void BuildChannelMap(enum PCMChannels *channelMap, uint64_t layout);
   int BuildChannelMapCEA(enum PCMChannels *channelMap, uint64_t layout);
   void BuildChannelMapOMX(enum OMX_AUDIO_CHANNELTYPE *channelMap, uint64_t layout);
@@ -173,7 +220,7 @@ protected:
   COMXCoreTunel     m_omx_tunnel_decoder;
   COMXCoreTunel     m_omx_tunnel_splitter_analog;
   COMXCoreTunel     m_omx_tunnel_splitter_hdmi;
-  DllAvUtil         m_dllAvUtil;
+  DllAvUtil         &m_dllAvUtil;
   CCriticalSection m_critSection;
 };
 #endif
@@ -21,17 +21,22 @@
 #define TARGET_LINUX
 
 #include "OMXAudioCodecOMX.h"
+#include "OMXGlobalInit.h"
 #ifdef TARGET_LINUX
 #endif
 #include "utils/log.h"
 
 #include "utils/PCMRemap.h"
+#include "utils/AudioKernels.h"
 
 // the size of the audio_render output port buffers
 #define AUDIO_DECODE_OUTPUT_BUFFER (32*1024)
 static const char rounded_up_channels_shift[] = {0,0,1,2,2,3,3,3,3};
 
-COMXAudioCodecOMX::COMXAudioCodecOMX()
+COMXAudioCodecOMX::COMXAudioCodecOMX() :
+  m_dllAvCodec(COMXGlobalInit::AvCodec()),
+  m_dllAvUtil(COMXGlobalInit::AvUtil()),
+  m_dllSwResample(COMXGlobalInit::SwResample())
 {
   m_pBufferOutput = NULL;
   m_iBufferOutputAlloced = 0;
@@ -64,11 +69,9 @@ bool COMXAudioCodecOMX::Open(COMXStreamInfo &hints, enum PCMLayout layout)
   AVCodec* pCodec;
   m_bOpenedCodec = false;
 
-  if (!m_dllAvUtil.Load() || !m_dllAvCodec.Load() || !m_dllSwResample.Load())
+  if (!COMXGlobalInit::Initialize())
     return false;
 
-  m_dllAvCodec.avcodec_register_all();
-
   pCodec = m_dllAvCodec.avcodec_find_decoder(hints.codec);
   if (!pCodec)
   {
@@ -151,10 +154,6 @@ void COMXAudioCodecOMX::Dispose()
     m_pCodecContext = NULL;
   }
 
-  m_dllAvCodec.Unload();
-  m_dllAvUtil.Unload();
-  m_dllSwResample.Unload();
-
   m_bGotFrame = false;
 }
 
@@ -241,36 +240,39 @@ int COMXAudioCodecOMX::GetData(BYTE** dst, double &dts, double &pts)
   /* need to convert format */
   if(m_pCodecContext->sample_fmt != m_desiredSampleFormat)
   {
-    if(m_pConvert && (m_pCodecContext->sample_fmt != m_iSampleFormat || m_channels != m_pCodecContext->channels))
+    if(!ConvertFrame(m_pBufferOutput + m_iBufferOutputUsed))
     {
-      m_dllSwResample.swr_free(&m_pConvert);
-      m_channels = m_pCodecContext->channels;
-    }
+      if(m_pConvert && (m_pCodecContext->sample_fmt != m_iSampleFormat || m_channels != m_pCodecContext->channels))
+      {
+        m_dllSwResample.swr_free(&m_pConvert);
+        m_channels = m_pCodecContext->channels;
+      }
 
-    if(!m_pConvert)
-    {
-      m_iSampleFormat = m_pCodecContext->sample_fmt;
-      m_pConvert = m_dllSwResample.swr_alloc_set_opts(NULL,
-                      m_dllAvUtil.av_get_default_channel_layout(m_pCodecContext->channels), 
-                      m_desiredSampleFormat, m_pCodecContext->sample_rate,
-                      m_dllAvUtil.av_get_default_channel_layout(m_pCodecContext->channels), 
-                      m_pCodecContext->sample_fmt, m_pCodecContext->sample_rate,
-                      0, NULL);
-
-      if(!m_pConvert || m_dllSwResample.swr_init(m_pConvert) < 0)
+      if(!m_pConvert)
       {
-        CLog::Log(LOGINFO, "COMXAudioCodecOMX::Decode - Unable to initialise convert format %d to %d", m_pCodecContext->sample_fmt, m_desiredSampleFormat);
-        return 0;
+        m_iSampleFormat = m_pCodecContext->sample_fmt;
+        m_pConvert = m_dllSwResample.swr_alloc_set_opts(NULL,
+                        m_dllAvUtil.av_get_default_channel_layout(m_pCodecContext->channels), 
+                        m_desiredSampleFormat, m_pCodecContext->sample_rate,
+                        m_dllAvUtil.av_get_default_channel_layout(m_pCodecContext->channels), 
+                        m_pCodecContext->sample_fmt, m_pCodecContext->sample_rate,
+                        0, NULL);
+
+        if(!m_pConvert || m_dllSwResample.swr_init(m_pConvert) < 0)
+        {
+          CLog::Log(LOGINFO, "COMXAudioCodecOMX::Decode - Unable to initialise convert format %d to %d", m_pCodecContext->sample_fmt, m_desiredSampleFormat);
+          return 0;
+        }
       }
-    }
 
-    /* use unaligned flag to keep output packed */
-    uint8_t *out_planes[m_pCodecContext->channels];
-    if(m_dllAvUtil.av_samples_fill_arrays(out_planes, NULL, m_pBufferOutput + m_iBufferOutputUsed, m_pCodecContext->channels, m_pFrame1->nb_samples, m_desiredSampleFormat, 1) < 0 ||
-       m_dllSwResample.swr_convert(m_pConvert, out_planes, m_pFrame1->nb_samples, (const uint8_t **)m_pFrame1->data, m_pFrame1->nb_samples) < 0)
-    {
-      CLog::Log(LOGINFO, "COMXAudioCodecOMX::Decode - Unable to convert format %d to %d", (int)m_pCodecContext->sample_fmt, m_desiredSampleFormat);
-      outputSize = 0;
+      /* use unaligned flag to keep output packed */
+      uint8_t *out_planes[m_pCodecContext->channels];
+      if(m_dllAvUtil.av_samples_fill_arrays(out_planes, NULL, m_pBufferOutput + m_iBufferOutputUsed, m_pCodecContext->channels, m_pFrame1->nb_samples, m_desiredSampleFormat, 1) < 0 ||
+         m_dllSwResample.swr_convert(m_pConvert, out_planes, m_pFrame1->nb_samples, (const uint8_t **)m_pFrame1->data, m_pFrame1->nb_samples) < 0)
+      {
+        CLog::Log(LOGINFO, "COMXAudioCodecOMX::Decode - Unable to convert format %d to %d", (int)m_pCodecContext->sample_fmt, m_desiredSampleFormat);
+        outputSize = 0;
+      }
     }
   }
   else
@@ -294,6 +296,46 @@ int COMXAudioCodecOMX::GetData(BYTE** dst, double &dts, double &pts)
   return 0;
 }
 
+// the usual decoder output formats are converted with the AudioKernels,
+// anything else is left to swresample
+bool COMXAudioCodecOMX::ConvertFrame(uint8_t *dst)
+{
+  if (m_desiredSampleFormat != AV_SAMPLE_FMT_FLTP)
+    return false;
+
+  int channels = m_pCodecContext->channels;
+  int samples = m_pFrame1->nb_samples;
+  uint8_t **src = m_pFrame1->extended_data;
+  void *out_planes[channels];
+  for (int i = 0; i < channels; i++)
+    out_planes[i] = dst + i * samples * sizeof(float);
+
+  switch (m_pCodecContext->sample_fmt)
+  {
+    case AV_SAMPLE_FMT_FLT:
+      AudioKernels::Deinterleave32(src[0], out_planes, channels, samples);
+      return true;
+    case AV_SAMPLE_FMT_S16:
+      AudioKernels::S16ToFloatPlanar((const int16_t *)src[0], (float **)out_planes, channels, samples);
+      return true;
+    case AV_SAMPLE_FMT_S16P:
+      for (int i = 0; i < channels; i++)
+        AudioKernels::S16ToFloat((const int16_t *)src[i], (float *)out_planes[i], samples);
+      return true;
+    case AV_SAMPLE_FMT_S32:
+      AudioKernels::Deinterleave32(src[0], out_planes, channels, samples);
+      for (int i = 0; i < channels; i++)
+        AudioKernels::S32ToFloat((const int32_t *)out_planes[i], (float *)out_planes[i], samples);
+      return true;
+    case AV_SAMPLE_FMT_S32P:
+      for (int i = 0; i < channels; i++)
+        AudioKernels::S32ToFloat((const int32_t *)src[i], (float *)out_planes[i], samples);
+      return true;
+    default:
+      return false;
+  }
+}
+
 void COMXAudioCodecOMX::Reset()
 {
   if (m_pCodecContext) m_dllAvCodec.avcodec_flush_buffers(m_pCodecContext);
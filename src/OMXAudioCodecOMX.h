@@ -49,6 +49,8 @@ public:
   unsigned int GetFrameSize() { return m_frameSize; }
 
 protected:
+  bool ConvertFrame(uint8_t *dst);
+
   AVCodecContext* m_pCodecContext;
   SwrContext*     m_pConvert;
   enum AVSampleFormat m_iSampleFormat;
@@ -69,7 +71,7 @@ protected:
   bool m_bNoConcatenate;
   unsigned int  m_frameSize;
   double m_dts, m_pts;
-  DllAvCodec m_dllAvCodec;
-  DllAvUtil m_dllAvUtil;
-  DllSwResample m_dllSwResample;
+  DllAvCodec &m_dllAvCodec;
+  DllAvUtil &m_dllAvUtil;
+  DllSwResample &m_dllSwResample;
 };
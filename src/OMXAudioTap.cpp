@@ -0,0 +1,226 @@
+#include "OMXAudioTap.h"
+#include "OMXTime.h"
+#include "utils/AudioKernels.h"
+
+#include <string.h>
+#include <new>
+
+OMXAudioTap::OMXAudioTap()
+{
+  m_slots     = NULL;
+  m_count     = 0;
+  m_write     = 0;
+  m_reset     = 0;
+  m_next_pts  = DVD_NOPTS_VALUE;
+}
+
+OMXAudioTap::~OMXAudioTap()
+{
+  delete [] m_slots.load();
+}
+
+bool OMXAudioTap::Open(unsigned int slots)
+{
+  // the slot being written is never readable, so one slot would hold nothing
+  if(m_slots.load() || slots < 2)
+    return false;
+
+  Slot *ring = new (std::nothrow) Slot[slots];
+  if(!ring)
+    return false;
+  for(unsigned int i = 0; i < slots; i++)
+    ring[i].seq.store(0, std::memory_order_relaxed);
+
+  m_count = slots;
+  m_slots.store(ring, std::memory_order_release);
+  return true;
+}
+
+OMXAudioTap::Slot *OMXAudioTap::BeginSlot()
+{
+  uint64_t index = m_write.load(std::memory_order_relaxed);
+  Slot *slot = &m_slots.load(std::memory_order_relaxed)[index % m_count];
+  slot->seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return slot;
+}
+
+void OMXAudioTap::EndSlot(Slot *slot)
+{
+  uint64_t index = m_write.load(std::memory_order_relaxed);
+  slot->seq.store(2 * index + 2, std::memory_order_release);
+  m_write.store(index + 1, std::memory_order_release);
+}
+
+void OMXAudioTap::Write(const uint8_t *data, int size, double pts, int channels, int sample_rate, int bits_per_sample, unsigned int frame_size)
+{
+  if(!m_slots.load(std::memory_order_relaxed) || size <= 0 || channels <= 0 ||
+     channels > OMX_AUDIO_TAP_MAX_CHANNELS || sample_rate <= 0)
+    return;
+
+  // codecs without timestamps on every packet carry on from the last block
+  if(pts == DVD_NOPTS_VALUE)
+    pts = m_next_pts;
+
+  const void *planes[OMX_AUDIO_TAP_MAX_CHANNELS];
+  int done = 0;
+  int block_frames;
+  int block_done;
+  int offset = 0;
+
+  if(bits_per_sample == 16)
+  {
+    frame_size = size;
+    block_frames = size / (2 * channels);
+  }
+  else
+  {
+    if(frame_size == 0 || frame_size > (unsigned int)size)
+      frame_size = size;
+    block_frames = frame_size / (4 * channels);
+  }
+
+  // one codec frame at a time, a slot never spans two so float planes can
+  // be interleaved straight into it
+  for(; block_frames > 0 && offset + (int)frame_size <= size; offset += frame_size)
+  {
+    for(block_done = 0; block_done < block_frames; )
+    {
+      int frames = block_frames - block_done;
+      if(frames > OMX_AUDIO_TAP_FRAMES)
+        frames = OMX_AUDIO_TAP_FRAMES;
+
+      Slot *slot = BeginSlot();
+      if(bits_per_sample == 16)
+      {
+        AudioKernels::S16ToFloat((const int16_t *)(data + offset) + block_done * channels, slot->samples, frames * channels);
+      }
+      else
+      {
+        for(int c = 0; c < channels; c++)
+          planes[c] = (const float *)(data + offset) + c * block_frames + block_done;
+        AudioKernels::Interleave32(planes, slot->samples, channels, frames);
+      }
+
+      OMXAudioTapBlock &block = slot->block;
+      block.pts         = pts == DVD_NOPTS_VALUE ? DVD_NOPTS_VALUE : pts + (double)done * DVD_TIME_BASE / sample_rate;
+      block.sample_rate = sample_rate;
+      block.channels    = channels;
+      block.frames      = frames;
+      memset(block.peak, 0, sizeof(block.peak));
+      memset(block.rms, 0, sizeof(block.rms));
+      AudioKernels::Levels(slot->samples, channels, frames, block.peak, block.rms);
+      EndSlot(slot);
+
+      block_done += frames;
+      done += frames;
+    }
+  }
+
+  m_next_pts = pts == DVD_NOPTS_VALUE ? DVD_NOPTS_VALUE : pts + (double)done * DVD_TIME_BASE / sample_rate;
+}
+
+void OMXAudioTap::Reset()
+{
+  m_reset.store(m_write.load(std::memory_order_relaxed), std::memory_order_release);
+  m_next_pts = DVD_NOPTS_VALUE;
+}
+
+uint64_t OMXAudioTap::GetCursor()
+{
+  return m_write.load(std::memory_order_acquire);
+}
+
+/* slots [first, end) are published and not being overwritten. m_reset is
+   read first so it can never be past end */
+void OMXAudioTap::Range(uint64_t &first, uint64_t &end)
+{
+  uint64_t reset = m_reset.load(std::memory_order_acquire);
+  end = m_write.load(std::memory_order_acquire);
+  first = end >= m_count ? end - m_count + 1 : 0;
+  if(first < reset)
+    first = reset;
+}
+
+bool OMXAudioTap::ReadSlot(uint64_t index, OMXAudioTapBlock &block, float *samples)
+{
+  Slot *slot = &m_slots.load(std::memory_order_acquire)[index % m_count];
+  uint64_t seq = 2 * index + 2;
+
+  if(slot->seq.load(std::memory_order_acquire) != seq)
+    return false;
+
+  memcpy(&block, &slot->block, sizeof(block));
+  if(samples)
+  {
+    // a torn header must not send the copy out of the slot
+    unsigned int count = block.frames * block.channels;
+    if(block.frames > OMX_AUDIO_TAP_FRAMES || block.channels > OMX_AUDIO_TAP_MAX_CHANNELS)
+      count = 0;
+    memcpy(samples, slot->samples, count * sizeof(float));
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool OMXAudioTap::Read(uint64_t &cursor, OMXAudioTapBlock &block, float *samples)
+{
+  uint64_t first, end;
+
+  if(!IsOpen())
+    return false;
+
+  Range(first, end);
+  if(cursor < first)
+    cursor = first;
+  while(cursor < end)
+  {
+    if(ReadSlot(cursor++, block, samples))
+      return true;
+    // lapped while reading, catch up with the writer
+    Range(first, end);
+    if(cursor < first)
+      cursor = first;
+  }
+  return false;
+}
+
+bool OMXAudioTap::Find(double pts, OMXAudioTapBlock &block, float *samples)
+{
+  OMXAudioTapBlock probe;
+  uint64_t lo, hi, best = 0;
+  bool found = false;
+
+  if(!IsOpen() || pts == DVD_NOPTS_VALUE)
+    return false;
+
+  // timestamps only go up between resets. DVD_NOPTS_VALUE sorts before
+  // everything, and is not a match
+  Range(lo, hi);
+  while(lo < hi)
+  {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(!ReadSlot(mid, probe, NULL))
+    {
+      // overwritten, everything older is gone too
+      lo = mid + 1;
+      continue;
+    }
+    if(probe.pts <= pts)
+    {
+      if(probe.pts != DVD_NOPTS_VALUE)
+      {
+        best = mid;
+        found = true;
+      }
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  return found && ReadSlot(best, block, samples);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+ * Single writer, many reader ring of the PCM the audio submit thread hands
+ * to the renderer, for visualisers and meters.
+ *
+ * The writer converts each decoded block to interleaved float once,
+ * cuts it into slots of at most OMX_AUDIO_TAP_FRAMES frames and stores the
+ * per channel peak and RMS with every slot, so readers get levels without
+ * touching the samples. The writer never waits: a reader that falls more
+ * than a ring behind loses the oldest slots. Each slot carries a seqlock
+ * style version (odd while being written, 2 * (index + 1) once published),
+ * so a copy that raced the writer is detected and thrown away.
+ *
+ * Memory is allocated once in Open and kept until the tap is destroyed, so
+ * readers on other threads never see it go away under them.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define OMX_AUDIO_TAP_FRAMES        512
+#define OMX_AUDIO_TAP_MAX_CHANNELS  8
+
+typedef struct OMXAudioTapBlock
+{
+  double        pts;          // of the first frame, DVD_TIME_BASE units, DVD_NOPTS_VALUE if unknown
+  unsigned int  sample_rate;
+  unsigned int  channels;
+  unsigned int  frames;
+  float         peak[OMX_AUDIO_TAP_MAX_CHANNELS];
+  float         rms[OMX_AUDIO_TAP_MAX_CHANNELS];
+} OMXAudioTapBlock;
+
+class OMXAudioTap
+{
+public:
+  OMXAudioTap();
+  ~OMXAudioTap();
+
+  // slots of OMX_AUDIO_TAP_FRAMES frames, can only be called once
+  bool Open(unsigned int slots);
+  bool IsOpen() { return m_slots.load(std::memory_order_acquire) != NULL; }
+  unsigned int GetSlotCount() { return m_count; }
+
+  // submit thread. data is S16 interleaved (bits_per_sample 16) or float
+  // planar codec frames of frame_size bytes each (bits_per_sample 32,
+  // frame_size 0 for a single frame), as COMXAudioCodecOMX::GetData hands
+  // them out. Blocks with more than OMX_AUDIO_TAP_MAX_CHANNELS are dropped.
+  void Write(const uint8_t *data, int size, double pts, int channels, int sample_rate, int bits_per_sample, unsigned int frame_size);
+  // after a flush, readers skip whatever was written before
+  void Reset();
+
+  // index of the next slot to be written, start a Read cursor here
+  uint64_t GetCursor();
+  // oldest slot at or after cursor that is still in the ring, cursor moves
+  // past it. samples, if given, needs room for frames * channels floats.
+  bool Read(uint64_t &cursor, OMXAudioTapBlock &block, float *samples = NULL);
+  // newest slot starting at or before pts
+  bool Find(double pts, OMXAudioTapBlock &block, float *samples = NULL);
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;
+    OMXAudioTapBlock      block;
+    float                 samples[OMX_AUDIO_TAP_FRAMES * OMX_AUDIO_TAP_MAX_CHANNELS];
+  };
+
+  Slot *BeginSlot();
+  void  EndSlot(Slot *slot);
+  bool  ReadSlot(uint64_t index, OMXAudioTapBlock &block, float *samples);
+  void  Range(uint64_t &first, uint64_t &end);
+
+  std::atomic<Slot *>   m_slots;
+  unsigned int          m_count;
+  std::atomic<uint64_t> m_write;   // slots published so far
+  std::atomic<uint64_t> m_reset;   // first slot written since the last Reset
+  double                m_next_pts;
+
+  OMXAudioTap(const OMXAudioTap &);
+  OMXAudioTap &operator=(const OMXAudioTap &);
+};
@@ -33,13 +33,15 @@
 //#include "settings/Settings.h"
 
 #include "OMXClock.h"
+#include "OMXGlobalInit.h"
 
 #define OMX_PRE_ROLL 200
 #define TP(speed) ((speed) < 0 || (speed) > 4*DVD_PLAYSPEED_NORMAL)
 
-OMXClock::OMXClock()
+OMXClock::OMXClock() :
+  m_dllAvFormat(COMXGlobalInit::AvFormat())
 {
-  m_dllAvFormat.Load();
+  COMXGlobalInit::Initialize();
 
   m_pause       = false;
 
@@ -57,7 +59,6 @@ OMXClock::~OMXClock()
 {
   OMXDeinitialize();
 
-  m_dllAvFormat.Unload();
   pthread_mutex_destroy(&m_lock);
 }
 
@@ -132,6 +133,10 @@ bool OMXClock::OMXInitialize()
 
   m_pause       = false;
 
+  // already up, e.g. an engine reused from the pool
+  if(m_omx_clock.GetComponent() != NULL)
+    return true;
+
   componentName = "OMX.broadcom.clock";
   if(!m_omx_clock.Initialize((const std::string)componentName, OMX_IndexParamOtherInit))
     return false;
@@ -11,17 +11,7 @@
 #include <IL/OMX_Video.h>
 #include <IL/OMX_Broadcom.h>
 
-
-#define DVD_TIME_BASE 1000000
-#define DVD_NOPTS_VALUE    (-1LL<<52) // should be possible to represent in both double and __int64
-
-#define DVD_TIME_TO_SEC(x)  ((int)((double)(x) / DVD_TIME_BASE))
-#define DVD_TIME_TO_MSEC(x) ((int)((double)(x) * 1000 / DVD_TIME_BASE))
-#define DVD_SEC_TO_TIME(x)  ((double)(x) * DVD_TIME_BASE)
-#define DVD_MSEC_TO_TIME(x) ((double)(x) * DVD_TIME_BASE / 1000)
-
-#define DVD_PLAYSPEED_PAUSE       0       // frame stepping
-#define DVD_PLAYSPEED_NORMAL      1000
+#include "OMXTime.h"
 
 #ifdef OMX_SKIP64BIT
 static inline OMX_TICKS ToOMXTime(int64_t pts)
@@ -54,7 +44,7 @@ public:
   COMXCoreComponent m_omx_clock;
   double            m_last_media_time;
   double            m_last_media_time_read;
-  DllAvFormat       m_dllAvFormat;
+  DllAvFormat       &m_dllAvFormat;
 
 
   OMXClock();
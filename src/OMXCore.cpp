@@ -1297,10 +1297,34 @@ OMX_ERRORTYPE COMXCoreComponent::DisablePort(unsigned int port, bool wait)
 OMX_ERRORTYPE COMXCoreComponent::UseEGLImage(OMX_BUFFERHEADERTYPE** ppBufferHdr, OMX_U32 nPortIndex, OMX_PTR pAppPrivate, void* eglImage)
 {
 if (m_callbacks.FillBufferDone == &COMXCoreComponent::DecoderFillBufferDoneCallback)
+{
+  std::vector<void*> eglImages(1, eglImage);
+  std::vector<OMX_BUFFERHEADERTYPE*> buffers;
+  OMX_ERRORTYPE omx_err = UseEGLImages(buffers, nPortIndex, eglImages);
+  if(omx_err == OMX_ErrorNone && !buffers.empty())
+    *ppBufferHdr = buffers[0];
+  return omx_err;
+}
+else
+{
+  OMX_ERRORTYPE omx_err;
+    omx_err = OMX_UseEGLImage(m_handle, ppBufferHdr, nPortIndex, pAppPrivate, eglImage);
+    if(omx_err != OMX_ErrorNone)
+    {
+      CLog::Log(LOGERROR, "%s::%s - %s failed with omx_err(0x%x)\n",
+                CLASSNAME, __func__, m_componentName.c_str(), omx_err);
+      return omx_err;
+    }
+  return omx_err;
+}
+}
+
+// One output buffer per EGLImage, pAppPrivate holds the index into eglImages
+OMX_ERRORTYPE COMXCoreComponent::UseEGLImages(std::vector<OMX_BUFFERHEADERTYPE*>& buffers, OMX_U32 nPortIndex, const std::vector<void*>& eglImages)
 {
   OMX_ERRORTYPE omx_err = OMX_ErrorNone;
 
-  if(!m_handle)
+  if(!m_handle || eglImages.empty())
     return OMX_ErrorUndefined;
 
   m_omx_output_use_buffers = false;
@@ -1321,6 +1345,18 @@ if (m_callbacks.FillBufferDone == &COMXCoreComponent::DecoderFillBufferDoneCallb
     SetStateForComponent(OMX_StateIdle);
   }
 
+  if(portFormat.nBufferCountActual != eglImages.size())
+  {
+    portFormat.nBufferCountActual = eglImages.size();
+    omx_err = OMX_SetParameter(m_handle, OMX_IndexParamPortDefinition, &portFormat);
+    if(omx_err != OMX_ErrorNone)
+    {
+      CLog::Log(LOGERROR, "%s::%s - %s nBufferCountActual(%u) rejected with omx_err(0x%x)", CLASSNAME, __func__,
+                m_componentName.c_str(), (unsigned)eglImages.size(), omx_err);
+      return omx_err;
+    }
+  }
+
   omx_err = EnablePort(m_output_port, false);
   if(omx_err != OMX_ErrorNone)
   {
@@ -1333,20 +1369,15 @@ if (m_callbacks.FillBufferDone == &COMXCoreComponent::DecoderFillBufferDoneCallb
   m_output_buffer_count  = portFormat.nBufferCountActual;
   m_output_buffer_size   = portFormat.nBufferSize;
 
-  if (portFormat.nBufferCountActual != 1)
-  {
-    CLog::Log(LOGERROR, "%s::%s - %s nBufferCountActual unexpected %d", CLASSNAME, __func__,
-              m_componentName.c_str(), portFormat.nBufferCountActual);
-    return omx_err;
-  }
-
   CLog::Log(LOGDEBUG, "%s::%s component(%s) - port(%d), nBufferCountMin(%u), nBufferCountActual(%u), nBufferSize(%u) nBufferAlignmen(%u)\n",
             CLASSNAME, __func__, m_componentName.c_str(), m_output_port, portFormat.nBufferCountMin,
             portFormat.nBufferCountActual, portFormat.nBufferSize, portFormat.nBufferAlignment);
 
-  for (size_t i = 0; i < portFormat.nBufferCountActual; i++)
+  buffers.clear();
+  for (size_t i = 0; i < eglImages.size(); i++)
   {
-    omx_err = OMX_UseEGLImage(m_handle, ppBufferHdr, nPortIndex, pAppPrivate, eglImage);
+    OMX_BUFFERHEADERTYPE *buffer = NULL;
+    omx_err = OMX_UseEGLImage(m_handle, &buffer, nPortIndex, (void*)i, eglImages[i]);
     if(omx_err != OMX_ErrorNone)
     {
       CLog::Log(LOGERROR, "%s::%s - %s failed with omx_err(0x%x)\n",
@@ -1354,13 +1385,13 @@ if (m_callbacks.FillBufferDone == &COMXCoreComponent::DecoderFillBufferDoneCallb
       return omx_err;
     }
 
-    OMX_BUFFERHEADERTYPE *buffer = *ppBufferHdr;
     buffer->nOutputPortIndex = m_output_port;
     buffer->nFilledLen       = 0;
     buffer->nOffset          = 0;
     buffer->pAppPrivate      = (void*)i;
     m_omx_output_buffers.push_back(buffer);
     m_omx_output_available.push(buffer);
+    buffers.push_back(buffer);
   }
 
   omx_err = WaitForCommand(OMX_CommandPortEnable, m_output_port);
@@ -1374,19 +1405,6 @@ if (m_callbacks.FillBufferDone == &COMXCoreComponent::DecoderFillBufferDoneCallb
 
   return omx_err;
 }
-else
-{
-  OMX_ERRORTYPE omx_err;
-    omx_err = OMX_UseEGLImage(m_handle, ppBufferHdr, nPortIndex, pAppPrivate, eglImage);
-    if(omx_err != OMX_ErrorNone)
-    {
-      CLog::Log(LOGERROR, "%s::%s - %s failed with omx_err(0x%x)\n",
-                CLASSNAME, __func__, m_componentName.c_str(), omx_err);
-      return omx_err;
-    }
-  return omx_err;
-}
-}
 
 bool COMXCoreComponent::Initialize( const std::string &component_name, OMX_INDEXTYPE index, OMX_CALLBACKTYPE *callbacks)
 {
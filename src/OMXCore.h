@@ -24,6 +24,7 @@
 
 #include <string>
 #include <queue>
+#include <vector>
 
 // TODO: should this be in configure
 #ifndef OMX_SKIP64BIT
@@ -115,6 +116,7 @@ public:
   OMX_ERRORTYPE EnablePort(unsigned int port, bool wait = true);
   OMX_ERRORTYPE DisablePort(unsigned int port, bool wait = true);
   OMX_ERRORTYPE UseEGLImage(OMX_BUFFERHEADERTYPE** ppBufferHdr, OMX_U32 nPortIndex, OMX_PTR pAppPrivate, void* eglImage);
+  OMX_ERRORTYPE UseEGLImages(std::vector<OMX_BUFFERHEADERTYPE*>& buffers, OMX_U32 nPortIndex, const std::vector<void*>& eglImages);
 
   bool          Initialize( const std::string &component_name, OMX_INDEXTYPE index, OMX_CALLBACKTYPE *callbacks = NULL);
   bool          IsInitialized() const { return m_handle != NULL; }
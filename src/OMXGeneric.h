@@ -0,0 +1,970 @@
+#pragma once
+
+/*
+ * Generic OMX IL component framework, split out of the ALSA sink
+ * Copyright (c) 2016 Timo Teräs
+ *
+ * This Program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * Everything is static, a component includes this from its one .cpp.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <IL/OMX_Core.h>
+#include <IL/OMX_Component.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+struct _GOMX_COMMAND;
+struct _GOMX_PORT;
+struct _GOMX_COMPONENT;
+
+template <class X> static inline X max(X a, X b)
+{
+	return (a > b) ? a : b;
+}
+
+template <class X> static OMX_ERRORTYPE omx_cast(X* &toptr, OMX_PTR fromptr)
+{
+	toptr = (X*) fromptr;
+	if (toptr->nSize < sizeof(X)) return OMX_ErrorBadParameter;
+	if (toptr->nVersion.nVersion != OMX_VERSION) return OMX_ErrorVersionMismatch;
+	return OMX_ErrorNone;
+}
+
+template <class X> static void omx_init(X &omx)
+{
+	omx.nSize = sizeof(X);
+	omx.nVersion.nVersion = OMX_VERSION;
+}
+
+#if 1
+#include <utils/log.h>
+#define CLOG(notice, comp, port, msg, ...) do { \
+	struct _GOMX_PORT *_port = (struct _GOMX_PORT *) port; \
+	if (_port) CLog::Log(notice ? LOGNOTICE : LOGDEBUG, "[%p port %d]: %s: " msg "\n", comp, _port->def.nPortIndex, __func__ , ##__VA_ARGS__); \
+	else CLog::Log(notice ? LOGNOTICE : LOGDEBUG, "[%p] %s: " msg "\n", comp, __func__ , ##__VA_ARGS__); \
+} while (0)
+#else
+#define CLOG(notice, comp, port, msg, ...) do { \
+	struct _GOMX_PORT *_port = (struct _GOMX_PORT *) port; \
+	if (_port) fprintf(stderr, "[%p port %d]: %s: " msg "\n", comp, _port->def.nPortIndex, __func__ , ##__VA_ARGS__); \
+	else fprintf(stderr, "[%p] %s: " msg "\n", comp, __func__ , ##__VA_ARGS__); \
+} while (0)
+#endif
+
+#define CINFO(comp, port, msg, ...) CLOG(1, comp, port, msg , ##__VA_ARGS__)
+#define CDEBUG(comp, port, msg, ...) CLOG(0, comp, port, msg , ##__VA_ARGS__)
+
+/* Generic OMX helpers */
+
+/* Bounded lock-free MPMC ring of pointers (Vyukov). Buffers pass between
+ * the client, the tunnel peer and the worker through these without taking
+ * the component mutex. Every cell carries a sequence number telling whether
+ * it is free for the enqueue at that position or holds the item for the
+ * dequeue at that position. */
+
+#define GOMX_QUEUE_SIZE 64	/* power of two, far more than any port's buffer count */
+
+typedef struct _GOMX_QUEUE_CELL {
+	size_t seq;
+	void *item;
+} GOMX_QUEUE_CELL;
+
+typedef struct _GOMX_QUEUE {
+	GOMX_QUEUE_CELL cells[GOMX_QUEUE_SIZE];
+	size_t head __attribute__((aligned(64)));	/* next dequeue */
+	size_t tail __attribute__((aligned(64)));	/* next enqueue */
+} GOMX_QUEUE;
+
+static void gomxq_init(GOMX_QUEUE *q)
+{
+	for (size_t i = 0; i < GOMX_QUEUE_SIZE; i++) {
+		q->cells[i].seq = i;
+		q->cells[i].item = 0;
+	}
+	q->head = q->tail = 0;
+}
+
+/* false when full */
+static bool gomxq_enqueue(GOMX_QUEUE *q, void *item)
+{
+	GOMX_QUEUE_CELL *cell;
+	size_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	ptrdiff_t dif;
+
+	for (;;) {
+		cell = &q->cells[pos & (GOMX_QUEUE_SIZE - 1)];
+		dif = (ptrdiff_t) __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (ptrdiff_t) pos;
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+		}
+	}
+	cell->item = item;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* 0 when empty */
+static void *gomxq_dequeue(GOMX_QUEUE *q)
+{
+	GOMX_QUEUE_CELL *cell;
+	size_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+	ptrdiff_t dif;
+	void *item;
+
+	for (;;) {
+		cell = &q->cells[pos & (GOMX_QUEUE_SIZE - 1)];
+		dif = (ptrdiff_t) __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (ptrdiff_t) (pos + 1);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return 0;
+		} else {
+			pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+		}
+	}
+	item = cell->item;
+	__atomic_store_n(&cell->seq, pos + GOMX_QUEUE_SIZE, __ATOMIC_RELEASE);
+	return item;
+}
+
+/* exact only while nobody is enqueueing or dequeueing */
+static size_t gomxq_size(GOMX_QUEUE *q)
+{
+	size_t head = __atomic_load_n(&q->head, __ATOMIC_SEQ_CST);
+	size_t tail = __atomic_load_n(&q->tail, __ATOMIC_SEQ_CST);
+	return tail - head;
+}
+
+typedef struct _GOMX_COMMAND {
+	OMX_COMMANDTYPE cmd;
+	OMX_U32 param;
+	OMX_PTR data;
+} GOMX_COMMAND;
+
+typedef struct _GOMX_PORT {
+	OMX_BOOL new_enabled;
+	OMX_PARAM_PORTDEFINITIONTYPE def;
+
+	size_t num_buffers, num_buffers_old;
+	pthread_cond_t cond_no_buffers;
+	pthread_cond_t cond_populated;
+	pthread_cond_t cond_idle;
+
+	OMX_HANDLETYPE tunnel_comp;
+	OMX_U32 tunnel_port;
+	bool tunnel_supplier;
+	GOMX_QUEUE tunnel_supplierq;
+
+	OMX_ERRORTYPE (*do_buffer)(struct _GOMX_COMPONENT *, struct _GOMX_PORT *, OMX_BUFFERHEADERTYPE *);
+	OMX_ERRORTYPE (*flush)(struct _GOMX_COMPONENT *, struct _GOMX_PORT *);
+} GOMX_PORT;
+
+typedef struct _GOMX_COMPONENT {
+	OMX_COMPONENTTYPE omx;
+	OMX_CALLBACKTYPE cb;
+	OMX_STATETYPE state, wanted_state;
+
+	pthread_t component_thread, worker_thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* The mutex covers state and command changes only. The worker sleeps
+	 * on worker_cond, and buffer producers only take the mutex to wake it
+	 * when worker_sleeping says it is actually asleep. */
+	pthread_cond_t worker_cond;
+	int worker_sleeping;
+
+	const char *name;
+	size_t nports;
+	GOMX_PORT *ports;
+	GOMX_QUEUE cmdq;
+
+	void* (*worker)(void *);
+	OMX_ERRORTYPE (*statechange)(struct _GOMX_COMPONENT *);
+} GOMX_COMPONENT;
+
+static GOMX_PORT *gomx_get_port(GOMX_COMPONENT *comp, size_t idx)
+{
+	if (idx < 0 || idx >= comp->nports) return 0;
+	return &comp->ports[idx];
+}
+
+static OMX_ERRORTYPE gomx_get_component_version(
+		OMX_HANDLETYPE hComponent, OMX_STRING pComponentName,
+		OMX_VERSIONTYPE *pComponentVersion, OMX_VERSIONTYPE *pSpecVersion, OMX_UUIDTYPE *pComponentUUID)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	CDEBUG(comp, 0, "enter");
+	strcpy(pComponentName, comp->name);
+	pComponentVersion->nVersion = OMX_VERSION;
+	pSpecVersion->nVersion = OMX_VERSION;
+	memcpy(pComponentUUID, &hComponent, sizeof hComponent);
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_get_parameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	GOMX_PORT *port;
+	OMX_PORT_PARAM_TYPE *ppt;
+	OMX_PARAM_PORTDEFINITIONTYPE *pdt;
+	OMX_ERRORTYPE r;
+	OMX_PORTDOMAINTYPE domain;
+
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+
+	CDEBUG(comp, 0, "called %x, %p", nParamIndex, pComponentParameterStructure);
+	switch (nParamIndex) {
+	case OMX_IndexParamAudioInit:
+		domain = OMX_PortDomainAudio;
+		goto param_init;
+	case OMX_IndexParamVideoInit:
+		domain = OMX_PortDomainVideo;
+		goto param_init;
+	case OMX_IndexParamImageInit:
+		domain = OMX_PortDomainImage;
+		goto param_init;
+	case OMX_IndexParamOtherInit:
+		domain = OMX_PortDomainOther;
+		goto param_init;
+	param_init:
+		if ((r = omx_cast(ppt, pComponentParameterStructure))) return r;
+		ppt->nPorts = 0;
+		ppt->nStartPortNumber = 0;
+		for (size_t i = 0; i < comp->nports; i++) {
+			if (comp->ports[i].def.eDomain != domain)
+				continue;
+			if (!ppt->nPorts)
+				ppt->nStartPortNumber = i;
+			ppt->nPorts++;
+		}
+		break;
+	case OMX_IndexParamPortDefinition:
+		if ((r = omx_cast(pdt, pComponentParameterStructure))) return r;
+		if (!(port = gomx_get_port(comp, pdt->nPortIndex))) return OMX_ErrorBadPortIndex;
+		memcpy(pComponentParameterStructure, &port->def, sizeof *pdt);
+		break;
+	default:
+		CINFO(comp, 0, "UNSUPPORTED %x, %p", nParamIndex, pComponentParameterStructure);
+		return OMX_ErrorNotImplemented;
+	}
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_get_state(OMX_HANDLETYPE hComponent, OMX_STATETYPE *pState)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	*pState = comp->state;
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_component_tunnel_request(
+		OMX_HANDLETYPE hComponent, OMX_U32 nPort,
+		OMX_HANDLETYPE hTunneledComp, OMX_U32 nTunneledPort, OMX_TUNNELSETUPTYPE* pTunnelSetup)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	GOMX_PORT *port = 0;
+
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+	if (!(port = gomx_get_port(comp, nPort))) return OMX_ErrorBadPortIndex;
+	if (comp->state != OMX_StateLoaded && port->def.bEnabled)
+		return OMX_ErrorIncorrectStateOperation;
+
+	if (hTunneledComp == 0 || pTunnelSetup == 0) {
+		port->tunnel_comp = 0;
+		return OMX_ErrorNone;
+	}
+
+	if (port->def.eDir == OMX_DirInput) {
+		/* Negotiate parameters */
+		OMX_PARAM_PORTDEFINITIONTYPE param;
+		omx_init(param);
+		param.nPortIndex = nTunneledPort;
+		if (OMX_GetParameter(hTunneledComp, OMX_IndexParamPortDefinition, &param))
+			goto not_compatible;
+		if (param.eDomain != port->def.eDomain)
+			goto not_compatible;
+
+		param.nBufferCountActual = max(param.nBufferCountMin, port->def.nBufferCountMin);
+		param.nBufferSize = max(port->def.nBufferSize, param.nBufferSize);
+		param.nBufferAlignment = max(port->def.nBufferAlignment, param.nBufferAlignment);
+		port->def.nBufferCountActual = param.nBufferCountActual;
+		port->def.nBufferSize = param.nBufferSize;
+		port->def.nBufferAlignment = param.nBufferAlignment;
+		if (OMX_SetParameter(hTunneledComp, OMX_IndexParamPortDefinition, &param))
+			goto not_compatible;
+
+		/* Negotiate buffer supplier */
+		OMX_PARAM_BUFFERSUPPLIERTYPE suppl;
+		omx_init(suppl);
+		suppl.nPortIndex = nTunneledPort;
+		if (OMX_GetParameter(hTunneledComp, OMX_IndexParamCompBufferSupplier, &suppl))
+			goto not_compatible;
+
+		/* Being supplier is not supported so ask the other side to be it */
+		suppl.eBufferSupplier =
+			(pTunnelSetup->eSupplier == OMX_BufferSupplyOutput)
+			? OMX_BufferSupplyOutput : OMX_BufferSupplyInput;
+		if (OMX_SetParameter(hTunneledComp, OMX_IndexParamCompBufferSupplier, &suppl))
+			goto not_compatible;
+
+		port->tunnel_comp = hTunneledComp;
+		port->tunnel_port = nTunneledPort;
+		port->tunnel_supplier = (suppl.eBufferSupplier == OMX_BufferSupplyInput);
+		pTunnelSetup->eSupplier = suppl.eBufferSupplier;
+		CINFO(comp, port, "ComponentTunnnelRequest: %p %d", hTunneledComp, nTunneledPort);
+	} else {
+		CINFO(comp, port, "OUTPUT TUNNEL UNSUPPORTED: %p, %d, %p", hTunneledComp, nTunneledPort, pTunnelSetup);
+		return OMX_ErrorNotImplemented;
+	}
+	return OMX_ErrorNone;
+
+not_compatible:
+	CINFO(comp, port, "ComponentTunnnelRequest: %p %d - NOT COMPATIBLE", hTunneledComp, nTunneledPort);
+	return OMX_ErrorPortsNotCompatible;
+}
+
+/* Called without comp->mutex */
+static void gomx_event(GOMX_COMPONENT *comp, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+	if (!comp->cb.EventHandler) return;
+	comp->cb.EventHandler((OMX_HANDLETYPE) comp, comp->omx.pApplicationPrivate, eEvent, nData1, nData2, pEventData);
+}
+
+/* Called with comp->mutex held, dropped around the callback */
+static void __gomx_event(GOMX_COMPONENT *comp, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+	if (!comp->cb.EventHandler) return;
+	pthread_mutex_unlock(&comp->mutex);
+	gomx_event(comp, eEvent, nData1, nData2, pEventData);
+	pthread_mutex_lock(&comp->mutex);
+}
+
+static void __gomx_port_update_buffer_state(GOMX_COMPONENT *comp, GOMX_PORT *port)
+{
+	if (port->num_buffers_old == port->num_buffers)
+		return;
+	port->num_buffers_old = port->num_buffers;
+
+	port->def.bPopulated = (port->num_buffers >= port->def.nBufferCountActual) ? OMX_TRUE : OMX_FALSE;
+	if (port->num_buffers == 0)
+		pthread_cond_signal(&port->cond_no_buffers);
+	else if (port->num_buffers == port->def.nBufferCountActual)
+		pthread_cond_signal(&port->cond_populated);
+}
+
+static OMX_ERRORTYPE gomx_use_buffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE **ppBufferHdr,
+				     OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8* pBuffer)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	OMX_BUFFERHEADERTYPE *hdr;
+	GOMX_PORT *port;
+	void *buf;
+
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+	if (!(port = gomx_get_port(comp, nPortIndex))) return OMX_ErrorBadPortIndex;
+
+	if (!((comp->state == OMX_StateLoaded && comp->wanted_state == OMX_StateIdle) ||
+	      (port->def.bEnabled == OMX_FALSE &&
+			(comp->state == OMX_StateExecuting ||
+			 comp->state == OMX_StatePause ||
+			 comp->state == OMX_StateIdle))))
+		return OMX_ErrorIncorrectStateOperation;
+
+	buf = malloc(sizeof(OMX_BUFFERHEADERTYPE) + (pBuffer ? 0 : nSizeBytes));
+	if (!buf) return OMX_ErrorInsufficientResources;
+
+	hdr = (OMX_BUFFERHEADERTYPE *) buf;
+	memset(hdr, 0, sizeof *hdr);
+	omx_init(*hdr);
+	hdr->pBuffer = pBuffer ? (OMX_U8*)pBuffer : (OMX_U8*)((char*)buf + nSizeBytes);
+	hdr->nAllocLen = nSizeBytes;
+	hdr->pAppPrivate = pAppPrivate;
+	if (port->def.eDir == OMX_DirInput) {
+		hdr->nInputPortIndex = nPortIndex;
+		hdr->pOutputPortPrivate = pAppPrivate;
+	} else {
+		hdr->nOutputPortIndex = nPortIndex;
+		hdr->pInputPortPrivate = pAppPrivate;
+	}
+	pthread_mutex_lock(&comp->mutex);
+	port->num_buffers++;
+	__gomx_port_update_buffer_state(comp, port);
+	pthread_mutex_unlock(&comp->mutex);
+
+	CDEBUG(comp, port, "allocated: %d, %p, %u, %p", nPortIndex, pAppPrivate, nSizeBytes, pBuffer);
+	*ppBufferHdr = hdr;
+
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_allocate_buffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE **ppBufferHdr,
+					  OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes)
+{
+	return gomx_use_buffer(hComponent, ppBufferHdr, nPortIndex, pAppPrivate, nSizeBytes, 0);
+}
+
+static OMX_ERRORTYPE gomx_free_buffer(OMX_HANDLETYPE hComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	GOMX_PORT *port;
+
+	if (!(port = gomx_get_port(comp, nPortIndex))) return OMX_ErrorBadPortIndex;
+
+	/* Freeing buffer is allowed in all states, so destructor can
+	 * synchronize successfully. */
+
+	pthread_mutex_lock(&comp->mutex);
+
+	if (!((comp->state == OMX_StateIdle && comp->wanted_state == OMX_StateLoaded) ||
+	      (port->def.bEnabled == OMX_FALSE &&
+			(comp->state == OMX_StateExecuting ||
+			 comp->state == OMX_StatePause ||
+			 comp->state == OMX_StateIdle)))) {
+		/* In unexpected states the port unpopulated error is sent. */
+		if (port->num_buffers == port->def.nBufferCountActual)
+			__gomx_event(comp, OMX_EventError, OMX_ErrorPortUnpopulated, nPortIndex, 0);
+		/* FIXME? should we mark the port also down */
+	}
+
+	port->num_buffers--;
+	__gomx_port_update_buffer_state(comp, port);
+
+	pthread_mutex_unlock(&comp->mutex);
+
+	free(pBuffer);
+
+	return OMX_ErrorNone;
+}
+
+/* Called without comp->mutex. Only the last buffer back takes the mutex,
+ * to wake a state change waiting for the port to go idle. */
+static void __gomx_port_queue_supplier_buffer(GOMX_COMPONENT *comp, GOMX_PORT *port, OMX_BUFFERHEADERTYPE *hdr)
+{
+	gomxq_enqueue(&port->tunnel_supplierq, (void *) hdr);
+	if (gomxq_size(&port->tunnel_supplierq) == port->num_buffers) {
+		pthread_mutex_lock(&comp->mutex);
+		pthread_cond_broadcast(&port->cond_idle);
+		pthread_mutex_unlock(&comp->mutex);
+	}
+}
+
+/* Called without comp->mutex */
+static OMX_ERRORTYPE __gomx_empty_buffer_done(GOMX_COMPONENT *comp, OMX_BUFFERHEADERTYPE *hdr)
+{
+	GOMX_PORT *port = gomx_get_port(comp, hdr->nInputPortIndex);
+	OMX_ERRORTYPE r;
+
+	if (port->tunnel_comp) {
+		/* Buffers are sent to the tunneled port once emptied as long as
+		 * the component is in the OMX_StateExecuting state */
+		if ((comp->state == OMX_StateExecuting && port->def.bEnabled) ||
+		    !port->tunnel_supplier) {
+			r = OMX_FillThisBuffer(port->tunnel_comp, hdr);
+		} else {
+			r = OMX_ErrorIncorrectStateOperation;
+		}
+	} else {
+		r = comp->cb.EmptyBufferDone((OMX_HANDLETYPE) comp, hdr->pAppPrivate, hdr);
+	}
+
+	if (r != OMX_ErrorNone && port->tunnel_supplier) {
+		__gomx_port_queue_supplier_buffer(comp, port, hdr);
+		r = OMX_ErrorNone;
+	}
+
+	return r;
+}
+
+static OMX_ERRORTYPE gomx_empty_this_buffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	GOMX_PORT *port;
+	OMX_ERRORTYPE r;
+
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+	if (comp->state != OMX_StatePause && comp->state != OMX_StateExecuting &&
+	    comp->wanted_state != OMX_StateExecuting)
+		return OMX_ErrorIncorrectStateOperation;
+
+	if (!(port = gomx_get_port(comp, pBuffer->nInputPortIndex)))
+		return OMX_ErrorBadPortIndex;
+
+	/* No mutex, do_buffer hands the buffer over through a lock-free queue */
+	if (port->def.bEnabled) {
+		if (port->do_buffer)
+			r = port->do_buffer(comp, port, pBuffer);
+		else
+			r = __gomx_empty_buffer_done(comp, pBuffer);
+	} else {
+		if (port->tunnel_supplier) {
+			__gomx_port_queue_supplier_buffer(comp, port, pBuffer);
+			r = OMX_ErrorNone;
+		} else {
+			r = OMX_ErrorIncorrectStateOperation;
+		}
+	}
+	return r;
+}
+
+static OMX_ERRORTYPE gomx_fill_this_buffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+	CDEBUG(hComponent, 0, "stub");
+	return OMX_ErrorNotImplemented;
+}
+
+/* Called without comp->mutex */
+static void __gomx_process_mark(GOMX_COMPONENT *comp, OMX_BUFFERHEADERTYPE *hdr)
+{
+	if (hdr->hMarkTargetComponent == (OMX_HANDLETYPE) comp) {
+		gomx_event(comp, OMX_EventMark, 0, 0, hdr->pMarkData);
+		hdr->hMarkTargetComponent = 0;
+		hdr->pMarkData = 0;
+	}
+}
+
+static OMX_ERRORTYPE __gomx_port_unpopulate(GOMX_COMPONENT *comp, GOMX_PORT *port)
+{
+	OMX_BUFFERHEADERTYPE *hdr;
+	void *buf;
+
+	if (port->tunnel_supplier) {
+		CINFO(comp, port, "waiting for supplier buffers (%d / %d)",
+			(int)gomxq_size(&port->tunnel_supplierq), (int)port->num_buffers);
+		while (gomxq_size(&port->tunnel_supplierq) != port->num_buffers)
+			pthread_cond_wait(&port->cond_idle, &comp->mutex);
+
+		CINFO(comp, port, "free tunnel buffers");
+		while ((hdr = (OMX_BUFFERHEADERTYPE*)gomxq_dequeue(&port->tunnel_supplierq)) != 0) {
+			buf = hdr->pBuffer;
+			OMX_FreeBuffer(port->tunnel_comp, port->tunnel_port, hdr);
+			free(buf);
+			port->num_buffers--;
+			__gomx_port_update_buffer_state(comp, port);
+		}
+	} else {
+		/* Wait client / tunnel supplier to allocate buffers */
+		CINFO(comp, port, "waiting %d buffers to be freed", (int)port->num_buffers);
+		while (port->num_buffers > 0)
+			pthread_cond_wait(&port->cond_no_buffers, &comp->mutex);
+	}
+
+	CINFO(comp, port, "UNPOPULATED");
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE __gomx_port_populate(GOMX_COMPONENT *comp, GOMX_PORT *port)
+{
+	OMX_ERRORTYPE r;
+	OMX_BUFFERHEADERTYPE *hdr;
+	void *buf;
+
+	if (port->tunnel_supplier) {
+		CINFO(comp, port, "Allocating tunnel buffers");
+		while (port->num_buffers < port->def.nBufferCountActual) {
+			pthread_mutex_unlock(&comp->mutex);
+			r = OMX_ErrorInsufficientResources;
+			buf = malloc(port->def.nBufferSize);
+			if (buf) {
+				r = OMX_UseBuffer(port->tunnel_comp, &hdr,
+						port->tunnel_port, 0,
+						port->def.nBufferSize, (OMX_U8*) buf);
+				if (r != OMX_ErrorNone) free(buf);
+			}
+			if (r == OMX_ErrorInvalidState ||
+			    r == OMX_ErrorIncorrectStateOperation) {
+				/* Non-supplier is not transitioned yet.
+				 * Wait for a bit and retry */
+				usleep(1000);
+				pthread_mutex_lock(&comp->mutex);
+				continue;
+			}
+			pthread_mutex_lock(&comp->mutex);
+
+			if (r != OMX_ErrorNone) {
+				/* Hard error. Cancel and bail out */
+				__gomx_port_unpopulate(comp, port);
+				return r;
+			}
+
+			if (port->def.eDir == OMX_DirInput)
+				hdr->nInputPortIndex = port->def.nPortIndex;
+			else
+				hdr->nOutputPortIndex = port->def.nPortIndex;
+			gomxq_enqueue(&port->tunnel_supplierq, (void*) hdr);
+			port->num_buffers++;
+			__gomx_port_update_buffer_state(comp, port);
+		}
+	} else {
+		/* Wait client / tunnel supplier to allocate buffers */
+		CINFO(comp, port, "waiting buffers");
+		while (!port->def.bPopulated)
+			pthread_cond_wait(&port->cond_populated, &comp->mutex);
+	}
+
+	CINFO(comp, port, "POPULATED");
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_send_command(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE Cmd, OMX_U32 nParam1, OMX_PTR pCmdData)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	GOMX_COMMAND *c;
+
+	/* OMX IL Specification is unclear which errors can be returned
+	 * inline and which need to be reported with a callback.
+	 * This just does minimal state checking, and queues everything
+	 * to worker and reports any real errors via the callback. */
+	if (!hComponent) return OMX_ErrorInvalidComponent;
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+	if (!comp->cb.EventHandler) return OMX_ErrorNotReady;
+
+	c = (GOMX_COMMAND*) malloc(sizeof(GOMX_COMMAND));
+	if (!c) return OMX_ErrorInsufficientResources;
+
+	CINFO(comp, 0, "SendCommand %x, %x, %p", Cmd, nParam1, pCmdData);
+	c->cmd = Cmd;
+	c->param = nParam1;
+	c->data = pCmdData;
+
+	pthread_mutex_lock(&comp->mutex);
+	if (!gomxq_enqueue(&comp->cmdq, (void*) c)) {
+		pthread_mutex_unlock(&comp->mutex);
+		free(c);
+		return OMX_ErrorInsufficientResources;
+	}
+	pthread_cond_signal(&comp->cond);
+	pthread_mutex_unlock(&comp->mutex);
+
+	return OMX_ErrorNone;
+}
+
+#define GOMX_TRANS(a,b) ((((uint32_t)a) << 16) | (uint32_t)b)
+
+static OMX_ERRORTYPE gomx_do_set_state(GOMX_COMPONENT *comp, GOMX_COMMAND *cmd)
+{
+	OMX_STATETYPE new_state = (OMX_STATETYPE) cmd->param;
+	OMX_ERRORTYPE r;
+	GOMX_PORT *port;
+	size_t i;
+
+	if (comp->state == new_state) return OMX_ErrorSameState;
+
+	if (new_state == OMX_StateInvalid) {
+		/* Transition to invalid state is always valid and immediate */
+		comp->state = new_state;
+		return OMX_ErrorNone;
+	}
+
+	CDEBUG(comp, 0, "starting transition to state %d", new_state);
+
+	comp->wanted_state = new_state;
+	pthread_cond_broadcast(&comp->worker_cond);
+
+	if (comp->statechange) {
+		r = comp->statechange(comp);
+		if (r != OMX_ErrorNone) goto err;
+	}
+
+	switch (GOMX_TRANS(comp->state, new_state)) {
+	case GOMX_TRANS(OMX_StateLoaded, OMX_StateIdle):
+		/* populate or wait for all enabled ports to be populated */
+		for (i = 0; i < comp->nports; i++) {
+			if (!comp->ports[i].def.bEnabled) continue;
+			r = __gomx_port_populate(comp, &comp->ports[i]);
+			if (r) goto err;
+		}
+		break;
+	case GOMX_TRANS(OMX_StateIdle, OMX_StateLoaded):
+		/* free or wait all ports to be unpopulated */
+		for (i = 0; i < comp->nports; i++) {
+			r = __gomx_port_unpopulate(comp, &comp->ports[i]);
+			if (r) goto err;
+		}
+		break;
+	case GOMX_TRANS(OMX_StateIdle, OMX_StateExecuting):
+		/* start threads */
+		r = OMX_ErrorInsufficientResources;
+		if (comp->worker &&
+		    pthread_create(&comp->worker_thread, 0, comp->worker, comp) != 0)
+			goto err;
+		break;
+	case GOMX_TRANS(OMX_StateExecuting, OMX_StateIdle):
+		/* stop/join threads & wait buffers to be returned to suppliers */
+		if (comp->worker_thread) {
+			pthread_mutex_unlock(&comp->mutex);
+			pthread_join(comp->worker_thread, 0);
+			pthread_mutex_lock(&comp->mutex);
+			comp->worker_thread = 0;
+		}
+		for (i = 0; i < comp->nports; i++) {
+			port = &comp->ports[i];
+			if (!port->tunnel_supplier || !port->def.bEnabled) continue;
+			while (gomxq_size(&port->tunnel_supplierq) != port->num_buffers)
+				pthread_cond_wait(&port->cond_idle, &comp->mutex);
+		}
+		break;
+	default:
+		/* FIXME: Pause and WaitForResources states not supported */
+		r = OMX_ErrorIncorrectStateTransition;
+		goto err;
+	}
+	comp->state = new_state;
+	CDEBUG(comp, 0, "transition to state %d: success", new_state);
+	return OMX_ErrorNone;
+err:
+	comp->wanted_state = comp->state;
+	CDEBUG(comp, 0, "transition to state %d: result %x", new_state, r);
+	return r;
+}
+
+static OMX_ERRORTYPE gomx_do_port_command(GOMX_COMPONENT *comp, GOMX_PORT *port, GOMX_COMMAND *cmd)
+{
+	OMX_ERRORTYPE r = OMX_ErrorNone;
+
+	switch (cmd->cmd) {
+	case OMX_CommandFlush:
+		if (port->flush) r = port->flush(comp, port);
+		break;
+	case OMX_CommandPortEnable:
+		port->def.bEnabled = OMX_TRUE;
+		r = __gomx_port_populate(comp, port);
+		if (r != OMX_ErrorNone)
+			port->def.bEnabled = OMX_FALSE;
+		break;
+	case OMX_CommandPortDisable:
+		port->def.bEnabled = OMX_FALSE;
+		if (port->flush) port->flush(comp, port);
+		r = __gomx_port_unpopulate(comp, port);
+		break;
+	default:
+		r = OMX_ErrorNotImplemented;
+		break;
+	}
+	return r;
+}
+
+static OMX_ERRORTYPE gomx_do_command(GOMX_COMPONENT *comp, GOMX_COMMAND *cmd)
+{
+	GOMX_PORT *port;
+
+	switch (cmd->cmd) {
+	case OMX_CommandStateSet:
+		CINFO(comp, 0, "state %x", cmd->param);
+		return gomx_do_set_state(comp, cmd);
+	case OMX_CommandFlush:
+	case OMX_CommandPortEnable:
+	case OMX_CommandPortDisable:
+		/* FIXME: OMX_ALL is not supported (but not used in omxplayer) */
+		if (!(port = gomx_get_port(comp, cmd->param)))
+			return OMX_ErrorBadPortIndex;
+		CINFO(comp, port, "command %x", cmd->cmd);
+		return gomx_do_port_command(comp, port, cmd);
+	case OMX_CommandMarkBuffer:
+		/* FIXME: Not implemented (but not used in omxplayer) */
+	default:
+		CINFO(comp, 0, "UNSUPPORTED %x, %x, %p", cmd->cmd, cmd->param, cmd->data);
+		return OMX_ErrorNotImplemented;
+	}
+}
+
+static void *gomx_worker(void *ptr)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) ptr;
+	GOMX_PORT *port;
+	GOMX_COMMAND *cmd;
+	OMX_BUFFERHEADERTYPE *hdr;
+	OMX_ERRORTYPE r;
+
+	CINFO(comp, 0, "start");
+	pthread_mutex_lock(&comp->mutex);
+	while (comp->state != OMX_StateInvalid) {
+		cmd = (GOMX_COMMAND *) gomxq_dequeue(&comp->cmdq);
+		if (cmd) {
+			r = gomx_do_command(comp, cmd);
+			if (r == OMX_ErrorNone)
+				__gomx_event(comp, OMX_EventCmdComplete,
+					     cmd->cmd, cmd->param, cmd->data);
+			else
+				__gomx_event(comp, OMX_EventError, r, 0, 0);
+		} else {
+			pthread_cond_wait(&comp->cond, &comp->mutex);
+		}
+
+		if (comp->state != OMX_StateExecuting)
+			continue;
+
+		/* FIXME: Rate limit and retry if needed suppplier buffer enqueuing */
+		for (size_t i = 0; i < comp->nports; i++) {
+			port = &comp->ports[i];
+			while ((hdr = (OMX_BUFFERHEADERTYPE*)gomxq_dequeue(&port->tunnel_supplierq)) != 0) {
+				pthread_mutex_unlock(&comp->mutex);
+				r = OMX_FillThisBuffer(port->tunnel_comp, hdr);
+				pthread_mutex_lock(&comp->mutex);
+				if (r != OMX_ErrorNone) {
+					gomxq_enqueue(&port->tunnel_supplierq, (void *) hdr);
+					if (gomxq_size(&port->tunnel_supplierq) == port->num_buffers)
+						pthread_cond_broadcast(&port->cond_idle);
+					break;
+				}
+			}
+		}
+	}
+	pthread_mutex_unlock(&comp->mutex);
+	/* FIXME: make sure all buffers are returned and worker threads stopped */
+	CINFO(comp, 0, "stop");
+	return 0;
+}
+
+static OMX_ERRORTYPE gomx_set_callbacks(OMX_HANDLETYPE hComponent, OMX_CALLBACKTYPE* pCallbacks, OMX_PTR pAppData)
+{
+	GOMX_COMPONENT *comp = (GOMX_COMPONENT *) hComponent;
+	if (comp->state == OMX_StateInvalid) return OMX_ErrorInvalidState;
+	if (comp->state != OMX_StateLoaded) return OMX_ErrorIncorrectStateOperation;
+	pthread_mutex_lock(&comp->mutex);
+	comp->omx.pApplicationPrivate = pAppData;
+	comp->cb = *pCallbacks;
+	pthread_mutex_unlock(&comp->mutex);
+	return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE gomx_use_egl_image(OMX_HANDLETYPE hComponent,
+		OMX_BUFFERHEADERTYPE** ppBufferHdr, OMX_U32 nPortIndex,
+		OMX_PTR pAppPrivate, void* eglImage)
+{
+	return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE gomx_component_role_enum(OMX_HANDLETYPE hComponent, OMX_U8 *cRole, OMX_U32 nIndex)
+{
+	return OMX_ErrorNotImplemented;
+}
+
+static void gomx_init(GOMX_COMPONENT *comp, const char *name, OMX_PTR pAppData, OMX_CALLBACKTYPE* pCallbacks, GOMX_PORT *ports, size_t nports)
+{
+	pthread_condattr_t attr;
+
+	comp->omx.nSize = sizeof comp->omx;
+	comp->omx.nVersion.nVersion = OMX_VERSION;
+	comp->omx.pApplicationPrivate = pAppData;
+	comp->omx.GetComponentVersion = gomx_get_component_version;
+	comp->omx.SendCommand = gomx_send_command;
+	comp->omx.GetParameter = gomx_get_parameter;
+	comp->omx.GetState = gomx_get_state;
+	comp->omx.ComponentTunnelRequest = gomx_component_tunnel_request;
+	comp->omx.UseBuffer = gomx_use_buffer;
+	comp->omx.AllocateBuffer = gomx_allocate_buffer;
+	comp->omx.FreeBuffer = gomx_free_buffer;
+	comp->omx.EmptyThisBuffer = gomx_empty_this_buffer;
+	comp->omx.FillThisBuffer = gomx_fill_this_buffer;
+	comp->omx.SetCallbacks = gomx_set_callbacks;
+	comp->omx.UseEGLImage = gomx_use_egl_image;
+	comp->omx.ComponentRoleEnum = gomx_component_role_enum;
+
+	comp->name = name;
+	comp->cb = *pCallbacks;
+	comp->state = OMX_StateLoaded;
+	comp->nports = nports;
+	comp->ports = ports;
+
+	gomxq_init(&comp->cmdq);
+	pthread_cond_init(&comp->cond, 0);
+	pthread_mutex_init(&comp->mutex, 0);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&comp->worker_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_create(&comp->component_thread, 0, gomx_worker, comp);
+
+	for (size_t i = 0; i < comp->nports; i++) {
+		GOMX_PORT *port = &comp->ports[i];
+		pthread_cond_init(&port->cond_no_buffers, 0);
+		pthread_cond_init(&port->cond_populated, 0);
+		pthread_cond_init(&port->cond_idle, 0);
+		gomxq_init(&port->tunnel_supplierq);
+	}
+}
+
+static void gomx_fini(GOMX_COMPONENT *comp)
+{
+	CINFO(comp, 0, "destroying");
+	pthread_mutex_lock(&comp->mutex);
+	comp->state = OMX_StateInvalid;
+	pthread_cond_broadcast(&comp->cond);
+	pthread_mutex_unlock(&comp->mutex);
+	pthread_join(comp->component_thread, 0);
+
+	for (size_t i = 0; i < comp->nports; i++) {
+		GOMX_PORT *port = &comp->ports[i];
+		pthread_cond_destroy(&port->cond_no_buffers);
+		pthread_cond_destroy(&port->cond_populated);
+		pthread_cond_destroy(&port->cond_idle);
+	}
+	pthread_mutex_destroy(&comp->mutex);
+	pthread_cond_destroy(&comp->cond);
+	pthread_cond_destroy(&comp->worker_cond);
+}
+
+/* Worker side of the handoff. Sleeps until gomx_worker_wake, a state change
+ * or timeout_ns (0 waits indefinitely), unless ready reports work after the
+ * sleep was announced. Call without comp->mutex. */
+static void gomx_worker_sleep(GOMX_COMPONENT *comp, bool (*ready)(GOMX_COMPONENT *), long timeout_ns)
+{
+	struct timespec ts;
+
+	/* Let a producer that is mid-burst finish before paying for a futex
+	 * sleep and wakeup per buffer */
+	sched_yield();
+	if (ready(comp)) return;
+
+	pthread_mutex_lock(&comp->mutex);
+	__atomic_store_n(&comp->worker_sleeping, 1, __ATOMIC_SEQ_CST);
+	if (comp->wanted_state == OMX_StateExecuting && !ready(comp)) {
+		if (timeout_ns) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			ts.tv_nsec += timeout_ns;
+			while (ts.tv_nsec >= 1000000000L) {
+				ts.tv_nsec -= 1000000000L;
+				ts.tv_sec++;
+			}
+			pthread_cond_timedwait(&comp->worker_cond, &comp->mutex, &ts);
+		} else {
+			pthread_cond_wait(&comp->worker_cond, &comp->mutex);
+		}
+	}
+	__atomic_store_n(&comp->worker_sleeping, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&comp->mutex);
+}
+
+/* Producer side, after making work visible (e.g. gomxq_enqueue). Free
+ * while the worker is busy, the mutex is only taken to wake it, and only
+ * by the first producer to find it asleep. */
+static void gomx_worker_wake(GOMX_COMPONENT *comp)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&comp->worker_sleeping, __ATOMIC_RELAXED) &&
+	    __atomic_exchange_n(&comp->worker_sleeping, 0, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&comp->mutex);
+		pthread_cond_signal(&comp->worker_cond);
+		pthread_mutex_unlock(&comp->mutex);
+	}
+}
@@ -0,0 +1,57 @@
+#include "OMXGlobalInit.h"
+#include "utils/log.h"
+
+#include <IL/OMX_Core.h>
+#include <pthread.h>
+#include <time.h>
+
+static pthread_once_t g_init_once   = PTHREAD_ONCE_INIT;
+static bool           g_initialized = false;
+static double         g_init_time   = 0.0;
+static volatile int   g_call_count  = 0;
+
+static double NowMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec * 1e-6;
+}
+
+void COMXGlobalInit::InitOnce()
+{
+  double start = NowMs();
+
+  if (!InitializeFFmpeg())
+    return;
+
+  OMX_ERRORTYPE omx_err = OMX_Init();
+  if (omx_err != OMX_ErrorNone)
+    CLog::Log(LOGERROR, "COMXGlobalInit::%s - OMX_Init failed with omx_err(0x%08x)", __func__, omx_err);
+
+  g_init_time   = NowMs() - start;
+  g_initialized = true;
+
+  CLog::Log(LOGINFO, "COMXGlobalInit::%s - ffmpeg/omx init took %.2f ms", __func__, g_init_time);
+}
+
+bool COMXGlobalInit::Initialize()
+{
+  __sync_fetch_and_add(&g_call_count, 1);
+  pthread_once(&g_init_once, &COMXGlobalInit::InitOnce);
+  return g_initialized;
+}
+
+bool COMXGlobalInit::IsInitialized()
+{
+  return g_initialized;
+}
+
+double COMXGlobalInit::GetInitTime()
+{
+  return g_init_time;
+}
+
+int COMXGlobalInit::GetCallCount()
+{
+  return g_call_count;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Process-wide, once-only initialisation of FFmpeg and OpenMAX IL.
+//
+// av_register_all, avcodec_register_all, avformat_network_init and OMX_Init
+// used to run on every reader/codec/player open. They now run exactly once
+// (pthread_once) and every reader, codec, clock and player shares the same
+// Dll* wrappers instead of holding and loading its own copies.
+//
+// The FFmpeg half lives in OMXGlobalInitFFmpeg.cpp so OMXReader and the
+// software thumbnail decoder build and run without OMX; only Initialize()
+// in OMXGlobalInit.cpp needs the IL headers and libopenmaxil.
+
+#include "DllAvUtil.h"
+#include "DllAvCodec.h"
+#include "DllAvFormat.h"
+#include "DllSwResample.h"
+#include "DllSwScale.h"
+
+class COMXGlobalInit
+{
+public:
+  // FFmpeg and OMX, thread safe, cheap after the first call
+  static bool Initialize();
+  static bool IsInitialized();
+
+  // FFmpeg only, what Initialize() runs first
+  static bool InitializeFFmpeg();
+
+  static DllAvUtil&     AvUtil();
+  static DllAvCodec&    AvCodec();
+  static DllAvFormat&   AvFormat();
+  static DllSwResample& SwResample();
+  static DllSwScale&    SwScale();
+
+  // wall time of the one-time init in ms and number of Initialize() callers
+  static double GetInitTime();
+  static int    GetCallCount();
+
+private:
+  static void InitOnce();
+  static void InitFFmpegOnce();
+};
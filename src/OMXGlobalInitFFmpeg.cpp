@@ -0,0 +1,58 @@
+#include "OMXGlobalInit.h"
+#include "utils/log.h"
+
+#include <pthread.h>
+
+static pthread_once_t g_ffmpeg_once        = PTHREAD_ONCE_INIT;
+static bool           g_ffmpeg_initialized = false;
+
+DllAvUtil& COMXGlobalInit::AvUtil()
+{
+  static DllAvUtil dll;
+  return dll;
+}
+
+DllAvCodec& COMXGlobalInit::AvCodec()
+{
+  static DllAvCodec dll;
+  return dll;
+}
+
+DllAvFormat& COMXGlobalInit::AvFormat()
+{
+  static DllAvFormat dll;
+  return dll;
+}
+
+DllSwResample& COMXGlobalInit::SwResample()
+{
+  static DllSwResample dll;
+  return dll;
+}
+
+DllSwScale& COMXGlobalInit::SwScale()
+{
+  static DllSwScale dll;
+  return dll;
+}
+
+void COMXGlobalInit::InitFFmpegOnce()
+{
+  if (!AvUtil().Load() || !AvCodec().Load() || !AvFormat().Load() || !SwResample().Load() || !SwScale().Load())
+  {
+    CLog::Log(LOGERROR, "COMXGlobalInit::%s - unable to load ffmpeg", __func__);
+    return;
+  }
+
+  AvFormat().av_register_all();
+  AvCodec().avcodec_register_all();
+  AvFormat().avformat_network_init();
+
+  g_ffmpeg_initialized = true;
+}
+
+bool COMXGlobalInit::InitializeFFmpeg()
+{
+  pthread_once(&g_ffmpeg_once, &COMXGlobalInit::InitFFmpegOnce);
+  return g_ffmpeg_initialized;
+}
@@ -26,13 +26,36 @@
 #endif
 
 #include "OMXPlayerAudio.h"
+#include "OMXGlobalInit.h"
+#include "OMXAudioTap.h"
+#include "utils/AudioKernels.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <algorithm>
 
 #include "linux/XMemUtils.h"
 
-OMXPlayerAudio::OMXPlayerAudio()
+static int64_t CurrentHostCounter(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return( ((int64_t)now.tv_sec * 1000000000LL) + now.tv_nsec );
+}
+
+void OMXAudioSubmitThread::Process()
+{
+  m_owner->SubmitProcess();
+}
+
+OMXPlayerAudio::OMXPlayerAudio() :
+  m_dllAvUtil(COMXGlobalInit::AvUtil()),
+  m_dllAvCodec(COMXGlobalInit::AvCodec()),
+  m_dllAvFormat(COMXGlobalInit::AvFormat())
 {
   m_open          = false;
   m_stream_id     = -1;
@@ -48,11 +71,25 @@ OMXPlayerAudio::OMXPlayerAudio()
   m_CurrentVolume = 0.0f;
   m_amplification = 0;
   m_mute          = false;
+  m_block_bytes   = 0;
+  m_block_limit   = 0;
+  m_flush_generation = 0;
+  m_submitting    = false;
+  m_decode_time   = 0;
+  m_submit_end    = DVD_NOPTS_VALUE;
+  m_transition    = false;
+  m_fade_frames   = 0;
+  m_fade_pos      = 0;
+  m_fade_skip     = 0;
+  m_submit_thread.m_owner = this;
 
   pthread_cond_init(&m_packet_cond, NULL);
   pthread_cond_init(&m_audio_cond, NULL);
+  pthread_cond_init(&m_blocks_cond, NULL);
   pthread_mutex_init(&m_lock, NULL);
   pthread_mutex_init(&m_lock_decoder, NULL);
+  pthread_mutex_init(&m_lock_blocks, NULL);
+  pthread_mutex_init(&m_lock_submit, NULL);
 }
 
 OMXPlayerAudio::~OMXPlayerAudio()
@@ -61,8 +98,11 @@ OMXPlayerAudio::~OMXPlayerAudio()
 
   pthread_cond_destroy(&m_audio_cond);
   pthread_cond_destroy(&m_packet_cond);
+  pthread_cond_destroy(&m_blocks_cond);
   pthread_mutex_destroy(&m_lock);
   pthread_mutex_destroy(&m_lock_decoder);
+  pthread_mutex_destroy(&m_lock_blocks);
+  pthread_mutex_destroy(&m_lock_submit);
 }
 
 void OMXPlayerAudio::Lock()
@@ -94,11 +134,9 @@ bool OMXPlayerAudio::Open(OMXClock *av_clock, const OMXAudioConfig &config, OMXR
   if(ThreadHandle())
     Close();
 
-  if (!m_dllAvUtil.Load() || !m_dllAvCodec.Load() || !m_dllAvFormat.Load() || !av_clock)
+  if (!COMXGlobalInit::Initialize() || !av_clock)
     return false;
   
-  m_dllAvFormat.av_register_all();
-
   m_config      = config;
   m_av_clock    = av_clock;
   m_omx_reader  = omx_reader;
@@ -110,6 +148,12 @@ bool OMXPlayerAudio::Open(OMXClock *av_clock, const OMXAudioConfig &config, OMXR
   m_flush_requested = false;
   m_cached_size = 0;
   m_pAudioCodec = NULL;
+  m_decode_time = 0;
+  m_pipeline_stats = OMXAudioPipelineStats();
+  m_submit_end  = DVD_NOPTS_VALUE;
+  m_transition  = false;
+  m_fade_frames = m_fade_pos = m_fade_skip = 0;
+  m_codec_name  = m_omx_reader->GetCodecName(OMXSTREAM_AUDIO);
 
   m_player_error = OpenAudioCodec();
   if(!m_player_error)
@@ -128,6 +172,11 @@ bool OMXPlayerAudio::Open(OMXClock *av_clock, const OMXAudioConfig &config, OMXR
   if(m_config.use_thread)
     Create();
 
+  /* feeding the renderer runs on its own thread so a decode burst and a full
+     renderer do not hold each other up. Decode() only queues blocks, so this
+     one is needed with or without the decode thread */
+  m_submit_thread.Create();
+
   m_open        = true;
 
   return true;
@@ -148,6 +197,18 @@ bool OMXPlayerAudio::Close()
     StopThread();
   }
 
+  if(m_submit_thread.ThreadHandle())
+  {
+    pthread_mutex_lock(&m_lock_blocks);
+    pthread_cond_broadcast(&m_blocks_cond);
+    pthread_mutex_unlock(&m_lock_blocks);
+
+    m_submit_thread.StopThread();
+  }
+  pthread_mutex_lock(&m_lock_blocks);
+  ClearBlocks();
+  pthread_mutex_unlock(&m_lock_blocks);
+
   CloseDecoder();
   CloseAudioCodec();
 
@@ -156,10 +217,6 @@ bool OMXPlayerAudio::Close()
   m_iCurrentPts   = DVD_NOPTS_VALUE;
   m_pStream       = NULL;
 
-  m_dllAvUtil.Unload();
-  m_dllAvCodec.Unload();
-  m_dllAvFormat.Unload();
-
   return true;
 }
 
@@ -173,9 +230,6 @@ bool OMXPlayerAudio::Decode(OMXPacket *pkt)
   if(!m_decoder || !m_pAudioCodec)
     return true;
 
-  if(!m_omx_reader->IsActive(OMXSTREAM_AUDIO, pkt->stream_index))
-    return true; 
-
   int channels = pkt->hints.channels;
 
   unsigned int old_bitrate = m_config.hints.bitrate;
@@ -200,16 +254,23 @@ bool OMXPlayerAudio::Decode(OMXPacket *pkt)
     printf("N : %d %d %d %d %d\n", pkt->hints.codec, channels, pkt->hints.samplerate, pkt->hints.bitrate, pkt->hints.bitspersample);
 
 
+    /* what was decoded in the old format has to reach the old renderer first */
+    if(!WaitForDrain())
+      return true;
+
+    pthread_mutex_lock(&m_lock_submit);
     CloseDecoder();
     CloseAudioCodec();
 
     m_config.hints = pkt->hints;
+    AVCodec *codec = m_dllAvCodec.avcodec_find_decoder(m_config.hints.codec);
+    m_codec_name = codec ? codec->name : "";
 
     m_player_error = OpenAudioCodec();
-    if(!m_player_error)
-      return false;
+    if(m_player_error)
+      m_player_error = OpenDecoder();
+    pthread_mutex_unlock(&m_lock_submit);
 
-    m_player_error = OpenDecoder();
     if(!m_player_error)
       return false;
   }
@@ -229,6 +290,7 @@ bool OMXPlayerAudio::Decode(OMXPacket *pkt)
     double dts = pkt->dts, pts=pkt->pts;
     while(data_len > 0)
     {
+      int64_t start = CurrentHostCounter();
       int len = m_pAudioCodec->Decode((BYTE *)data_dec, data_len, dts, pts);
       if( (len < 0) || (len >  data_len) )
       {
@@ -241,42 +303,234 @@ bool OMXPlayerAudio::Decode(OMXPacket *pkt)
 
       uint8_t *decoded;
       int decoded_size = m_pAudioCodec->GetData(&decoded, dts, pts);
+      m_decode_time += CurrentHostCounter() - start;
 
       if(decoded_size <=0)
         continue;
 
-      while((int) m_decoder->GetSpace() < decoded_size)
+      if(m_fade_skip > 0 || m_fade_pos < m_fade_frames)
       {
-        OMXClock::OMXSleep(10);
-        if(m_flush_requested) return true;
+        if(!QueueCrossfade(decoded, decoded_size, dts, pts, m_pAudioCodec->GetFrameSize()))
+          return true;
       }
+      else if(!QueueBlock(decoded, decoded_size, dts, pts, m_pAudioCodec->GetFrameSize(), false))
+        return true;
+    }
+  }
+  else
+  {
+    QueueBlock(pkt->data, pkt->size, pkt->dts, pkt->pts, 0, false);
+  }
 
-      int ret = 0;
+  return true;
+}
 
-      ret = m_decoder->AddPackets(decoded, decoded_size, dts, pts, m_pAudioCodec->GetFrameSize());
-      if(ret != decoded_size)
-      {
-        printf("error ret %d decoded_size %d\n", ret, decoded_size);
-      }
+/* copies a block into the queue for the submit thread, waiting while the
+   queue is full. false if a flush or close came first */
+bool OMXPlayerAudio::QueueBlock(const uint8_t *data, int size, double dts, double pts, unsigned int frame_size, bool eos)
+{
+  int64_t wait_start = CurrentHostCounter();
+
+  pthread_mutex_lock(&m_lock_blocks);
+  // a block bigger than the whole limit still goes in once the queue is empty
+  while(!m_blocks.empty() && m_block_bytes + size > m_block_limit && !m_flush_requested && !m_bAbort)
+    pthread_cond_wait(&m_blocks_cond, &m_lock_blocks);
+
+  if(m_flush_requested || m_bAbort)
+  {
+    pthread_mutex_unlock(&m_lock_blocks);
+    return false;
+  }
+
+  OMXAudioBlock block;
+  block.data        = NULL;
+  block.size        = size;
+  block.dts         = dts;
+  block.pts         = pts;
+  block.duration    = 0;
+  block.frame_size  = frame_size;
+  block.channels    = 0;
+  block.sample_rate = 0;
+  block.bits_per_sample = 0;
+  block.eos         = eos;
+  block.transition  = m_transition && !eos;
+  block.queued_time = CurrentHostCounter();
+  if(!eos)
+    m_transition = false;
+  if(!m_passthrough && !m_hw_decode && m_pAudioCodec && m_pAudioCodec->GetSampleRate() > 0)
+  {
+    unsigned int pitch = m_pAudioCodec->GetChannels() * m_pAudioCodec->GetBitsPerSample() >> 3;
+    if(pitch)
+      block.duration = (double)(size / pitch) * DVD_TIME_BASE / m_pAudioCodec->GetSampleRate();
+    block.channels        = m_pAudioCodec->GetChannels();
+    block.sample_rate     = m_pAudioCodec->GetSampleRate();
+    block.bits_per_sample = m_pAudioCodec->GetBitsPerSample();
+  }
+  if(size)
+  {
+    block.data = (uint8_t *)malloc(size);
+    memcpy(block.data, data, size);
+  }
+
+  OMXAudioPipelineStats &stats = m_pipeline_stats;
+  stats.decode_wait_ms += (block.queued_time - wait_start) / 1000000.0f;
+  if(!eos)
+  {
+    float decode_ms = m_decode_time / 1000000.0f;
+    stats.decoded_blocks++;
+    stats.decode_ms += (decode_ms - stats.decode_ms) / stats.decoded_blocks;
+    stats.decode_ms_max = std::max(stats.decode_ms_max, decode_ms);
+  }
+  m_decode_time = 0;
+
+  m_blocks.push_back(block);
+  m_block_bytes += size;
+  pthread_cond_broadcast(&m_blocks_cond);
+  pthread_mutex_unlock(&m_lock_blocks);
+  return true;
+}
+
+void OMXPlayerAudio::SubmitProcess()
+{
+  while(true)
+  {
+    pthread_mutex_lock(&m_lock_blocks);
+    while(m_blocks.empty() && !m_submit_thread.Stopping() && !m_bAbort)
+      pthread_cond_wait(&m_blocks_cond, &m_lock_blocks);
+
+    if(m_submit_thread.Stopping() || m_bAbort)
+    {
+      pthread_mutex_unlock(&m_lock_blocks);
+      break;
     }
+
+    OMXAudioBlock block = m_blocks.front();
+    m_blocks.pop_front();
+    m_block_bytes -= block.size;
+    m_submitting = true;
+    unsigned int generation = m_flush_generation;
+    pthread_cond_broadcast(&m_blocks_cond);
+    pthread_mutex_unlock(&m_lock_blocks);
+
+    SubmitBlock(block, generation);
+    free(block.data);
+
+    pthread_mutex_lock(&m_lock_blocks);
+    m_submitting = false;
+    pthread_cond_broadcast(&m_blocks_cond);
+    pthread_mutex_unlock(&m_lock_blocks);
   }
-  else
+}
+
+/* hands one block to COMXAudio once it has room for all of it. Dropped when a
+   flush happened since the block was taken off the queue */
+bool OMXPlayerAudio::SubmitBlock(OMXAudioBlock &block, unsigned int generation)
+{
+  int64_t wait_start = CurrentHostCounter();
+
+  while(true)
   {
-    while((int) m_decoder->GetSpace() < pkt->size)
+    pthread_mutex_lock(&m_lock_submit);
+    if(generation != m_flush_generation || m_bAbort || !m_decoder)
+    {
+      pthread_mutex_unlock(&m_lock_submit);
+      return false;
+    }
+    if(block.eos)
+    {
+      m_decoder->SubmitEOS();
+      pthread_mutex_unlock(&m_lock_submit);
+      return true;
+    }
+    if((int) m_decoder->GetSpace() >= block.size)
+      break;
+    pthread_mutex_unlock(&m_lock_submit);
+
+    // COMXAudio has no event for freed input buffers, poll but wake up early for a flush or close
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += 5 * 1000000;
+    if(timeout.tv_nsec >= 1000000000)
     {
-      OMXClock::OMXSleep(10);
-      if(m_flush_requested) return true;
+      timeout.tv_sec++;
+      timeout.tv_nsec -= 1000000000;
     }
+    pthread_mutex_lock(&m_lock_blocks);
+    if(generation == m_flush_generation && !m_bAbort)
+      pthread_cond_timedwait(&m_blocks_cond, &m_lock_blocks, &timeout);
+    pthread_mutex_unlock(&m_lock_blocks);
+  }
+
+  // what the renderer has left to play when the next file's audio reaches it
+  float headroom_ms = block.transition ? m_decoder->GetCacheTime() * 1000.0f : 0.0f;
 
-    m_decoder->AddPackets(pkt->data, pkt->size, pkt->dts, pkt->pts, 0);
+  int64_t start = CurrentHostCounter();
+  int ret = m_decoder->AddPackets(block.data, block.size, block.dts, block.pts, block.frame_size);
+  int64_t end = CurrentHostCounter();
+  // what the renderer got, so a crossfade's mix replaces the tail it pulled
+  // back and timestamps keep going up. Under m_lock_submit like Flush's Reset
+  if(m_config.tap && block.sample_rate)
+    m_config.tap->Write(block.data, block.size, block.pts, block.channels, block.sample_rate,
+                        block.bits_per_sample, block.frame_size);
+  pthread_mutex_unlock(&m_lock_submit);
+
+  if(ret != block.size)
+  {
+    printf("error ret %d decoded_size %d\n", ret, block.size);
   }
 
+  pthread_mutex_lock(&m_lock_blocks);
+  OMXAudioPipelineStats &stats = m_pipeline_stats;
+  float submit_ms = (end - start) / 1000000.0f;
+  float queue_ms = (start - block.queued_time) / 1000000.0f;
+  stats.submitted_blocks++;
+  stats.submit_ms += (submit_ms - stats.submit_ms) / stats.submitted_blocks;
+  stats.submit_ms_max = std::max(stats.submit_ms_max, submit_ms);
+  stats.space_wait_ms += ((start - wait_start) / 1000000.0f - stats.space_wait_ms) / stats.submitted_blocks;
+  stats.queue_ms += (queue_ms - stats.queue_ms) / stats.submitted_blocks;
+  stats.queue_ms_max = std::max(stats.queue_ms_max, queue_ms);
+  if(block.transition)
+  {
+    float gap_ms = 0.0f;
+    if(m_submit_end != DVD_NOPTS_VALUE && block.pts != DVD_NOPTS_VALUE)
+      gap_ms = (block.pts - m_submit_end) / 1000.0f;
+    if(fabsf(gap_ms) > fabsf(stats.transition_gap_ms))
+      stats.transition_gap_ms = gap_ms;
+    if(stats.transitions == 0 || headroom_ms < stats.transition_headroom_ms)
+      stats.transition_headroom_ms = headroom_ms;
+    stats.transitions++;
+  }
+  m_submit_end = block.pts != DVD_NOPTS_VALUE && block.duration > 0 ? block.pts + block.duration : DVD_NOPTS_VALUE;
+  pthread_mutex_unlock(&m_lock_blocks);
   return true;
 }
 
+/* waits until the submit thread has handed everything queued to COMXAudio,
+   false if a flush or close interrupted */
+bool OMXPlayerAudio::WaitForDrain()
+{
+  pthread_mutex_lock(&m_lock_blocks);
+  while((!m_blocks.empty() || m_submitting) && !m_flush_requested && !m_bAbort)
+    pthread_cond_wait(&m_blocks_cond, &m_lock_blocks);
+  pthread_mutex_unlock(&m_lock_blocks);
+  return !m_flush_requested && !m_bAbort;
+}
+
+/* call with m_lock_blocks held */
+void OMXPlayerAudio::ClearBlocks()
+{
+  while (!m_blocks.empty())
+  {
+    free(m_blocks.front().data);
+    m_blocks.pop_front();
+  }
+  m_block_bytes = 0;
+}
+
 void OMXPlayerAudio::Process()
 {
   OMXPacket *omx_pkt = NULL;
+  bool transition = false;
 
   while(true)
   {
@@ -290,27 +544,38 @@ void OMXPlayerAudio::Process()
       break;
     }
 
-    if(m_flush && omx_pkt)
+    if(m_flush && (omx_pkt || transition))
     {
       OMXReader::FreePacket(omx_pkt);
       omx_pkt = NULL;
+      transition = false;
       m_flush = false;
     }
-    else if(!omx_pkt && !m_packets.empty())
+    else if(!omx_pkt && !transition && !m_packets.empty())
     {
+      // AddTransition queues NULL
       omx_pkt = m_packets.front();
-      m_cached_size -= omx_pkt->size;
       m_packets.pop_front();
+      if(omx_pkt)
+        m_cached_size -= omx_pkt->size;
+      else
+        transition = true;
     }
     UnLock();
     
     LockDecoder();
-    if(m_flush && omx_pkt)
+    if(m_flush && (omx_pkt || transition))
     {
       OMXReader::FreePacket(omx_pkt);
       omx_pkt = NULL;
+      transition = false;
       m_flush = false;
     }
+    else if(transition)
+    {
+      BeginTransition();
+      transition = false;
+    }
     else if(omx_pkt && Decode(omx_pkt))
     {
       OMXReader::FreePacket(omx_pkt);
@@ -326,10 +591,18 @@ void OMXPlayerAudio::Process()
 void OMXPlayerAudio::Flush()
 {
   m_flush_requested = true;
+  // wake a decode thread waiting for queue space
+  pthread_mutex_lock(&m_lock_blocks);
+  pthread_cond_broadcast(&m_blocks_cond);
+  pthread_mutex_unlock(&m_lock_blocks);
+
   Lock();
   LockDecoder();
+  pthread_mutex_lock(&m_lock_submit);
   if(m_pAudioCodec)
     m_pAudioCodec->Reset();
+  if(m_config.tap)
+    m_config.tap->Reset();
   m_flush_requested = false;
   m_flush = true;
   while (!m_packets.empty())
@@ -338,10 +611,20 @@ void OMXPlayerAudio::Flush()
     m_packets.pop_front();
     OMXReader::FreePacket(pkt);
   }
+  pthread_mutex_lock(&m_lock_blocks);
+  ClearBlocks();
+  m_flush_generation++;
+  m_decode_time = 0;
+  m_submit_end = DVD_NOPTS_VALUE;
+  pthread_cond_broadcast(&m_blocks_cond);
+  pthread_mutex_unlock(&m_lock_blocks);
+  m_transition = false;
+  m_fade_frames = m_fade_pos = m_fade_skip = 0;
   m_iCurrentPts = DVD_NOPTS_VALUE;
   m_cached_size = 0;
   if(m_decoder)
     m_decoder->Flush();
+  pthread_mutex_unlock(&m_lock_submit);
   UnLockDecoder();
   UnLock();
 }
@@ -369,6 +652,149 @@ bool OMXPlayerAudio::AddPacket(OMXPacket *pkt)
   return ret;
 }
 
+/* everything added before this belongs to one file and everything after to
+   the next, which the engine has already rebased to carry on where this one
+   ends (minus config.crossfade). The renderer and codec stay open */
+void OMXPlayerAudio::AddTransition()
+{
+  Lock();
+  m_packets.push_back(NULL);
+  UnLock();
+  pthread_cond_broadcast(&m_packet_cond);
+}
+
+/* codec output to interleaved float. S16 comes interleaved, float planar in
+   frame_size chunks */
+static void BlockToFloat(const uint8_t *data, int size, unsigned int frame_size, int channels, int bits, float *dst)
+{
+  if(bits == 16)
+  {
+    AudioKernels::S16ToFloat((const int16_t *)data, dst, size / 2);
+    return;
+  }
+  if(frame_size == 0 || frame_size > (unsigned int)size)
+    frame_size = size;
+
+  int frames = frame_size / (4 * channels);
+  std::vector<const void *> planes(channels);
+  for(int offset = 0; offset + (int)frame_size <= size; offset += frame_size)
+  {
+    for(int c = 0; c < channels; c++)
+      planes[c] = (const float *)(data + offset) + c * frames;
+    AudioKernels::Interleave32(&planes[0], dst, channels, frames);
+    dst += frames * channels;
+  }
+}
+
+/* the old file's last packet has been decoded. Its tail is taken back off the
+   block queue so the new file's first blocks can be mixed over it, whole
+   blocks only so it is never longer than the crossfade. Whatever the
+   crossfade is short of (all of it when the submit thread already has the
+   tail) is dropped from the start of the new file, it was rebased to overlap
+   by the full crossfade */
+void OMXPlayerAudio::BeginTransition()
+{
+  m_transition  = true;
+  m_fade_frames = m_fade_pos = m_fade_skip = 0;
+
+  if(m_passthrough || m_hw_decode || !m_pAudioCodec || m_config.crossfade <= 0.0f)
+    return;
+
+  int channels = m_pAudioCodec->GetChannels();
+  int bits     = m_pAudioCodec->GetBitsPerSample();
+  int rate     = m_pAudioCodec->GetSampleRate();
+  int pitch    = channels * bits >> 3;
+  int length   = m_config.crossfade * rate;
+  if(pitch <= 0 || length <= 0)
+    return;
+
+  std::deque<OMXAudioBlock> tail;
+  int frames = 0;
+
+  pthread_mutex_lock(&m_lock_blocks);
+  while(!m_blocks.empty())
+  {
+    OMXAudioBlock &block = m_blocks.back();
+    int block_frames = block.size / pitch;
+    if(block.eos || block.transition || block_frames == 0 || frames + block_frames > length)
+      break;
+    frames += block_frames;
+    m_block_bytes -= block.size;
+    tail.push_front(block);
+    m_blocks.pop_back();
+  }
+  pthread_cond_broadcast(&m_blocks_cond);
+  pthread_mutex_unlock(&m_lock_blocks);
+
+  m_fade_tail.resize(frames * channels);
+  float *dst = frames ? &m_fade_tail[0] : NULL;
+  for(size_t i = 0; i < tail.size(); i++)
+  {
+    BlockToFloat(tail[i].data, tail[i].size, tail[i].frame_size, channels, bits, dst);
+    dst += tail[i].size / pitch * channels;
+    free(tail[i].data);
+  }
+  m_fade_frames = frames;
+  m_fade_skip   = length - frames;
+}
+
+/* queues a block of the new file while it still overlaps the old one's tail */
+bool OMXPlayerAudio::QueueCrossfade(const uint8_t *data, int size, double dts, double pts, unsigned int frame_size)
+{
+  int channels = m_pAudioCodec->GetChannels();
+  int bits     = m_pAudioCodec->GetBitsPerSample();
+  int rate     = m_pAudioCodec->GetSampleRate();
+  int pitch    = channels * bits >> 3;
+  int frames   = size / pitch;
+  if(frames <= 0)
+    return true;
+
+  m_fade_buffer.resize(frames * channels);
+  BlockToFloat(data, size, frame_size, channels, bits, &m_fade_buffer[0]);
+  float *samples = &m_fade_buffer[0];
+
+  // already covered by the old file
+  int skip = std::min(m_fade_skip, frames);
+  m_fade_skip -= skip;
+  frames      -= skip;
+  samples     += skip * channels;
+  if(frames == 0)
+    return true;
+  double shift = (double)skip * DVD_TIME_BASE / rate;
+  if(pts != DVD_NOPTS_VALUE)
+    pts += shift;
+  if(dts != DVD_NOPTS_VALUE)
+    dts += shift;
+
+  // linear, the old file's gain goes from 1 to 0 over its tail
+  int mix = std::min(frames, m_fade_frames - m_fade_pos);
+  const float *tail = m_fade_frames ? &m_fade_tail[m_fade_pos * channels] : NULL;
+  for(int i = 0; i < mix; i++)
+  {
+    float in = (m_fade_pos + i + 0.5f) / m_fade_frames;
+    for(int c = 0; c < channels; c++)
+      samples[i * channels + c] = samples[i * channels + c] * in + tail[i * channels + c] * (1.0f - in);
+  }
+  m_fade_pos += mix;
+
+  // back to the codec's layout, float as a single planar chunk
+  int out_size = frames * pitch;
+  m_fade_output.resize(out_size);
+  if(bits == 16)
+  {
+    AudioKernels::FloatToS16(samples, (int16_t *)&m_fade_output[0], frames * channels);
+  }
+  else
+  {
+    std::vector<void *> planes(channels);
+    for(int c = 0; c < channels; c++)
+      planes[c] = (float *)&m_fade_output[0] + c * frames;
+    AudioKernels::Deinterleave32(samples, &planes[0], channels, frames);
+    frame_size = out_size;
+  }
+  return QueueBlock(&m_fade_output[0], out_size, dts, pts, frame_size, false);
+}
+
 bool OMXPlayerAudio::OpenAudioCodec()
 {
   m_pAudioCodec = new COMXAudioCodecOMX();
@@ -450,6 +876,12 @@ bool OMXPlayerAudio::OpenDecoder()
         m_codec_name.c_str(), m_config.hints.channels, m_config.hints.samplerate, m_config.hints.bitspersample);
     }
   }
+  // queue about pcm_queue_seconds of decoded audio ahead of the renderer
+  unsigned int bytes_per_second = m_config.hints.samplerate * m_pAudioCodec->GetChannels() * m_pAudioCodec->GetBitsPerSample() >> 3;
+  if(m_passthrough || m_hw_decode)
+    bytes_per_second = m_config.hints.bitrate ? m_config.hints.bitrate >> 3 : 64 * 1024;
+  m_block_limit = std::max((unsigned int)(bytes_per_second * m_config.pcm_queue_seconds), 16u * 1024u);
+
   // setup current volume settings
   m_decoder->SetVolume(m_CurrentVolume);
   m_decoder->SetMute(m_mute);
@@ -492,12 +924,34 @@ double OMXPlayerAudio::GetCacheTotal()
 
 void OMXPlayerAudio::SubmitEOS()
 {
-  if(m_decoder)
-    m_decoder->SubmitEOS();
+  // queued behind the last decoded block so the renderer gets it after the last sample
+  LockDecoder();
+  QueueBlock(NULL, 0, DVD_NOPTS_VALUE, DVD_NOPTS_VALUE, 0, true);
+  UnLockDecoder();
 }
 
 bool OMXPlayerAudio::IsEOS()
 {
-  return m_packets.empty() && (!m_decoder || m_decoder->IsEOS());
+  pthread_mutex_lock(&m_lock_blocks);
+  bool queued = !m_blocks.empty() || m_submitting;
+  pthread_mutex_unlock(&m_lock_blocks);
+  return m_packets.empty() && !queued && (!m_decoder || m_decoder->IsEOS());
+}
+
+OMXAudioPipelineStats OMXPlayerAudio::GetPipelineStats()
+{
+  pthread_mutex_lock(&m_lock_blocks);
+  OMXAudioPipelineStats stats = m_pipeline_stats;
+  stats.queued_blocks = m_blocks.size();
+  stats.queued_bytes  = m_block_bytes;
+  stats.queue_limit   = m_block_limit;
+  pthread_mutex_unlock(&m_lock_blocks);
+  if(m_decoder)
+  {
+    if(m_config.hints.samplerate)
+      stats.render_latency_ms = 1000.0f * m_decoder->GetAudioRenderingLatency() / m_config.hints.samplerate;
+    stats.output_delay_ms = 1000.0f * m_decoder->GetDelay();
+  }
+  return stats;
 }
 
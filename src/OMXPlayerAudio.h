@@ -36,21 +36,89 @@
 #include "OMXThread.h"
 
 #include <deque>
+#include <vector>
 #include <string>
 #include <atomic>
 #include <sys/types.h>
 
 using namespace std;
 
+/* decoded PCM (or passthrough/hw decode packets) on its way from the decode
+   thread to the submit thread, eos marks where SubmitEOS was called and
+   transition the first block of the next file after AddTransition */
+typedef struct OMXAudioBlock
+{
+  uint8_t       *data;
+  int           size;
+  double        dts;
+  double        pts;
+  double        duration;   // 0 for passthrough/hw decode
+  unsigned int  frame_size;
+  int           channels;   // PCM layout for the tap, 0 for passthrough/hw decode
+  int           sample_rate;
+  int           bits_per_sample;
+  bool          eos;
+  bool          transition;
+  int64_t       queued_time;
+} OMXAudioBlock;
+
+class OMXAudioPipelineStats
+{
+public:
+  unsigned int  decoded_blocks;
+  float         decode_ms;          // average codec time per block
+  float         decode_ms_max;
+  float         decode_wait_ms;     // total time the decode thread waited on a full queue
+  unsigned int  submitted_blocks;
+  float         submit_ms;          // average AddPackets time per block
+  float         submit_ms_max;
+  float         space_wait_ms;      // average wait for free OMX input buffers per block
+  float         queue_ms;           // average time from decoded to submitted
+  float         queue_ms_max;
+  unsigned int  queued_blocks;
+  unsigned int  queued_bytes;
+  unsigned int  queue_limit;
+  unsigned int  transitions;            // gapless transitions to a next file
+  float         transition_gap_ms;      // worst timestamp gap between one file's last sample and the next one's first, < 0 overlaps
+  float         transition_headroom_ms; // least audio the renderer still had when a next file's first block reached it, 0 = audible gap
+  float         render_latency_ms;      // audio the renderer holds now, port buffers plus the ALSA ring for omx:alsa
+  float         output_delay_ms;        // last submitted sample to the clock's media time, submit to speaker
+
+  OMXAudioPipelineStats()
+  {
+    decoded_blocks = 0;
+    decode_ms = decode_ms_max = decode_wait_ms = 0.0f;
+    submitted_blocks = 0;
+    submit_ms = submit_ms_max = space_wait_ms = 0.0f;
+    queue_ms = queue_ms_max = 0.0f;
+    queued_blocks = queued_bytes = queue_limit = 0;
+    transitions = 0;
+    transition_gap_ms = transition_headroom_ms = 0.0f;
+    render_latency_ms = output_delay_ms = 0.0f;
+  }
+};
+
+class OMXPlayerAudio;
+
+class OMXAudioSubmitThread : public OMXThread
+{
+public:
+  OMXAudioSubmitThread() : m_owner(NULL) {}
+  void Process();
+  bool Stopping() { return m_bStop; }
+  OMXPlayerAudio *m_owner;
+};
+
 class OMXPlayerAudio : public OMXThread
 {
+  friend class OMXAudioSubmitThread;
 protected:
   AVStream                  *m_pStream;
   int                       m_stream_id;
   std::deque<OMXPacket *>   m_packets;
-  DllAvUtil                 m_dllAvUtil;
-  DllAvCodec                m_dllAvCodec;
-  DllAvFormat               m_dllAvFormat;
+  DllAvUtil                 &m_dllAvUtil;
+  DllAvCodec                &m_dllAvCodec;
+  DllAvFormat               &m_dllAvFormat;
   bool                      m_open;
   COMXStreamInfo            m_hints;
   double                    m_iCurrentPts;
@@ -77,10 +145,38 @@ protected:
   bool                      m_mute;
   bool   m_player_error;
 
+  std::deque<OMXAudioBlock> m_blocks;
+  unsigned int              m_block_bytes;
+  unsigned int              m_block_limit;
+  unsigned int              m_flush_generation;
+  bool                      m_submitting;
+  int64_t                   m_decode_time;
+  pthread_mutex_t           m_lock_blocks;
+  pthread_cond_t            m_blocks_cond;
+  pthread_mutex_t           m_lock_submit;
+  OMXAudioSubmitThread      m_submit_thread;
+  OMXAudioPipelineStats     m_pipeline_stats;
+  double                    m_submit_end;
+
+  bool                      m_transition;
+  std::vector<float>        m_fade_tail;
+  std::vector<float>        m_fade_buffer;
+  std::vector<uint8_t>      m_fade_output;
+  int                       m_fade_frames;
+  int                       m_fade_pos;
+  int                       m_fade_skip;
+
   void Lock();
   void UnLock();
   void LockDecoder();
   void UnLockDecoder();
+  bool QueueBlock(const uint8_t *data, int size, double dts, double pts, unsigned int frame_size, bool eos);
+  void SubmitProcess();
+  bool SubmitBlock(OMXAudioBlock &block, unsigned int generation);
+  bool WaitForDrain();
+  void ClearBlocks();
+  void BeginTransition();
+  bool QueueCrossfade(const uint8_t *data, int size, double dts, double pts, unsigned int frame_size);
 private:
 public:
   OMXPlayerAudio();
@@ -91,6 +187,7 @@ public:
   void Process();
   void Flush();
   bool AddPacket(OMXPacket *pkt);
+  void AddTransition();
   bool OpenAudioCodec();
   void CloseAudioCodec();      
   bool IsPassthrough(COMXStreamInfo hints);
@@ -100,14 +197,18 @@ public:
   double GetCacheTime();
   double GetCacheTotal();
   double GetCurrentPTS() { return m_iCurrentPts; };
+  // what AddTransition will overlap, compressed audio is only ever joined end to end
+  double GetCrossfade() { return m_passthrough || m_hw_decode ? 0.0 : m_config.crossfade; };
   void SubmitEOS();
   bool IsEOS();
+  OMXAudioPipelineStats GetPipelineStats();
   unsigned int GetCached() { return m_cached_size; };
   unsigned int GetMaxCached() { return m_config.queue_size * 1024 * 1024; };
   unsigned int GetLevel() { return m_config.queue_size ? 100.0f * m_cached_size / (m_config.queue_size * 1024.0f * 1024.0f) : 0; };
   void SetVolume(float fVolume)                          { m_CurrentVolume = fVolume; if(m_decoder) m_decoder->SetVolume(fVolume); }
   float GetVolume()                                      { return m_CurrentVolume; }
   void SetMute(bool bOnOff)                              { m_mute = bOnOff; if(m_decoder) m_decoder->SetMute(bOnOff); }
+  void SetMixGain(float gain)                            { m_config.alsa_mix_gain = gain; if(m_decoder) m_decoder->SetMixGain(gain); }
   void SetDynamicRangeCompression(long drc)              { m_amplification = drc; if(m_decoder) m_decoder->SetDynamicRangeCompression(drc); }
   bool Error() { return !m_player_error; };
 };
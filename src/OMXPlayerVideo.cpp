@@ -26,6 +26,7 @@
 #endif
 
 #include "OMXPlayerVideo.h"
+#include "OMXGlobalInit.h"
 
 #include <stdio.h>
 #include <unistd.h>
@@ -33,7 +34,10 @@
 
 #include "linux/XMemUtils.h"
 
-OMXPlayerVideo::OMXPlayerVideo()
+OMXPlayerVideo::OMXPlayerVideo() :
+  m_dllAvUtil(COMXGlobalInit::AvUtil()),
+  m_dllAvCodec(COMXGlobalInit::AvCodec()),
+  m_dllAvFormat(COMXGlobalInit::AvFormat())
 {
   m_open          = false;
   m_stream_id     = -1;
@@ -90,14 +94,12 @@ void OMXPlayerVideo::UnLockDecoder()
 bool OMXPlayerVideo::Open(OMXClock *av_clock, const OMXVideoConfig &config)
 {
 
-  if (!m_dllAvUtil.Load() || !m_dllAvCodec.Load() || !m_dllAvFormat.Load() || !av_clock)
+  if (!COMXGlobalInit::Initialize() || !av_clock)
     return false;
   
   if(ThreadHandle())
     Close();
 
-  m_dllAvFormat.av_register_all();
-
   m_config      = config;
   m_av_clock    = av_clock;
   m_fps         = 25.0f;
@@ -161,10 +163,6 @@ bool OMXPlayerVideo::Close()
 
   CloseDecoder();
 
-  m_dllAvUtil.Unload();
-  m_dllAvCodec.Unload();
-  m_dllAvFormat.Unload();
-
   m_open          = false;
   m_stream_id     = -1;
   m_iCurrentPts   = DVD_NOPTS_VALUE;
@@ -193,6 +191,13 @@ void OMXPlayerVideo::SetVideoRect(int aspectMode)
   m_decoder->SetVideoRect(aspectMode);
 }
 
+bool OMXPlayerVideo::SetRegions(const std::vector<OMXVideoRegion>& regions)
+{
+  if(!m_decoder)
+    return false;
+  return m_decoder->SetRegions(regions);
+}
+
 void OMXPlayerVideo::SetOrientation(int degreesClockWise, bool doMirror)
 {
     m_decoder->SetOrientation(degreesClockWise, doMirror);
@@ -405,3 +410,26 @@ int OMXPlayerVideo::getFrameNumber()
     }
     return result;
 }
+
+bool OMXPlayerVideo::getLastFrame(int& frameNumber, double& pts)
+{
+    frameNumber = 0;
+    pts = DVD_NOPTS_VALUE;
+    if(!m_decoder)
+    {
+        return false;
+    }
+    m_decoder->GetLastFrame(frameNumber, pts);
+    return true;
+}
+
+int OMXPlayerVideo::latchFrame(int& frameNumber, double& pts)
+{
+    frameNumber = 0;
+    pts = DVD_NOPTS_VALUE;
+    if(!m_decoder)
+    {
+        return -1;
+    }
+    return m_decoder->LatchFrame(frameNumber, pts);
+}
@@ -46,9 +46,9 @@ public:
     AVStream                  *m_pStream;
     int                       m_stream_id;
     std::deque<OMXPacket *>   m_packets;
-    DllAvUtil                 m_dllAvUtil;
-    DllAvCodec                m_dllAvCodec;
-    DllAvFormat               m_dllAvFormat;
+    DllAvUtil                 &m_dllAvUtil;
+    DllAvCodec                &m_dllAvCodec;
+    DllAvFormat               &m_dllAvFormat;
     bool                      m_open;
     double                    m_iCurrentPts;
     pthread_cond_t            m_packet_cond;
@@ -99,7 +99,10 @@ public:
     void SetLayer(int layer);
     void SetVideoRect(const CRect& SrcRect, const CRect& DestRect);
     void SetVideoRect(int aspectMode);
+    bool SetRegions(const std::vector<OMXVideoRegion>& regions);
     int getFrameNumber();
+    bool getLastFrame(int& frameNumber, double& pts);
+    int latchFrame(int& frameNumber, double& pts); //GL thread, index into the EGLImage ring
     void SetOrientation(int degreesClockWise, bool doMirror=false);
     void SetFilter(OMX_IMAGEFILTERTYPE filterType);
 
@@ -26,23 +26,22 @@
 #endif
 
 #include "OMXReader.h"
-#include "OMXClock.h"
+#include "OMXGlobalInit.h"
+// not OMXClock.h, the reader only needs ffmpeg so ofxOMXThumbnailService runs without a GPU
+#include "OMXTime.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <unistd.h>
-
+#include <algorithm>
 #include "linux/XMemUtils.h"
 
 #define MAX_DATA_SIZE_VIDEO    8 * 1024 * 1024
 #define MAX_DATA_SIZE_AUDIO    2 * 1024 * 1024
 #define MAX_DATA_SIZE          10 * 1024 * 1024
 
-static bool g_abort = false;
-
-static int64_t timeout_start;
-static int64_t timeout_default_duration;
-static int64_t timeout_duration;
-
 static int64_t CurrentHostCounter(void)
 {
     struct timespec now;
@@ -50,19 +49,25 @@ static int64_t CurrentHostCounter(void)
     return( ((int64_t)now.tv_sec * 1000000000LL) + now.tv_nsec );
 }
 
-#define RESET_TIMEOUT(x) do { \
-timeout_start = CurrentHostCounter(); \
-timeout_duration = (x) * timeout_default_duration; \
-} while (0)
+// abort flag and timeout are per reader so one player can be cancelled
+// without interrupting the others
+#define RESET_TIMEOUT(x) ResetTimeout(x)
 
 
-OMXReader::OMXReader()
+OMXReader::OMXReader() :
+    m_dllAvUtil(COMXGlobalInit::AvUtil()),
+    m_dllAvCodec(COMXGlobalInit::AvCodec()),
+    m_dllAvFormat(COMXGlobalInit::AvFormat())
 {
     m_open        = false;
     m_filename    = "";
     m_bMatroska   = false;
     m_bAVI        = false;
-    g_abort       = false;
+    m_abort       = false;
+    m_input_open  = false;
+    m_timeout_start = 0;
+    m_timeout_duration = 0;
+    m_timeout_default_duration = 0;
     m_pFile       = NULL;
     m_ioContext   = NULL;
     m_pFormatContext = NULL;
@@ -95,39 +100,58 @@ void OMXReader::UnLock()
     pthread_mutex_unlock(&m_lock);
 }
 
-static int interrupt_cb(void *unused)
+void OMXReader::ResetTimeout(int x)
+{
+    m_timeout_start = CurrentHostCounter();
+    m_timeout_duration = x * m_timeout_default_duration;
+}
+
+void OMXReader::Abort(bool abort)
+{
+    m_abort = abort;
+}
+
+bool OMXReader::IsInterrupted()
 {
-    int ret = 0;
-    if (g_abort)
+    bool ret = false;
+    if (m_abort)
     {
         CLog::Log(LOGERROR, "COMXPlayer::interrupt_cb - Told to abort");
-        ret = 1;
+        ret = true;
     }
-    else if (timeout_duration && CurrentHostCounter() - timeout_start > timeout_duration)
+    else if (m_timeout_duration && CurrentHostCounter() - m_timeout_start > m_timeout_duration)
     {
         CLog::Log(LOGERROR, "COMXPlayer::interrupt_cb - Timed out");
-        ret = 1;
+        ret = true;
     }
     return ret;
 }
 
+static int interrupt_cb(void *opaque)
+{
+    OMXReader *reader = (OMXReader *)opaque;
+    return reader->IsInterrupted() ? 1 : 0;
+}
+
 static int dvd_file_read(void *h, uint8_t* buf, int size)
 {
-    RESET_TIMEOUT(1);
-    if(interrupt_cb(NULL))
+    OMXReader *reader = (OMXReader *)h;
+    reader->ResetTimeout(1);
+    if(reader->IsInterrupted())
         return -1;
     
-    XFILE::CFile *pFile = (XFILE::CFile *)h;
+    XFILE::CFile *pFile = reader->GetFile();
     return pFile->Read(buf, size);
 }
 
 static offset_t dvd_file_seek(void *h, offset_t pos, int whence)
 {
-    RESET_TIMEOUT(1);
-    if(interrupt_cb(NULL))
+    OMXReader *reader = (OMXReader *)h;
+    reader->ResetTimeout(1);
+    if(reader->IsInterrupted())
         return -1;
     
-    XFILE::CFile *pFile = (XFILE::CFile *)h;
+    XFILE::CFile *pFile = reader->GetFile();
     if(whence == AVSEEK_SIZE)
         return pFile->GetLength();
     else
@@ -136,21 +160,19 @@ static offset_t dvd_file_seek(void *h, offset_t pos, int whence)
 
 bool OMXReader::Open(std::string filename, bool dump_format, bool live /* =false */, float timeout /* = 0.0f */, std::string cookie /* = "" */, std::string user_agent /* = "" */, std::string lavfdopts /* = "" */, std::string avdict /* = "" */)
 {
-    if (!m_dllAvUtil.Load() || !m_dllAvCodec.Load() || !m_dllAvFormat.Load())
+    if (!COMXGlobalInit::InitializeFFmpeg())
         return false;
     
-    timeout_default_duration = (int64_t) (timeout * 1e9);
+    m_timeout_default_duration = (int64_t) (timeout * 1e9);
     m_iCurrentPts = DVD_NOPTS_VALUE;
     m_filename    = filename; 
     m_speed       = DVD_PLAYSPEED_NORMAL;
     m_program     = UINT_MAX;
-    const AVIOInterruptCB int_cb = { interrupt_cb, NULL };
+    const AVIOInterruptCB int_cb = { interrupt_cb, this };
     RESET_TIMEOUT(3);
     
     ClearStreams();
     
-    m_dllAvFormat.av_register_all();
-    m_dllAvFormat.avformat_network_init();
     m_dllAvUtil.av_log_set_level(dump_format ? AV_LOG_INFO:AV_LOG_QUIET);
     
     int           result    = -1;
@@ -251,7 +273,7 @@ bool OMXReader::Open(std::string filename, bool dump_format, bool live /* =false
         }
         
         buffer = (unsigned char*)m_dllAvUtil.av_malloc(FFMPEG_FILE_BUFFER_SIZE);
-        m_ioContext = m_dllAvFormat.avio_alloc_context(buffer, FFMPEG_FILE_BUFFER_SIZE, 0, m_pFile, dvd_file_read, NULL, dvd_file_seek);
+        m_ioContext = m_dllAvFormat.avio_alloc_context(buffer, FFMPEG_FILE_BUFFER_SIZE, 0, this, dvd_file_read, NULL, dvd_file_seek);
         m_ioContext->max_packet_size = 6144;
         if(m_ioContext->max_packet_size)
             m_ioContext->max_packet_size *= FFMPEG_FILE_BUFFER_SIZE / m_ioContext->max_packet_size;
@@ -278,6 +300,8 @@ bool OMXReader::Open(std::string filename, bool dump_format, bool live /* =false
         }
     }
     
+    m_input_open = true;
+    
     m_bMatroska = strncmp(m_pFormatContext->iformat->name, "matroska", 8) == 0; // for "matroska.webm"
     m_bAVI = strcmp(m_pFormatContext->iformat->name, "avi") == 0;
     
@@ -387,13 +411,8 @@ bool OMXReader::Close()
         m_pFile = NULL;
     }
     
-    m_dllAvFormat.avformat_network_deinit();
-    
-    m_dllAvUtil.Unload();
-    m_dllAvCodec.Unload();
-    m_dllAvFormat.Unload();
-    
     m_open            = false;
+    m_input_open      = false;
     m_filename        = "";
     m_bMatroska       = false;
     m_bAVI            = false;
@@ -413,6 +432,63 @@ bool OMXReader::Close()
     return true;
 }
 
+void OMXReader::Swap(OMXReader &other)
+{
+    if(&other == this)
+        return;
+    
+    OMXReader *first  = this < &other ? this : &other;
+    OMXReader *second = this < &other ? &other : this;
+    first->Lock();
+    second->Lock();
+    
+    std::swap(m_video_index, other.m_video_index);
+    std::swap(m_audio_index, other.m_audio_index);
+    std::swap(m_subtitle_index, other.m_subtitle_index);
+    std::swap(m_video_count, other.m_video_count);
+    std::swap(m_audio_count, other.m_audio_count);
+    std::swap(m_subtitle_count, other.m_subtitle_count);
+    std::swap(m_open, other.m_open);
+    std::swap(m_filename, other.m_filename);
+    std::swap(m_bMatroska, other.m_bMatroska);
+    std::swap(m_bAVI, other.m_bAVI);
+    std::swap(m_pFile, other.m_pFile);
+    std::swap(m_pFormatContext, other.m_pFormatContext);
+    std::swap(m_ioContext, other.m_ioContext);
+    std::swap(m_eof, other.m_eof);
+    for(int i = 0; i < MAX_OMX_CHAPTERS; i++)
+        std::swap(m_chapters[i], other.m_chapters[i]);
+    for(int i = 0; i < MAX_STREAMS; i++)
+        std::swap(m_streams[i], other.m_streams[i]);
+    std::swap(m_chapter_count, other.m_chapter_count);
+    std::swap(m_iCurrentPts, other.m_iCurrentPts);
+    std::swap(m_speed, other.m_speed);
+    std::swap(m_program, other.m_program);
+    std::swap(m_aspect, other.m_aspect);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_seek, other.m_seek);
+    bool input_open = m_input_open;
+    m_input_open = other.m_input_open;
+    other.m_input_open = input_open;
+    std::swap(m_timeout_start, other.m_timeout_start);
+    std::swap(m_timeout_duration, other.m_timeout_duration);
+    std::swap(m_timeout_default_duration, other.m_timeout_default_duration);
+    
+    // the interrupt and io callbacks are handed the reader that opened them
+    OMXReader *readers[2] = { this, &other };
+    for(int i = 0; i < 2; i++)
+    {
+        if(readers[i]->m_pFormatContext)
+            readers[i]->m_pFormatContext->interrupt_callback.opaque = readers[i];
+        if(readers[i]->m_ioContext)
+            readers[i]->m_ioContext->opaque = readers[i];
+    }
+    
+    second->UnLock();
+    first->UnLock();
+}
+
 /*void OMXReader::FlushRead()
  {
  m_iCurrentPts = DVD_NOPTS_VALUE;
@@ -512,7 +588,7 @@ OMXPacket *OMXReader::Read()
         return NULL;
     }
     
-    if (pkt.size < 0 || pkt.stream_index >= MAX_OMX_STREAMS || interrupt_cb(NULL))
+    if (pkt.size < 0 || pkt.stream_index >= MAX_OMX_STREAMS || IsInterrupted())
     {
         // XXX, in some cases ffmpeg returns a negative packet size
         if(m_pFormatContext->pb && !m_pFormatContext->pb->eof_reached)
@@ -1199,6 +1275,22 @@ int OMXReader::GetStreamLength()
     return (int)(m_pFormatContext->duration / (AV_TIME_BASE / 1000));
 }
 
+double OMXReader::GetStartTime(OMXStreamType type)
+{
+    int index = -1;
+    
+    if(type == OMXSTREAM_AUDIO)
+        index = m_audio_index;
+    else if(type == OMXSTREAM_VIDEO)
+        index = m_video_index;
+    
+    if(index == -1 || !m_streams[index].stream)
+        return DVD_NOPTS_VALUE;
+    
+    AVStream *stream = m_streams[index].stream;
+    return ConvertTimestamp(stream->start_time, stream->time_base.den, stream->time_base.num);
+}
+
 double OMXReader::NormalizeFrameduration(double frameduration)
 {
     //if the duration is within 20 microseconds of a common duration, use that
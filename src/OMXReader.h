@@ -103,9 +103,9 @@ protected:
   int                       m_video_count;
   int                       m_audio_count;
   int                       m_subtitle_count;
-  DllAvUtil                 m_dllAvUtil;
-  DllAvCodec                m_dllAvCodec;
-  DllAvFormat               m_dllAvFormat;
+  DllAvUtil                 &m_dllAvUtil;
+  DllAvCodec                &m_dllAvCodec;
+  DllAvFormat               &m_dllAvFormat;
   bool                      m_open;
   std::string               m_filename;
   bool                      m_bMatroska;
@@ -128,6 +128,11 @@ protected:
   void UnLock();
   bool SetActiveStreamInternal(OMXStreamType type, unsigned int index);
   bool                      m_seek;
+  volatile bool             m_abort;
+  volatile bool             m_input_open;
+  int64_t                   m_timeout_start;
+  int64_t                   m_timeout_duration;
+  int64_t                   m_timeout_default_duration;
 private:
 public:
   OMXReader();
@@ -135,6 +140,16 @@ public:
   bool Open(std::string filename, bool dump_format, bool live = false, float timeout = 0.0f, std::string cookie = "", std::string user_agent = "", std::string lavfdopts = "", std::string avdict = "");
   void ClearStreams();
   bool Close();
+  // exchanges the open files with other, abort flags stay where they are
+  void Swap(OMXReader &other);
+  // interrupts any blocking open/probe/read, safe to call from another thread
+  void Abort(bool abort = true);
+  bool IsAborted() { return m_abort; };
+  bool IsInterrupted();
+  void ResetTimeout(int x);
+  // true once avformat_open_input succeeded, stream probing may still be running
+  bool IsInputOpen() { return m_input_open; };
+  XFILE::CFile *GetFile() { return m_pFile; };
   //void FlushRead();
   bool SeekTime(int time, bool backwords, double *startpts);
   AVMediaType PacketType(OMXPacket *pkt);
@@ -178,6 +193,8 @@ public:
   }
 
   int GetStreamLength();
+  // first timestamp of the active stream of type, DVD_NOPTS_VALUE if the container does not say
+  double GetStartTime(OMXStreamType type);
   static double NormalizeFrameduration(double frameduration);
   bool IsMatroska() { return m_bMatroska; };
   std::string GetCodecName(OMXStreamType type);
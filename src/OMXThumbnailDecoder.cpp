@@ -0,0 +1,244 @@
+#include "OMXThumbnailDecoder.h"
+#include "OMXGlobalInit.h"
+#include "OMXTime.h"
+#include "utils/log.h"
+
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <mutex>
+
+// scanning forward for an accurate frame stops after this many packets
+#define THUMBNAIL_MAX_PACKETS 1000
+
+// older libavcodec builds need codec open/close serialised
+static std::mutex g_codec_open_lock;
+
+static double NowMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec * 1e-6;
+}
+
+COMXThumbnailDecoder::COMXThumbnailDecoder() :
+  m_dllAvUtil(COMXGlobalInit::AvUtil()),
+  m_dllAvCodec(COMXGlobalInit::AvCodec()),
+  m_dllSwScale(COMXGlobalInit::SwScale())
+{
+  m_pCodecContext = NULL;
+  m_pFrame        = NULL;
+  m_pScaler       = NULL;
+  m_aspect        = 0.0f;
+  m_picture       = false;
+  m_pts           = 0.0;
+  m_duration      = 0;
+  m_decode_ms     = 0.0f;
+}
+
+COMXThumbnailDecoder::~COMXThumbnailDecoder()
+{
+  Close();
+  if(m_pScaler)
+  {
+    m_dllSwScale.sws_freeContext(m_pScaler);
+    m_pScaler = NULL;
+  }
+}
+
+bool COMXThumbnailDecoder::OpenCodec(COMXStreamInfo &hints)
+{
+  AVCodec *codec = m_dllAvCodec.avcodec_find_decoder(hints.codec);
+  if(!codec)
+  {
+    CLog::Log(LOGERROR, "COMXThumbnailDecoder::%s - no software decoder for codec %d", __func__, hints.codec);
+    return false;
+  }
+  m_pCodecContext = m_dllAvCodec.avcodec_alloc_context3(codec);
+  // parallelism comes from running several decoders, one thread each
+  m_pCodecContext->thread_count = 1;
+  m_pCodecContext->width  = hints.width;
+  m_pCodecContext->height = hints.height;
+  if(hints.extradata && hints.extrasize > 0)
+  {
+    m_pCodecContext->extradata_size = hints.extrasize;
+    m_pCodecContext->extradata = (uint8_t *)m_dllAvUtil.av_mallocz(hints.extrasize + AV_INPUT_BUFFER_PADDING_SIZE);
+    memcpy(m_pCodecContext->extradata, hints.extradata, hints.extrasize);
+  }
+  {
+    std::lock_guard<std::mutex> guard(g_codec_open_lock);
+    if(m_dllAvCodec.avcodec_open2(m_pCodecContext, codec, NULL) < 0)
+    {
+      CLog::Log(LOGERROR, "COMXThumbnailDecoder::%s - could not open decoder %s", __func__, codec->name);
+      Close();
+      return false;
+    }
+  }
+  m_pFrame = m_dllAvCodec.av_frame_alloc();
+  m_aspect = hints.aspect;
+  return true;
+}
+
+void COMXThumbnailDecoder::Close()
+{
+  if(m_pFrame)
+  {
+    m_dllAvUtil.av_free(m_pFrame);
+    m_pFrame = NULL;
+  }
+  if(m_pCodecContext)
+  {
+    {
+      std::lock_guard<std::mutex> guard(g_codec_open_lock);
+      m_dllAvCodec.avcodec_close(m_pCodecContext);
+    }
+    if(m_pCodecContext->extradata)
+    {
+      m_dllAvUtil.av_free(m_pCodecContext->extradata);
+      m_pCodecContext->extradata = NULL;
+    }
+    m_dllAvUtil.av_free(m_pCodecContext);
+    m_pCodecContext = NULL;
+  }
+  m_picture = false;
+}
+
+bool COMXThumbnailDecoder::Decode(const std::string &path, int time_ms, bool accurate)
+{
+  double start = NowMs();
+  Close();
+  m_pts       = 0.0;
+  m_duration  = 0;
+  m_decode_ms = 0.0f;
+
+  OMXReader reader;
+  if(!reader.Open(path, false))
+  {
+    CLog::Log(LOGERROR, "COMXThumbnailDecoder::%s - could not open %s", __func__, path.c_str());
+    return false;
+  }
+  COMXStreamInfo hints;
+  if(!reader.GetHints(OMXSTREAM_VIDEO, hints) || !OpenCodec(hints))
+  {
+    reader.Close();
+    return false;
+  }
+  m_duration = reader.GetStreamLength();
+
+  if(time_ms < 0)
+    time_ms = m_duration / 10;
+  if(m_duration > 0)
+    time_ms = std::min(time_ms, m_duration);
+  // backwards lands on the keyframe at or before the time
+  if(time_ms > 0)
+    reader.SeekTime(time_ms, true, NULL);
+  double target_pts = DVD_MSEC_TO_TIME(time_ms);
+
+  double frame_pts = DVD_NOPTS_VALUE;
+  int packets = 0;
+  while(packets < THUMBNAIL_MAX_PACKETS)
+  {
+    OMXPacket *packet = reader.Read();
+    AVPacket avpkt;
+    m_dllAvCodec.av_init_packet(&avpkt);
+    if(packet)
+    {
+      if(!reader.IsActive(OMXSTREAM_VIDEO, packet->stream_index))
+      {
+        OMXReader::FreePacket(packet);
+        continue;
+      }
+      packets++;
+      avpkt.data = packet->data;
+      avpkt.size = packet->size;
+      double pts = packet->pts != DVD_NOPTS_VALUE ? packet->pts : packet->dts;
+      // comes back out with the picture this packet produces, after reordering
+      m_pCodecContext->reordered_opaque = (int64_t)pts;
+    }
+    else
+    {
+      // end of file, drain the frames the decoder is holding back
+      avpkt.data = NULL;
+      avpkt.size = 0;
+    }
+
+    int got_picture = 0;
+    int result = m_dllAvCodec.avcodec_decode_video2(m_pCodecContext, m_pFrame, &got_picture, &avpkt);
+    if(packet)
+      OMXReader::FreePacket(packet);
+    if(result >= 0 && got_picture)
+    {
+      m_picture = true;
+      frame_pts = (double)m_pFrame->reordered_opaque;
+      if(!accurate || frame_pts == DVD_NOPTS_VALUE || frame_pts >= target_pts)
+        break;
+    }
+    else if(!packet)
+    {
+      break;
+    }
+  }
+  reader.Close();
+
+  if(!m_picture)
+  {
+    CLog::Log(LOGERROR, "COMXThumbnailDecoder::%s - no picture decoded from %s", __func__, path.c_str());
+    Close();
+    return false;
+  }
+  m_pts = frame_pts == DVD_NOPTS_VALUE ? 0.0 : frame_pts / DVD_TIME_BASE;
+  m_decode_ms = NowMs() - start;
+  return true;
+}
+
+void COMXThumbnailDecoder::GetScaledSize(int &width, int &height)
+{
+  int source_width  = GetWidth();
+  int source_height = GetHeight();
+  if(source_width <= 0 || source_height <= 0)
+  {
+    width = height = 0;
+    return;
+  }
+  float aspect = m_aspect;
+  if(aspect <= 0.0f)
+  {
+    AVRational sar = m_pCodecContext->sample_aspect_ratio;
+    aspect = (float)source_width / source_height * (sar.num > 0 && sar.den > 0 ? (float)sar.num / sar.den : 1.0f);
+  }
+
+  if(width <= 0 && height <= 0)
+  {
+    width  = roundf(source_height * aspect);
+    height = source_height;
+  }
+  else if(width <= 0)
+  {
+    width = roundf(height * aspect);
+  }
+  else if(height <= 0)
+  {
+    height = roundf(width / aspect);
+  }
+  width  = std::max(1, width);
+  height = std::max(1, height);
+}
+
+bool COMXThumbnailDecoder::Scale(uint8_t *dst, int stride, int width, int height, AVPixelFormat format)
+{
+  if(!m_picture)
+    return false;
+
+  m_pScaler = m_dllSwScale.sws_getCachedContext(m_pScaler, GetWidth(), GetHeight(), m_pCodecContext->pix_fmt,
+                                                width, height, format, SWS_BILINEAR, NULL, NULL, NULL);
+  if(!m_pScaler)
+  {
+    CLog::Log(LOGERROR, "COMXThumbnailDecoder::%s - no swscale conversion from pixel format %d", __func__, m_pCodecContext->pix_fmt);
+    return false;
+  }
+  uint8_t *planes[4] = { dst, NULL, NULL, NULL };
+  int strides[4] = { stride, 0, 0, 0 };
+  m_dllSwScale.sws_scale(m_pScaler, m_pFrame->data, m_pFrame->linesize, 0, GetHeight(), planes, strides);
+  return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Software decode of a single picture, for poster frames and thumbnails.
+ *
+ * Decode opens the file with OMXReader, seeks back to the keyframe at or
+ * before the requested time and decodes with libavcodec on one thread,
+ * with accurate set it keeps going up to the requested time. Scale then
+ * converts the picture with swscale into the caller's buffer.
+ *
+ * Only ffmpeg is used (COMXGlobalInit::InitializeFFmpeg), no OMX and no
+ * GL. One decoder per thread.
+ */
+
+#include "OMXReader.h"
+#include "DllSwScale.h"
+
+#include <string>
+
+class COMXThumbnailDecoder
+{
+public:
+  COMXThumbnailDecoder();
+  ~COMXThumbnailDecoder();
+
+  // time_ms < 0 picks a point 10% into the file
+  bool Decode(const std::string &path, int time_ms, bool accurate);
+  // 0 for either keeps the display aspect ratio, both 0 = display size
+  void GetScaledSize(int &width, int &height);
+  // dst holds height rows of stride bytes
+  bool Scale(uint8_t *dst, int stride, int width, int height, AVPixelFormat format);
+  void Close();
+
+  int    GetWidth()       { return m_pCodecContext ? m_pCodecContext->width : 0; };
+  int    GetHeight()      { return m_pCodecContext ? m_pCodecContext->height : 0; };
+  double GetPts()         { return m_pts; };         // seconds, of the decoded picture
+  int    GetDuration()    { return m_duration; };    // ms, 0 if unknown
+  float  GetDecodeTime()  { return m_decode_ms; };   // open, seek and decode
+
+private:
+  bool OpenCodec(COMXStreamInfo &hints);
+
+  DllAvUtil         &m_dllAvUtil;
+  DllAvCodec        &m_dllAvCodec;
+  DllSwScale        &m_dllSwScale;
+  AVCodecContext    *m_pCodecContext;
+  AVFrame           *m_pFrame;
+  struct SwsContext *m_pScaler;
+  float             m_aspect;
+  bool              m_picture;
+  double            m_pts;
+  int               m_duration;
+  float             m_decode_ms;
+};
@@ -33,6 +33,7 @@
 
 #include <sys/time.h>
 #include <inttypes.h>
+#include <algorithm>
 
 #ifdef CLASSNAME
 #undef CLASSNAME
@@ -74,7 +75,13 @@ COMXVideo::COMXVideo() : m_video_codec_name("")
     m_setStartTime      = false;
     m_transform         = OMX_DISPLAY_ROT0;
     m_pixel_aspect      = 1.0f;
+    m_num_regions       = 0;
     frameCounter = 0;
+    framePTS = DVD_NOPTS_VALUE;
+    eglBuffer = NULL;
+    frontBuffer = -1;
+    latchedBuffer = -1;
+    deferredBuffer = -1;
     omxErrorTypes[OMX_ErrorNone] =  "OMX_ErrorNone";
     omxErrorTypes[OMX_ErrorInsufficientResources] =  "OMX_ErrorInsufficientResources";
     omxErrorTypes[OMX_ErrorUndefined] =  "OMX_ErrorUndefined";
@@ -278,6 +285,10 @@ bool COMXVideo::PortSettingsChanged()
         {
             return false;
         }
+        if(m_num_regions > 1 && !SetupRegions())
+        {
+            return false;
+        }
     }
     
     
@@ -403,7 +414,13 @@ bool COMXVideo::PortSettingsChanged()
     {
         m_omx_tunnel_decoder.Initialize(&m_omx_decoder, m_omx_decoder.GetOutputPort(), &m_omx_sched, m_omx_sched.GetInputPort());
     }
-    m_omx_tunnel_sched.Initialize(&m_omx_sched, m_omx_sched.GetOutputPort(), &m_omx_render, m_omx_render.GetInputPort());
+    if(m_num_regions > 1)
+    {
+        m_omx_tunnel_sched.Initialize(&m_omx_sched, m_omx_sched.GetOutputPort(), &m_omx_splitter, m_omx_splitter.GetInputPort());
+    }else
+    {
+        m_omx_tunnel_sched.Initialize(&m_omx_sched, m_omx_sched.GetOutputPort(), &m_omx_render, m_omx_render.GetInputPort());
+    }
     m_omx_tunnel_clock.Initialize(m_omx_clock, m_omx_clock->GetInputPort() + 1, &m_omx_sched, m_omx_sched.GetOutputPort() + 1);
     
     omx_err = m_omx_tunnel_clock.Establish();
@@ -455,6 +472,37 @@ bool COMXVideo::PortSettingsChanged()
             return false;
         }
         
+        if(m_num_regions > 1)
+        {
+            //one decode feeds every region, each render only crops and scales
+            for(int i=0; i<m_num_regions; i++)
+            {
+                COMXCoreComponent* render = GetRegionRender(i);
+                m_omx_tunnel_splitter[i].Initialize(&m_omx_splitter, m_omx_splitter.GetOutputPort()+i, render, render->GetInputPort());
+                omx_err = m_omx_tunnel_splitter[i].Establish();
+                if(omx_err != OMX_ErrorNone)
+                {
+                    ofLog(OF_LOG_NOTICE, "%s::%s - m_omx_tunnel_splitter[%d].Establish omx_err(%s)", CLASSNAME, __func__, i, omxErrorTypes[omx_err].c_str());
+                    return false;
+                }
+            }
+            omx_err = m_omx_splitter.SetStateForComponent(OMX_StateExecuting);
+            if(omx_err != OMX_ErrorNone)
+            {
+                ofLog(OF_LOG_NOTICE, "%s::%s - m_omx_splitter.SetStateForComponent omx_err(%s)", CLASSNAME, __func__, omxErrorTypes[omx_err].c_str());
+                return false;
+            }
+            for(int i=1; i<m_num_regions; i++)
+            {
+                omx_err = GetRegionRender(i)->SetStateForComponent(OMX_StateExecuting);
+                if(omx_err != OMX_ErrorNone)
+                {
+                    ofLog(OF_LOG_NOTICE, "%s::%s - region render %d SetStateForComponent omx_err(%s)", CLASSNAME, __func__, i, omxErrorTypes[omx_err].c_str());
+                    return false;
+                }
+            }
+        }
+        
         omx_err = m_omx_render.SetStateForComponent(OMX_StateExecuting);
         if(omx_err != OMX_ErrorNone)
         {
@@ -510,18 +558,36 @@ bool COMXVideo::PortSettingsChanged()
         if(error != OMX_ErrorNone) return false;
         
         
-        eglBuffer = NULL;
-        error = m_omx_render.UseEGLImage(&eglBuffer, m_omx_render.GetOutputPort(), NULL, m_config.eglImage);
+        std::vector<void*> eglImages;
+        if(m_config.eglImages.empty())
+        {
+            eglImages.push_back(m_config.eglImage);
+        }else
+        {
+            eglImages.assign(m_config.eglImages.begin(), m_config.eglImages.end());
+        }
+        
+        std::vector<OMX_BUFFERHEADERTYPE*> buffers;
+        error = m_omx_render.UseEGLImages(buffers, m_omx_render.GetOutputPort(), eglImages);
         OMX_TRACE(error);
         if(error != OMX_ErrorNone) return false;
+        {
+            CSingleLock frameLock (m_frameSection);
+            eglBuffers = buffers;
+            eglBuffer = eglBuffers[0];
+        }
         
         error = m_omx_render.SetStateForComponent(OMX_StateExecuting);
         OMX_TRACE(error);
         if(error != OMX_ErrorNone) return false;
         
         //error = m_omx_render.WaitForEvent(OMX_EventPortSettingsChanged, 0);
-        error = m_omx_render.FillThisBuffer(eglBuffer);
-        OMX_TRACE(error);        
+        //egl_render owns every buffer until the first one completes
+        for(size_t i=0; i<buffers.size(); i++)
+        {
+            error = m_omx_render.FillThisBuffer(buffers[i]);
+            OMX_TRACE(error);
+        }
     }
     
     m_settings_changed = true;
@@ -618,9 +684,63 @@ void COMXVideo::processCodec(COMXStreamInfo& hints)
 
 void COMXVideo::onFillBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
 {
-    OMX_FillThisBuffer(hComponent, pBuffer);
+    //read the timestamp before the buffer goes back to egl_render
+    double pts = (double)FromOMXTime(pBuffer->nTimeStamp);
+    
+    CSingleLock lock (m_frameSection);
     frameCounter++;
+    framePTS = pts;
     //ofLog() << "onFillBuffer: " << frameCounter;
+    
+    if(eglBuffers.size() < 2)
+    {
+        //single EGLImage, egl_render renders straight into the texture being drawn
+        OMX_FillThisBuffer(hComponent, pBuffer);
+        return;
+    }
+    
+    //this buffer becomes the front, the previous front goes back to egl_render
+    //unless the GL thread is still sampling it
+    int previous = frontBuffer;
+    frontBuffer = (int)(size_t)pBuffer->pAppPrivate;
+    if(previous < 0 || previous == frontBuffer)
+    {
+        return;
+    }
+    if(previous == latchedBuffer)
+    {
+        deferredBuffer = previous;
+    }else
+    {
+        OMX_FillThisBuffer(hComponent, eglBuffers[previous]);
+    }
+}
+
+void COMXVideo::GetLastFrame(int& frameNumber, double& pts)
+{
+    CSingleLock lock (m_frameSection);
+    frameNumber = frameCounter;
+    pts = framePTS;
+}
+
+//GL thread - pins the front EGLImage until the next call and returns its
+//index, or -1 before the first frame
+int COMXVideo::LatchFrame(int& frameNumber, double& pts)
+{
+    CSingleLock lock (m_frameSection);
+    frameNumber = frameCounter;
+    pts = framePTS;
+    if(eglBuffers.size() < 2)
+    {
+        return eglBuffers.empty() ? -1 : 0;
+    }
+    latchedBuffer = frontBuffer;
+    if(deferredBuffer >= 0 && deferredBuffer != latchedBuffer)
+    {
+        OMX_FillThisBuffer(m_omx_render.GetComponent(), eglBuffers[deferredBuffer]);
+        deferredBuffer = -1;
+    }
+    return latchedBuffer;
 }
 
 
@@ -631,7 +751,16 @@ bool COMXVideo::Open(OMXClock *clock, const OMXVideoConfig &config)
 
     Close();
     
-    frameCounter = 0;
+    {
+        CSingleLock frameLock (m_frameSection);
+        frameCounter = 0;
+        framePTS = DVD_NOPTS_VALUE;
+        eglBuffer = NULL;
+        eglBuffers.clear();
+        frontBuffer = -1;
+        latchedBuffer = -1;
+        deferredBuffer = -1;
+    }
     
     bool vflip = false;
     OMX_ERRORTYPE omx_err   = OMX_ErrorNone;
@@ -642,6 +771,7 @@ bool COMXVideo::Open(OMXClock *clock, const OMXVideoConfig &config)
     m_config = config;
     filtersEnabled = m_config.enableFilters;
     useTexture = config.useTexture;
+    m_num_regions = useTexture ? 0 : std::min((int)m_config.regions.size(), MAX_VIDEO_REGIONS);
     m_video_codec_name      = "";
     m_codingType            = OMX_VIDEO_CodingUnused;
     
@@ -968,15 +1098,37 @@ void COMXVideo::Close()
         m_omx_tunnel_image_fx.Deestablish();
     }
     m_omx_tunnel_sched.Deestablish();
+    for(int i=0; i<m_num_regions && m_num_regions > 1; i++)
+    {
+        m_omx_tunnel_splitter[i].Deestablish();
+    }
     
     m_omx_decoder.FlushInput();
     
     m_omx_sched.Deinitialize();
+    if(m_num_regions > 1)
+    {
+        m_omx_splitter.Deinitialize();
+        for(int i=1; i<m_num_regions; i++)
+        {
+            GetRegionRender(i)->Deinitialize();
+        }
+    }
+    m_num_regions = 0;
     m_omx_decoder.Deinitialize();
     if(filtersEnabled)
     {
         m_omx_image_fx.Deinitialize();
     }
+    {
+        //the buffers go away with egl_render, stop LatchFrame handing them back
+        CSingleLock frameLock (m_frameSection);
+        eglBuffer = NULL;
+        eglBuffers.clear();
+        frontBuffer = -1;
+        latchedBuffer = -1;
+        deferredBuffer = -1;
+    }
     m_omx_render.Deinitialize();
     
     m_is_open       = false;
@@ -1126,6 +1278,14 @@ void COMXVideo::SetVideoRect()
     {
         return;
     }
+    if(m_num_regions > 0)
+    {
+        for(int i=0; i<m_num_regions; i++)
+        {
+            SetRegionRect(i);
+        }
+        return;
+    }
     
     OMX_ERRORTYPE omx_err;
     OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
@@ -1172,6 +1332,107 @@ void COMXVideo::SetVideoRect()
     }
 }
 
+COMXCoreComponent* COMXVideo::GetRegionRender(int index)
+{
+    return index == 0 ? &m_omx_render : &m_omx_region_render[index-1];
+}
+
+bool COMXVideo::SetupRegions()
+{
+    if(!m_omx_splitter.Initialize("OMX.broadcom.video_splitter", OMX_IndexParamVideoInit))
+    {
+        return false;
+    }
+    for(int i=1; i<m_num_regions; i++)
+    {
+        COMXCoreComponent* render = GetRegionRender(i);
+        if(!render->Initialize("OMX.broadcom.video_render", OMX_IndexParamVideoInit))
+        {
+            return false;
+        }
+        //the same display settings PortSettingsChanged gives m_omx_render
+        OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
+        OMX_INIT_STRUCTURE(configDisplay);
+        configDisplay.nPortIndex = render->GetInputPort();
+        configDisplay.set = (OMX_DISPLAYSETTYPE)(OMX_DISPLAY_SET_ALPHA | OMX_DISPLAY_SET_TRANSFORM | OMX_DISPLAY_SET_LAYER | OMX_DISPLAY_SET_NUM);
+        configDisplay.alpha = m_config.alpha;
+        configDisplay.num = m_config.display;
+        configDisplay.layer = m_config.layer;
+        configDisplay.transform = m_transform;
+        OMX_ERRORTYPE omx_err = render->SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
+        if(omx_err != OMX_ErrorNone)
+        {
+            ofLog(OF_LOG_NOTICE, "%s::%s - region %d display config omx_err(%s)", CLASSNAME, __func__, i, omxErrorTypes[omx_err].c_str());
+            return false;
+        }
+    }
+    ofLog(OF_LOG_VERBOSE, "%s::%s - splitting into %d regions", CLASSNAME, __func__, m_num_regions);
+    return true;
+}
+
+void COMXVideo::SetRegionRect(int index)
+{
+    const OMXVideoRegion& region = m_config.regions[index];
+    COMXCoreComponent* render = GetRegionRender(index);
+    //an empty crop is the whole frame, as in textured mode
+    CRect src_rect = region.src_rect;
+    if(src_rect.IsEmpty())
+    {
+        src_rect.SetRect(0, 0, m_config.hints.width, m_config.hints.height);
+    }
+    
+    OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
+    OMX_INIT_STRUCTURE(configDisplay);
+    configDisplay.nPortIndex = render->GetInputPort();
+    //tiles are placed exactly where they are asked for, no letterboxing
+    configDisplay.set = (OMX_DISPLAYSETTYPE)(OMX_DISPLAY_SET_NOASPECT | OMX_DISPLAY_SET_MODE | OMX_DISPLAY_SET_SRC_RECT | OMX_DISPLAY_SET_DEST_RECT | OMX_DISPLAY_SET_FULLSCREEN);
+    configDisplay.noaspect   = OMX_TRUE;
+    configDisplay.mode       = OMX_DISPLAY_MODE_FILL;
+    configDisplay.fullscreen = OMX_FALSE;
+    
+    configDisplay.src_rect.x_offset   = (int)(src_rect.x1+0.5f);
+    configDisplay.src_rect.y_offset   = (int)(src_rect.y1+0.5f);
+    configDisplay.src_rect.width      = (int)(src_rect.Width()+0.5f);
+    configDisplay.src_rect.height     = (int)(src_rect.Height()+0.5f);
+    
+    configDisplay.dest_rect.x_offset  = (int)(region.dst_rect.x1+0.5f);
+    configDisplay.dest_rect.y_offset  = (int)(region.dst_rect.y1+0.5f);
+    configDisplay.dest_rect.width     = (int)(region.dst_rect.Width()+0.5f);
+    configDisplay.dest_rect.height    = (int)(region.dst_rect.Height()+0.5f);
+    
+    OMX_ERRORTYPE omx_err = render->SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
+    if(omx_err != OMX_ErrorNone)
+    {
+        ofLog(OF_LOG_NOTICE, "%s::%s - region %d OMX_IndexConfigDisplayRegion omx_err(%s)", CLASSNAME, __func__, index, omxErrorTypes[omx_err].c_str());
+    }
+}
+
+//Rects can change at any time. Going between one and several regions, or
+//changing how many when split, rebuilds the pipeline and so needs a reopen;
+//returns false in that case and the new regions apply on the next Open
+bool COMXVideo::SetRegions(const std::vector<OMXVideoRegion>& regions)
+{
+    CSingleLock lock (m_critSection);
+    int numRegions = std::min((int)regions.size(), MAX_VIDEO_REGIONS);
+    m_config.regions.assign(regions.begin(), regions.begin()+numRegions);
+    if(useTexture)
+    {
+        return true;
+    }
+    if(!m_is_open || !m_settings_changed)
+    {
+        m_num_regions = numRegions;
+        return true;
+    }
+    if((numRegions > 1 || m_num_regions > 1) && numRegions != m_num_regions)
+    {
+        return false;
+    }
+    m_num_regions = numRegions;
+    SetVideoRect();
+    return true;
+}
+
 void COMXVideo::SetLayer(int layer)
 {
     CSingleLock lock (m_critSection);
@@ -1182,14 +1443,17 @@ void COMXVideo::SetLayer(int layer)
     OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
     OMX_INIT_STRUCTURE(configDisplay);
     
-    configDisplay.nPortIndex = m_omx_render.GetInputPort();
     configDisplay.set = OMX_DISPLAY_SET_LAYER;
     configDisplay.layer = layer;
     
-    omx_err = m_omx_render.SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
-    if(omx_err != OMX_ErrorNone)
+    for(int i=0; i<std::max(1, m_num_regions); i++)
     {
-        ofLog(OF_LOG_NOTICE, "COMXVideo::LAYER::Open error OMX_IndexConfigDisplayRegion omx_err(%s)\n", omxErrorTypes[omx_err].c_str());
+        configDisplay.nPortIndex = GetRegionRender(i)->GetInputPort();
+        omx_err = GetRegionRender(i)->SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
+        if(omx_err != OMX_ErrorNone)
+        {
+            ofLog(OF_LOG_NOTICE, "COMXVideo::LAYER::Open error OMX_IndexConfigDisplayRegion omx_err(%s)\n", omxErrorTypes[omx_err].c_str());
+        }
     }
     
 }
@@ -1247,15 +1511,17 @@ void COMXVideo::SetOrientation(int degreesClockWise, bool doMirror)
     
     OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
     OMX_INIT_STRUCTURE(configDisplay);
-    configDisplay.nPortIndex = m_omx_render.GetInputPort();
-    
     configDisplay.set = OMX_DISPLAY_SET_TRANSFORM;
     configDisplay.transform = m_transform;
-    OMX_ERRORTYPE omx_err = m_omx_render.SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
-    if(omx_err != OMX_ErrorNone)
+    for(int i=0; i<std::max(1, m_num_regions); i++)
     {
-        ofLog(OF_LOG_NOTICE, "%s::%s - could not set transform : %d", CLASSNAME, __func__, m_transform);
-        return;
+        configDisplay.nPortIndex = GetRegionRender(i)->GetInputPort();
+        OMX_ERRORTYPE omx_err = GetRegionRender(i)->SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
+        if(omx_err != OMX_ErrorNone)
+        {
+            ofLog(OF_LOG_NOTICE, "%s::%s - could not set transform : %d", CLASSNAME, __func__, m_transform);
+            return;
+        }
     }
     
 }
@@ -1270,14 +1536,17 @@ void COMXVideo::SetAlpha(int alpha)
     OMX_CONFIG_DISPLAYREGIONTYPE configDisplay;
     OMX_INIT_STRUCTURE(configDisplay);
     
-    configDisplay.nPortIndex = m_omx_render.GetInputPort();
     configDisplay.set = OMX_DISPLAY_SET_ALPHA;
     configDisplay.alpha = alpha;
     
-    omx_err = m_omx_render.SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
-    if(omx_err != OMX_ErrorNone)
+    for(int i=0; i<std::max(1, m_num_regions); i++)
     {
-        ofLog(OF_LOG_NOTICE, "COMXVideo::ALPHA::Open error OMX_IndexConfigDisplayRegion omx_err(%s)\n", omxErrorTypes[omx_err].c_str());
+        configDisplay.nPortIndex = GetRegionRender(i)->GetInputPort();
+        omx_err = GetRegionRender(i)->SetConfig(OMX_IndexConfigDisplayRegion, &configDisplay);
+        if(omx_err != OMX_ErrorNone)
+        {
+            ofLog(OF_LOG_NOTICE, "COMXVideo::ALPHA::Open error OMX_IndexConfigDisplayRegion omx_err(%s)\n", omxErrorTypes[omx_err].c_str());
+        }
     }
     
 }
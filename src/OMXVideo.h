@@ -49,6 +49,16 @@ enum EDEINTERLACEMODE
 
 #define CLASSNAME "COMXVideo"
 
+//video_splitter has four outputs
+#define MAX_VIDEO_REGIONS 4
+
+//one crop of the decoded frame shown at dst_rect, direct mode only
+struct OMXVideoRegion
+{
+    CRect src_rect;
+    CRect dst_rect;
+};
+
 
 class OMXVideoConfig
 {
@@ -71,6 +81,8 @@ public:
     float fifo_size;
     bool useTexture;
     EGLImageKHR eglImage;
+    std::vector<EGLImageKHR> eglImages; //texture ring, eglImage alone when empty
+    std::vector<OMXVideoRegion> regions; //direct mode, more than one splits the decoder output
     OMX_IMAGEFILTERTYPE filterType;
     bool enableFilters;
     OMXVideoConfig()
@@ -124,6 +136,8 @@ public:
     void SetVideoRect(const CRect& SrcRect, const CRect& DestRect);
     void SetVideoRect(int aspectMode);
     void SetVideoRect();
+    bool SetRegions(const std::vector<OMXVideoRegion>& regions);
+    int GetNumRegions() { return m_num_regions; };
     void SetAlpha(int alpha);
     void SetLayer(int layer);
     int GetInputBufferSize();
@@ -133,10 +147,17 @@ public:
     bool BadState() { return m_omx_decoder.BadState(); };
     
     OMX_BUFFERHEADERTYPE* eglBuffer;
+    std::vector<OMX_BUFFERHEADERTYPE*> eglBuffers;
+    int frontBuffer;    //last completed EGLImage
+    int latchedBuffer;  //EGLImage the GL thread is sampling
+    int deferredBuffer; //completed while latched, goes back to egl_render on the next latch
+    int LatchFrame(int& frameNumber, double& pts);
     
     void onFillBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer);
     OMX_CALLBACKTYPE textureCallbacks;
     int frameCounter;
+    double framePTS;
+    void GetLastFrame(int& frameNumber, double& pts);
 
     void SetOrientation(int degreesClockWise, bool doMirror=false);
     void SetFilter(OMX_IMAGEFILTERTYPE filterType);
@@ -151,6 +172,8 @@ protected:
     COMXCoreComponent m_omx_render;
     COMXCoreComponent m_omx_sched;
     COMXCoreComponent m_omx_image_fx;
+    COMXCoreComponent m_omx_splitter;
+    COMXCoreComponent m_omx_region_render[MAX_VIDEO_REGIONS-1]; //regions after the first, which uses m_omx_render
     COMXCoreComponent *m_omx_clock;
     OMXClock           *m_av_clock;
     
@@ -158,6 +181,8 @@ protected:
     COMXCoreTunel     m_omx_tunnel_clock;
     COMXCoreTunel     m_omx_tunnel_sched;
     COMXCoreTunel     m_omx_tunnel_image_fx;
+    COMXCoreTunel     m_omx_tunnel_splitter[MAX_VIDEO_REGIONS];
+    int               m_num_regions; //0 = no splitter, m_omx_render shows the whole frame
     bool              m_is_open;
     
     bool              m_setStartTime;
@@ -173,8 +198,13 @@ protected:
     OMX_DISPLAYTRANSFORMTYPE m_transform;
     bool              m_settings_changed;
     CCriticalSection  m_critSection;
+    CCriticalSection  m_frameSection; //frameCounter/framePTS, written from the fill buffer callback
     
     bool filtersEnabled;
+    
+    COMXCoreComponent* GetRegionRender(int index);
+    void SetRegionRect(int index);
+    bool SetupRegions();
 };
 
 #endif
@@ -33,21 +33,23 @@ ofRPIVideoPlayer::ofRPIVideoPlayer()
     videoHasEnded = false;
 }
 
-bool ofRPIVideoPlayer::load(string name)
+//what load and loadAsync open name with
+void ofRPIVideoPlayer::applyDefaultSettings(string name)
 {
-    
     settings.videoPath = name;
     settings.useHDMIForAudio = true;	//default true
     settings.enableTexture = true;		//default true
     settings.enableLooping = true;		//default true
     settings.enableAudio = true;		//default true, save resources by disabling
     
-    
     settings.listener = this;
+}
+
+bool ofRPIVideoPlayer::load(string name)
+{
+    applyDefaultSettings(name);
     bool result = openOMXPlayer(settings);
     return result;
-    
-    
 }
 
 bool ofRPIVideoPlayer::openOMXPlayer(ofxOMXPlayerSettings settings_)
@@ -71,7 +73,10 @@ void ofRPIVideoPlayer::disablePixels()
 
 void ofRPIVideoPlayer::loadAsync(string name)
 {
-    load(name);
+    applyDefaultSettings(name);
+    videoHasEnded = false;
+    //openState follows omxPlayer.isOpen() in update()
+    omxPlayer.loadAsync(settings);
 }
 
 void ofRPIVideoPlayer::play()
@@ -157,10 +162,13 @@ bool ofRPIVideoPlayer::getIsMovieDone() const
 
 ofPixels& ofRPIVideoPlayer::getPixels()
 {
-    if(!pixels.isAllocated())
+    //the readback rotates buffers, so follow the front one
+    unsigned char* front = omxPlayer.getPixels();
+    int pixelsWidth = omxPlayer.getPixelsWidth();
+    int pixelsHeight = omxPlayer.getPixelsHeight();
+    if(front && (front != pixels.getData() || pixels.getPixelFormat() != pixelFormat || pixels.getWidth() != pixelsWidth || pixels.getHeight() != pixelsHeight))
     {
-        pixels.allocate(getWidth(), getHeight(), getPixelFormat());
-        pixels.setFromExternalPixels(omxPlayer.getPixels(), getWidth(), getHeight(), 4);
+        pixels.setFromExternalPixels(front, pixelsWidth, pixelsHeight, pixelFormat);
     }
     return pixels;
 }
@@ -183,6 +191,7 @@ void ofRPIVideoPlayer::update()
     if (doPixels && hasNewFrame) 
     {
         omxPlayer.updatePixels();
+        getPixels();
     }
     
 }
@@ -209,9 +218,17 @@ void ofRPIVideoPlayer::close()
     omxPlayer.close();
 }
 
-bool ofRPIVideoPlayer::setPixelFormat(ofPixelFormat pixelFormat)
+bool ofRPIVideoPlayer::setPixelFormat(ofPixelFormat pixelFormat_)
 {
-    return false;
+    if(!ofxOMXPixelConverter::isSupportedFormat(pixelFormat_))
+    {
+        return false;
+    }
+    pixelFormat = pixelFormat_;
+    ofxOMXPixelRequest request = omxPlayer.getPixelRequest();
+    request.format = pixelFormat;
+    omxPlayer.setPixelRequest(request);
+    return true;
 }
 
 ofPixelFormat ofRPIVideoPlayer::getPixelFormat() const
@@ -57,6 +57,7 @@ protected:
     void onVideoLoop(ofxOMXPlayer*);
 
     ofxOMXPlayerSettings settings;
+    void applyDefaultSettings(string name);
     bool openOMXPlayer(ofxOMXPlayerSettings);
 };
 
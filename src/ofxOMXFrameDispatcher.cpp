@@ -0,0 +1,245 @@
+#include "ofxOMXFrameDispatcher.h"
+
+#pragma mark POOL
+
+ofxOMXFramePool::ofxOMXFramePool()
+{
+    numAllocated = 0;
+}
+
+ofxOMXFrameRef ofxOMXFramePool::acquire(int width, int height, ofPixelFormat format)
+{
+    ofxOMXFrame* frame = NULL;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for(size_t i=0; i<freeFrames.size(); i++)
+        {
+            ofPixels& pixels = freeFrames[i]->pixels;
+            if(pixels.getWidth() == width && pixels.getHeight() == height && pixels.getPixelFormat() == format)
+            {
+                frame = freeFrames[i];
+                freeFrames.erase(freeFrames.begin()+i);
+                break;
+            }
+        }
+        if(!frame && !freeFrames.empty())
+        {
+            //wrong size, reallocate the oldest one rather than growing
+            frame = freeFrames.front();
+            freeFrames.erase(freeFrames.begin());
+        }
+        if(!frame)
+        {
+            numAllocated++;
+        }
+    }
+    if(!frame)
+    {
+        frame = new ofxOMXFrame();
+    }
+    if(frame->pixels.getWidth() != width || frame->pixels.getHeight() != height || frame->pixels.getPixelFormat() != format)
+    {
+        frame->pixels.allocate(width, height, format);
+    }
+    frame->frameNumber = 0;
+    frame->pts = 0;
+    frame->readyTime = 0;
+
+    Recycler recycler;
+    recycler.pool = shared_from_this();
+    return ofxOMXFrameRef(frame, recycler);
+}
+
+void ofxOMXFramePool::Recycler::operator()(ofxOMXFrame* frame)
+{
+    shared_ptr<ofxOMXFramePool> owner = pool.lock();
+    if(owner)
+    {
+        owner->recycle(frame);
+    }else
+    {
+        delete frame;
+    }
+}
+
+void ofxOMXFramePool::recycle(ofxOMXFrame* frame)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    freeFrames.push_back(frame);
+}
+
+int ofxOMXFramePool::getNumAllocated()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return numAllocated;
+}
+
+int ofxOMXFramePool::getNumFree()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return freeFrames.size();
+}
+
+void ofxOMXFramePool::clear()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    for(size_t i=0; i<freeFrames.size(); i++)
+    {
+        delete freeFrames[i];
+    }
+    numAllocated -= freeFrames.size();
+    freeFrames.clear();
+}
+
+#pragma mark SUBSCRIPTION
+
+ofxOMXFrameSubscription::ofxOMXFrameSubscription(ofxOMXFrameSubscriber* subscriber_, int queueDepth_)
+{
+    subscriber = subscriber_;
+    queueDepth = max(1, queueDepth_);
+    doStop = false;
+}
+
+void ofxOMXFrameSubscription::push(ofxOMXFrameRef frame)
+{
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        while((int)queue.size() >= queueDepth)
+        {
+            queue.pop_front();
+            stats.numDropped++;
+        }
+        queue.push_back(frame);
+        stats.numQueued = queue.size();
+    }
+    queueCondition.notify_one();
+}
+
+void ofxOMXFrameSubscription::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        doStop = true;
+        queue.clear();
+        stats.numQueued = 0;
+    }
+    queueCondition.notify_one();
+    waitForThread(true);
+}
+
+ofxOMXFrameSubscriberStats ofxOMXFrameSubscription::getStats()
+{
+    std::lock_guard<std::mutex> guard(queueMutex);
+    return stats;
+}
+
+void ofxOMXFrameSubscription::threadedFunction()
+{
+    while(isThreadRunning())
+    {
+        ofxOMXFrameRef frame;
+        {
+            std::unique_lock<std::mutex> guard(queueMutex);
+            while(queue.empty() && !doStop)
+            {
+                queueCondition.wait(guard);
+            }
+            if(doStop)
+            {
+                break;
+            }
+            frame = queue.front();
+            queue.pop_front();
+            stats.numQueued = queue.size();
+            stats.numDelivered++;
+            float latency = (ofGetElapsedTimeMicros()-frame->readyTime)/1000.0f;
+            stats.averageLatencyMillis += (latency-stats.averageLatencyMillis)/stats.numDelivered;
+        }
+        subscriber->onFrame(frame);
+    }
+}
+
+#pragma mark DISPATCHER
+
+ofxOMXFrameDispatcher::ofxOMXFrameDispatcher()
+{
+    pool = shared_ptr<ofxOMXFramePool>(new ofxOMXFramePool());
+}
+
+ofxOMXFrameDispatcher::~ofxOMXFrameDispatcher()
+{
+    clear();
+}
+
+void ofxOMXFrameDispatcher::subscribe(ofxOMXFrameSubscriber* subscriber, int queueDepth)
+{
+    if(!subscriber) return;
+    unsubscribe(subscriber);
+    ofxOMXFrameSubscription* subscription = new ofxOMXFrameSubscription(subscriber, queueDepth);
+    subscriptions.push_back(subscription);
+    subscription->startThread();
+}
+
+//blocks until the subscriber's current onFrame returns
+void ofxOMXFrameDispatcher::unsubscribe(ofxOMXFrameSubscriber* subscriber)
+{
+    for(size_t i=0; i<subscriptions.size(); i++)
+    {
+        if(subscriptions[i]->subscriber == subscriber)
+        {
+            subscriptions[i]->stop();
+            delete subscriptions[i];
+            subscriptions.erase(subscriptions.begin()+i);
+            return;
+        }
+    }
+}
+
+void ofxOMXFrameDispatcher::clear()
+{
+    for(size_t i=0; i<subscriptions.size(); i++)
+    {
+        subscriptions[i]->stop();
+        delete subscriptions[i];
+    }
+    subscriptions.clear();
+    pool->clear();
+}
+
+bool ofxOMXFrameDispatcher::hasSubscribers()
+{
+    return !subscriptions.empty();
+}
+
+void ofxOMXFrameDispatcher::dispatch(unsigned char* pixels, int width, int height, ofPixelFormat format, int frameNumber, double pts)
+{
+    if(!pixels || subscriptions.empty()) return;
+
+    ofxOMXFrameRef frame = pool->acquire(width, height, format);
+    memcpy(frame->pixels.getData(), pixels, frame->pixels.getTotalBytes());
+    frame->frameNumber = frameNumber;
+    frame->pts = pts;
+    frame->readyTime = ofGetElapsedTimeMicros();
+
+    for(size_t i=0; i<subscriptions.size(); i++)
+    {
+        subscriptions[i]->push(frame);
+    }
+}
+
+ofxOMXFrameSubscriberStats ofxOMXFrameDispatcher::getStats(ofxOMXFrameSubscriber* subscriber)
+{
+    for(size_t i=0; i<subscriptions.size(); i++)
+    {
+        if(subscriptions[i]->subscriber == subscriber)
+        {
+            return subscriptions[i]->getStats();
+        }
+    }
+    return ofxOMXFrameSubscriberStats();
+}
+
+shared_ptr<ofxOMXFramePool> ofxOMXFrameDispatcher::getPool()
+{
+    return pool;
+}
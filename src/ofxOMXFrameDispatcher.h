@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+
+/*
+ Delivers decoded frames to worker threads.
+
+ Each subscriber gets its own thread and a bounded queue. The GL thread
+ copies a new frame once into a pooled ofxOMXFrame and pushes the same
+ reference to every queue; when a queue is full the oldest frame is
+ dropped, so a slow subscriber never holds up decoding or the others.
+ Frames go back to the pool when the last reference is released.
+ */
+
+struct ofxOMXFrame
+{
+    ofPixels pixels;
+    int frameNumber;    //decoded frame sequence, see ofxOMXPlayer::getDecodedFrameNumber
+    double pts;         //seconds
+    uint64_t readyTime; //ofGetElapsedTimeMicros when it was queued
+};
+
+typedef shared_ptr<ofxOMXFrame> ofxOMXFrameRef;
+
+class ofxOMXFramePool : public enable_shared_from_this<ofxOMXFramePool>
+{
+public:
+    ofxOMXFramePool();
+
+    //any thread - reuses a returned buffer of the same size and format when there is one
+    ofxOMXFrameRef acquire(int width, int height, ofPixelFormat format);
+
+    int getNumAllocated();
+    int getNumFree();
+    void clear();
+
+private:
+    void recycle(ofxOMXFrame* frame);
+
+    struct Recycler
+    {
+        weak_ptr<ofxOMXFramePool> pool;
+        void operator()(ofxOMXFrame* frame);
+    };
+
+    std::mutex mutex;
+    vector<ofxOMXFrame*> freeFrames;
+    int numAllocated;
+};
+
+class ofxOMXFrameSubscriber
+{
+public:
+    virtual ~ofxOMXFrameSubscriber(){};
+    //called on the subscription's own thread
+    virtual void onFrame(ofxOMXFrameRef frame) = 0;
+};
+
+struct ofxOMXFrameSubscriberStats
+{
+    ofxOMXFrameSubscriberStats()
+    {
+        numDelivered = 0;
+        numDropped = 0;
+        numQueued = 0;
+        averageLatencyMillis = 0;
+    }
+    int numDelivered;
+    int numDropped;             //pushed out of a full queue
+    int numQueued;
+    float averageLatencyMillis; //queued until onFrame started
+};
+
+class ofxOMXFrameSubscription : public ofThread
+{
+public:
+    ofxOMXFrameSubscription(ofxOMXFrameSubscriber* subscriber_, int queueDepth_);
+
+    void push(ofxOMXFrameRef frame);
+    void stop();
+    ofxOMXFrameSubscriberStats getStats();
+    void threadedFunction();
+
+    ofxOMXFrameSubscriber* subscriber;
+
+private:
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    deque<ofxOMXFrameRef> queue;
+    int queueDepth;
+    bool doStop;
+    ofxOMXFrameSubscriberStats stats;
+};
+
+class ofxOMXFrameDispatcher
+{
+public:
+    ofxOMXFrameDispatcher();
+    ~ofxOMXFrameDispatcher();
+
+    //GL thread
+    void subscribe(ofxOMXFrameSubscriber* subscriber, int queueDepth = 2);
+    void unsubscribe(ofxOMXFrameSubscriber* subscriber);
+    void clear();
+    bool hasSubscribers();
+
+    //copies pixels once into a pooled frame and queues it for every subscriber
+    void dispatch(unsigned char* pixels, int width, int height, ofPixelFormat format, int frameNumber, double pts);
+
+    ofxOMXFrameSubscriberStats getStats(ofxOMXFrameSubscriber* subscriber);
+    shared_ptr<ofxOMXFramePool> getPool();
+
+private:
+    vector<ofxOMXFrameSubscription*> subscriptions;
+    shared_ptr<ofxOMXFramePool> pool;
+};
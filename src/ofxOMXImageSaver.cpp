@@ -0,0 +1,168 @@
+#include "ofxOMXImageSaver.h"
+#include "ofxOMXPixelConverter.h"
+
+ofxOMXImageSaver::ofxOMXImageSaver()
+{
+    listener = NULL;
+    maxQueued = 4;
+    doStop = false;
+    pool = shared_ptr<ofxOMXFramePool>(new ofxOMXFramePool());
+}
+
+ofxOMXImageSaver::~ofxOMXImageSaver()
+{
+    close();
+}
+
+void ofxOMXImageSaver::setup(ofxOMXImageSaverListener* listener_, int maxQueued_)
+{
+    listener = listener_;
+    maxQueued = max(1, maxQueued_);
+    if(!isThreadRunning())
+    {
+        startThread();
+    }
+}
+
+void ofxOMXImageSaver::close()
+{
+    if(!isThreadRunning()) return;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        doStop = true;
+    }
+    queueCondition.notify_one();
+    waitForThread(true);
+    doStop = false;
+}
+
+bool ofxOMXImageSaver::save(unsigned char* pixels, int width, int height, ofPixelFormat format, string path,
+                            int frameNumber, double pts, ofImageQualityType quality)
+{
+    if(!pixels || !isThreadRunning()) return false;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        if((int)queue.size() >= maxQueued)
+        {
+            stats.numRejected++;
+            ofLogWarning(__func__) << "queue full, skipping " << path;
+            return false;
+        }
+    }
+
+    Request request;
+    request.frame = pool->acquire(width, height, format);
+    memcpy(request.frame->pixels.getData(), pixels, request.frame->pixels.getTotalBytes());
+    request.frame->frameNumber = frameNumber;
+    request.frame->pts = pts;
+    request.quality = quality;
+    request.queueTime = ofGetElapsedTimeMicros();
+    request.result.path = path;
+    request.result.frameNumber = frameNumber;
+    request.result.pts = pts;
+    request.result.requestTime = ofGetTimestampString();
+    request.result.success = false;
+    request.result.waitMillis = 0;
+    request.result.encodeMillis = 0;
+
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        queue.push_back(request);
+    }
+    queueCondition.notify_one();
+    return true;
+}
+
+void ofxOMXImageSaver::update()
+{
+    vector<ofxOMXSavedImage> ready;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        ready.swap(finished);
+    }
+    for(size_t i=0; i<ready.size(); i++)
+    {
+        if(ready[i].success)
+        {
+            ofLogVerbose(__func__) << "SAVED IMAGE TO: " << ready[i].path << " in " << ready[i].encodeMillis << "ms";
+        }
+        if(listener)
+        {
+            listener->onImageSaved(ready[i]);
+        }
+    }
+}
+
+int ofxOMXImageSaver::getNumQueued()
+{
+    std::lock_guard<std::mutex> guard(queueMutex);
+    return queue.size();
+}
+
+ofxOMXImageSaverStats ofxOMXImageSaver::getStats()
+{
+    std::lock_guard<std::mutex> guard(queueMutex);
+    return stats;
+}
+
+#pragma mark THREAD
+
+bool ofxOMXImageSaver::encode(Request& request)
+{
+    ofPixels& pixels = request.frame->pixels;
+    string extension = ofToLower(ofFilePath::getFileExt(request.result.path));
+    if((extension == "jpg" || extension == "jpeg") && pixels.getPixelFormat() == OF_PIXELS_RGBA)
+    {
+        if(rgbPixels.getWidth() != pixels.getWidth() || rgbPixels.getHeight() != pixels.getHeight())
+        {
+            rgbPixels.allocate(pixels.getWidth(), pixels.getHeight(), OF_PIXELS_RGB);
+        }
+        ofxOMXPixelConverter::convertRGBAToRGB(pixels.getData(), rgbPixels.getData(), pixels.getWidth()*pixels.getHeight());
+        return ofSaveImage(rgbPixels, request.result.path, request.quality);
+    }
+    return ofSaveImage(pixels, request.result.path, request.quality);
+}
+
+//runs until close() rather than isThreadRunning() so the queue is always drained
+void ofxOMXImageSaver::threadedFunction()
+{
+    for(;;)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> guard(queueMutex);
+            while(queue.empty() && !doStop)
+            {
+                queueCondition.wait(guard);
+            }
+            if(queue.empty())
+            {
+                break;
+            }
+            request = queue.front();
+            queue.pop_front();
+        }
+
+        uint64_t startTime = ofGetElapsedTimeMicros();
+        request.result.waitMillis = (startTime-request.queueTime)/1000.0f;
+        request.result.success = encode(request);
+        request.result.encodeMillis = (ofGetElapsedTimeMicros()-startTime)/1000.0f;
+        if(!request.result.success)
+        {
+            ofLogError(__func__) << "could not save " << request.result.path;
+        }
+        //back to the pool before the result is visible
+        request.frame.reset();
+
+        std::lock_guard<std::mutex> guard(queueMutex);
+        if(request.result.success)
+        {
+            stats.numSaved++;
+            stats.averageEncodeMillis += (request.result.encodeMillis-stats.averageEncodeMillis)/stats.numSaved;
+        }else
+        {
+            stats.numFailed++;
+        }
+        finished.push_back(request.result);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ofxOMXFrameDispatcher.h"
+
+/*
+ Encodes and writes snapshots on a worker thread.
+
+ save() copies the frame once into a pooled buffer on the calling (GL)
+ thread and queues it. The worker encodes PNG/JPEG by the path's extension,
+ and update() hands the results to the listener back on the GL thread.
+ The queue is bounded: when maxQueued requests are waiting, new ones are
+ rejected rather than letting memory grow behind a slow SD card.
+ */
+
+struct ofxOMXSavedImage
+{
+    string path;
+    int frameNumber;        //see ofxOMXPlayer::getPixelsFrameNumber
+    double pts;             //seconds
+    string requestTime;     //ofGetTimestampString when save() was called
+    bool success;
+    float waitMillis;       //queued until the worker picked it up
+    float encodeMillis;
+};
+
+class ofxOMXImageSaverListener
+{
+public:
+    virtual ~ofxOMXImageSaverListener(){};
+    //GL thread, from ofxOMXImageSaver::update
+    virtual void onImageSaved(ofxOMXSavedImage& image) = 0;
+};
+
+struct ofxOMXImageSaverStats
+{
+    ofxOMXImageSaverStats()
+    {
+        numSaved = 0;
+        numFailed = 0;
+        numRejected = 0;
+        averageEncodeMillis = 0;
+    }
+    int numSaved;
+    int numFailed;
+    int numRejected;        //queue was full
+    float averageEncodeMillis;
+};
+
+class ofxOMXImageSaver : public ofThread
+{
+public:
+    ofxOMXImageSaver();
+    ~ofxOMXImageSaver();
+
+    //starts the worker
+    void setup(ofxOMXImageSaverListener* listener_, int maxQueued_ = 4);
+    //finishes what is already queued, then stops the worker
+    void close();
+
+    //GL thread, false when the queue is full or setup() was not called
+    bool save(unsigned char* pixels, int width, int height, ofPixelFormat format, string path,
+              int frameNumber, double pts, ofImageQualityType quality = OF_IMAGE_QUALITY_BEST);
+    //GL thread, delivers finished saves to the listener
+    void update();
+
+    int getNumQueued();
+    ofxOMXImageSaverStats getStats();
+
+    void threadedFunction();
+
+private:
+    struct Request
+    {
+        ofxOMXFrameRef frame;
+        ofxOMXSavedImage result;
+        ofImageQualityType quality;
+        uint64_t queueTime;
+    };
+    bool encode(Request& request);
+
+    ofxOMXImageSaverListener* listener;
+    int maxQueued;
+    shared_ptr<ofxOMXFramePool> pool;
+    ofPixels rgbPixels;     //worker only, JPEG has no alpha
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    deque<Request> queue;
+    vector<ofxOMXSavedImage> finished;
+    bool doStop;
+    ofxOMXImageSaverStats stats;
+};
@@ -0,0 +1,236 @@
+#include "ofxOMXPixelConverter.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OMX_CONVERT_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OMX_CONVERT_SSE2 1
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#endif
+
+#define STRINGIFY(x) #x
+
+static const char* packVertexShader = STRINGIFY(
+attribute vec4 position;
+uniform mat4 modelViewProjectionMatrix;
+void main()
+{
+    gl_Position = modelViewProjectionMatrix * position;
+}
+);
+
+//every output texel holds 4 bytes of the converted row, gl_FragCoord picks
+//which ones so the texture coordinates OF passes in are not needed. luma()
+//is the CPU kernels' (77R + 150G + 29B) >> 8 on the 8 bit values, so gray
+//comes out the same whichever path made it
+static const char* packFragmentShader = STRINGIFY(
+precision highp float;
+uniform sampler2D src_tex_unit0;
+uniform vec2 srcSize;
+uniform float isRGB;
+
+const vec3 lumaWeights = vec3(77.0, 150.0, 29.0);
+
+vec4 fetch(float x, float y)
+{
+    return texture2D(src_tex_unit0, vec2((x+0.5)/srcSize.x, y/srcSize.y));
+}
+
+float luma(vec4 color)
+{
+    vec3 bytes = floor(color.rgb*255.0 + 0.5);
+    return floor(dot(bytes, lumaWeights)/256.0)/255.0;
+}
+
+float rgbByte(float byteIndex, float y)
+{
+    float x = floor((byteIndex+0.5)/3.0);
+    float channel = byteIndex - x*3.0;
+    vec4 color = fetch(x, y);
+    if(channel < 0.5) return color.r;
+    if(channel < 1.5) return color.g;
+    return color.b;
+}
+
+void main()
+{
+    float outX = floor(gl_FragCoord.x);
+    float y = gl_FragCoord.y;
+    if(isRGB > 0.5)
+    {
+        float byteIndex = outX*4.0;
+        gl_FragColor = vec4(rgbByte(byteIndex, y),
+                            rgbByte(byteIndex+1.0, y),
+                            rgbByte(byteIndex+2.0, y),
+                            rgbByte(byteIndex+3.0, y));
+    }
+    else
+    {
+        float x = outX*4.0;
+        gl_FragColor = vec4(luma(fetch(x, y)),
+                            luma(fetch(x+1.0, y)),
+                            luma(fetch(x+2.0, y)),
+                            luma(fetch(x+3.0, y)));
+    }
+}
+);
+
+ofxOMXPixelConverter::ofxOMXPixelConverter()
+{
+    didSetup = false;
+}
+
+bool ofxOMXPixelConverter::setup()
+{
+    if(didSetup)
+    {
+        return isShaderLoaded();
+    }
+    didSetup = true;
+    shader.setupShaderFromSource(GL_VERTEX_SHADER, packVertexShader);
+    shader.setupShaderFromSource(GL_FRAGMENT_SHADER, packFragmentShader);
+    shader.bindDefaults();
+    shader.linkProgram();
+    if(!isShaderLoaded())
+    {
+        ofLogError(__func__) << "packing shader failed, converting on the CPU";
+    }
+    return isShaderLoaded();
+}
+
+bool ofxOMXPixelConverter::isShaderLoaded()
+{
+    return shader.isLoaded();
+}
+
+bool ofxOMXPixelConverter::isSupportedFormat(ofPixelFormat format)
+{
+    return format == OF_PIXELS_RGBA || format == OF_PIXELS_RGB || format == OF_PIXELS_GRAY;
+}
+
+int ofxOMXPixelConverter::getNumChannels(ofPixelFormat format)
+{
+    switch(format)
+    {
+        case OF_PIXELS_GRAY:    return 1;
+        case OF_PIXELS_RGB:     return 3;
+        default:                return 4;
+    }
+}
+
+int ofxOMXPixelConverter::getPackedWidth(int width, ofPixelFormat format)
+{
+    return width*getNumChannels(format)/4;
+}
+
+void ofxOMXPixelConverter::pack(ofTexture& source, ofFbo& target, int width, int height, ofPixelFormat format)
+{
+    //the alpha channel carries data, so nothing may blend it
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    target.begin();
+    shader.begin();
+    shader.setUniformTexture("src_tex_unit0", source, 1);
+    shader.setUniform2f("srcSize", width, height);
+    shader.setUniform1f("isRGB", format == OF_PIXELS_RGB ? 1.0f : 0.0f);
+    ofDrawRectangle(0, 0, target.getWidth(), target.getHeight());
+    shader.end();
+    target.end();
+    ofPopStyle();
+}
+
+#pragma mark CPU
+
+void ofxOMXPixelConverter::convert(const unsigned char* rgba, unsigned char* dst, int numPixels, ofPixelFormat format)
+{
+    switch(format)
+    {
+        case OF_PIXELS_GRAY:
+            convertRGBAToGray(rgba, dst, numPixels);
+            break;
+        case OF_PIXELS_RGB:
+            convertRGBAToRGB(rgba, dst, numPixels);
+            break;
+        default:
+            memcpy(dst, rgba, numPixels*4);
+            break;
+    }
+}
+
+void ofxOMXPixelConverter::convertRGBAToGray(const unsigned char* rgba, unsigned char* gray, int numPixels)
+{
+    int i = 0;
+#if defined(OMX_CONVERT_NEON)
+    uint8x8_t wr = vdup_n_u8(77);
+    uint8x8_t wg = vdup_n_u8(150);
+    uint8x8_t wb = vdup_n_u8(29);
+    for(; i+16<=numPixels; i+=16)
+    {
+        uint8x16x4_t px = vld4q_u8(rgba+i*4);
+        uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), wr);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[1]), wg);
+        lo = vmlal_u8(lo, vget_low_u8(px.val[2]), wb);
+        uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), wr);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[1]), wg);
+        hi = vmlal_u8(hi, vget_high_u8(px.val[2]), wb);
+        vst1q_u8(gray+i, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+#elif defined(OMX_CONVERT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    for(; i+4<=numPixels; i+=4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)(rgba+i*4));
+        //r*77+g*150 and b*29 per pixel, then fold the pairs
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+        lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+        hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+        lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0));
+        hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0));
+        __m128i sum = _mm_srli_epi32(_mm_unpacklo_epi64(lo, hi), 8);
+        sum = _mm_packs_epi32(sum, zero);
+        sum = _mm_packus_epi16(sum, zero);
+        int packed = _mm_cvtsi128_si32(sum);
+        memcpy(gray+i, &packed, 4);
+    }
+#endif
+    for(; i<numPixels; i++)
+    {
+        const unsigned char* px = rgba+i*4;
+        gray[i] = (px[0]*77 + px[1]*150 + px[2]*29) >> 8;
+    }
+}
+
+void ofxOMXPixelConverter::convertRGBAToRGB(const unsigned char* rgba, unsigned char* rgb, int numPixels)
+{
+    int i = 0;
+#if defined(OMX_CONVERT_NEON)
+    for(; i+16<=numPixels; i+=16)
+    {
+        uint8x16x4_t px = vld4q_u8(rgba+i*4);
+        uint8x16x3_t out;
+        out.val[0] = px.val[0];
+        out.val[1] = px.val[1];
+        out.val[2] = px.val[2];
+        vst3q_u8(rgb+i*3, out);
+    }
+#elif defined(OMX_CONVERT_SSE2) && defined(__SSSE3__)
+    const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    //each store writes 16 bytes for 12 valid ones, stay 4 pixels clear of the end
+    for(; i+8<=numPixels; i+=4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)(rgba+i*4));
+        _mm_storeu_si128((__m128i*)(rgb+i*3), _mm_shuffle_epi8(px, dropAlpha));
+    }
+#endif
+    for(; i<numPixels; i++)
+    {
+        rgb[i*3]   = rgba[i*4];
+        rgb[i*3+1] = rgba[i*4+1];
+        rgb[i*3+2] = rgba[i*4+2];
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+
+/*
+ Converts RGBA frames to OF_PIXELS_GRAY or tightly packed OF_PIXELS_RGB.
+
+ GLES 2 can only glReadPixels GL_RGBA/GL_UNSIGNED_BYTE, so pack() runs a
+ shader that writes the converted bytes four at a time into the RGBA
+ channels of a narrower fbo: gray needs width/4 texels per row, RGB
+ width*3/4. Reading that fbo back gives the converted pixels directly and
+ moves 4x (gray) or 1.33x (RGB) fewer bytes. Widths must be a multiple of 4.
+
+ The CPU kernels are used when the shader can't be built and by the format
+ benchmark. Luma is BT.601, (77R + 150G + 29B) >> 8, on both paths.
+ */
+
+class ofxOMXPixelConverter
+{
+public:
+    ofxOMXPixelConverter();
+
+    //GL thread, compiles the packing shader on first use
+    bool setup();
+    bool isShaderLoaded();
+
+    static bool isSupportedFormat(ofPixelFormat format);
+    static int getNumChannels(ofPixelFormat format);
+    static int getPackedWidth(int width, ofPixelFormat format);
+
+    //draws width x height of source converted into target, which must already
+    //be allocated getPackedWidth(width) x height
+    void pack(ofTexture& source, ofFbo& target, int width, int height, ofPixelFormat format);
+
+    static void convert(const unsigned char* rgba, unsigned char* dst, int numPixels, ofPixelFormat format);
+    static void convertRGBAToGray(const unsigned char* rgba, unsigned char* gray, int numPixels);
+    static void convertRGBAToRGB(const unsigned char* rgba, unsigned char* rgb, int numPixels);
+
+private:
+    ofShader shader;
+    bool didSetup;
+};
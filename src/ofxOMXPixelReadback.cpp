@@ -0,0 +1,258 @@
+#include "ofxOMXPixelReadback.h"
+
+ofxOMXPixelReadback::ofxOMXPixelReadback()
+{
+    width = 0;
+    height = 0;
+    dataSize = 0;
+    writeIndex = 0;
+    frontIndex = -1;
+    numIssued = 0;
+    lastReadFrameNumber = -1;
+}
+
+ofxOMXPixelReadback::~ofxOMXPixelReadback()
+{
+    clear();
+}
+
+bool ofxOMXPixelReadback::setup(int width_, int height_, int numBuffers)
+{
+    if(width_ <= 0 || height_ <= 0)
+    {
+        ofLogError(__func__) << "invalid size " << width_ << "x" << height_;
+        return false;
+    }
+    if(numBuffers < 1)
+    {
+        numBuffers = 1;
+    }
+    if(isAllocated() && width == width_ && height == height_ && getNumBuffers() == numBuffers)
+    {
+        return true;
+    }
+
+    clear();
+    width = width_;
+    height = height_;
+    dataSize = width * height * 4;
+
+    for(int i=0; i<numBuffers; i++)
+    {
+        unsigned char* buffer = new unsigned char[dataSize];
+        memset(buffer, 0, dataSize);
+        buffers.push_back(buffer);
+    }
+    pending.assign(numBuffers, false);
+    frameNumbers.assign(numBuffers, -1);
+    timestamps.assign(numBuffers, 0);
+
+#ifdef OMX_READBACK_USE_PBO
+    pixelBuffers.resize(numBuffers, 0);
+    glGenBuffers(numBuffers, &pixelBuffers[0]);
+    for(int i=0; i<numBuffers; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, dataSize, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+
+    ofLogVerbose(__func__) << width << "x" << height << " x" << numBuffers << " usesPixelBuffers: " << usesPixelBuffers();
+    return true;
+}
+
+void ofxOMXPixelReadback::clear()
+{
+#ifdef OMX_READBACK_USE_PBO
+    if(!pixelBuffers.empty())
+    {
+        glDeleteBuffers(pixelBuffers.size(), &pixelBuffers[0]);
+        pixelBuffers.clear();
+    }
+#endif
+    for(size_t i=0; i<buffers.size(); i++)
+    {
+        delete[] buffers[i];
+    }
+    buffers.clear();
+    pending.clear();
+    frameNumbers.clear();
+    timestamps.clear();
+    lastReadFrameNumber = -1;
+    width = 0;
+    height = 0;
+    dataSize = 0;
+    writeIndex = 0;
+    frontIndex = -1;
+    numIssued = 0;
+    stats.clear();
+}
+
+void ofxOMXPixelReadback::reset()
+{
+    //anything still in flight is simply overwritten by later readbacks
+    pending.assign(pending.size(), false);
+    frameNumbers.assign(frameNumbers.size(), -1);
+    timestamps.assign(timestamps.size(), 0);
+    lastReadFrameNumber = -1;
+    writeIndex = 0;
+    frontIndex = -1;
+    numIssued = 0;
+    stats.clear();
+}
+
+bool ofxOMXPixelReadback::isAllocated()
+{
+    return !buffers.empty();
+}
+
+void ofxOMXPixelReadback::readPixels(int frameNumber, double pts)
+{
+    if(!isAllocated()) return;
+
+    uint64_t startMicros = ofGetElapsedTimeMicros();
+    int numBuffers = getNumBuffers();
+    frameNumbers[writeIndex] = frameNumber;
+    timestamps[writeIndex] = pts;
+    lastReadFrameNumber = frameNumber;
+
+#ifdef OMX_READBACK_USE_PBO
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[writeIndex]);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pending[writeIndex] = true;
+    numIssued++;
+
+    //the buffer after writeIndex is the oldest one in flight, its copy has had
+    //numBuffers-1 frames to finish
+    int readIndex = (writeIndex+1) % numBuffers;
+    if(pending[readIndex])
+    {
+        mapBuffer(readIndex);
+    }
+    stats.latencyFrames = numBuffers-1;
+#else
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, buffers[writeIndex]);
+    numIssued++;
+    frontIndex = writeIndex;
+    stats.latencyFrames = 0;
+#endif
+
+    writeIndex = (writeIndex+1) % numBuffers;
+    addTiming(startMicros);
+}
+
+void ofxOMXPixelReadback::mapBuffer(int index)
+{
+#ifdef OMX_READBACK_USE_PBO
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[index]);
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, dataSize, GL_MAP_READ_BIT);
+    if(mapped)
+    {
+        memcpy(buffers[index], mapped, dataSize);
+        frontIndex = index;
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+    pending[index] = false;
+}
+
+void ofxOMXPixelReadback::completePending()
+{
+    if(!hasPending()) return;
+
+    uint64_t startMicros = ofGetElapsedTimeMicros();
+    int numBuffers = getNumBuffers();
+    //writeIndex is the oldest slot, walk forward so the newest lands in front
+    for(int i=0; i<numBuffers; i++)
+    {
+        int index = (writeIndex+i) % numBuffers;
+        if(pending[index])
+        {
+            mapBuffer(index);
+        }
+    }
+    addTiming(startMicros);
+}
+
+bool ofxOMXPixelReadback::hasPending()
+{
+    for(size_t i=0; i<pending.size(); i++)
+    {
+        if(pending[i]) return true;
+    }
+    return false;
+}
+
+void ofxOMXPixelReadback::addTiming(uint64_t startMicros)
+{
+    float millis = (ofGetElapsedTimeMicros()-startMicros)/1000.0f;
+    stats.numReadbacks++;
+    stats.lastMillis = millis;
+    stats.averageMillis += (millis-stats.averageMillis)/stats.numReadbacks;
+    if(millis > stats.maxMillis)
+    {
+        stats.maxMillis = millis;
+    }
+}
+
+unsigned char* ofxOMXPixelReadback::getPixels()
+{
+    if(frontIndex < 0) return NULL;
+    return buffers[frontIndex];
+}
+
+int ofxOMXPixelReadback::getFrameNumber()
+{
+    if(frontIndex < 0) return -1;
+    return frameNumbers[frontIndex];
+}
+
+double ofxOMXPixelReadback::getPTS()
+{
+    if(frontIndex < 0) return 0;
+    return timestamps[frontIndex];
+}
+
+int ofxOMXPixelReadback::getLastReadFrameNumber()
+{
+    return lastReadFrameNumber;
+}
+
+int ofxOMXPixelReadback::getWidth()
+{
+    return width;
+}
+
+int ofxOMXPixelReadback::getHeight()
+{
+    return height;
+}
+
+int ofxOMXPixelReadback::getNumBuffers()
+{
+    return buffers.size();
+}
+
+bool ofxOMXPixelReadback::usesPixelBuffers()
+{
+#ifdef OMX_READBACK_USE_PBO
+    return true;
+#else
+    return false;
+#endif
+}
+
+ofxOMXReadbackStats& ofxOMXPixelReadback::getStats()
+{
+    return stats;
+}
+
+void ofxOMXPixelReadback::resetStats()
+{
+    int latencyFrames = stats.latencyFrames;
+    stats.clear();
+    stats.latencyFrames = latencyFrames;
+}
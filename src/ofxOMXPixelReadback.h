@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ofMain.h"
+
+/*
+ Rotating readback of the bound framebuffer into N RGBA buffers.
+
+ With pixel buffer objects (desktop GL, which includes Mesa's llvmpipe/softpipe,
+ or GLES 3) glReadPixels only queues a copy into a PBO and the buffer read
+ numBuffers-1 frames ago is mapped instead, so the render loop never waits on
+ the GPU. GLES 2 (the Pi's Broadcom driver) has no PBOs - there the read is
+ still synchronous, but it goes into the next buffer in the ring so the frame
+ the app is holding is never overwritten underneath it.
+
+ Each readback is tagged with the decoded frame number and PTS it came from
+ so callers can tell which frame getPixels() actually holds.
+
+ All calls must be made on the GL thread.
+ */
+
+#if !defined(TARGET_OPENGLES) || defined(GL_ES_VERSION_3_0)
+#define OMX_READBACK_USE_PBO 1
+#endif
+
+struct ofxOMXReadbackStats
+{
+    ofxOMXReadbackStats()
+    {
+        clear();
+    }
+    void clear()
+    {
+        numReadbacks = 0;
+        numSkipped = 0;
+        lastMillis = 0;
+        averageMillis = 0;
+        maxMillis = 0;
+        latencyFrames = 0;
+    }
+    int numReadbacks;
+    int numSkipped;         //updatePixels calls with no new decoded frame
+    float lastMillis;       //time the render loop spent in the last readPixels
+    float averageMillis;
+    float maxMillis;
+    int latencyFrames;      //how many readPixels calls behind getPixels() is
+};
+
+class ofxOMXPixelReadback
+{
+public:
+    ofxOMXPixelReadback();
+    ~ofxOMXPixelReadback();
+
+    bool setup(int width, int height, int numBuffers = 2);
+    void clear();
+    void reset(); //forget frames and stats but keep the buffers, no GL calls
+    bool isAllocated();
+
+    //reads width x height from the currently bound framebuffer
+    void readPixels(int frameNumber = 0, double pts = 0);
+
+    //maps every readback still in flight, newest ends up in front
+    void completePending();
+    bool hasPending();
+
+    //most recently completed frame, NULL until the first readback completes
+    unsigned char* getPixels();
+    int getFrameNumber();   //-1 until the first readback completes
+    double getPTS();
+    int getLastReadFrameNumber(); //newest frame issued, may still be in flight
+
+    int getWidth();
+    int getHeight();
+    int getNumBuffers();
+    bool usesPixelBuffers();
+
+    ofxOMXReadbackStats& getStats();
+    void resetStats();
+
+private:
+    void addTiming(uint64_t startMicros);
+    void mapBuffer(int index);
+
+    int width;
+    int height;
+    int dataSize;
+    vector<unsigned char*> buffers;
+    vector<GLuint> pixelBuffers;
+    vector<bool> pending;
+    vector<int> frameNumbers;
+    vector<double> timestamps;
+    int lastReadFrameNumber;
+    int writeIndex;
+    int frontIndex;
+    int numIssued;
+    ofxOMXReadbackStats stats;
+};
@@ -1,4 +1,7 @@
 #include "ofxOMXPlayer.h"
+#include "ofxOMXPlayerReaper.h"
+#include "ofxOMXPlayerEnginePool.h"
+#include "OMXGlobalInit.h"
 
 ofxOMXPlayer::ofxOMXPlayer()
 {
@@ -32,15 +35,35 @@ ofxOMXPlayer::ofxOMXPlayer()
     listener = NULL;
     engineNeedsRestart = false;
     pendingLoopMessage = false;
-    OMX_Init();
-    av_register_all();
-    avformat_network_init();
-    omxCore.Initialize();
+    pendingNextMessage = false;
+    lastDispatchedFrame = -1;
+    snapshotInterval = 0;
+    nextSnapshotTime = 0;
+    COMXGlobalInit::Initialize();
+    engine = ofxOMXPlayerEnginePool::getInstance().checkout();
     ofAddListener(ofEvents().update, this, &ofxOMXPlayer::onUpdate);
     
     
 }
 
+ofxOMXPlayer::~ofxOMXPlayer()
+{
+    ofRemoveListener(ofEvents().update, this, &ofxOMXPlayer::onUpdate);
+    ofxOMXPlayerReaper::getInstance().removeListener(this);
+    frameDispatcher.clear();
+    imageSaver.close();
+    //torn down on the reaper thread and pooled like closeAsync, unless the
+    //app is already past its exit event and the reaper has stopped
+    if(ofxOMXPlayerReaper::getInstance().isThreadRunning())
+    {
+        engine->closeAsync();
+    }else
+    {
+        delete engine;
+    }
+    engine = NULL;
+}
+
 bool ofxOMXPlayer::setup(ofxOMXPlayerSettings settings_)
 {
     
@@ -49,15 +72,19 @@ bool ofxOMXPlayer::setup(ofxOMXPlayerSettings settings_)
     {
         listener = settings.listener;  
     }
-    if(isOpen())
+    if(isOpen() || isLoading())
     {
-        engine.close();
+        closeAsync();
     }
-    bool result = engine.setup(settings);
+    bool result = engine->setup(settings);
     if(result)
     {
-        engine.listener = this; 
-        currentFilterName = findFilterName(engine.m_config_video.filterType);
+        engine->listener = this; 
+        currentFilterName = findFilterName(engine->m_config_video.filterType);
+        if(!nextVideoPath.empty())
+        {
+            engine->queueNext(nextVideoPath);
+        }
     }
     return result;
 }
@@ -65,9 +92,9 @@ bool ofxOMXPlayer::setup(ofxOMXPlayerSettings settings_)
 
 void ofxOMXPlayer::start()
 {
-    if(!engine.isThreadRunning())
+    if(!engine->isThreadRunning())
     {
-        engine.startThread();
+        engine->startThread();
     }
 }
 void ofxOMXPlayer::loadMovie(string videoPath)
@@ -76,6 +103,60 @@ void ofxOMXPlayer::loadMovie(string videoPath)
     engineNeedsRestart = true;
 }
 
+//Plays videoPath when the current file ends. If its streams decode the same
+//way (codec, size, rate, channels) the engine carries on without reopening
+//anything so the audio has no gap, see settings.gaplessCrossfade, otherwise
+//it is opened like loadMovie. onVideoNext is sent either way, takes
+//precedence over looping
+void ofxOMXPlayer::setNextMovie(string videoPath)
+{
+    nextVideoPath = videoPath;
+    engine->queueNext(videoPath);
+}
+
+//Non-blocking version of setup(). Progress comes in through
+//ofxOMXPlayerListener::onVideoLoadStage on the GL thread
+bool ofxOMXPlayer::loadAsync(ofxOMXPlayerSettings settings_)
+{
+    settings = settings_;
+    if(settings.listener)
+    {
+        listener = settings.listener;  
+    }
+    if(isOpen() || isLoading())
+    {
+        closeAsync();
+    }
+    engine->listener = this;
+    if(!nextVideoPath.empty())
+    {
+        engine->queueNext(nextVideoPath);
+    }
+    return engine->loadAsync(settings);
+}
+
+bool ofxOMXPlayer::loadAsync(string videoPath)
+{
+    settings.videoPath = videoPath;
+    return loadAsync(settings);
+}
+
+void ofxOMXPlayer::cancelLoad()
+{
+    if(!isLoading()) return;
+    closeAsync();
+}
+
+bool ofxOMXPlayer::isLoading()
+{
+    return engine->isLoading;
+}
+
+ofxOMXLoadStage ofxOMXPlayer::getLoadStage()
+{
+    return engine->reportedLoadStage;
+}
+
 void ofxOMXPlayer::reopen()
 {
     engineNeedsRestart = true;
@@ -85,52 +166,52 @@ void ofxOMXPlayer::reopen()
 
 int ofxOMXPlayer::getWidth()
 {
-    return engine.videoWidth; 
+    return engine->videoWidth; 
 }
 
 int ofxOMXPlayer::getHeight()
 {
-    return engine.videoHeight; 
+    return engine->videoHeight; 
 }
 
 float ofxOMXPlayer::getFPS()
 {
-    return engine.videoFrameRate;
+    return engine->videoFrameRate;
 }
 
 int ofxOMXPlayer::getTotalNumFrames()
 {
-    return engine.totalNumFrames;
+    return engine->totalNumFrames;
 }
 
 float ofxOMXPlayer::getDurationInSeconds()
 {
-    return engine.duration;
+    return engine->duration;
 }
 
 ofTexture& ofxOMXPlayer::getTextureReference()
 {
-    return engine.fbo.getTextureReference();
+    return engine->fbo.getTextureReference();
 }
 
 GLuint ofxOMXPlayer::getTextureID()
 {
-    return engine.texture.getTextureData().textureID;
+    return engine->texture.getTextureData().textureID;
 }
 
 unsigned char* ofxOMXPlayer::getPixels()
 {
-    return engine.pixels;
+    return engine->pixels;
 }
 
 int ofxOMXPlayer::getClockSpeed()
 {
-    return engine.omxClock.OMXPlaySpeed();
+    return engine->omxClock.OMXPlaySpeed();
 }
 
 bool ofxOMXPlayer::isOpen()
 {
-    return engine.isOpen;
+    return engine->isOpen;
 }
 
 bool ofxOMXPlayer::getIsOpen()
@@ -141,7 +222,7 @@ bool ofxOMXPlayer::getIsOpen()
 bool ofxOMXPlayer::isPlaying()
 {
     bool result = false;
-    if(isOpen() && !isPaused() && engine.isThreadRunning())
+    if(isOpen() && !isPaused() && engine->isThreadRunning())
     {
         result = true;
     }
@@ -150,7 +231,7 @@ bool ofxOMXPlayer::isPlaying()
 
 float ofxOMXPlayer::getPlaybackSpeed()
 {
-    return engine.speeds[engine.currentSpeed];
+    return engine->speeds[engine->currentSpeed];
 }
 
 
@@ -158,7 +239,7 @@ float ofxOMXPlayer::getPlaybackSpeed()
 
 float ofxOMXPlayer::getMediaTime()
 {
-    float t = (float)(engine.omxClock.OMXMediaTime()*1e-6);
+    float t = (float)(engine->getMediaTime()*1e-6);
     return t;
 }
 
@@ -180,12 +261,12 @@ float ofxOMXPlayer::getVolume()
 
 float ofxOMXPlayer::getVolumeDB()
 {
-    return engine.m_Volume;
+    return engine->m_Volume;
 }
 
 bool ofxOMXPlayer::isLoopingEnabled()
 {
-    return engine.m_loop; 
+    return engine->m_loop; 
 }
 
 bool ofxOMXPlayer::isTextureEnabled()
@@ -195,16 +276,16 @@ bool ofxOMXPlayer::isTextureEnabled()
 
 bool ofxOMXPlayer::isFrameNew()
 {
-    return engine.hasNewFrame;
+    return engine->hasNewFrame;
 }
 
 COMXStreamInfo&  ofxOMXPlayer::getVideoStreamInfo()
 {
-    return engine.m_config_video.hints;
+    return engine->m_config_video.hints;
 }
 COMXStreamInfo&  ofxOMXPlayer::getAudioStreamInfo()
 {
-    return engine.m_config_audio.hints;
+    return engine->m_config_audio.hints;
 }
 
 string ofxOMXPlayer::getRandomVideo(string path)
@@ -271,6 +352,16 @@ string ofxOMXPlayer::getInfo()
         info << "LOOPING ENABLED: " << isLoopingEnabled() << endl;
         info << "CURRENT VOLUME: " << getVolume() << endl;
         info << "CURRENT VOLUME NORMALIZED: " << getVolumeNormalized() << endl; 
+        if(engine->m_has_audio)
+        {
+            OMXAudioPipelineStats audioStats = getAudioPipelineStats();
+            info << "AUDIO DECODE MS: " << audioStats.decode_ms << " (MAX " << audioStats.decode_ms_max << ")" << endl;
+            info << "AUDIO QUEUE: " << audioStats.queued_bytes/1024 << "/" << audioStats.queue_limit/1024 << "KB, " << audioStats.queue_ms << "MS" << endl;
+            if(audioStats.transitions)
+            {
+                info << "AUDIO TRANSITIONS: " << audioStats.transitions << ", GAP " << audioStats.transition_gap_ms << "MS, HEADROOM " << audioStats.transition_headroom_ms << "MS" << endl;
+            }
+        }
         info << "FILE: " << settings.videoPath << endl; 
         info << "TEXTURE ENABLED: " << isTextureEnabled() << endl; 
         info << "FILTERS ENABLED: " << settings.enableFilters << endl; 
@@ -305,16 +396,25 @@ void ofxOMXPlayer::onVideoLoop(bool needsRestart)
     engineNeedsRestart = needsRestart;
 }
 
+void ofxOMXPlayer::onVideoNext(bool needsRestart)
+{
+    //onUpdate must never see the restart without the next file
+    pendingNextMessage = true;
+    engineNeedsRestart = needsRestart;
+}
+
 void ofxOMXPlayer::onUpdate(ofEventArgs& eventArgs)
 {
     if(engineNeedsRestart)
     {
         engineNeedsRestart = false;
-        if(isOpen())
+        if(pendingNextMessage)
         {
-            engine.close();
+            settings.videoPath = nextVideoPath;
+            nextVideoPath = "";
         }
         
+        //setup() hands the old engine to the reaper
         setup(settings);
         if(pendingLoopMessage)
         {
@@ -326,22 +426,93 @@ void ofxOMXPlayer::onUpdate(ofEventArgs& eventArgs)
         }
         
     }
+    if(pendingNextMessage)
+    {
+        pendingNextMessage = false;
+        //played on without a restart
+        if(!nextVideoPath.empty())
+        {
+            settings.videoPath = nextVideoPath;
+            nextVideoPath = "";
+        }
+        if(listener)
+        {
+            listener->onVideoNext(this);
+        }
+    }
+    if(frameDispatcher.hasSubscribers())
+    {
+        dispatchFrames();
+    }
+    if(snapshotInterval > 0 && ofGetElapsedTimeMillis() >= nextSnapshotTime && isOpen())
+    {
+        nextSnapshotTime = ofGetElapsedTimeMillis() + snapshotInterval*1000;
+        string fileName = ofGetTimestampString() + "_" + ofToString(getDecodedFrameNumber()) + "." + snapshotExtension;
+        saveImage(ofFilePath::join(snapshotDirectory, fileName));
+    }
+    imageSaver.update();
 }
 
 
 void ofxOMXPlayer::close()
 {
-    engine.close();
+    engine->close();
+}
+
+//Returns immediately - the old engine is torn down in the background and
+//onVideoClosed is sent once its resources have been released
+void ofxOMXPlayer::closeAsync()
+{
+    //same resolution is the common case for playlists, so ask for matching textures
+    ofxOMXPlayerEngine* nextEngine = ofxOMXPlayerEnginePool::getInstance().checkout(engine->videoWidth, engine->videoHeight);
+    
+    //keep any config set directly on the engine (e.g. m_config_audio.device)
+    nextEngine->m_config_audio = engine->m_config_audio;
+    nextEngine->m_config_video = engine->m_config_video;
+    nextEngine->m_config_video.eglImage = NULL;
+    nextEngine->m_config_video.eglImages.clear();
+    
+    engine->closeAsync(this);
+    engine = nextEngine;
+    lastDispatchedFrame = -1;
+}
+
+void ofxOMXPlayer::onLoadStage(ofxOMXPlayerEngine* loadingEngine, ofxOMXLoadStage stage)
+{
+    if(stage == LOAD_STAGE_DECODER_READY)
+    {
+        currentFilterName = findFilterName(engine->m_config_video.filterType);
+    }
+    if(listener)
+    {
+        listener->onVideoLoadStage(this, stage);
+    }
+}
+
+void ofxOMXPlayer::onImageSaved(ofxOMXSavedImage& image)
+{
+    if(listener)
+    {
+        listener->onImageSaved(this, image);
+    }
+}
+
+void ofxOMXPlayer::onEngineClosed(ofxOMXPlayerEngine* closedEngine)
+{
+    if(listener)
+    {
+        listener->onVideoClosed(this);
+    }
 }
 
 void ofxOMXPlayer::enableLooping()
 {
-    engine.m_loop = true;
+    engine->m_loop = true;
 }
 
 void ofxOMXPlayer::disableLooping()
 {
-    engine.m_loop = false; 
+    engine->m_loop = false; 
 }
 
 #pragma mark DRAWING
@@ -351,7 +522,7 @@ void ofxOMXPlayer::draw(float x, float y, float w, float h)
     //ofLog() << "draw: " << ofRectangle(x, y, w, h);
     if(isTextureEnabled())
     {
-        engine.draw(x, y, w, h);
+        engine->draw(x, y, w, h);
     }else
     {
         ofRectangle drawRect(x, y, w, h);
@@ -379,7 +550,7 @@ void ofxOMXPlayer::draw(ofRectangle rectangle)
 void ofxOMXPlayer::drawCropped(float cropX, float cropY, float cropWidth, float cropHeight,
                  float drawX, float drawY, float drawWidth, float drawHeight)
 {
-    engine.drawCropped(cropX, cropY, cropWidth, cropHeight,
+    engine->drawCropped(cropX, cropY, cropWidth, cropHeight,
                        drawX, drawY, drawWidth, drawHeight);
 }
 
@@ -390,9 +561,35 @@ void ofxOMXPlayer::drawCropped(ofRectangle cropRectangle, ofRectangle drawRectan
                 drawRectangle.x, drawRectangle.y, drawRectangle.width, drawRectangle.height);
 }
 
+void ofxOMXPlayer::setRegions(vector<ofxOMXVideoRegion> regions)
+{
+    settings.regions = regions;
+    if(!engine->setRegions(settings.regions))
+    {
+        ofLogNotice(__func__) << "region count changed, takes effect on reopen()";
+    }
+}
+
+void ofxOMXPlayer::addRegion(ofRectangle crop, ofRectangle destination)
+{
+    vector<ofxOMXVideoRegion> regions = settings.regions;
+    regions.push_back(ofxOMXVideoRegion(crop, destination));
+    setRegions(regions);
+}
+
+vector<ofxOMXVideoRegion>& ofxOMXPlayer::getRegions()
+{
+    return settings.regions;
+}
+
+void ofxOMXPlayer::drawRegions()
+{
+    engine->drawRegions();
+}
+
 void ofxOMXPlayer::setAlpha(int alpha)
 {
-    engine.setAlpha(alpha);
+    engine->setAlpha(alpha);
 }
 
 void ofxOMXPlayer::setLayer(int layer)
@@ -402,7 +599,7 @@ void ofxOMXPlayer::setLayer(int layer)
         ofLogError() << "TOO EARLY TO SET LAYER, Use ofxOMXPlayerSettings.layer to pass in";
         return;
     }
-    engine.setLayer(layer);
+    engine->setLayer(layer);
 }
 
 void ofxOMXPlayer::rotateVideo(int degrees, bool doMirror)
@@ -410,39 +607,39 @@ void ofxOMXPlayer::rotateVideo(int degrees, bool doMirror)
     if(isTextureEnabled())return;
     if(degrees<0) return;
     if(degrees>360) return;
-    engine.rotateVideo(degrees, doMirror);
+    engine->rotateVideo(degrees, doMirror);
 }
 
 #pragma mark PLAYBACK CONTROLS
 
 bool ofxOMXPlayer::isPaused()
 {
-    return engine.m_Pause;
+    return engine->m_Pause;
 }
 
 void ofxOMXPlayer::setPaused(bool doPause)
 {
-    engine.m_Pause = doPause;
+    engine->m_Pause = doPause;
 }
 
 void ofxOMXPlayer::togglePause()
 {
-    engine.m_Pause = !engine.m_Pause;
+    engine->m_Pause = !engine->m_Pause;
 }
 
 void ofxOMXPlayer::setNormalSpeed()
 {
-    engine.setNormalSpeed();
+    engine->setNormalSpeed();
 }
 
 void ofxOMXPlayer::increaseSpeed()
 {
-    engine.increaseSpeed();
+    engine->increaseSpeed();
 }
 
 void ofxOMXPlayer::decreaseSpeed()
 {
-    engine.decreaseSpeed();
+    engine->decreaseSpeed();
 }
 
 void ofxOMXPlayer::stepFrameForward()
@@ -452,17 +649,17 @@ void ofxOMXPlayer::stepFrameForward()
 
 void ofxOMXPlayer::stepNumFrames(int step)
 {
-    engine.stepNumFrames(step);
+    engine->stepNumFrames(step);
 }
 
 void ofxOMXPlayer::seekToTimeInSeconds(int timeInSeconds)
 {
-    engine.seekToTimeInSeconds(timeInSeconds);
+    engine->seekToTimeInSeconds(timeInSeconds);
 }
 
 void ofxOMXPlayer::seekToFrame(int frameTarget)
 {
-    engine.seekToFrame(frameTarget);
+    engine->seekToFrame(frameTarget);
 }
 
 
@@ -475,19 +672,19 @@ void ofxOMXPlayer::restartMovie()
 
 void ofxOMXPlayer::increaseVolume()
 {
-    engine.increaseVolume();
+    engine->increaseVolume();
 }
 
 void ofxOMXPlayer::decreaseVolume()
 {
-    engine.decreaseVolume();
+    engine->decreaseVolume();
     
 }
 
 void ofxOMXPlayer::setVolumeNormalized(float volume)
 {
     float value = ofMap(volume, 0.0, 1.0, -6000.0, 6000.0, true);
-    engine.m_Volume = value;
+    engine->m_Volume = value;
 }
 
 void ofxOMXPlayer::setVolume(float volume)
@@ -495,36 +692,203 @@ void ofxOMXPlayer::setVolume(float volume)
     setVolumeNormalized(volume);
 }
 
+void ofxOMXPlayer::setAudioMixGain(float gain)
+{
+    engine->setAudioMixGain(gain);
+}
+
 float ofxOMXPlayer::getVolumeNormalized()
 {
-    float value = ofMap(engine.m_Volume, -6000.0, 6000.0, 0.0, 1.0, true);
+    float value = ofMap(engine->m_Volume, -6000.0, 6000.0, 0.0, 1.0, true);
     return value;
 }
 
+OMXAudioPipelineStats ofxOMXPlayer::getAudioPipelineStats()
+{
+    return engine->getAudioPipelineStats();
+}
+
+bool ofxOMXPlayer::getAudioLevels(OMXAudioTapBlock& block)
+{
+    return engine->getAudioLevels(block);
+}
+
+OMXAudioTap* ofxOMXPlayer::getAudioTap()
+{
+    return engine->m_config_audio.tap;
+}
+
 
 
 #pragma mark PIXELS
 
 void ofxOMXPlayer::updatePixels()
 {
-    engine.updatePixels();
+    engine->updatePixels();
+}
+
+ofxOMXReadbackStats& ofxOMXPlayer::getReadbackStats()
+{
+    return engine->getReadbackStats();
+}
+
+void ofxOMXPlayer::setPixelRequest(ofxOMXPixelRequest request)
+{
+    settings.pixelRequest = request;
+    engine->setPixelRequest(request);
+}
+
+ofxOMXPixelRequest ofxOMXPlayer::getPixelRequest()
+{
+    return engine->pixelRequest;
+}
+
+int ofxOMXPlayer::getPixelsWidth()
+{
+    ofRectangle crop;
+    int width = 0;
+    int height = 0;
+    engine->getPixelRegion(crop, width, height);
+    return width;
+}
+
+int ofxOMXPlayer::getPixelsHeight()
+{
+    ofRectangle crop;
+    int width = 0;
+    int height = 0;
+    engine->getPixelRegion(crop, width, height);
+    return height;
+}
+
+int ofxOMXPlayer::getDecodedFrameNumber()
+{
+    return engine->updateCounter;
+}
+
+float ofxOMXPlayer::getDecodedFramePTS()
+{
+    return (float)(engine->framePTS*1e-6);
+}
+
+int ofxOMXPlayer::getPixelsFrameNumber()
+{
+    return engine->getPixelsFrameNumber();
+}
+
+float ofxOMXPlayer::getPixelsPTS()
+{
+    return (float)(engine->getPixelsPTS()*1e-6);
+}
+
+unsigned char* ofxOMXPlayer::getPixelsAfter(int frameNumber)
+{
+    return engine->getPixelsAfter(frameNumber);
 }
 
 
-void ofxOMXPlayer::saveImage(string imagePath)
+bool ofxOMXPlayer::saveImage(string imagePath, ofImageQualityType quality)
 {
-    if(!isTextureEnabled()) return;
+    if(!isTextureEnabled()) return false;
     if(imagePath == "")
     {
         imagePath = ofToDataPath(ofGetTimestampString()+".png", true);
     }
     updatePixels();
-    //TODO make smarter, re-allocating every time
-    ofImage image;
-    image.setFromPixels(getPixels(), getWidth(), getHeight(), OF_IMAGE_COLOR_ALPHA);
-    image.saveImage(imagePath);
+    if(!getPixels())
+    {
+        ofLogError(__func__) << "NO PIXELS YET";
+        return false;
+    }
+    startImageSaver();
+    return imageSaver.save(getPixels(), getPixelsWidth(), getPixelsHeight(), engine->pixelRequest.format, imagePath,
+                           getPixelsFrameNumber(), getPixelsPTS(), quality);
+}
+
+void ofxOMXPlayer::setSnapshotInterval(float seconds, string directory, string extension)
+{
+    snapshotInterval = max(0.0f, seconds);
+    snapshotDirectory = ofToDataPath(directory, true);
+    snapshotExtension = extension;
+    nextSnapshotTime = ofGetElapsedTimeMillis();
+    if(snapshotInterval > 0 && !directory.empty())
+    {
+        ofDirectory::createDirectory(snapshotDirectory, false, true);
+    }
+    if(snapshotInterval > 0)
+    {
+        startImageSaver();
+    }
+}
+
+//the worker thread is only started once a player saves something
+void ofxOMXPlayer::startImageSaver()
+{
+    if(!imageSaver.isThreadRunning())
+    {
+        imageSaver.setup(this);
+    }
+}
+
+ofxOMXImageSaverStats ofxOMXPlayer::getImageSaverStats()
+{
+    return imageSaver.getStats();
+}
+
+void ofxOMXPlayer::subscribeFrames(ofxOMXFrameSubscriber* subscriber, int queueDepth)
+{
+    frameDispatcher.subscribe(subscriber, queueDepth);
+}
+
+//blocks until the subscriber's current onFrame returns
+void ofxOMXPlayer::unsubscribeFrames(ofxOMXFrameSubscriber* subscriber)
+{
+    frameDispatcher.unsubscribe(subscriber);
+}
+
+ofxOMXFrameSubscriberStats ofxOMXPlayer::getFrameSubscriberStats(ofxOMXFrameSubscriber* subscriber)
+{
+    return frameDispatcher.getStats(subscriber);
+}
+
+//GL thread, once per update while anyone is subscribed
+void ofxOMXPlayer::dispatchFrames()
+{
+    if(!isTextureEnabled() || !isOpen()) return;
     
-    ofLog() << "SAVED IMAGE TO: " << imagePath;
+    engine->updatePixels();
+    int frameNumber = engine->getPixelsFrameNumber();
+    if(frameNumber <= 0 || frameNumber == lastDispatchedFrame || !getPixels())
+    {
+        return;
+    }
+    frameDispatcher.dispatch(getPixels(), getPixelsWidth(), getPixelsHeight(), engine->pixelRequest.format,
+                             frameNumber, getPixelsPTS());
+    lastDispatchedFrame = frameNumber;
+}
+
+void ofxOMXPlayer::startSharedFrameExport(string name, int numSlots, int maxFrameBytes)
+{
+    stopSharedFrameExport();
+    sharedFrameExporter.setup(name, numSlots, maxFrameBytes);
+    //one queued frame is enough, readers always want the newest
+    frameDispatcher.subscribe(&sharedFrameExporter, 1);
+}
+
+void ofxOMXPlayer::stopSharedFrameExport()
+{
+    frameDispatcher.unsubscribe(&sharedFrameExporter);
+    sharedFrameExporter.close();
+}
+
+bool ofxOMXPlayer::isSharedFrameExportEnabled()
+{
+    return sharedFrameExporter.isSetup();
+}
+
+ofxOMXSharedFrameExportStats ofxOMXPlayer::getSharedFrameExportStats()
+{
+    return sharedFrameExporter.getStats();
 }
 
 
@@ -541,7 +905,7 @@ void ofxOMXPlayer::setFilter(OMX_IMAGEFILTERTYPE filterType)
 {
     
     currentFilterName = findFilterName(filterType);
-    engine.setFilter(filterType);
+    engine->setFilter(filterType);
 }
 
 string ofxOMXPlayer::findFilterName(OMX_IMAGEFILTERTYPE filterType)
@@ -1,12 +1,19 @@
 #pragma once
 #include "ofMain.h"
 #include "ofxOMXPlayerEngine.h"
+#include "ofxOMXFrameDispatcher.h"
+#include "ofxOMXSharedFrameExporter.h"
+#include "ofxOMXImageSaver.h"
 class ofxOMXPlayer;
 class ofxOMXPlayerListener
 {
 public:
     virtual void onVideoEnd(ofxOMXPlayer*) = 0;
     virtual void onVideoLoop(ofxOMXPlayer*) = 0;
+    virtual void onVideoNext(ofxOMXPlayer*){};
+    virtual void onVideoClosed(ofxOMXPlayer*){};
+    virtual void onVideoLoadStage(ofxOMXPlayer*, ofxOMXLoadStage){};
+    virtual void onImageSaved(ofxOMXPlayer*, ofxOMXSavedImage&){};
     
 };
 class ImageFilter
@@ -20,28 +27,46 @@ public:
         filterType = filterType_;
     };
 };
-class ofxOMXPlayer : public EngineListener
+class ofxOMXPlayer : public EngineListener, public ofxOMXImageSaverListener
 {
 public:
     
     
-    COMXCore omxCore;
-    ofxOMXPlayerEngine engine;
+    ofxOMXPlayerEngine* engine;
     ofxOMXPlayerSettings settings;
     ofxOMXPlayerListener* listener;
-    bool engineNeedsRestart;
-    bool pendingLoopMessage;
+    //set on the engine thread, handled in onUpdate
+    std::atomic<bool> engineNeedsRestart;
+    std::atomic<bool> pendingLoopMessage;
+    std::atomic<bool> pendingNextMessage;
+    string nextVideoPath;
+    ofxOMXFrameDispatcher frameDispatcher;
+    int lastDispatchedFrame;
+    ofxOMXSharedFrameExporter sharedFrameExporter;
+    ofxOMXImageSaver imageSaver;
+    float snapshotInterval;
+    uint64_t nextSnapshotTime;
+    string snapshotDirectory;
+    string snapshotExtension;
     vector<ImageFilter>imageFilters;
     string currentFilterName;
     
     
 #pragma mark SETUP
     ofxOMXPlayer();
+    ~ofxOMXPlayer();
     bool setup(ofxOMXPlayerSettings settings_);
     void start();
     void loadMovie(string videoPath);
+    void setNextMovie(string videoPath);
+    bool loadAsync(ofxOMXPlayerSettings settings_);
+    bool loadAsync(string videoPath);
+    void cancelLoad();
+    bool isLoading();
+    ofxOMXLoadStage getLoadStage();
     void reopen();
     void close();
+    void closeAsync();
 
 #pragma mark GETTERS
     int getWidth();
@@ -72,6 +97,10 @@ public:
 #pragma mark LISTENERS
     void onVideoEnd();
     void onVideoLoop(bool needsRestart);
+    void onVideoNext(bool needsRestart);
+    void onEngineClosed(ofxOMXPlayerEngine* closedEngine);
+    void onLoadStage(ofxOMXPlayerEngine* loadingEngine, ofxOMXLoadStage stage);
+    void onImageSaved(ofxOMXSavedImage& image);
     void onUpdate(ofEventArgs& eventArgs);
 
 #pragma mark DRAWING
@@ -80,6 +109,11 @@ public:
     void drawCropped(float cropX, float cropY, float cropWidth, float cropHeight,
                      float drawX, float drawY, float drawWidth, float drawHeight);
     void drawCropped(ofRectangle cropRectangle, ofRectangle drawRectangle);
+    //one decode shown as several crops, see ofxOMXPlayerSettings::regions
+    void setRegions(vector<ofxOMXVideoRegion> regions);
+    void addRegion(ofRectangle crop, ofRectangle destination);
+    vector<ofxOMXVideoRegion>& getRegions();
+    void drawRegions();                     //textured only, direct regions are composited by the GPU
     void setAlpha(int alpha);
     void setLayer(int layer);
     void rotateVideo(int degrees, bool doMirror = false);
@@ -107,11 +141,52 @@ public:
     void setVolumeNormalized(float volume);
     void setVolume(float volume);
     float getVolumeNormalized();
+    //settings.sharedAudioOutput only, linear gain into the shared mix on top of the volume
+    void setAudioMixGain(float gain);
+    //decode -> OMX submit queue timings, all zero without an audio stream
+    OMXAudioPipelineStats getAudioPipelineStats();
+    //levels of the decoded audio playing now, needs settings.audioTapSeconds
+    bool getAudioLevels(OMXAudioTapBlock& block);
+    //decoded PCM as interleaved float, NULL without settings.audioTapSeconds
+    OMXAudioTap* getAudioTap();
     
 #pragma mark PIXELS
     
     void updatePixels();
-    void saveImage(string imagePath="");
+    ofxOMXReadbackStats& getReadbackStats();
+    
+    //crop/scale what getPixels() holds, e.g. ofxOMXPixelRequest(320, 180)
+    void setPixelRequest(ofxOMXPixelRequest request);
+    ofxOMXPixelRequest getPixelRequest();
+    int getPixelsWidth();
+    int getPixelsHeight();
+    
+    //decoded frame sequence, counts frames egl_render has filled since open
+    int getDecodedFrameNumber();
+    float getDecodedFramePTS();             //seconds
+    int getPixelsFrameNumber();             //frame getPixels() holds, -1 before the first
+    float getPixelsPTS();                   //seconds
+    unsigned char* getPixelsAfter(int frameNumber); //NULL until a newer frame has been read back
+    //queues the current pixels for encoding on a worker, the result arrives in
+    //ofxOMXPlayerListener::onImageSaved. false if the queue is full
+    bool saveImage(string imagePath="", ofImageQualityType quality=OF_IMAGE_QUALITY_BEST);
+    //saves a snapshot every seconds into directory (0 stops), e.g. for proof-of-play logs
+    void setSnapshotInterval(float seconds, string directory="", string extension="jpg");
+    ofxOMXImageSaverStats getImageSaverStats();
+    void startImageSaver();
+    
+    //frames arrive in the getPixelRequest() format on a thread per subscriber,
+    //a full queue drops its oldest frame
+    void subscribeFrames(ofxOMXFrameSubscriber* subscriber, int queueDepth = 2);
+    void unsubscribeFrames(ofxOMXFrameSubscriber* subscriber);
+    ofxOMXFrameSubscriberStats getFrameSubscriberStats(ofxOMXFrameSubscriber* subscriber);
+    void dispatchFrames();
+    
+    //publish frames to POSIX shared memory for other processes, see ofxOMXSharedFrameRing
+    void startSharedFrameExport(string name = "/ofxomxplayer", int numSlots = 4, int maxFrameBytes = 0);
+    void stopSharedFrameExport();
+    bool isSharedFrameExportEnabled();
+    ofxOMXSharedFrameExportStats getSharedFrameExportStats();
 
 #pragma mark OLD/TODO
     void scrubForward(int step=1);
@@ -1,4 +1,6 @@
 #include "ofxOMXPlayerEngine.h"
+#include "ofxOMXPlayerReaper.h"
+#include "OMXGlobalInit.h"
 
 
 
@@ -66,6 +68,10 @@ bool ofxOMXPlayerEngine::TRICKPLAY(int speed)
 ofxOMXPlayerEngine::ofxOMXPlayerEngine()
 {
     eglImage = NULL;
+    pixels = NULL;
+    numPixelBuffers = 2;
+    numTextures = 3;
+    convertedFrameNumber = -1;
     
     speeds.push_back(createSpeed(0.0625));
     speeds.push_back(createSpeed(0.125));
@@ -94,6 +100,7 @@ void ofxOMXPlayerEngine::clear()
     useTexture = false;
     m_has_video = false;
     m_has_audio = false;
+    m_enable_audio = true;
     //currentPlaybackSpeed = 0.0;
     hasNewFrame = false;
     listener = NULL;
@@ -118,8 +125,8 @@ void ofxOMXPlayerEngine::clear()
     m_Volume = 0;
     startpts = 0;
     updateCounter = 0;
+    framePTS = 0;
     
-    pixels = NULL;
     display = NULL;
     context = NULL;
     appEGLWindow = NULL;
@@ -134,15 +141,28 @@ void ofxOMXPlayerEngine::clear()
     m_incr = 0;
     m_loop_from = m_incr;
     
+    m_next_filename = "";
+    m_restart_next = false;
+    m_pts_offset = 0;
+    m_prev_pts_offset = 0;
+    m_next_start = DVD_NOPTS_VALUE;
+    m_stream_end = DVD_NOPTS_VALUE;
+    
     m_timeout = 1000;
     m_cookie = "";
     m_user_agent = "";
     m_lavfdopts = "";
     currentSpeed = normalSpeedIndex;
     
+    isLoading = false;
+    loadCancelRequested = false;
+    eglImageRequested = false;
+    loadStage = LOAD_STAGE_NONE;
+    reportedLoadStage = LOAD_STAGE_NONE;
+    
 }
 
-bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
+void ofxOMXPlayerEngine::applySettings(ofxOMXPlayerSettings& settings)
 {
     
     if(!settings.directDrawRectangle.isZero())
@@ -162,9 +182,6 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
     useTexture = settings.enableTexture;
     m_loop = settings.enableLooping;
     
-    CLog::SetLogLevel(settings.debugLevel);
-    CLog::Init(settings.logDirectory.c_str(), settings.logToOF);
-    
     if(strchr(settings.loopPoint.c_str(), ':'))
     {
         unsigned int h, m, s;
@@ -182,14 +199,73 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
         m_loop_from = m_incr;
     }
     
-    
-    bool didOpen = true;
     //m_config_video.filterType = OMX_ImageFilterCartoon;
     m_config_video.useTexture = useTexture;
+    m_config_video.enableFilters = settings.enableFilters;
+    numPixelBuffers = settings.numPixelBuffers;
+    pixelRequest = settings.pixelRequest;
+    numTextures = ofClamp(settings.numTextures, 1, 4);
+    setRegions(settings.regions);
+    
+    //openPlayers picks these from settings, drop what the last file used
+    m_config_audio.device = "";
+    m_config_audio.subdevice = "";
+    m_config_audio.alsa_shared = false;
+    m_config_audio.ClearLowLatency();
+}
+
+bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
+{
+    applySettings(settings);
+    
+    bool didOpen = openReader(settings);
+    if(!didOpen)
+    {
+        return didOpen;
+    }
+    
+    if(m_has_video && useTexture)
+    {
+        bool didCreateEGLImage = generateEGLImage();
+        if(!didCreateEGLImage)
+        {
+            didOpen = false;
+            ofLogError() << "generateEGLImage FAILED";
+            
+            return didOpen;
+        }
+        m_config_video.eglImage = eglImage;
+        m_config_video.eglImages = eglImages;
+    }
+    
+    didOpen = openPlayers(settings);
+    if(didOpen && m_has_video && useTexture)
+    {
+        ofAddListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
+    }
+    
+    if(didOpen)
+    {
+        if(settings.autoStart)
+        {
+            startThread(); 
+            
+        }
+    }
+    isOpen = didOpen;
+    return didOpen;
+}
+
+//demuxer open and stream probing - no GL calls, safe off the GL thread
+bool ofxOMXPlayerEngine::openReader(ofxOMXPlayerSettings& settings)
+{
+    CLog::SetLogLevel(settings.debugLevel);
+    CLog::Init(settings.logDirectory.c_str(), settings.logToOF);
+    
     bool m_dump_format = true;
     bool m_config_audio_is_live = false;
     
-    
+    uint64_t openStartTime = ofGetElapsedTimeMillis();
     bool didOpenReader = m_omx_reader.Open(m_filename.c_str(),
                                            m_dump_format,
                                            m_config_audio_is_live,
@@ -198,6 +274,7 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
                                            m_user_agent.c_str(),
                                            m_lavfdopts.c_str());
     ofLog() << "didOpenReader: " << didOpenReader;
+    ofLog() << "reader open took: " << ofGetElapsedTimeMillis()-openStartTime << "ms, one-time ffmpeg/omx init: " << COMXGlobalInit::GetInitTime() << "ms";
     
     
     ofLog() << "VideoStreamCount(): " << m_omx_reader.VideoStreamCount();
@@ -207,31 +284,28 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
     
     if(!didOpenReader)
     {
-        didOpen = false;
         ofLogError() << "READER COULD NOT OPEN " << m_filename;
-        
-        return didOpen;
+        return false;
     }
-    omxClock.OMXInitialize();
-    omxClock.OMXStateIdle();
-    omxClock.OMXStop();
-    omxClock.OMXPause();
     
     m_omx_reader.GetHints(OMXSTREAM_AUDIO, m_config_audio.hints);
     m_omx_reader.GetHints(OMXSTREAM_VIDEO, m_config_video.hints);
     
     
     m_has_video     = m_omx_reader.VideoStreamCount();
+    m_enable_audio  = settings.enableAudio;
     if(settings.enableAudio)
     {
         m_has_audio = m_omx_reader.AudioStreamCount();
         
     }
-    
-    
-    omxClock.OMXReset(m_has_video, m_has_audio);
-    omxClock.OMXStateExecute();
-    
+    updateStreamInfo();
+    return true;
+}
+
+//dimensions, frame count and duration from m_config_video.hints
+void ofxOMXPlayerEngine::updateStreamInfo()
+{
     if(m_has_video)
     {
         videoWidth = m_config_video.hints.width;
@@ -256,21 +330,153 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
         }
         
         duration = m_config_video.hints.nb_frames / videoFrameRate;
-        
-        m_config_video.enableFilters = settings.enableFilters;
-        if(useTexture)
+    }
+}
+
+//true when a decoder opened for a can carry on with b's packets
+static bool isSameStream(COMXStreamInfo& a, COMXStreamInfo& b)
+{
+    if(a.codec != b.codec || a.extrasize != b.extrasize)
+    {
+        return false;
+    }
+    if(a.extrasize && memcmp(a.extradata, b.extradata, a.extrasize))
+    {
+        return false;
+    }
+    return a.width == b.width && a.height == b.height &&
+           a.fpsrate == b.fpsrate && a.fpsscale == b.fpsscale &&
+           a.channels == b.channels && a.samplerate == b.samplerate &&
+           a.bitspersample == b.bitspersample;
+}
+
+void ofxOMXPlayerEngine::queueNext(string path)
+{
+    lock();
+    m_next_filename = path;
+    unlock();
+}
+
+string ofxOMXPlayerEngine::takeNext()
+{
+    lock();
+    string path = m_next_filename;
+    m_next_filename = "";
+    unlock();
+    return path;
+}
+
+//Switches the demuxer to path and leaves the clock and players running when
+//its streams decode the same way as the current ones. Called at the current
+//file's demuxer EOF, while the players still have its tail queued. Packets
+//from here on are rebased to carry on where the fed audio ends, minus the
+//crossfade the audio player will mix over it. False if path has to be
+//opened from scratch.
+bool ofxOMXPlayerEngine::openNext(string path)
+{
+    uint64_t openStartTime = ofGetElapsedTimeMillis();
+    
+    //opened next to the current reader and swapped in, only once it is known
+    //to decode the same way
+    OMXReader next;
+    if(!next.Open(path.c_str(), false, false, m_timeout, m_cookie.c_str(), m_user_agent.c_str(), m_lavfdopts.c_str()))
+    {
+        ofLogError() << "READER COULD NOT OPEN " << path;
+        return false;
+    }
+    //only the streams that are played have to match
+    bool nextHasAudio = m_enable_audio && next.AudioStreamCount() > 0;
+    bool compatible = (next.VideoStreamCount() > 0) == m_has_video && nextHasAudio == m_has_audio;
+    if(compatible && m_has_video)
+    {
+        COMXStreamInfo currentHints, nextHints;
+        m_omx_reader.GetHints(OMXSTREAM_VIDEO, currentHints);
+        next.GetHints(OMXSTREAM_VIDEO, nextHints);
+        compatible = isSameStream(currentHints, nextHints);
+    }
+    if(compatible && m_has_audio)
+    {
+        COMXStreamInfo currentHints, nextHints;
+        m_omx_reader.GetHints(OMXSTREAM_AUDIO, currentHints);
+        next.GetHints(OMXSTREAM_AUDIO, nextHints);
+        compatible = isSameStream(currentHints, nextHints);
+    }
+    if(!compatible)
+    {
+        ofLog() << path << " does not decode like " << m_filename << ", will reopen";
+        return false;
+    }
+    
+    //next closes the played out file when it goes out of scope
+    m_omx_reader.Swap(next);
+    m_filename = path;
+    m_omx_reader.GetHints(OMXSTREAM_AUDIO, m_config_audio.hints);
+    m_omx_reader.GetHints(OMXSTREAM_VIDEO, m_config_video.hints);
+    updateStreamInfo();
+    
+    m_prev_pts_offset = m_pts_offset;
+    if(m_stream_end != DVD_NOPTS_VALUE)
+    {
+        double start = m_omx_reader.GetStartTime(m_has_audio ? OMXSTREAM_AUDIO : OMXSTREAM_VIDEO);
+        double crossfade = m_has_audio ? m_player_audio.GetCrossfade() * DVD_TIME_BASE : 0;
+        m_next_start = m_stream_end - crossfade;
+        m_pts_offset = m_next_start - (start == DVD_NOPTS_VALUE ? 0 : start);
+    }
+    m_stream_end = DVD_NOPTS_VALUE;
+    if(m_has_audio)
+    {
+        m_player_audio.AddTransition();
+    }
+    ofLog() << "gapless switch to " << path << " took: " << ofGetElapsedTimeMillis()-openStartTime << "ms";
+    return true;
+}
+
+void ofxOMXPlayerEngine::rebasePacket(OMXPacket* pkt)
+{
+    if(m_pts_offset != 0)
+    {
+        if(pkt->pts != DVD_NOPTS_VALUE)
         {
-            bool didCreateEGLImage = generateEGLImage();
-            if(!didCreateEGLImage)
-            {
-                didOpen = false;
-                ofLogError() << "generateEGLImage FAILED";
-                
-                return didOpen;
-            }
-            m_config_video.eglImage = eglImage;
-            
-        }else
+            pkt->pts += m_pts_offset;
+        }
+        if(pkt->dts != DVD_NOPTS_VALUE)
+        {
+            pkt->dts += m_pts_offset;
+        }
+    }
+    double start = pkt->pts != DVD_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    bool timeline = m_has_audio ? m_omx_reader.IsActive(OMXSTREAM_AUDIO, pkt->stream_index) : m_omx_reader.IsActive(OMXSTREAM_VIDEO, pkt->stream_index);
+    if(timeline && start != DVD_NOPTS_VALUE && (m_stream_end == DVD_NOPTS_VALUE || start + pkt->duration > m_stream_end))
+    {
+        m_stream_end = start + pkt->duration;
+    }
+}
+
+//clock time within the file being played, the clock itself runs on across
+//gapless switches
+double ofxOMXPlayerEngine::getMediaTime()
+{
+    double t = omxClock.OMXMediaTime();
+    return t - (t < m_next_start ? m_prev_pts_offset : m_pts_offset);
+}
+
+//clock and decoder bring-up - expects m_config_video.eglImage to be ready in texture mode
+bool ofxOMXPlayerEngine::openPlayers(ofxOMXPlayerSettings& settings)
+{
+    bool didOpen = true;
+    uint64_t openStartTime = ofGetElapsedTimeMillis();
+    
+    omxClock.OMXInitialize();
+    omxClock.OMXStateIdle();
+    omxClock.OMXStop();
+    omxClock.OMXPause();
+    
+    omxClock.OMXReset(m_has_video, m_has_audio);
+    omxClock.OMXStateExecute();
+    
+    if(m_has_video)
+    {
+        if(!useTexture)
         {
             
             if(settings.setDisplayResolution)
@@ -311,11 +517,6 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
         
         
         bool didVideoOpen =  m_player_video.Open(&omxClock, m_config_video);
-        if(didVideoOpen && useTexture)
-        {
-            ofAddListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
-            
-        }
         if(!didVideoOpen)
         {
             didOpen = false;
@@ -328,6 +529,16 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
     
     if(m_has_audio)
     {
+        if (!settings.alsaDevice.empty())
+        {
+            m_config_audio.device = "omx:alsa";
+            m_config_audio.subdevice = settings.alsaDevice;
+            if(settings.lowLatencyAudio)
+            {
+                m_config_audio.SetLowLatency();
+            }
+            m_config_audio.alsa_shared = settings.sharedAudioOutput;
+        }
         if (m_config_audio.device == "")
         {
             if(settings.useHDMIForAudio)
@@ -355,6 +566,18 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
         {
             m_config_audio.passthrough = false;
         }
+        m_config_audio.crossfade = settings.gaplessCrossfade;
+        //slots of OMX_AUDIO_TAP_FRAMES, plus the one being written and one of slack
+        m_config_audio.tap = NULL;
+        if(settings.audioTapSeconds > 0)
+        {
+            int rate = m_config_audio.hints.samplerate > 0 ? m_config_audio.hints.samplerate : 48000;
+            unsigned int slots = ceil(settings.audioTapSeconds*rate/OMX_AUDIO_TAP_FRAMES)+2;
+            if(audioTap.IsOpen() || audioTap.Open(slots))
+            {
+                m_config_audio.tap = &audioTap;
+            }
+        }
         bool didAudioOpen = m_player_audio.Open(&omxClock, m_config_audio, &m_omx_reader);
         
         if(!didAudioOpen)
@@ -383,53 +606,317 @@ bool ofxOMXPlayerEngine::setup(ofxOMXPlayerSettings settings)
             m_player_audio.SetVolume(pow(10, m_Volume / 2000.0));
         }
     }
+    ofLog() << "players open took: " << ofGetElapsedTimeMillis()-openStartTime << "ms";
+    return didOpen;
+}
+
+#pragma mark ASYNC LOAD
+
+//Runs openReader/openPlayers on the engine thread. The EGLImage is still
+//created on the GL thread (onUpdate) between the two. Progress is reported
+//to the listener from onUpdate, so callbacks arrive on the GL thread.
+bool ofxOMXPlayerEngine::loadAsync(ofxOMXPlayerSettings settings)
+{
+    if(isThreadRunning())
+    {
+        ofLogError(__func__) << "ENGINE IS BUSY";
+        return false;
+    }
+    applySettings(settings);
     
-    if(didOpen)
+    lock();
+    loadSettings = settings;
+    loadStage = LOAD_STAGE_NONE;
+    reportedLoadStage = LOAD_STAGE_NONE;
+    isLoading = true;
+    unlock();
+    
+    ofAddListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
+    startThread();
+    return true;
+}
+
+void ofxOMXPlayerEngine::cancelLoad()
+{
+    if(!isLoading) return;
+    
+    loadCancelRequested = true;
+    //unblocks avformat_open_input/avformat_find_stream_info via interrupt_cb
+    m_omx_reader.Abort();
+    //and runLoad waiting on the GL thread for the EGLImage
+    std::lock_guard<std::mutex> eglLock(eglImageMutex);
+    eglImageCondition.notify_all();
+}
+
+void ofxOMXPlayerEngine::setLoadStage(ofxOMXLoadStage stage)
+{
+    lock();
+    if(stage > loadStage)
     {
-        if(settings.autoStart)
+        loadStage = stage;
+    }
+    unlock();
+}
+
+bool ofxOMXPlayerEngine::runLoad()
+{
+    if(!openReader(loadSettings))
+    {
+        setLoadStage(loadCancelRequested ? LOAD_STAGE_CANCELLED : LOAD_STAGE_FAILED);
+        return false;
+    }
+    setLoadStage(LOAD_STAGE_PROBED);
+    
+    if(m_has_video && useTexture)
+    {
+        //updateLoadStage makes it on the next update
+        std::unique_lock<std::mutex> eglLock(eglImageMutex);
+        eglImageRequested = true;
+        eglImageCondition.wait(eglLock, [this]{ return !eglImageRequested || loadCancelRequested; });
+        eglLock.unlock();
+        if(loadCancelRequested)
         {
-            startThread(); 
-            
+            setLoadStage(LOAD_STAGE_CANCELLED);
+            return false;
+        }
+        if(eglImage == EGL_NO_IMAGE_KHR)
+        {
+            ofLogError() << "generateEGLImage FAILED";
+            setLoadStage(LOAD_STAGE_FAILED);
+            return false;
+        }
+        m_config_video.eglImage = eglImage;
+        m_config_video.eglImages = eglImages;
+    }
+    
+    if(loadCancelRequested || !isThreadRunning())
+    {
+        setLoadStage(LOAD_STAGE_CANCELLED);
+        return false;
+    }
+    
+    if(!openPlayers(loadSettings))
+    {
+        setLoadStage(LOAD_STAGE_FAILED);
+        return false;
+    }
+    isOpen = true;
+    setLoadStage(LOAD_STAGE_DECODER_READY);
+    return true;
+}
+
+//GL thread
+void ofxOMXPlayerEngine::updateLoadStage()
+{
+    if(eglImageRequested)
+    {
+        if(!generateEGLImage())
+        {
+            destroyEGLImage();
+        }
+        std::lock_guard<std::mutex> eglLock(eglImageMutex);
+        eglImageRequested = false;
+        eglImageCondition.notify_all();
+    }
+    
+    if(loadStage == LOAD_STAGE_NONE && m_omx_reader.IsInputOpen())
+    {
+        setLoadStage(LOAD_STAGE_OPENED);
+    }
+    if(loadStage == LOAD_STAGE_DECODER_READY)
+    {
+        if(m_player_video.getFrameNumber() > 0 || omxClock.OMXMediaTime() > 0)
+        {
+            setLoadStage(LOAD_STAGE_FIRST_FRAME);
+        }
+    }
+    
+    while(reportedLoadStage < loadStage)
+    {
+        if(loadStage >= LOAD_STAGE_FAILED)
+        {
+            reportedLoadStage = loadStage;
+        }else
+        {
+            reportedLoadStage = (ofxOMXLoadStage)(reportedLoadStage+1);
+        }
+        ofLogVerbose(__func__) << m_filename << " " << getLoadStageName(reportedLoadStage);
+        if(listener)
+        {
+            listener->onLoadStage(this, reportedLoadStage);
         }
     }
-    isOpen = didOpen;
-    return didOpen;
+}
+
+string ofxOMXPlayerEngine::getLoadStageName(ofxOMXLoadStage stage)
+{
+    switch (stage) 
+    {
+        case LOAD_STAGE_NONE:           return "NONE";
+        case LOAD_STAGE_OPENED:         return "OPENED";
+        case LOAD_STAGE_PROBED:         return "PROBED";
+        case LOAD_STAGE_DECODER_READY:  return "DECODER_READY";
+        case LOAD_STAGE_FIRST_FRAME:    return "FIRST_FRAME";
+        case LOAD_STAGE_FAILED:         return "FAILED";
+        case LOAD_STAGE_CANCELLED:      return "CANCELLED";
+    }
+    return "UNKNOWN";
 }
 
 
 #pragma mark PIXELS
 
-void ofxOMXPlayerEngine::updatePixels()
-{    
-    lock();
-    
-    if(!texture.isAllocated())
+void ofxOMXPlayerEngine::setPixelRequest(ofxOMXPixelRequest request)
+{
+    if(!ofxOMXPixelConverter::isSupportedFormat(request.format))
     {
-        ofLogError() << "NO TEXTURE";
-        unlock();
-        return;
-        
+        ofLogWarning(__func__) << "only RGBA, RGB and GRAY are supported, using RGBA";
+        request.format = OF_PIXELS_RGBA;
+    }
+    pixelRequest = request;
+    //the next updatePixels reads back even if no new frame was decoded
+    readback.reset();
+    convertedFrameNumber = -1;
+    pixels = NULL;
+}
+
+//Resolves pixelRequest against the current video size
+void ofxOMXPlayerEngine::getPixelRegion(ofRectangle& crop, int& width, int& height)
+{
+    ofRectangle frame(0, 0, videoWidth, videoHeight);
+    crop = pixelRequest.crop.isEmpty() ? frame : pixelRequest.crop.getIntersection(frame);
+    if(crop.isEmpty())
+    {
+        crop = frame;
+    }
+    width = pixelRequest.width;
+    height = pixelRequest.height;
+    if(width <= 0 && height <= 0)
+    {
+        width = crop.width;
+        height = crop.height;
     }
+    else if(width <= 0)
+    {
+        width = ofClamp(roundf(height*crop.width/crop.height), 1, videoWidth);
+    }
+    else if(height <= 0)
+    {
+        height = ofClamp(roundf(width*crop.height/crop.width), 1, videoHeight);
+    }
+    if(pixelRequest.format != OF_PIXELS_RGBA)
+    {
+        //packed formats carry 4 bytes per texel. The crop loses the same
+        //share of its width so a 1:1 request stays a copy, not a stretch
+        int packedWidth = max(4, width - width%4);
+        crop.width = min(crop.width*packedWidth/width, videoWidth-crop.x);
+        width = packedWidth;
+    }
+}
+
+void ofxOMXPlayerEngine::updatePixels()
+{
+    //GL thread only - the fbo already holds the latest frame from onUpdate so
+    //there is nothing to redraw and nothing the demux thread can change under us
     if(!fbo.isAllocated())
     {
         ofLogError() << "NO fbo";
-        unlock();
         return;
-        
     }
-    if(!pixels)
+    ofRectangle crop;
+    int width = 0;
+    int height = 0;
+    getPixelRegion(crop, width, height);
+    
+    ofPixelFormat format = pixelRequest.format;
+    bool doPack = format != OF_PIXELS_RGBA && pixelConverter.setup();
+    int readbackWidth = doPack ? ofxOMXPixelConverter::getPackedWidth(width, format) : width;
+    if(!readback.setup(readbackWidth, height, numPixelBuffers))
     {
         ofLogError() << "NO pixels";
-        unlock();
         return;
     }
-    fbo.begin();
-    ofClear(0, 0, 0, 0);
-    texture.draw(0, 0);
-    //ofLogVerbose() << "updatePixels";
-    glReadPixels(0,0,videoWidth, videoHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    fbo.end();
-    unlock();
+    if(updateCounter == 0 || updateCounter == readback.getLastReadFrameNumber())
+    {
+        //nothing decoded since the last readback, let the copies in flight land instead
+        readback.getStats().numSkipped++;
+        readback.completePending();
+        updateConvertedPixels(width, height, doPack);
+        return;
+    }
+    
+    ofFbo* source = &fbo;
+    bool isWholeFrame = crop.x == 0 && crop.y == 0 && crop.width == videoWidth && crop.height == videoHeight;
+    if(!isWholeFrame || width != videoWidth || height != videoHeight)
+    {
+        //crop and scale on the GPU so only width x height comes back
+        if(readbackFbo.getWidth() != width || readbackFbo.getHeight() != height)
+        {
+            readbackFbo.allocate(width, height, GL_RGBA);
+        }
+        readbackFbo.begin();
+        ofClear(0, 0, 0, 0);
+        fbo.getTextureReference().drawSubsection(0, 0, width, height, crop.x, crop.y, crop.width, crop.height);
+        readbackFbo.end();
+        source = &readbackFbo;
+    }
+    if(doPack)
+    {
+        if(packFbo.getWidth() != readbackWidth || packFbo.getHeight() != height)
+        {
+            packFbo.allocate(readbackWidth, height, GL_RGBA);
+        }
+        pixelConverter.pack(source->getTextureReference(), packFbo, width, height, format);
+        source = &packFbo;
+    }
+    source->bind();
+    readback.readPixels(updateCounter, framePTS);
+    source->unbind();
+    updateConvertedPixels(width, height, doPack);
+}
+
+//Points pixels at the readback front buffer, converting it on the CPU when
+//a packed format was asked for but the shader isn't available
+void ofxOMXPlayerEngine::updateConvertedPixels(int width, int height, bool didPack)
+{
+    pixels = readback.getPixels();
+    if(!pixels || didPack || pixelRequest.format == OF_PIXELS_RGBA)
+    {
+        return;
+    }
+    if(convertedFrameNumber == readback.getFrameNumber() && !convertedPixels.empty())
+    {
+        pixels = &convertedPixels[0];
+        return;
+    }
+    convertedPixels.resize(width*height*ofxOMXPixelConverter::getNumChannels(pixelRequest.format));
+    ofxOMXPixelConverter::convert(pixels, &convertedPixels[0], width*height, pixelRequest.format);
+    convertedFrameNumber = readback.getFrameNumber();
+    pixels = &convertedPixels[0];
+}
+
+int ofxOMXPlayerEngine::getPixelsFrameNumber()
+{
+    return readback.getFrameNumber();
+}
+
+double ofxOMXPlayerEngine::getPixelsPTS()
+{
+    return readback.getPTS();
+}
+
+unsigned char* ofxOMXPlayerEngine::getPixelsAfter(int frameNumber)
+{
+    if(readback.getFrameNumber() > frameNumber)
+    {
+        return readback.getPixels();
+    }
+    return NULL;
+}
+
+ofxOMXReadbackStats& ofxOMXPlayerEngine::getReadbackStats()
+{
+    return readback.getStats();
 }
 
 
@@ -468,16 +955,72 @@ void ofxOMXPlayerEngine::drawCropped(float cropX, float cropY, float cropWidth,
     
 }
 
+//Direct mode returns false when the new regions need the pipeline rebuilt,
+//they are kept in m_config_video and used from the next open
+bool ofxOMXPlayerEngine::setRegions(vector<ofxOMXVideoRegion>& regions_)
+{
+    lock();
+    regions = regions_;
+    m_config_video.regions.clear();
+    for(size_t i=0; i<regions.size(); i++)
+    {
+        ofRectangle& crop = regions[i].crop;
+        ofRectangle& destination = regions[i].destination;
+        OMXVideoRegion region;
+        region.src_rect.SetRect(crop.x, crop.y, crop.x+crop.width, crop.y+crop.height);
+        region.dst_rect.SetRect(destination.x, destination.y, destination.x+destination.width, destination.y+destination.height);
+        m_config_video.regions.push_back(region);
+    }
+    if(!useTexture && regions.size() > MAX_VIDEO_REGIONS)
+    {
+        ofLogWarning(__func__) << "direct mode shows the first " << MAX_VIDEO_REGIONS << " of " << regions.size() << " regions";
+    }
+    bool applied = true;
+    if(m_has_video && !useTexture)
+    {
+        applied = m_player_video.SetRegions(m_config_video.regions);
+    }
+    unlock();
+    return applied;
+}
+
+//Textured mode: every region samples the same latched EGLImage texture
+void ofxOMXPlayerEngine::drawRegions()
+{
+    if(!m_has_video || !useTexture || !texture.isAllocated()) return;
+    for(size_t i=0; i<regions.size(); i++)
+    {
+        ofRectangle crop = regions[i].crop;
+        if(crop.isEmpty())
+        {
+            crop.set(0, 0, texture.getWidth(), texture.getHeight());
+        }
+        ofRectangle& destination = regions[i].destination;
+        texture.drawSubsection(destination.x, destination.y, destination.width, destination.height,
+                               crop.x, crop.y, crop.width, crop.height);
+    }
+}
+
 
 #pragma mark UPDATE
 void ofxOMXPlayerEngine::onUpdate(ofEventArgs& eventArgs)
 {
+    if(isLoading || (loadStage != LOAD_STAGE_NONE && reportedLoadStage < LOAD_STAGE_FIRST_FRAME))
+    {
+        updateLoadStage();
+    }
     
     if(!m_has_video) return;
     if (!texture.isAllocated() && !fbo.isAllocated()) return;
     if(omxClock.OMXMediaTime()<0) return; 
     
-    int frameNumber = m_player_video.getFrameNumber();
+    int frameNumber = 0;
+    double pts = 0;
+    int textureIndex = m_player_video.latchFrame(frameNumber, pts);
+    if(textureIndex >= 0 && textureIndex < (int)textures.size())
+    {
+        texture = textures[textureIndex];
+    }
     if(updateCounter != frameNumber)
     {
         hasNewFrame = true;
@@ -486,6 +1029,7 @@ void ofxOMXPlayerEngine::onUpdate(ofEventArgs& eventArgs)
         texture.draw(0, 0, texture.getWidth(), texture.getHeight()); 
         fbo.end();
         updateCounter = frameNumber;
+        framePTS = pts;
     }else
     {
         hasNewFrame = false;
@@ -505,7 +1049,7 @@ bool ofxOMXPlayerEngine::generateEGLImage()
     }
     else
     {
-        if (texture.getWidth() != videoWidth && texture.getHeight() != videoHeight)
+        if (texture.getWidth() != videoWidth || texture.getHeight() != videoHeight)
         {
             needsRegeneration = true;
         }
@@ -517,12 +1061,17 @@ bool ofxOMXPlayerEngine::generateEGLImage()
     }
     else
     {
-        if (fbo.getWidth() != videoWidth && fbo.getHeight() != videoHeight)
+        if (fbo.getWidth() != videoWidth || fbo.getHeight() != videoHeight)
         {
             needsRegeneration = true;
         }
     }
     
+    if ((int)eglImages.size() != numTextures)
+    {
+        needsRegeneration = true;
+    }
+    
     if(!needsRegeneration)
     {
         //ofLogVerbose(__func__) << "NO CHANGES NEEDED - RETURNING EARLY";
@@ -559,61 +1108,51 @@ bool ofxOMXPlayerEngine::generateEGLImage()
         return false;
     }
     
-    if (needsRegeneration)
-    {
-        
-        fbo.allocate(videoWidth, videoHeight, GL_RGBA);
-        texture.allocate(videoWidth, videoHeight, GL_RGBA);
-        texture.setTextureWrap(GL_REPEAT, GL_REPEAT);
-        textureID = texture.getTextureData().textureID;
-    }
-    
-    ofLog() << "textureID: " << textureID;
-    ofLog() << "tex.isAllocated(): " << texture.isAllocated();
-    ofLog() << "videoWidth: " << videoWidth;
-    ofLog() << "videoHeight: " << videoHeight;
-    ofLog() << "pixels: " << videoHeight;
-    
-    // setup first texture
-    int dataSize = videoWidth * videoHeight * 4;
-    
-    if (pixels && needsRegeneration)
-    {
-        delete[] pixels;
-        pixels = NULL;
-    }
+    fbo.allocate(videoWidth, videoHeight, GL_RGBA);
+    destroyEGLImage();
     
-    if (pixels == NULL)
+    //egl_render rotates through the ring so the one being drawn is never the
+    //one being rendered into
+    textures.assign(numTextures, ofTexture());
+    success = true;
+    for (int i=0; i<numTextures; i++)
     {
-        pixels = new unsigned char[dataSize];
+        ofTexture& ringTexture = textures[i];
+        ringTexture.allocate(videoWidth, videoHeight, GL_RGBA);
+        ringTexture.setTextureWrap(GL_REPEAT, GL_REPEAT);
+        GLuint ringTextureID = ringTexture.getTextureData().textureID;
+        
+        glBindTexture(GL_TEXTURE_2D, ringTextureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, videoWidth, videoHeight, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        
+        // Create EGL Image
+        EGLImageKHR ringImage = eglCreateImageKHR(display, context, EGL_GL_TEXTURE_2D_KHR, (EGLClientBuffer)ringTextureID, NULL);
+        if (ringImage == EGL_NO_IMAGE_KHR)
+        {
+            ofLog()    << "Create EGLImage " << i << " FAIL <---------------- :(";
+            success = false;
+            break;
+        }
+        eglImages.push_back(ringImage);
     }
-    ofLog() << "dataSize: " << dataSize;
-    
-    //memset(pixels, 0xff, dataSize);  // white texture, opaque
-    
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, videoWidth, videoHeight, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
     
-    
-    if (eglImage && needsRegeneration)
+    if (!success)
     {
         destroyEGLImage();
+        return false;
     }
     
-    // Create EGL Image
-    eglImage = eglCreateImageKHR(display, context, EGL_GL_TEXTURE_2D_KHR, (EGLClientBuffer)textureID, NULL);
+    texture = textures[0];
+    textureID = texture.getTextureData().textureID;
+    eglImage = eglImages[0];
     
-    if (eglImage == EGL_NO_IMAGE_KHR)
-    {
-        ofLog()    << "Create EGLImage FAIL <---------------- :(";
-        
-    }
-    else
-    {
-        success = true;
-        ofLog()  << "Create EGLImage PASS <---------------- :)";
-    }
+    ofLog() << "textureID: " << textureID;
+    ofLog() << "numTextures: " << numTextures;
+    ofLog() << "videoWidth: " << videoWidth;
+    ofLog() << "videoHeight: " << videoHeight;
+    ofLog()  << "Create EGLImage PASS <---------------- :)";
     return success;
     
 }
@@ -622,7 +1161,7 @@ void ofxOMXPlayerEngine::destroyEGLImage()
 {
     
     
-    if (eglImage)
+    if (!eglImages.empty())
     {
         if (appEGLWindow == NULL)
         {
@@ -634,15 +1173,19 @@ void ofxOMXPlayerEngine::destroyEGLImage()
             display = appEGLWindow->getEglDisplay();
         }
         
-        if (!eglDestroyImageKHR(display, eglImage))
-        {
-            ofLog() << __func__ << " FAIL <---------------- :(";
-        }else
+        for (size_t i=0; i<eglImages.size(); i++)
         {
-            ofLog() << __func__ << " PASS <---------------- :)";
+            if (!eglDestroyImageKHR(display, eglImages[i]))
+            {
+                ofLog() << __func__ << " FAIL <---------------- :(";
+            }else
+            {
+                ofLog() << __func__ << " PASS <---------------- :)";
+            }
         }
-        eglImage = NULL;
+        eglImages.clear();
     }
+    eglImage = NULL;
     
 }
 
@@ -651,7 +1194,15 @@ void ofxOMXPlayerEngine::destroyEGLImage()
 
 void ofxOMXPlayerEngine::threadedFunction()
 {
-    
+    if(isLoading)
+    {
+        bool didLoad = runLoad();
+        isLoading = false;
+        if(!didLoad || !loadSettings.autoStart)
+        {
+            return;
+        }
+    }
     
     while(isThreadRunning())
     {
@@ -687,7 +1238,7 @@ void ofxOMXPlayerEngine::threadedFunction()
                 {
                     pts = omxClock.OMXMediaTime();
                     
-                    seek_pos = (pts ? pts / DVD_TIME_BASE : last_seek_pos) + m_incr;
+                    seek_pos = (pts ? getMediaTime() / DVD_TIME_BASE : last_seek_pos) + m_incr;
                     last_seek_pos = seek_pos;
                     
                     seek_pos *= 1000.0;
@@ -728,7 +1279,7 @@ void ofxOMXPlayerEngine::threadedFunction()
                 double seek_pos     = 0;
                 double pts          = 0;
                 
-                pts = omxClock.OMXMediaTime();
+                pts = getMediaTime();
                 seek_pos = (pts / DVD_TIME_BASE);
                 
                 seek_pos *= 1000.0;
@@ -890,13 +1441,31 @@ void ofxOMXPlayerEngine::threadedFunction()
             }
             
             if(!m_omx_pkt)
+            {
                 m_omx_pkt = m_omx_reader.Read();
+                if(m_omx_pkt)
+                    rebasePacket(m_omx_pkt);
+            }
             
             if(m_omx_pkt)
                 m_send_eos = false;
             
             if(m_omx_reader.IsEof() && !m_omx_pkt)
             {
+                string next = !m_send_eos && !m_restart_next ? takeNext() : "";
+                if(!next.empty())
+                {
+                    if(openNext(next))
+                    {
+                        if(listener)
+                        {
+                            listener->onVideoNext(false);
+                        }
+                        continue;
+                    }
+                    //the current file is still open, play it out first
+                    m_restart_next = true;
+                }
                 // demuxer EOF, but may have not played out data yet
                 if ( (m_has_video && m_player_video.GetCached()) ||
                     (m_has_audio && m_player_audio.GetCached()) )
@@ -917,6 +1486,15 @@ void ofxOMXPlayerEngine::threadedFunction()
                 }
                 ofLog() << "REACHED END OF STREAM";
                 
+                if(m_restart_next)
+                {
+                    m_restart_next = false;
+                    if(listener)
+                    {
+                        listener->onVideoNext(true);
+                    }
+                    break;
+                }
                 if (m_loop)
                 {
                     ofLog() << "SHOULD LOOP";
@@ -924,7 +1502,7 @@ void ofxOMXPlayerEngine::threadedFunction()
                     bool needsRestart = false;
                     if(totalNumFrames)
                     {
-                        m_incr = m_loop_from - (omxClock.OMXMediaTime() ? omxClock.OMXMediaTime() / DVD_TIME_BASE : last_seek_pos); 
+                        m_incr = m_loop_from - (omxClock.OMXMediaTime() ? getMediaTime() / DVD_TIME_BASE : last_seek_pos); 
                     }else
                     {
                         ofLog() << "WILL LOOP VIA RESTART";
@@ -961,7 +1539,7 @@ void ofxOMXPlayerEngine::threadedFunction()
                 else
                     OMXClock::OMXSleep(10);
             }
-            else if(m_has_audio && m_omx_pkt && !TRICKPLAY(omxClock.OMXPlaySpeed()) && m_omx_pkt->codec_type == AVMEDIA_TYPE_AUDIO)
+            else if(m_has_audio && m_omx_pkt && !TRICKPLAY(omxClock.OMXPlaySpeed()) && m_omx_reader.IsActive(OMXSTREAM_AUDIO, m_omx_pkt->stream_index))
             {
                 if(m_player_audio.AddPacket(m_omx_pkt))
                     m_omx_pkt = NULL;
@@ -1105,6 +1683,23 @@ void ofxOMXPlayerEngine::increaseVolume()
     ofLog(OF_LOG_NOTICE, "Current Volume: %.2fdB\n", m_Volume / 100.0f);
 }
 
+OMXAudioPipelineStats ofxOMXPlayerEngine::getAudioPipelineStats()
+{
+    return m_player_audio.GetPipelineStats();
+}
+
+void ofxOMXPlayerEngine::setAudioMixGain(float gain)
+{
+    m_config_audio.alsa_mix_gain = gain;
+    m_player_audio.SetMixGain(gain);
+}
+
+bool ofxOMXPlayerEngine::getAudioLevels(OMXAudioTapBlock& block)
+{
+    if(!m_config_audio.tap) return false;
+    return m_config_audio.tap->Find(omxClock.OMXMediaTime(), block);
+}
+
 #pragma mark DISPLAY
 void ofxOMXPlayerEngine::setLayer(int layer)
 {
@@ -1311,6 +1906,12 @@ void ofxOMXPlayerEngine::FlushStreams(double pts)
     if(pts != DVD_NOPTS_VALUE)
         omxClock.OMXMediaTime(pts);
     
+    //seeked in the reader's own time, the clock now is too
+    m_pts_offset = 0;
+    m_prev_pts_offset = 0;
+    m_next_start = DVD_NOPTS_VALUE;
+    m_stream_end = DVD_NOPTS_VALUE;
+    
     
     if(m_omx_pkt)
     {
@@ -1320,7 +1921,7 @@ void ofxOMXPlayerEngine::FlushStreams(double pts)
 }
 
 #pragma mark EXIT
-int ofxOMXPlayerEngine::doExit()
+int ofxOMXPlayerEngine::doExit(bool keepClock)//default keepClock = false
 {
     ofLog() << "EXITING";
     
@@ -1357,7 +1958,11 @@ int ofxOMXPlayerEngine::doExit()
     
     m_omx_reader.Close();
     
-    omxClock.OMXDeinitialize();
+    //pooled engines keep the clock component for the next open
+    if(!keepClock)
+    {
+        omxClock.OMXDeinitialize();
+    }
     
     
     vc_tv_show_info(0);
@@ -1383,6 +1988,7 @@ void ofxOMXPlayerEngine::close(bool clearTextures)//default clearTextures = fals
 {
     lock();
     //ofRemoveListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
+    cancelLoad();
     stopThread();
     //
     
@@ -1393,18 +1999,53 @@ void ofxOMXPlayerEngine::close(bool clearTextures)//default clearTextures = fals
     }
     
     unlock();
+    //a load or the playback loop may still be running and calls doExit itself
+    waitForThread(false);
     doExit(); 
 }
 
+//Engine must be heap allocated - ownership passes to ofxOMXPlayerReaper which
+//deletes it on the GL thread once the teardown is done
+void ofxOMXPlayerEngine::closeAsync(EngineListener* closeListener)//default closeListener = NULL
+{
+    lock();
+    listener = NULL;
+    unlock();
+    ofRemoveListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
+    cancelLoad();
+    stopThread();
+    ofxOMXPlayerReaper::getInstance().reap(this, closeListener);
+}
+
+//Prepares a closed engine for another setup/loadAsync, keeps textures and clock
+void ofxOMXPlayerEngine::recycle()
+{
+    m_omx_reader.Abort(false);
+    clear();
+    readback.reset();
+    convertedFrameNumber = -1;
+    pixels = NULL;
+}
+
+//GL thread only
+void ofxOMXPlayerEngine::releaseTextures()
+{
+    destroyEGLImage();
+    fbo.clear();
+    texture.clear();
+    textures.clear();
+    readbackFbo.clear();
+    packFbo.clear();
+    readback.clear();
+    convertedPixels.clear();
+    pixels = NULL;
+}
+
 ofxOMXPlayerEngine::~ofxOMXPlayerEngine()
 {
+    ofRemoveListener(ofEvents().update, this, &ofxOMXPlayerEngine::onUpdate);
     close();
     destroyEGLImage();
-    if(pixels)
-    {
-        delete[] pixels;
-        pixels = NULL;
-    }
 }
 
 
@@ -2,16 +2,35 @@
 
 #include "ofMain.h"
 #include "ofxOMXPlayerSettings.h"
+#include "ofxOMXPixelReadback.h"
+#include "ofxOMXPixelConverter.h"
 #include "OMXReader.h"
 #include "OMXClock.h"
 #include "OMXAudio.h"
 #include "OMXPlayerVideo.h"
 #include "OMXPlayerAudio.h"
+#include "OMXAudioTap.h"
 #include "utils/Strprintf.h"
 #include "ofAppEGLWindow.h"
 #include <EGL/egl.h>
 #include <EGL/eglplatform.h>
 #include <EGL/eglext.h>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class ofxOMXPlayerEngine;
+
+enum ofxOMXLoadStage
+{
+    LOAD_STAGE_NONE = 0,
+    LOAD_STAGE_OPENED,          //container opened
+    LOAD_STAGE_PROBED,          //streams found, hints/dimensions valid
+    LOAD_STAGE_DECODER_READY,   //clock and decoders up, isOpen is true
+    LOAD_STAGE_FIRST_FRAME,     //first frame rendered
+    LOAD_STAGE_FAILED,
+    LOAD_STAGE_CANCELLED
+};
 
 class EngineListener
 {
@@ -20,6 +39,9 @@ public:
     virtual ~EngineListener(){};
     virtual void onVideoEnd() = 0;
     virtual void onVideoLoop(bool needsRestart)= 0;
+    virtual void onVideoNext(bool needsRestart){};
+    virtual void onEngineClosed(ofxOMXPlayerEngine* engine){};
+    virtual void onLoadStage(ofxOMXPlayerEngine* engine, ofxOMXLoadStage stage){};
 };
 
 
@@ -38,6 +60,7 @@ public:
     OMXVideoConfig    m_config_video;
     OMXPlayerVideo    m_player_video;
     OMXPlayerAudio    m_player_audio;
+    OMXAudioTap       audioTap;
     
     //int count;
     float m_threshold;
@@ -46,6 +69,7 @@ public:
     
     bool m_has_video;
     bool m_has_audio;
+    bool m_enable_audio;
     double m_incr;
     double last_seek_pos;
     OMXPacket *m_omx_pkt;
@@ -73,20 +97,39 @@ public:
     
     vector<int>speeds;
     string m_filename;
+    string m_next_filename;     //queueNext, taken at the current file's demuxer EOF
+    bool m_restart_next;        //taken but could not be switched to, reopen once this one has played out
+    double m_pts_offset;        //added to every packet since the last gapless switch
+    double m_prev_pts_offset;   //what was added before it, until the clock reaches m_next_start
+    double m_next_start;
+    double m_stream_end;        //where the audio fed so far ends (video without audio)
     
     EGLImageKHR eglImage;
     bool useTexture;
     int videoWidth;
     int videoHeight;
     ofFbo           fbo;
-    ofTexture       texture;
-    
-    unsigned char*  pixels;
+    ofTexture       texture;        //latched EGLImage texture, one of textures
+    vector<ofTexture> textures;
+    vector<EGLImageKHR> eglImages;
+    int             numTextures;
+    
+    ofxOMXPixelReadback readback;
+    ofxOMXPixelRequest pixelRequest;
+    ofFbo           readbackFbo;    //only allocated for cropped/scaled requests
+    ofFbo           packFbo;        //only allocated for GRAY/RGB requests
+    ofxOMXPixelConverter pixelConverter;
+    vector<unsigned char> convertedPixels; //CPU fallback when the packing shader is unavailable
+    int             convertedFrameNumber;
+    int             numPixelBuffers;
+    unsigned char*  pixels;         //readback front buffer, owned by readback
+    vector<ofxOMXVideoRegion> regions;
     GLuint          textureID;
     EGLDisplay      display;
     EGLContext      context;
     ofAppEGLWindow* appEGLWindow;
-    int updateCounter;
+    int updateCounter;  //decoded frame number currently in the fbo
+    double framePTS;    //and its PTS in microseconds
     
     int totalNumFrames;
     int videoFrameRate;
@@ -110,14 +153,48 @@ public:
     ofxOMXPlayerEngine();
     void clear();
     bool setup(ofxOMXPlayerSettings settings);
+    void applySettings(ofxOMXPlayerSettings& settings);
+    bool openReader(ofxOMXPlayerSettings& settings);
+    bool openPlayers(ofxOMXPlayerSettings& settings);
+    void updateStreamInfo();
+    void queueNext(string path);
+    string takeNext();
+    bool openNext(string path);
+    void rebasePacket(OMXPacket* pkt);
+    double getMediaTime();
     void threadedFunction();
+    
+    bool loadAsync(ofxOMXPlayerSettings settings);
+    void cancelLoad();
+    bool runLoad();
+    void setLoadStage(ofxOMXLoadStage stage);
+    void updateLoadStage();
+    static string getLoadStageName(ofxOMXLoadStage stage);
+    
+    ofxOMXPlayerSettings loadSettings;
+    volatile bool isLoading;
+    volatile bool loadCancelRequested;
+    std::atomic<bool> eglImageRequested;  //set by runLoad, cleared on the GL thread
+    std::mutex eglImageMutex;
+    std::condition_variable eglImageCondition;   //signalled by updateLoadStage and cancelLoad
+    ofxOMXLoadStage loadStage;
+    ofxOMXLoadStage reportedLoadStage;
 
     void updatePixels();
+    void setPixelRequest(ofxOMXPixelRequest request);
+    void getPixelRegion(ofRectangle& crop, int& width, int& height);
+    void updateConvertedPixels(int width, int height, bool didPack);
+    ofxOMXReadbackStats& getReadbackStats();
+    int getPixelsFrameNumber();
+    double getPixelsPTS();
+    unsigned char* getPixelsAfter(int frameNumber);
     bool generateEGLImage();
     void destroyEGLImage();
     void draw(float x, float y, float width, float height);
     void drawCropped(float cropX, float cropY, float cropWidth, float cropHeight,
                      float drawX, float drawY, float drawWidth, float drawHeight);
+    bool setRegions(vector<ofxOMXVideoRegion>& regions_);
+    void drawRegions();
     
     void setLayer(int layer);
     void setAlpha(int alpha);
@@ -137,6 +214,9 @@ public:
     
     void decreaseVolume();
     void increaseVolume();
+    OMXAudioPipelineStats getAudioPipelineStats();
+    bool getAudioLevels(OMXAudioTapBlock& block);
+    void setAudioMixGain(float gain);
     
     void SetSpeed();
     void FlushStreams(double pts);
@@ -148,7 +228,10 @@ public:
     
     
     void close(bool clearTextures = false);
-    int doExit();
+    void closeAsync(EngineListener* closeListener = NULL);
+    void releaseTextures();
+    void recycle();
+    int doExit(bool keepClock = false);
     ~ofxOMXPlayerEngine();
     
 };
@@ -0,0 +1,121 @@
+#include "ofxOMXPlayerEnginePool.h"
+
+ofxOMXPlayerEnginePool& ofxOMXPlayerEnginePool::getInstance()
+{
+    //never deleted - idle engines are released in onExit while GL is still up
+    static ofxOMXPlayerEnginePool* instance = new ofxOMXPlayerEnginePool();
+    return *instance;
+}
+
+ofxOMXPlayerEnginePool::ofxOMXPlayerEnginePool()
+{
+    maxSize = 2;
+    numReserved = 0;
+    numHits = 0;
+    numMisses = 0;
+    ofAddListener(ofEvents().exit, this, &ofxOMXPlayerEnginePool::onExit);
+}
+
+ofxOMXPlayerEngine* ofxOMXPlayerEnginePool::checkout(int width, int height)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if(idleEngines.empty())
+    {
+        numMisses++;
+        return new ofxOMXPlayerEngine();
+    }
+    
+    size_t index = idleEngines.size()-1;
+    for(size_t i=0; i<idleEngines.size(); i++)
+    {
+        ofTexture& texture = idleEngines[i]->texture;
+        if(texture.isAllocated() && texture.getWidth() == width && texture.getHeight() == height)
+        {
+            index = i;
+            break;
+        }
+    }
+    
+    ofxOMXPlayerEngine* engine = idleEngines[index];
+    idleEngines.erase(idleEngines.begin()+index);
+    numHits++;
+    ofLogVerbose(__func__) << "reusing engine " << engine << " hits: " << numHits << " misses: " << numMisses;
+    return engine;
+}
+
+bool ofxOMXPlayerEnginePool::reserve()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if((int)idleEngines.size() + numReserved >= maxSize)
+    {
+        return false;
+    }
+    numReserved++;
+    return true;
+}
+
+bool ofxOMXPlayerEnginePool::checkin(ofxOMXPlayerEngine* engine, bool reserved)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if(reserved)
+    {
+        numReserved--;
+    }
+    //setMaxSize may have shrunk the pool since the reservation
+    if((int)idleEngines.size() + numReserved >= maxSize)
+    {
+        return false;
+    }
+    engine->recycle();
+    idleEngines.push_back(engine);
+    return true;
+}
+
+//deletes idle engines until at most size are left, GL thread only
+void ofxOMXPlayerEnginePool::trim(int size)
+{
+    vector<ofxOMXPlayerEngine*> released;
+    mutex.lock();
+    while((int)idleEngines.size() > size)
+    {
+        released.push_back(idleEngines.back());
+        idleEngines.pop_back();
+    }
+    mutex.unlock();
+    for(size_t i=0; i<released.size(); i++)
+    {
+        released[i]->releaseTextures();
+        delete released[i];
+    }
+}
+
+void ofxOMXPlayerEnginePool::setMaxSize(int maxSize_)
+{
+    mutex.lock();
+    maxSize = maxSize_;
+    mutex.unlock();
+    trim(maxSize_);
+}
+
+int ofxOMXPlayerEnginePool::getMaxSize()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return maxSize;
+}
+
+int ofxOMXPlayerEnginePool::getNumIdle()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return idleEngines.size();
+}
+
+void ofxOMXPlayerEnginePool::clear()
+{
+    trim(0);
+}
+
+void ofxOMXPlayerEnginePool::onExit(ofEventArgs& eventArgs)
+{
+    //anything reaped after this point is deleted instead of pooled
+    setMaxSize(0);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayerEngine.h"
+#include <mutex>
+
+/*
+ Process-wide pool of closed engines kept warm for the next load.
+
+ Engines come back from ofxOMXPlayerReaper with their OMX clock still
+ initialised and their EGLImage/fbo/texture/pixels still allocated, so a
+ checkout for the same resolution skips the clock bring-up and the GL
+ allocations in generateEGLImage. All calls are from the GL thread except
+ reserve(), which ofxOMXPlayerReaper calls before its teardown so an engine
+ the pool will not take is torn down completely off the GL thread.
+ */
+
+class ofxOMXPlayerEnginePool
+{
+public:
+
+    static ofxOMXPlayerEnginePool& getInstance();
+
+    //returns an idle engine, preferring one whose textures match width/height
+    ofxOMXPlayerEngine* checkout(int width = 0, int height = 0);
+
+    //any thread - holds a place for one engine, false if the pool is full
+    bool reserve();
+
+    //engine must be closed (doExit done) - returns false if the pool is full,
+    //reserved hands back a place taken with reserve() either way
+    bool checkin(ofxOMXPlayerEngine* engine, bool reserved = false);
+
+    //0 disables pooling
+    void setMaxSize(int maxSize_);
+    int getMaxSize();
+    int getNumIdle();
+    void clear();
+
+    int numHits;
+    int numMisses;
+
+    void onExit(ofEventArgs& eventArgs);
+
+private:
+    ofxOMXPlayerEnginePool();
+    void trim(int size);
+    vector<ofxOMXPlayerEngine*> idleEngines;
+    int numReserved;
+    int maxSize;
+    std::mutex mutex;
+};
@@ -0,0 +1,162 @@
+#include "ofxOMXPlayerReaper.h"
+#include "ofxOMXPlayerEnginePool.h"
+
+ofxOMXPlayerReaper& ofxOMXPlayerReaper::getInstance()
+{
+    //never deleted - the update/exit listeners must outlive every player
+    static ofxOMXPlayerReaper* instance = new ofxOMXPlayerReaper();
+    return *instance;
+}
+
+ofxOMXPlayerReaper::ofxOMXPlayerReaper()
+{
+    ofAddListener(ofEvents().update, this, &ofxOMXPlayerReaper::onUpdate);
+    ofAddListener(ofEvents().exit, this, &ofxOMXPlayerReaper::onExit);
+    startThread();
+}
+
+void ofxOMXPlayerReaper::reap(ofxOMXPlayerEngine* engine, EngineListener* listener)
+{
+    if(!engine) return;
+
+    ofxOMXPlayerReaperItem item;
+    item.engine = engine;
+    item.listener = listener;
+    item.startTime = ofGetElapsedTimeMillis();
+    item.poolable = true;
+    item.pooled = false;
+
+    lock();
+    pending.push_back(item);
+    unlock();
+}
+
+void ofxOMXPlayerReaper::removeListener(EngineListener* listener)
+{
+    lock();
+    for(size_t i=0; i<pending.size(); i++)
+    {
+        if(pending[i].listener == listener)
+        {
+            pending[i].listener = NULL;
+        }
+    }
+    for(size_t i=0; i<finished.size(); i++)
+    {
+        if(finished[i].listener == listener)
+        {
+            finished[i].listener = NULL;
+        }
+    }
+    unlock();
+}
+
+int ofxOMXPlayerReaper::getNumPending()
+{
+    lock();
+    int result = pending.size() + finished.size();
+    unlock();
+    return result;
+}
+
+#pragma mark THREAD
+
+void ofxOMXPlayerReaper::threadedFunction()
+{
+    while(isThreadRunning())
+    {
+        bool hasItem = false;
+        ofxOMXPlayerReaperItem item;
+
+        lock();
+        if(!pending.empty())
+        {
+            item = pending.front();
+            pending.pop_front();
+            hasItem = true;
+        }
+        unlock();
+
+        if(!hasItem)
+        {
+            ofSleepMillis(10);
+            continue;
+        }
+
+        //let the demux loop finish its current packet before pulling the components out
+        item.engine->waitForThread(true);
+        item.pooled = item.poolable && ofxOMXPlayerEnginePool::getInstance().reserve();
+        item.engine->doExit(item.pooled);
+
+        lock();
+        finished.push_back(item);
+        unlock();
+    }
+}
+
+#pragma mark GL
+
+void ofxOMXPlayerReaper::release(ofxOMXPlayerReaperItem& item)
+{
+    ofLogVerbose(__func__) << "engine closed in " << ofGetElapsedTimeMillis()-item.startTime << "ms";
+    if(item.listener)
+    {
+        item.listener->onEngineClosed(item.engine);
+        item.listener = NULL;
+    }
+    if(item.pooled)
+    {
+        if(ofxOMXPlayerEnginePool::getInstance().checkin(item.engine, true))
+        {
+            item.engine = NULL;
+            return;
+        }
+        //the clock is still up, deinitialising it here would stall the GL thread
+        item.poolable = false;
+        item.pooled = false;
+        if(isThreadRunning())
+        {
+            lock();
+            pending.push_back(item);
+            unlock();
+            return;
+        }
+        item.engine->doExit();
+    }
+    item.engine->releaseTextures();
+    delete item.engine;
+    item.engine = NULL;
+}
+
+void ofxOMXPlayerReaper::onUpdate(ofEventArgs& eventArgs)
+{
+    vector<ofxOMXPlayerReaperItem> ready;
+
+    lock();
+    ready.swap(finished);
+    unlock();
+
+    for(size_t i=0; i<ready.size(); i++)
+    {
+        release(ready[i]);
+    }
+}
+
+void ofxOMXPlayerReaper::onExit(ofEventArgs& eventArgs)
+{
+    //the GL context is still alive here, so finish everything synchronously
+    waitForThread(true);
+
+    lock();
+    while(!pending.empty())
+    {
+        ofxOMXPlayerReaperItem item = pending.front();
+        pending.pop_front();
+        item.engine->waitForThread(true);
+        item.engine->doExit();
+        finished.push_back(item);
+    }
+    unlock();
+
+    onUpdate(eventArgs);
+}
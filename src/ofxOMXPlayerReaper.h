@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOMXPlayerEngine.h"
+
+/*
+ Tears down closed engines off the GL thread.
+
+ ofxOMXPlayerEngine::closeAsync() hands the engine over here. The reaper thread
+ joins the demux thread and runs doExit() (decoders, tunnels, clock, reader),
+ keeping the clock only when ofxOMXPlayerEnginePool has reserved a place for
+ the engine. The next update on the GL thread fires onEngineClosed and checks
+ the engine into the pool, or releases the EGLImage/fbo/texture and deletes
+ it. An engine the pool turns away after all (it shrank in between) goes
+ back to the reaper thread for its clock first.
+ */
+
+struct ofxOMXPlayerReaperItem
+{
+    ofxOMXPlayerEngine* engine;
+    EngineListener* listener;
+    uint64_t startTime;
+    bool poolable;  //false once the pool turned it away
+    bool pooled;    //doExit kept the clock for a reserved pool place
+};
+
+class ofxOMXPlayerReaper : public ofThread
+{
+public:
+
+    static ofxOMXPlayerReaper& getInstance();
+
+    //call from the GL thread, takes ownership of engine
+    void reap(ofxOMXPlayerEngine* engine, EngineListener* listener = NULL);
+
+    //stop sending onEngineClosed to a listener that is going away
+    void removeListener(EngineListener* listener);
+
+    int getNumPending();
+
+    void threadedFunction();
+    void onUpdate(ofEventArgs& eventArgs);
+    void onExit(ofEventArgs& eventArgs);
+
+private:
+    ofxOMXPlayerReaper();
+    void release(ofxOMXPlayerReaperItem& item);
+
+    deque<ofxOMXPlayerReaperItem> pending;   //waiting for doExit on the reaper thread
+    vector<ofxOMXPlayerReaperItem> finished; //waiting for GL release on update
+};
@@ -10,6 +10,52 @@
 #include "utils/log.h"
 
 class ofxOMXPlayerListener;
+
+//What getPixels() should hold. Cropping and scaling happen on the GPU before
+//readback so the bytes moved match what was asked for.
+class ofxOMXPixelRequest
+{
+public:
+    ofxOMXPixelRequest()
+    {
+        width = 0;
+        height = 0;
+        format = OF_PIXELS_RGBA;
+    }
+    ofxOMXPixelRequest(int width_, int height_, ofRectangle crop_ = ofRectangle(), ofPixelFormat format_ = OF_PIXELS_RGBA)
+    {
+        width = width_;
+        height = height_;
+        crop = crop_;
+        format = format_;
+    }
+    bool isFullFrame()
+    {
+        return width == 0 && height == 0 && crop.isEmpty() && format == OF_PIXELS_RGBA;
+    }
+    int width;          //0 for both = crop size, 0 for one = keep the crop aspect
+    int height;
+    ofRectangle crop;   //in video pixels, empty = whole frame
+    ofPixelFormat format;
+};
+
+//One tile of a video wall: crop (video pixels, empty = whole frame) shown at
+//destination (screen pixels). All regions share one decoder.
+class ofxOMXVideoRegion
+{
+public:
+    ofxOMXVideoRegion()
+    {
+    }
+    ofxOMXVideoRegion(ofRectangle crop_, ofRectangle destination_)
+    {
+        crop = crop_;
+        destination = destination_;
+    }
+    ofRectangle crop;
+    ofRectangle destination;
+};
+
 class ofxOMXPlayerSettings
 {
 public:
@@ -33,6 +79,13 @@ public:
         logToOF = true;
         setDisplayResolution = false;
         layer = 0;
+        numPixelBuffers = 2;
+        numTextures = 3;
+        alsaDevice = "";
+        lowLatencyAudio = false;
+        audioTapSeconds = 0;
+        sharedAudioOutput = false;
+        gaplessCrossfade = 0;
     }
     bool enableFilters;
     OMX_IMAGEFILTERTYPE filter;
@@ -43,6 +96,11 @@ public:
     bool enableAudio;
     float initialVolume; //0.0 - 1.0
     bool useHDMIForAudio;
+    string alsaDevice; //e.g. "default" or "hw:1,0", plays through ALSA instead of HDMI/local
+    bool lowLatencyAudio; //ALSA only, ~20ms device buffer fed by 2x5ms OMX buffers, see OMXAudioConfig::SetLowLatency
+    float audioTapSeconds; //> 0 keeps this much decoded audio for getAudioLevels/getAudioTap, 0 = off
+    bool sharedAudioOutput; //ALSA only, players on the same alsaDevice mix into one output, see setAudioMixGain
+    float gaplessCrossfade; //seconds a setNextMovie file overlaps the one before when it plays on without reopening, 0 = end to end
     bool enableLooping;
     string loopPoint;
     bool autoStart;
@@ -50,10 +108,16 @@ public:
     string logDirectory;
     bool logToOF;
     uint layer;
+    int numPixelBuffers; //readback ring for getPixels, more buffers = fewer stalls but more latency
+    ofxOMXPixelRequest pixelRequest;
+    int numTextures; //EGLImage ring for texture mode, 2-4 (1 = egl_render writes the texture being drawn)
     ofxOMXPlayerListener* listener;
     
     bool setDisplayResolution; //direct only
     ofRectangle directDrawRectangle;
+    //textured: drawRegions() draws each from the one texture
+    //direct: up to 4, a video_splitter feeds one video_render per region
+    vector<ofxOMXVideoRegion> regions;
     
     
     //PlayerDirectDisplayOptions directDisplayOptions;
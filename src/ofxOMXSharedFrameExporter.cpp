@@ -0,0 +1,86 @@
+#include "ofxOMXSharedFrameExporter.h"
+
+ofxOMXSharedFrameExporter::ofxOMXSharedFrameExporter()
+{
+    numSlots = 4;
+    maxFrameBytes = 0;
+}
+
+ofxOMXSharedFrameExporter::~ofxOMXSharedFrameExporter()
+{
+    close();
+}
+
+void ofxOMXSharedFrameExporter::setup(string name_, int numSlots_, int maxFrameBytes_)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    ring.close();
+    name = name_;
+    numSlots = max(1, numSlots_);
+    maxFrameBytes = maxFrameBytes_;
+    stats = ofxOMXSharedFrameExportStats();
+}
+
+void ofxOMXSharedFrameExporter::close()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    ring.close();
+    name = "";
+}
+
+bool ofxOMXSharedFrameExporter::isSetup()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return !name.empty();
+}
+
+string ofxOMXSharedFrameExporter::getName()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return name;
+}
+
+ofxOMXSharedFrameExportStats ofxOMXSharedFrameExporter::getStats()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return stats;
+}
+
+//subscription thread
+void ofxOMXSharedFrameExporter::onFrame(ofxOMXFrameRef frame)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if(name.empty()) return;
+
+    ofPixels& pixels = frame->pixels;
+    int frameBytes = pixels.getTotalBytes();
+    if(ring.isOpen() && frameBytes > ring.getMaxFrameBytes())
+    {
+        //a bigger clip or pixel request, closing clears writerAlive so
+        //readers drop the old ring and open the new one
+        ofLogNotice(__func__) << name << " frames grew to " << frameBytes << " bytes, recreating the ring";
+        ring.close();
+        stats.numRecreated++;
+    }
+    if(!ring.isOpen())
+    {
+        if(!ring.create(name, numSlots, max(maxFrameBytes, frameBytes)))
+        {
+            ofLogError(__func__) << "could not create shared memory ring " << name << ": " << ring.getLastError();
+            name = "";
+            return;
+        }
+        ofLogVerbose(__func__) << name << " " << numSlots << " slots of " << ring.getMaxFrameBytes() << " bytes";
+    }
+
+    uint64_t startTime = ofGetElapsedTimeMicros();
+    if(!ring.publish(pixels.getData(), pixels.getWidth(), pixels.getHeight(), pixels.getNumChannels(),
+                     frame->frameNumber, frame->pts))
+    {
+        stats.numRejected++;
+        return;
+    }
+    stats.numPublished++;
+    float publishMillis = (ofGetElapsedTimeMicros()-startTime)/1000.0f;
+    stats.averagePublishMillis += (publishMillis-stats.averagePublishMillis)/stats.numPublished;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ofxOMXFrameDispatcher.h"
+#include "ofxOMXSharedFrameRing.h"
+
+/*
+ Frame subscriber that publishes into an ofxOMXSharedFrameRing so other
+ processes can read the decoded frames, see ofxOMXPlayer::startSharedFrameExport.
+ The ring is created on the first frame and sized for it unless
+ maxFrameBytes is given; a larger frame after that recreates it, readers
+ see isWriterAlive() go false and open it again.
+ */
+
+struct ofxOMXSharedFrameExportStats
+{
+    ofxOMXSharedFrameExportStats()
+    {
+        numPublished = 0;
+        numRejected = 0;
+        numRecreated = 0;
+        averagePublishMillis = 0;
+    }
+    int numPublished;
+    int numRejected;
+    int numRecreated;            //frames outgrew the ring
+    float averagePublishMillis;  //copy into the ring plus the futex wake
+};
+
+class ofxOMXSharedFrameExporter : public ofxOMXFrameSubscriber
+{
+public:
+    ofxOMXSharedFrameExporter();
+    ~ofxOMXSharedFrameExporter();
+
+    void setup(string name, int numSlots = 4, int maxFrameBytes = 0);
+    void close();
+    bool isSetup();
+    string getName();
+    ofxOMXSharedFrameExportStats getStats();
+
+    void onFrame(ofxOMXFrameRef frame);
+
+private:
+    std::mutex mutex;
+    ofxOMXSharedFrameRing ring;
+    string name;
+    int numSlots;
+    int maxFrameBytes;
+    ofxOMXSharedFrameExportStats stats;
+};
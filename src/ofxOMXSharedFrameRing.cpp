@@ -0,0 +1,322 @@
+#include "ofxOMXSharedFrameRing.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+
+static size_t alignTo(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//shared (not FUTEX_PRIVATE) so waiters in other processes are woken too
+static long futexWait(std::atomic<uint32_t>* word, uint32_t expected, const struct timespec* timeout)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static long futexWakeAll(std::atomic<uint32_t>* word)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+ofxOMXSharedFrameRing::ofxOMXSharedFrameRing()
+{
+    isWriter = false;
+    fd = -1;
+    mappedSize = 0;
+    mapped = NULL;
+    header = NULL;
+    writeSequence = 0;
+}
+
+ofxOMXSharedFrameRing::~ofxOMXSharedFrameRing()
+{
+    close();
+}
+
+uint64_t ofxOMXSharedFrameRing::getMonotonicMicros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+#pragma mark WRITER
+
+bool ofxOMXSharedFrameRing::create(std::string name_, int numSlots, int maxFrameBytes, mode_t mode)
+{
+    close();
+    lastError = "";
+    if(numSlots < 1 || maxFrameBytes <= 0)
+    {
+        lastError = "invalid numSlots " + std::to_string(numSlots) + " maxFrameBytes " + std::to_string(maxFrameBytes);
+        return false;
+    }
+
+    size_t dataOffset = alignTo(sizeof(ofxOMXSharedFrameSlot), 64);
+    size_t slotStride = alignTo(dataOffset + maxFrameBytes, 4096);
+    size_t headerSize = alignTo(sizeof(ofxOMXSharedFrameHeader), 4096);
+    size_t size = headerSize + slotStride*numSlots;
+
+    //a stale ring from a crashed writer may have another geometry
+    shm_unlink(name_.c_str());
+    fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, mode);
+    if(fd < 0)
+    {
+        lastError = "shm_open " + name_ + " failed: " + strerror(errno);
+        return false;
+    }
+    if(ftruncate(fd, size) != 0)
+    {
+        lastError = std::string("ftruncate failed: ") + strerror(errno);
+        close();
+        return false;
+    }
+    mapped = (unsigned char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED)
+    {
+        lastError = std::string("mmap failed: ") + strerror(errno);
+        mapped = NULL;
+        close();
+        return false;
+    }
+    mappedSize = size;
+    name = name_;
+    isWriter = true;
+    writeSequence = 0;
+
+    header = new (mapped) ofxOMXSharedFrameHeader();
+    header->numSlots = numSlots;
+    header->slotStride = slotStride;
+    header->maxFrameBytes = maxFrameBytes;
+    header->dataOffset = dataOffset;
+    header->published.store(0);
+    header->writerAlive.store(1);
+    for(int i=0; i<numSlots; i++)
+    {
+        ofxOMXSharedFrameSlot* slot = new (mapped + headerSize + slotStride*i) ofxOMXSharedFrameSlot();
+        slot->lock.store(0);
+        slot->sequence = 0;
+    }
+    header->version = OMX_SHARED_FRAME_VERSION;
+    //readers check magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = OMX_SHARED_FRAME_MAGIC;
+    return true;
+}
+
+bool ofxOMXSharedFrameRing::publish(const unsigned char* data, int width, int height, int channels, int frameNumber, double pts)
+{
+    if(!isWriter || !header) return false;
+
+    uint32_t size = width*height*channels;
+    if(size > header->maxFrameBytes)
+    {
+        return false;
+    }
+
+    uint32_t sequence = writeSequence+1;
+    ofxOMXSharedFrameSlot* slot = getSlot(sequence);
+
+    uint32_t lock = slot->lock.load(std::memory_order_relaxed);
+    slot->lock.store(lock+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->sequence = sequence;
+    slot->width = width;
+    slot->height = height;
+    slot->channels = channels;
+    slot->size = size;
+    slot->frameNumber = frameNumber;
+    slot->pts = pts;
+    slot->writeTimeMicros = getMonotonicMicros();
+    memcpy((unsigned char*)slot + header->dataOffset, data, size);
+
+    slot->lock.store(lock+2, std::memory_order_release);
+    writeSequence = sequence;
+    header->published.store(sequence, std::memory_order_release);
+    futexWakeAll(&header->published);
+    return true;
+}
+
+#pragma mark READER
+
+bool ofxOMXSharedFrameRing::open(std::string name_)
+{
+    close();
+    fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ofxOMXSharedFrameHeader))
+    {
+        close();
+        return false;
+    }
+    //PROT_READ only, readers can never corrupt the ring. The futex word is
+    //only waited on, which does not need write access.
+    mapped = (unsigned char*)mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED)
+    {
+        mapped = NULL;
+        close();
+        return false;
+    }
+    mappedSize = info.st_size;
+    header = (ofxOMXSharedFrameHeader*)mapped;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(header->magic != OMX_SHARED_FRAME_MAGIC || header->version != OMX_SHARED_FRAME_VERSION)
+    {
+        close();
+        return false;
+    }
+    name = name_;
+    isWriter = false;
+    return true;
+}
+
+uint32_t ofxOMXSharedFrameRing::waitForFrame(uint32_t lastSequence, int timeoutMillis)
+{
+    if(!header) return lastSequence;
+
+    uint64_t deadline = getMonotonicMicros() + (uint64_t)(timeoutMillis > 0 ? timeoutMillis : 0)*1000;
+    uint32_t published = header->published.load(std::memory_order_acquire);
+    while(published == lastSequence && header->writerAlive.load(std::memory_order_acquire))
+    {
+        struct timespec timeout;
+        struct timespec* timeoutPtr = NULL;
+        if(timeoutMillis >= 0)
+        {
+            uint64_t now = getMonotonicMicros();
+            if(now >= deadline)
+            {
+                break;
+            }
+            uint64_t remaining = deadline-now;
+            timeout.tv_sec = remaining/1000000;
+            timeout.tv_nsec = (remaining%1000000)*1000;
+            timeoutPtr = &timeout;
+        }
+        futexWait(&header->published, lastSequence, timeoutPtr);
+        published = header->published.load(std::memory_order_acquire);
+    }
+    return published;
+}
+
+uint32_t ofxOMXSharedFrameRing::getPublished()
+{
+    if(!header) return 0;
+    return header->published.load(std::memory_order_acquire);
+}
+
+bool ofxOMXSharedFrameRing::beginRead(uint32_t sequence, ofxOMXSharedFrameView& view)
+{
+    if(!header || sequence == 0) return false;
+
+    ofxOMXSharedFrameSlot* slot = getSlot(sequence);
+    uint32_t lock = slot->lock.load(std::memory_order_acquire);
+    if(lock & 1)
+    {
+        return false;
+    }
+    if(slot->sequence != sequence || slot->size > header->maxFrameBytes)
+    {
+        return false;
+    }
+    view.sequence = sequence;
+    view.width = slot->width;
+    view.height = slot->height;
+    view.channels = slot->channels;
+    view.size = slot->size;
+    view.frameNumber = slot->frameNumber;
+    view.pts = slot->pts;
+    view.writeTimeMicros = slot->writeTimeMicros;
+    view.data = (const unsigned char*)slot + header->dataOffset;
+    view.lock = lock;
+    view.slot = slot;
+    return true;
+}
+
+bool ofxOMXSharedFrameRing::endRead(const ofxOMXSharedFrameView& view)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot && view.slot->lock.load(std::memory_order_relaxed) == view.lock;
+}
+
+bool ofxOMXSharedFrameRing::isWriterAlive()
+{
+    return header && header->writerAlive.load(std::memory_order_acquire);
+}
+
+#pragma mark COMMON
+
+ofxOMXSharedFrameSlot* ofxOMXSharedFrameRing::getSlot(uint32_t sequence)
+{
+    size_t headerSize = alignTo(sizeof(ofxOMXSharedFrameHeader), 4096);
+    size_t index = sequence % header->numSlots;
+    return (ofxOMXSharedFrameSlot*)(mapped + headerSize + header->slotStride*index);
+}
+
+void ofxOMXSharedFrameRing::close()
+{
+    if(isWriter && header)
+    {
+        //wake blocked readers so they notice the writer is gone
+        header->writerAlive.store(0, std::memory_order_release);
+        futexWakeAll(&header->published);
+    }
+    if(mapped)
+    {
+        munmap(mapped, mappedSize);
+        mapped = NULL;
+    }
+    header = NULL;
+    mappedSize = 0;
+    if(fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    if(isWriter && !name.empty())
+    {
+        shm_unlink(name.c_str());
+    }
+    isWriter = false;
+    name = "";
+}
+
+bool ofxOMXSharedFrameRing::isOpen()
+{
+    return header != NULL;
+}
+
+int ofxOMXSharedFrameRing::getNumSlots()
+{
+    return header ? header->numSlots : 0;
+}
+
+int ofxOMXSharedFrameRing::getMaxFrameBytes()
+{
+    return header ? header->maxFrameBytes : 0;
+}
+
+std::string ofxOMXSharedFrameRing::getName()
+{
+    return name;
+}
+
+std::string ofxOMXSharedFrameRing::getLastError()
+{
+    return lastError;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+ Single writer, many reader frame ring in POSIX shared memory.
+
+ Layout: one ofxOMXSharedFrameHeader followed by numSlots slots of slotStride
+ bytes, each an ofxOMXSharedFrameSlot followed by the pixel data. The writer
+ never waits for readers. Each slot carries a seqlock style version (odd
+ while being written), so a reader works on the mapped pixels in place and
+ checks endRead() afterwards to learn whether the slot was overwritten
+ under it.
+
+ header->published counts frames written and doubles as a process-shared
+ futex word, so readers sleep in waitForFrame() until the writer bumps it.
+ No fds have to be passed between processes.
+
+ Only depends on libc/libstdc++ so out-of-process consumers can build it on
+ plain Linux without openFrameworks (link with -lrt on glibc < 2.34).
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <atomic>
+
+#define OMX_SHARED_FRAME_MAGIC      0x4f4d5846 //"OMXF"
+#define OMX_SHARED_FRAME_VERSION    1
+
+struct ofxOMXSharedFrameHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t slotStride;        //bytes from one slot header to the next
+    uint32_t maxFrameBytes;
+    uint32_t dataOffset;        //from the slot header to its pixels
+    std::atomic<uint32_t> published;    //frames written so far, futex word
+    std::atomic<uint32_t> writerAlive;
+};
+
+struct ofxOMXSharedFrameSlot
+{
+    std::atomic<uint32_t> lock;     //odd while the writer is inside
+    uint32_t sequence;              //value of published this frame was written as
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;              //1 gray, 3 RGB, 4 RGBA
+    uint32_t size;                  //bytes of pixel data
+    int32_t frameNumber;            //decoded frame sequence in the player
+    uint32_t reserved;
+    double pts;                     //seconds
+    uint64_t writeTimeMicros;       //CLOCK_MONOTONIC when the slot was published
+};
+
+//What a reader sees of one frame, data points into the mapping
+struct ofxOMXSharedFrameView
+{
+    uint32_t sequence;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t size;
+    int32_t frameNumber;
+    double pts;
+    uint64_t writeTimeMicros;
+    const unsigned char* data;
+    uint32_t lock;
+    const ofxOMXSharedFrameSlot* slot;
+};
+
+class ofxOMXSharedFrameRing
+{
+public:
+    ofxOMXSharedFrameRing();
+    ~ofxOMXSharedFrameRing();
+
+    //writer - name is a shm_open name like "/ofxomxplayer". Readers only need
+    //read access, so others get none to write with unless mode says so
+    bool create(std::string name, int numSlots, int maxFrameBytes, mode_t mode = 0644);
+    bool publish(const unsigned char* data, int width, int height, int channels, int frameNumber, double pts);
+
+    //reader
+    bool open(std::string name);
+    //blocks until a frame newer than lastSequence is published, returns the
+    //newest sequence or lastSequence on timeout (timeoutMillis < 0 waits forever)
+    uint32_t waitForFrame(uint32_t lastSequence, int timeoutMillis);
+    uint32_t getPublished();
+    bool beginRead(uint32_t sequence, ofxOMXSharedFrameView& view);
+    bool endRead(const ofxOMXSharedFrameView& view);   //false if the frame was overwritten meanwhile
+    bool isWriterAlive();
+
+    void close();
+    bool isOpen();
+    int getNumSlots();
+    int getMaxFrameBytes();
+    std::string getName();
+    std::string getLastError();     //why create() failed, for the caller to log
+    static uint64_t getMonotonicMicros();
+
+private:
+    ofxOMXSharedFrameSlot* getSlot(uint32_t sequence);
+
+    std::string name;
+    std::string lastError;
+    bool isWriter;
+    int fd;
+    size_t mappedSize;
+    unsigned char* mapped;
+    ofxOMXSharedFrameHeader* header;
+    uint32_t writeSequence;
+};
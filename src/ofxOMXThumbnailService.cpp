@@ -0,0 +1,309 @@
+#include "ofxOMXThumbnailService.h"
+#include "OMXGlobalInit.h"
+#include <sys/stat.h>
+#include <thread>
+
+string ofxOMXThumbnailRequest::getCacheKey()
+{
+    //size and mtime so a replaced file is not served from the cache
+    struct stat info;
+    int64_t size = 0;
+    int64_t modified = 0;
+    if(stat(videoPath.c_str(), &info) == 0)
+    {
+        size = info.st_size;
+        modified = info.st_mtime;
+    }
+    stringstream key;
+    key << videoPath << "|" << size << "|" << modified << "|" << timeMillis << "|"
+    << width << "x" << height << "|" << format << "|" << accurate;
+    return key.str();
+}
+
+#pragma mark DECODER
+
+bool ofxOMXThumbnailDecoder::extract(ofxOMXThumbnailRequest& request, ofxOMXThumbnail& thumbnail)
+{
+    uint64_t startTime = ofGetElapsedTimeMicros();
+    thumbnail.request = request;
+    thumbnail.success = false;
+    thumbnail.pts = 0;
+    thumbnail.videoWidth = 0;
+    thumbnail.videoHeight = 0;
+    thumbnail.durationMillis = 0;
+    thumbnail.decodeMillis = 0;
+    thumbnail.fromCache = false;
+
+    if(decoder.Decode(request.videoPath, request.timeMillis, request.accurate))
+    {
+        thumbnail.videoWidth = decoder.GetWidth();
+        thumbnail.videoHeight = decoder.GetHeight();
+        thumbnail.durationMillis = decoder.GetDuration();
+        thumbnail.pts = decoder.GetPts();
+
+        AVPixelFormat targetFormat = AV_PIX_FMT_RGB24;
+        ofPixelFormat format = request.format;
+        switch(format)
+        {
+            case OF_PIXELS_GRAY:    targetFormat = AV_PIX_FMT_GRAY8;    break;
+            case OF_PIXELS_RGBA:    targetFormat = AV_PIX_FMT_RGBA;     break;
+            default:                format = OF_PIXELS_RGB;             break;
+        }
+        int width = request.width;
+        int height = request.height;
+        decoder.GetScaledSize(width, height);
+        thumbnail.pixels.allocate(width, height, format);
+        thumbnail.success = decoder.Scale(thumbnail.pixels.getData(), width*thumbnail.pixels.getNumChannels(), width, height, targetFormat);
+        decoder.Close();
+    }
+    thumbnail.decodeMillis = (ofGetElapsedTimeMicros()-startTime)/1000.0f;
+    return thumbnail.success;
+}
+
+#pragma mark WORKER
+
+ofxOMXThumbnailWorker::ofxOMXThumbnailWorker(ofxOMXThumbnailService* service_)
+{
+    service = service_;
+}
+
+void ofxOMXThumbnailWorker::threadedFunction()
+{
+    ofxOMXThumbnailService::Job job;
+    while(service->waitForJob(job))
+    {
+        ofxOMXThumbnailRef thumbnail = service->decode(decoder, job.request);
+        service->finish(job, thumbnail);
+    }
+}
+
+#pragma mark SERVICE
+
+ofxOMXThumbnailService::ofxOMXThumbnailService()
+{
+    doStop = false;
+    cacheSize = 64;
+}
+
+ofxOMXThumbnailService::~ofxOMXThumbnailService()
+{
+    close();
+}
+
+void ofxOMXThumbnailService::setup(int numWorkers, int cacheSize_)
+{
+    close();
+    COMXGlobalInit::InitializeFFmpeg();
+    if(numWorkers <= 0)
+    {
+        numWorkers = max(1, (int)std::thread::hardware_concurrency());
+    }
+    cacheSize = max(0, cacheSize_);
+    doStop = false;
+    for(int i=0; i<numWorkers; i++)
+    {
+        ofxOMXThumbnailWorker* worker = new ofxOMXThumbnailWorker(this);
+        workers.push_back(worker);
+        worker->startThread();
+    }
+}
+
+void ofxOMXThumbnailService::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        doStop = true;
+        jobs.clear();
+    }
+    jobCondition.notify_all();
+    for(size_t i=0; i<workers.size(); i++)
+    {
+        workers[i]->waitForThread(true);
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+void ofxOMXThumbnailService::request(ofxOMXThumbnailRequest request, ofxOMXThumbnailListener* listener)
+{
+    ofxOMXThumbnailRef cached = findCached(request.getCacheKey());
+    if(cached)
+    {
+        if(listener)
+        {
+            listener->onThumbnail(cached);
+        }
+        return;
+    }
+    if(workers.empty())
+    {
+        ofLogError(__func__) << "call setup() first";
+        return;
+    }
+    Job job;
+    job.request = request;
+    job.listener = listener;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stats.numRequested++;
+        jobs.push_back(job);
+    }
+    jobCondition.notify_one();
+}
+
+ofxOMXThumbnailRef ofxOMXThumbnailService::extract(ofxOMXThumbnailRequest request)
+{
+    ofxOMXThumbnailRef cached = findCached(request.getCacheKey());
+    if(cached)
+    {
+        return cached;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stats.numRequested++;
+    }
+    ofxOMXThumbnailDecoder decoder;
+    return decode(decoder, request);
+}
+
+void ofxOMXThumbnailService::removeListener(ofxOMXThumbnailListener* listener)
+{
+    //taking the delivery lock waits out a callback that is already running
+    std::lock_guard<std::mutex> delivering(deliveryMutex);
+    std::lock_guard<std::mutex> guard(mutex);
+    for(size_t i=0; i<jobs.size(); i++)
+    {
+        if(jobs[i].listener == listener)
+        {
+            jobs[i].listener = NULL;
+        }
+    }
+    for(size_t i=0; i<activeJobs.size(); i++)
+    {
+        if(activeJobs[i]->listener == listener)
+        {
+            activeJobs[i]->listener = NULL;
+        }
+    }
+}
+
+bool ofxOMXThumbnailService::waitForJob(Job& job)
+{
+    std::unique_lock<std::mutex> guard(mutex);
+    while(jobs.empty() && !doStop)
+    {
+        jobCondition.wait(guard);
+    }
+    if(doStop)
+    {
+        return false;
+    }
+    job = jobs.front();
+    jobs.pop_front();
+    activeJobs.push_back(&job);
+    return true;
+}
+
+ofxOMXThumbnailRef ofxOMXThumbnailService::decode(ofxOMXThumbnailDecoder& decoder, ofxOMXThumbnailRequest& request)
+{
+    //a request queued twice may have been decoded while this one waited
+    string key = request.getCacheKey();
+    ofxOMXThumbnailRef thumbnail = findCached(key);
+    if(thumbnail)
+    {
+        return thumbnail;
+    }
+
+    thumbnail = ofxOMXThumbnailRef(new ofxOMXThumbnail());
+    bool success = decoder.extract(request, *thumbnail);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if(!success)
+    {
+        stats.numFailed++;
+        return thumbnail;
+    }
+    stats.numDecoded++;
+    stats.averageDecodeMillis += (thumbnail->decodeMillis-stats.averageDecodeMillis)/stats.numDecoded;
+    //another worker or extract() may have decoded the same key meanwhile
+    if(cacheSize > 0 && !touchCached(key))
+    {
+        cache.push_front(make_pair(key, thumbnail));
+        while((int)cache.size() > cacheSize)
+        {
+            cache.pop_back();
+        }
+    }
+    return thumbnail;
+}
+
+ofxOMXThumbnailRef ofxOMXThumbnailService::findCached(string key)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    for(list<pair<string, ofxOMXThumbnailRef> >::iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        if(it->first == key)
+        {
+            ofxOMXThumbnailRef found = it->second;
+            cache.splice(cache.begin(), cache, it);
+            stats.numCacheHits++;
+            //copy so callers can't see fromCache change under them
+            ofxOMXThumbnailRef result(new ofxOMXThumbnail(*found));
+            result->fromCache = true;
+            return result;
+        }
+    }
+    return ofxOMXThumbnailRef();
+}
+
+//moves key to the front if it is cached, mutex must be held
+bool ofxOMXThumbnailService::touchCached(string& key)
+{
+    for(list<pair<string, ofxOMXThumbnailRef> >::iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        if(it->first == key)
+        {
+            cache.splice(cache.begin(), cache, it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ofxOMXThumbnailService::finish(Job& job, ofxOMXThumbnailRef thumbnail)
+{
+    std::lock_guard<std::mutex> delivering(deliveryMutex);
+    ofxOMXThumbnailListener* listener = NULL;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        listener = job.listener;
+        activeJobs.erase(std::remove(activeJobs.begin(), activeJobs.end(), &job), activeJobs.end());
+    }
+    if(listener)
+    {
+        listener->onThumbnail(thumbnail);
+    }
+}
+
+int ofxOMXThumbnailService::getNumQueued()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return jobs.size();
+}
+
+int ofxOMXThumbnailService::getNumWorkers()
+{
+    return workers.size();
+}
+
+ofxOMXThumbnailStats ofxOMXThumbnailService::getStats()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return stats;
+}
+
+void ofxOMXThumbnailService::clearCache()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    cache.clear();
+}
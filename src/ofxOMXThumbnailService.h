@@ -0,0 +1,153 @@
+#pragma once
+
+#include "ofMain.h"
+#include "OMXThumbnailDecoder.h"
+#include <condition_variable>
+
+/*
+ Software poster frame / thumbnail extraction.
+
+ Each request is decoded by COMXThumbnailDecoder: OMXReader seeks back to
+ the keyframe at or before timeMillis and libavcodec decodes in software.
+ With accurate set it keeps decoding up to the requested time. swscale then
+ converts and scales to the requested size.
+
+ Nothing here touches OMX or GL (only ffmpeg is initialised), so it runs on
+ any Linux box with openFrameworks and on as many workers as there are
+ cores. Results are cached (LRU) by path, file size/mtime, time, size and
+ format.
+ */
+
+struct ofxOMXThumbnailRequest
+{
+    ofxOMXThumbnailRequest()
+    {
+        timeMillis = 0;
+        width = 0;
+        height = 0;
+        format = OF_PIXELS_RGB;
+        accurate = false;
+    }
+    string videoPath;
+    int timeMillis;         //negative picks a point 10% into the video
+    int width;              //0 keeps the video's display aspect ratio
+    int height;
+    ofPixelFormat format;   //RGB, RGBA or GRAY
+    bool accurate;          //decode past the keyframe up to timeMillis
+    string getCacheKey();
+};
+
+struct ofxOMXThumbnail
+{
+    ofxOMXThumbnailRequest request;
+    ofPixels pixels;
+    bool success;
+    double pts;             //seconds, of the frame that was decoded
+    int videoWidth;
+    int videoHeight;
+    int durationMillis;
+    float decodeMillis;     //open, seek, decode and scale
+    bool fromCache;
+};
+
+typedef shared_ptr<ofxOMXThumbnail> ofxOMXThumbnailRef;
+
+class ofxOMXThumbnailListener
+{
+public:
+    virtual ~ofxOMXThumbnailListener(){};
+    //called on a worker thread, one callback at a time
+    virtual void onThumbnail(ofxOMXThumbnailRef thumbnail) = 0;
+};
+
+//Decodes one thumbnail at a time, one of these per worker
+class ofxOMXThumbnailDecoder
+{
+public:
+    bool extract(ofxOMXThumbnailRequest& request, ofxOMXThumbnail& thumbnail);
+
+private:
+    COMXThumbnailDecoder decoder;
+};
+
+struct ofxOMXThumbnailStats
+{
+    ofxOMXThumbnailStats()
+    {
+        numRequested = 0;
+        numDecoded = 0;
+        numFailed = 0;
+        numCacheHits = 0;
+        averageDecodeMillis = 0;
+    }
+    int numRequested;
+    int numDecoded;
+    int numFailed;
+    int numCacheHits;
+    float averageDecodeMillis;
+};
+
+class ofxOMXThumbnailService;
+
+class ofxOMXThumbnailWorker : public ofThread
+{
+public:
+    ofxOMXThumbnailWorker(ofxOMXThumbnailService* service_);
+    void threadedFunction();
+
+private:
+    ofxOMXThumbnailService* service;
+    ofxOMXThumbnailDecoder decoder;
+};
+
+class ofxOMXThumbnailService
+{
+public:
+    ofxOMXThumbnailService();
+    ~ofxOMXThumbnailService();
+
+    //numWorkers 0 uses one per core
+    void setup(int numWorkers = 0, int cacheSize = 64);
+    //waits for the workers to finish their current thumbnail, drops the rest
+    void close();
+
+    //any thread - cache hits call the listener right away on the calling thread
+    void request(ofxOMXThumbnailRequest request, ofxOMXThumbnailListener* listener);
+    //any thread - decodes on the calling thread unless it is cached
+    ofxOMXThumbnailRef extract(ofxOMXThumbnailRequest request);
+    //stop calling listener, blocks while one of its callbacks is running so
+    //it must not be called from inside onThumbnail
+    void removeListener(ofxOMXThumbnailListener* listener);
+
+    int getNumQueued();
+    int getNumWorkers();
+    ofxOMXThumbnailStats getStats();
+    void clearCache();
+
+private:
+    friend class ofxOMXThumbnailWorker;
+
+    struct Job
+    {
+        ofxOMXThumbnailRequest request;
+        ofxOMXThumbnailListener* listener;
+    };
+    bool waitForJob(Job& job);
+    ofxOMXThumbnailRef decode(ofxOMXThumbnailDecoder& decoder, ofxOMXThumbnailRequest& request);
+    ofxOMXThumbnailRef findCached(string key);
+    bool touchCached(string& key);
+    void finish(Job& job, ofxOMXThumbnailRef thumbnail);
+
+    vector<ofxOMXThumbnailWorker*> workers;
+    std::mutex mutex;
+    std::mutex deliveryMutex;       //held while a listener runs
+    vector<Job*> activeJobs;        //being decoded, so removeListener can reach them
+    std::condition_variable jobCondition;
+    deque<Job> jobs;
+    bool doStop;
+
+    //most recently used at the front
+    list<pair<string, ofxOMXThumbnailRef> > cache;
+    int cacheSize;
+    ofxOMXThumbnailStats stats;
+};
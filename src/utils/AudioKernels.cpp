@@ -0,0 +1,651 @@
+#include "AudioKernels.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_KERNELS_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_KERNELS_SSE2 1
+#endif
+
+static inline int16_t ClipS16(long value)
+{
+  return value > 32767 ? 32767 : (value < -32768 ? -32768 : (int16_t)value);
+}
+
+static inline int32_t ClipS32(long long value)
+{
+  return value > 2147483647LL ? 2147483647 : (value < -2147483647LL-1 ? (int32_t)(-2147483647LL-1) : (int32_t)value);
+}
+
+#if defined(AUDIO_KERNELS_NEON)
+// ARMv7 NEON has no round to nearest float->int convert (vcvtq truncates), so
+// round in float first. Adding and removing 2^23 leaves the nearest even
+// integer for anything smaller, bigger values are already integers.
+static inline float32x4_t RoundNearest(float32x4_t v)
+{
+  const float32x4_t limit = vdupq_n_f32(8388608.0f);
+  uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000));
+  float32x4_t magic = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(limit), sign));
+  float32x4_t rounded = vsubq_f32(vaddq_f32(v, magic), magic);
+  return vbslq_f32(vcltq_f32(vabsq_f32(v), limit), rounded, v);
+}
+
+static inline int16x4_t FloatToS16x4(float32x4_t v)
+{
+  // vcvtq and vqmovn both saturate
+  return vqmovn_s32(vcvtq_s32_f32(RoundNearest(vmulq_n_f32(v, 32768.0f))));
+}
+#elif defined(AUDIO_KERNELS_SSE2)
+static inline __m128i FloatToS32x4(__m128 v)
+{
+  // cvtps returns 0x80000000 on overflow, which is right for negative values
+  // and needs flipping to 0x7fffffff for positive ones
+  __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(v, _mm_set1_ps(2147483648.0f)));
+  return _mm_xor_si128(_mm_cvtps_epi32(v), overflow);
+}
+
+static inline __m128i S16ToS32Lo(__m128i v)
+{
+  return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static inline __m128i S16ToS32Hi(__m128i v)
+{
+  return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+#endif
+
+void AudioKernels::Interleave32(const void* const* src, void* dst, int channels, int samples)
+{
+  uint32_t* out = (uint32_t*)dst;
+  if (channels == 1)
+  {
+    memcpy(out, src[0], samples * 4);
+    return;
+  }
+  int i = 0;
+  if (channels == 2)
+  {
+    const uint32_t* left = (const uint32_t*)src[0];
+    const uint32_t* right = (const uint32_t*)src[1];
+#if defined(AUDIO_KERNELS_NEON)
+    for (; i + 4 <= samples; i += 4)
+    {
+      uint32x4x2_t lr;
+      lr.val[0] = vld1q_u32(left + i);
+      lr.val[1] = vld1q_u32(right + i);
+      vst2q_u32(out + i * 2, lr);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    for (; i + 4 <= samples; i += 4)
+    {
+      __m128i l = _mm_loadu_si128((const __m128i*)(left + i));
+      __m128i r = _mm_loadu_si128((const __m128i*)(right + i));
+      _mm_storeu_si128((__m128i*)(out + i * 2), _mm_unpacklo_epi32(l, r));
+      _mm_storeu_si128((__m128i*)(out + i * 2 + 4), _mm_unpackhi_epi32(l, r));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+      out[i * 2] = left[i];
+      out[i * 2 + 1] = right[i];
+    }
+    return;
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    const uint32_t* plane = (const uint32_t*)src[c];
+    uint32_t* o = out + c;
+    for (i = 0; i < samples; i++, o += channels)
+      *o = plane[i];
+  }
+}
+
+void AudioKernels::Deinterleave32(const void* src, void* const* dst, int channels, int samples)
+{
+  const uint32_t* in = (const uint32_t*)src;
+  if (channels == 1)
+  {
+    memcpy(dst[0], in, samples * 4);
+    return;
+  }
+  int i = 0;
+  if (channels == 2)
+  {
+    uint32_t* left = (uint32_t*)dst[0];
+    uint32_t* right = (uint32_t*)dst[1];
+#if defined(AUDIO_KERNELS_NEON)
+    for (; i + 4 <= samples; i += 4)
+    {
+      uint32x4x2_t lr = vld2q_u32(in + i * 2);
+      vst1q_u32(left + i, lr.val[0]);
+      vst1q_u32(right + i, lr.val[1]);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    for (; i + 4 <= samples; i += 4)
+    {
+      __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + i * 2)));
+      __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(in + i * 2 + 4)));
+      _mm_storeu_si128((__m128i*)(left + i), _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+      _mm_storeu_si128((__m128i*)(right + i), _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+      left[i] = in[i * 2];
+      right[i] = in[i * 2 + 1];
+    }
+    return;
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    uint32_t* plane = (uint32_t*)dst[c];
+    const uint32_t* s = in + c;
+    for (i = 0; i < samples; i++, s += channels)
+      plane[i] = *s;
+  }
+}
+
+void AudioKernels::Interleave16(const int16_t* const* src, int16_t* dst, int channels, int samples)
+{
+  if (channels == 1)
+  {
+    memcpy(dst, src[0], samples * 2);
+    return;
+  }
+  int i = 0;
+  if (channels == 2)
+  {
+    const int16_t* left = src[0];
+    const int16_t* right = src[1];
+#if defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= samples; i += 8)
+    {
+      int16x8x2_t lr;
+      lr.val[0] = vld1q_s16(left + i);
+      lr.val[1] = vld1q_s16(right + i);
+      vst2q_s16(dst + i * 2, lr);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m128i l = _mm_loadu_si128((const __m128i*)(left + i));
+      __m128i r = _mm_loadu_si128((const __m128i*)(right + i));
+      _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi16(l, r));
+      _mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+      dst[i * 2] = left[i];
+      dst[i * 2 + 1] = right[i];
+    }
+    return;
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    const int16_t* plane = src[c];
+    int16_t* o = dst + c;
+    for (i = 0; i < samples; i++, o += channels)
+      *o = plane[i];
+  }
+}
+
+void AudioKernels::Deinterleave16(const int16_t* src, int16_t* const* dst, int channels, int samples)
+{
+  if (channels == 1)
+  {
+    memcpy(dst[0], src, samples * 2);
+    return;
+  }
+  int i = 0;
+  if (channels == 2)
+  {
+    int16_t* left = dst[0];
+    int16_t* right = dst[1];
+#if defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= samples; i += 8)
+    {
+      int16x8x2_t lr = vld2q_s16(src + i * 2);
+      vst1q_s16(left + i, lr.val[0]);
+      vst1q_s16(right + i, lr.val[1]);
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    for (; i + 8 <= samples; i += 8)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + i * 2 + 8));
+      // the sign extended halves of each pair are in range, so packs is exact
+      __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+      __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+      _mm_storeu_si128((__m128i*)(left + i), l);
+      _mm_storeu_si128((__m128i*)(right + i), r);
+    }
+#endif
+    for (; i < samples; i++)
+    {
+      left[i] = src[i * 2];
+      right[i] = src[i * 2 + 1];
+    }
+    return;
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    int16_t* plane = dst[c];
+    const int16_t* s = src + c;
+    for (i = 0; i < samples; i++, s += channels)
+      plane[i] = *s;
+  }
+}
+
+void AudioKernels::S16ToFloat(const int16_t* src, float* dst, int count)
+{
+  const float scale = 1.0f / (1 << 15);
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 8 <= count; i += 8)
+  {
+    int16x8_t v = vld1q_s16(src + i);
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+  }
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 s = _mm_set1_ps(scale);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Lo(v)), s));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Hi(v)), s));
+  }
+#endif
+  for (; i < count; i++)
+    dst[i] = src[i] * scale;
+}
+
+void AudioKernels::S32ToFloat(const int32_t* src, float* dst, int count)
+{
+  const float scale = 1.0f / (1U << 31);
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 s = _mm_set1_ps(scale);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i))), s));
+#endif
+  for (; i < count; i++)
+    dst[i] = src[i] * scale;
+}
+
+void AudioKernels::FloatToS16(const float* src, int16_t* dst, int count)
+{
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 8 <= count; i += 8)
+    vst1q_s16(dst + i, vcombine_s16(FloatToS16x4(vld1q_f32(src + i)), FloatToS16x4(vld1q_f32(src + i + 4))));
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 scale = _mm_set1_ps(32768.0f);
+  for (; i + 8 <= count; i += 8)
+  {
+    // packs saturates, only values beyond int32 need the overflow fix
+    __m128i lo = FloatToS32x4(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+    __m128i hi = FloatToS32x4(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < count; i++)
+    dst[i] = ClipS16(lrintf(src[i] * (1 << 15)));
+}
+
+void AudioKernels::FloatToS32(const float* src, int32_t* dst, int count)
+{
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 4 <= count; i += 4)
+    vst1q_s32(dst + i, vcvtq_s32_f32(RoundNearest(vmulq_n_f32(vld1q_f32(src + i), 2147483648.0f))));
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 scale = _mm_set1_ps(2147483648.0f);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_si128((__m128i*)(dst + i), FloatToS32x4(_mm_mul_ps(_mm_loadu_ps(src + i), scale)));
+#endif
+  for (; i < count; i++)
+    dst[i] = ClipS32(llrintf(src[i] * (1U << 31)));
+}
+
+void AudioKernels::S16ToFloatPlanar(const int16_t* src, float* const* dst, int channels, int samples)
+{
+  if (channels == 1)
+  {
+    S16ToFloat(src, dst[0], samples);
+    return;
+  }
+  const float scale = 1.0f / (1 << 15);
+  int i = 0;
+  if (channels == 2)
+  {
+    float* left = dst[0];
+    float* right = dst[1];
+#if defined(AUDIO_KERNELS_NEON)
+    for (; i + 8 <= samples; i += 8)
+    {
+      int16x8x2_t lr = vld2q_s16(src + i * 2);
+      vst1q_f32(left + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lr.val[0]))), scale));
+      vst1q_f32(left + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lr.val[0]))), scale));
+      vst1q_f32(right + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lr.val[1]))), scale));
+      vst1q_f32(right + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lr.val[1]))), scale));
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 4 <= samples; i += 4)
+    {
+      // l0 r0 l1 r1 l2 r2 l3 r3 as int32: low halves are left, high halves right
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      _mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16)), s));
+      _mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 16)), s));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+      left[i] = src[i * 2] * scale;
+      right[i] = src[i * 2 + 1] * scale;
+    }
+    return;
+  }
+  for (int c = 0; c < channels; c++)
+  {
+    float* plane = dst[c];
+    const int16_t* s = src + c;
+    for (i = 0; i < samples; i++, s += channels)
+      plane[i] = *s * scale;
+  }
+}
+
+void AudioKernels::ApplyGain(const float* src, float* dst, int count, float gain)
+{
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(src + i), gain));
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+#endif
+  for (; i < count; i++)
+    dst[i] = src[i] * gain;
+}
+
+void AudioKernels::ApplyGainS16(const int16_t* src, int16_t* dst, int count, float gain)
+{
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 8 <= count; i += 8)
+  {
+    int16x8_t v = vld1q_s16(src + i);
+    float32x4_t lo = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), gain);
+    float32x4_t hi = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), gain);
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(RoundNearest(lo))), vqmovn_s32(vcvtq_s32_f32(RoundNearest(hi)))));
+  }
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = FloatToS32x4(_mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Lo(v)), g));
+    __m128i hi = FloatToS32x4(_mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Hi(v)), g));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < count; i++)
+    dst[i] = ClipS16(lrintf(src[i] * gain));
+}
+
+void AudioKernels::AccumulateS16(const int16_t* src, float* dst, int count, float gain)
+{
+  // scale and gain in one multiply, exact for a power of two gain
+  const float g = gain / (1 << 15);
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  for (; i + 8 <= count; i += 8)
+  {
+    int16x8_t v = vld1q_s16(src + i);
+    vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), g));
+    vst1q_f32(dst + i + 4, vmlaq_n_f32(vld1q_f32(dst + i + 4), vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), g));
+  }
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 s = _mm_set1_ps(g);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Lo(v)), s)));
+    _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(S16ToS32Hi(v)), s)));
+  }
+#endif
+  for (; i < count; i++)
+    dst[i] += src[i] * g;
+}
+
+void AudioKernels::Mix(const float* src, int inChannels, float* dst, int outChannels, const float* matrix, int frames)
+{
+  int f = 0;
+#if defined(AUDIO_KERNELS_NEON) || defined(AUDIO_KERNELS_SSE2)
+  // each frame is loaded as one or two full vectors, so the loop stops before
+  // that would read past the last frame. The extra samples from the next
+  // frame meet zero weights.
+  int loaded = inChannels > 4 ? 8 : 4;
+  int vectorFrames = frames * inChannels >= loaded ? (frames * inChannels - loaded) / inChannels + 1 : 0;
+  if (inChannels > 8)
+    vectorFrames = 0;
+  for (; f < vectorFrames; f++)
+  {
+    const float* in = src + f * inChannels;
+    float* out = dst + f * outChannels;
+#if defined(AUDIO_KERNELS_NEON)
+    float32x4_t lo = vld1q_f32(in);
+    float32x4_t hi = loaded > 4 ? vld1q_f32(in + 4) : vdupq_n_f32(0.0f);
+    int o = 0;
+    for (; o + 2 <= outChannels; o += 2)
+    {
+      const float* m = matrix + o * 8;
+      float32x4_t a = vmlaq_f32(vmulq_f32(lo, vld1q_f32(m)), hi, vld1q_f32(m + 4));
+      float32x4_t b = vmlaq_f32(vmulq_f32(lo, vld1q_f32(m + 8)), hi, vld1q_f32(m + 12));
+      float32x2_t pa = vpadd_f32(vget_low_f32(a), vget_high_f32(a));
+      float32x2_t pb = vpadd_f32(vget_low_f32(b), vget_high_f32(b));
+      vst1_f32(out + o, vpadd_f32(pa, pb));
+    }
+    if (o < outChannels)
+    {
+      const float* m = matrix + o * 8;
+      float32x4_t a = vmlaq_f32(vmulq_f32(lo, vld1q_f32(m)), hi, vld1q_f32(m + 4));
+      float32x2_t pa = vpadd_f32(vget_low_f32(a), vget_high_f32(a));
+      vst1_lane_f32(out + o, vpadd_f32(pa, pa), 0);
+    }
+#else
+    __m128 lo = _mm_loadu_ps(in);
+    __m128 hi = loaded > 4 ? _mm_loadu_ps(in + 4) : _mm_setzero_ps();
+    int o = 0;
+    for (; o + 2 <= outChannels; o += 2)
+    {
+      const float* m = matrix + o * 8;
+      __m128 a = _mm_add_ps(_mm_mul_ps(lo, _mm_loadu_ps(m)), _mm_mul_ps(hi, _mm_loadu_ps(m + 4)));
+      __m128 b = _mm_add_ps(_mm_mul_ps(lo, _mm_loadu_ps(m + 8)), _mm_mul_ps(hi, _mm_loadu_ps(m + 12)));
+      // a0+a2 b0+b2 a1+a3 b1+b3, then fold the upper pair onto the lower
+      __m128 sum = _mm_add_ps(_mm_unpacklo_ps(a, b), _mm_unpackhi_ps(a, b));
+      sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+      _mm_storel_pi((__m64*)(out + o), sum);
+    }
+    if (o < outChannels)
+    {
+      const float* m = matrix + o * 8;
+      __m128 a = _mm_add_ps(_mm_mul_ps(lo, _mm_loadu_ps(m)), _mm_mul_ps(hi, _mm_loadu_ps(m + 4)));
+      __m128 sum = _mm_add_ps(_mm_unpacklo_ps(a, a), _mm_unpackhi_ps(a, a));
+      sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+      _mm_store_ss(out + o, sum);
+    }
+#endif
+  }
+#endif
+  for (; f < frames; f++)
+  {
+    const float* in = src + f * inChannels;
+    float* out = dst + f * outChannels;
+    for (int o = 0; o < outChannels; o++)
+    {
+      const float* m = matrix + o * 8;
+      float sum = 0.0f;
+      for (int i = 0; i < inChannels && i < 8; i++)
+        sum += in[i] * m[i];
+      out[o] = sum;
+    }
+  }
+}
+
+float AudioKernels::Peak(const float* src, int count)
+{
+  int i = 0;
+  float peak = 0.0f;
+#if defined(AUDIO_KERNELS_NEON)
+  float32x4_t max = vdupq_n_f32(0.0f);
+  for (; i + 4 <= count; i += 4)
+    max = vmaxq_f32(max, vabsq_f32(vld1q_f32(src + i)));
+  float32x2_t pair = vpmax_f32(vget_low_f32(max), vget_high_f32(max));
+  peak = vget_lane_f32(vpmax_f32(pair, pair), 0);
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 max = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4)
+    max = _mm_max_ps(max, _mm_and_ps(_mm_loadu_ps(src + i), absMask));
+  max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+  max = _mm_max_ss(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 1, 1, 1)));
+  peak = _mm_cvtss_f32(max);
+#endif
+  for (; i < count; i++)
+  {
+    float value = fabsf(src[i]);
+    if (value > peak)
+      peak = value;
+  }
+  return peak;
+}
+
+void AudioKernels::Levels(const float* src, int channels, int frames, float* peak, float* rms)
+{
+  float sum[8];
+  int f = 0;
+  for (int c = 0; c < channels; c++)
+  {
+    peak[c] = 0.0f;
+    sum[c] = 0.0f;
+  }
+#if defined(AUDIO_KERNELS_NEON) || defined(AUDIO_KERNELS_SSE2)
+  // Interleaved channels repeat every lcm(channels, 4) floats, so lane l of
+  // the v-th vector in that period always holds channel (v*4+l) % channels.
+  // Keep one max and one sum of squares per vector of the period (at most 7,
+  // for 7 channels) and fold the lanes into channels at the end.
+  int period = channels;
+  while (period % 4)
+    period += channels;
+  const int vectors = period / 4;
+  const int periodFrames = period / channels;
+  float lanesMax[7*4], lanesSum[7*4];
+#if defined(AUDIO_KERNELS_NEON)
+  float32x4_t max[7], sq[7];
+  for (int v = 0; v < vectors; v++)
+  {
+    max[v] = vdupq_n_f32(0.0f);
+    sq[v] = vdupq_n_f32(0.0f);
+  }
+  for (; f + periodFrames <= frames; f += periodFrames)
+  {
+    const float* in = src + f * channels;
+    for (int v = 0; v < vectors; v++)
+    {
+      float32x4_t x = vld1q_f32(in + v * 4);
+      max[v] = vmaxq_f32(max[v], vabsq_f32(x));
+      sq[v] = vmlaq_f32(sq[v], x, x);
+    }
+  }
+  for (int v = 0; v < vectors; v++)
+  {
+    vst1q_f32(lanesMax + v * 4, max[v]);
+    vst1q_f32(lanesSum + v * 4, sq[v]);
+  }
+#else
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 max[7], sq[7];
+  for (int v = 0; v < vectors; v++)
+  {
+    max[v] = _mm_setzero_ps();
+    sq[v] = _mm_setzero_ps();
+  }
+  for (; f + periodFrames <= frames; f += periodFrames)
+  {
+    const float* in = src + f * channels;
+    for (int v = 0; v < vectors; v++)
+    {
+      __m128 x = _mm_loadu_ps(in + v * 4);
+      max[v] = _mm_max_ps(max[v], _mm_and_ps(x, absMask));
+      sq[v] = _mm_add_ps(sq[v], _mm_mul_ps(x, x));
+    }
+  }
+  for (int v = 0; v < vectors; v++)
+  {
+    _mm_storeu_ps(lanesMax + v * 4, max[v]);
+    _mm_storeu_ps(lanesSum + v * 4, sq[v]);
+  }
+#endif
+  for (int i = 0; i < period; i++)
+  {
+    int c = i % channels;
+    if (lanesMax[i] > peak[c])
+      peak[c] = lanesMax[i];
+    sum[c] += lanesSum[i];
+  }
+#endif
+  for (; f < frames; f++)
+  {
+    for (int c = 0; c < channels; c++)
+    {
+      float x = src[f * channels + c];
+      if (fabsf(x) > peak[c])
+        peak[c] = fabsf(x);
+      sum[c] += x * x;
+    }
+  }
+  for (int c = 0; c < channels; c++)
+    rms[c] = frames > 0 ? sqrtf(sum[c] / frames) : 0.0f;
+}
+
+void AudioKernels::Clip(const float* src, float* dst, int count)
+{
+  int i = 0;
+#if defined(AUDIO_KERNELS_NEON)
+  const float32x4_t upper = vdupq_n_f32(1.0f);
+  const float32x4_t lower = vdupq_n_f32(-1.0f);
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(dst + i, vmaxq_f32(vminq_f32(vld1q_f32(src + i), upper), lower));
+#elif defined(AUDIO_KERNELS_SSE2)
+  const __m128 upper = _mm_set1_ps(1.0f);
+  const __m128 lower = _mm_set1_ps(-1.0f);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(dst + i, _mm_max_ps(_mm_min_ps(_mm_loadu_ps(src + i), upper), lower));
+#endif
+  for (; i < count; i++)
+    dst[i] = src[i] > 1.0f ? 1.0f : (src[i] < -1.0f ? -1.0f : src[i]);
+}
+
+const char* AudioKernels::GetImplementation()
+{
+#if defined(AUDIO_KERNELS_NEON)
+  return "neon";
+#elif defined(AUDIO_KERNELS_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
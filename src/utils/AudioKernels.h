@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * Sample format kernels for the software audio path.
+ *
+ * NEON on the Pi, SSE2 on x86 so the same code can be benchmarked on a
+ * desktop, and a scalar tail/fallback everywhere else. Conversions follow
+ * swresample's conventions (S16 <-> float scales by 1<<15, S32 by 1<<31,
+ * float -> int rounds to nearest and saturates) so output is bit identical
+ * to what the decoder path produced before.
+ *
+ * Nothing here depends on ffmpeg or OMX.
+ */
+
+#include <stdint.h>
+
+namespace AudioKernels
+{
+  // planar <-> interleaved for any 4 byte sample (float or S32)
+  void Interleave32(const void* const* src, void* dst, int channels, int samples);
+  void Deinterleave32(const void* src, void* const* dst, int channels, int samples);
+
+  // planar <-> interleaved for S16
+  void Interleave16(const int16_t* const* src, int16_t* dst, int channels, int samples);
+  void Deinterleave16(const int16_t* src, int16_t* const* dst, int channels, int samples);
+
+  // sample format conversion, count is samples across all channels
+  void S16ToFloat(const int16_t* src, float* dst, int count);
+  void S32ToFloat(const int32_t* src, float* dst, int count);
+  void FloatToS16(const float* src, int16_t* dst, int count);
+  void FloatToS32(const float* src, int32_t* dst, int count);
+
+  // S16 interleaved straight to float planes, the common codec -> OMX case
+  void S16ToFloatPlanar(const int16_t* src, float* const* dst, int channels, int samples);
+
+  // in place gain, src and dst may be the same buffer
+  void ApplyGain(const float* src, float* dst, int count, float gain);
+  void ApplyGainS16(const int16_t* src, int16_t* dst, int count, float gain);
+  // dst += src * gain with S16 scaled to [-1, 1), for summing streams
+  void AccumulateS16(const int16_t* src, float* dst, int count, float gain);
+
+  // dst = matrix * src per frame for up to 8 interleaved input channels.
+  // matrix has outChannels rows of 8 weights, zero padded past inChannels.
+  void Mix(const float* src, int inChannels, float* dst, int outChannels, const float* matrix, int frames);
+
+  // largest absolute sample value
+  float Peak(const float* src, int count);
+  // per channel peak and RMS of interleaved audio, up to 8 channels
+  void Levels(const float* src, int channels, int frames, float* peak, float* rms);
+  // clamp to [-1, 1], src and dst may be the same buffer
+  void Clip(const float* src, float* dst, int count);
+
+  // name of the code path compiled in, for logs and benchmarks
+  const char* GetImplementation();
+};
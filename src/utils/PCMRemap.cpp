@@ -30,6 +30,7 @@
 
 #include "MathUtils.h"
 #include "PCMRemap.h"
+#include "AudioKernels.h"
 #include "utils/log.h"
 #ifdef _WIN32
 #include "../win32/PlatformDefs.h"
@@ -169,8 +170,6 @@ CPCMRemap::CPCMRemap() :
   m_outChannels (0),
   m_inSampleSize(0),
   m_ignoreLayout(false),
-  m_buf(NULL),
-  m_bufsize(0),
   m_attenuation (1.0),
   m_attenuationInc(0.0),
   m_attenuationMin(1.0),
@@ -188,9 +187,8 @@ CPCMRemap::~CPCMRemap()
 
 void CPCMRemap::Dispose()
 {
-  free(m_buf);
-  m_buf = NULL;
-  m_bufsize = 0;
+  memset(m_mixMatrix, 0, sizeof(m_mixMatrix));
+  memset(m_gainMatrix, 0, sizeof(m_gainMatrix));
 }
 
 /* resolves the channels recursively and returns the new index of tablePtr */
@@ -419,6 +417,23 @@ void CPCMRemap::BuildMap()
     }
     CLog::Log(LOGDEBUG, "CPCMRemap: %s = %s\n", PCMChannelStr(m_outMap[out_ch]).c_str(), s.c_str());
   }
+  BuildMixMatrix();
+}
+
+/* flattens the lookup table into the dense matrix Remap() multiplies with */
+void CPCMRemap::BuildMixMatrix()
+{
+  memset(m_mixMatrix, 0, sizeof(m_mixMatrix));
+  for (unsigned int ch = 0; ch < m_outChannels; ch++)
+  {
+    struct PCMMapInfo *info = m_lookupMap[m_outMap[ch]];
+    for(; info->channel != PCM_INVALID; info++)
+    {
+      unsigned int in_ch = info->in_offset >> 1;
+      if (in_ch < 8)
+        m_mixMatrix[ch * 8 + in_ch] += info->level;
+    }
+  }
 }
 
 void CPCMRemap::DumpMap(CStdString info, unsigned int channels, enum PCMChannels *channelMap)
@@ -502,7 +517,6 @@ void CPCMRemap::SetOutputFormat(unsigned int channels, enum PCMChannels *channel
   m_holdCounter = 0;
 }
 
-#if 0
 void CPCMRemap::Remap(void *data, void *out, unsigned int samples, long drc)
 {
   float gain = 1.0f;
@@ -515,79 +529,24 @@ void CPCMRemap::Remap(void *data, void *out, unsigned int samples, long drc)
 /* remap the supplied data into out, which must be pre-allocated */
 void CPCMRemap::Remap(void *data, void *out, unsigned int samples, float gain /*= 1.0f*/)
 {
-  CheckBufferSize(samples * m_outChannels * sizeof(float));
-
-  //set output buffer to 0
-  memset(out, 0, samples * m_outChannels * m_inSampleSize);
-
-  //set intermediate buffer to 0
-  memset(m_buf, 0, m_bufsize);
-
   ProcessInput(data, out, samples, gain);
-  //AddGain(m_buf, samples * m_outChannels, gain);
-  //ProcessLimiter(samples, gain);
-  ProcessOutput(out, samples, gain);
-}
-
-void CPCMRemap::CheckBufferSize(int size)
-{
-  if (m_bufsize < size)
-  {
-    m_bufsize = size;
-    m_buf = (float*)realloc(m_buf, m_bufsize);
-  }
+  ProcessLimiter((float*)out, samples, gain);
+  ProcessOutput((float*)out, samples);
 }
 
 void CPCMRemap::ProcessInput(void* data, void* out, unsigned int samples, float gain)
 {
-  for (unsigned int ch = 0; ch < m_outChannels; ch++)
+  const float* matrix = m_mixMatrix;
+  if (gain != 1.0f)
   {
-    struct PCMMapInfo *info = m_lookupMap[m_outMap[ch]];
-    if (info->channel == PCM_INVALID)
-      continue;
-
-    if (info->copy && gain == 1.0f) //do direct copy
-    {
-      uint8_t* src = (uint8_t*)data + info->in_offset;
-      uint8_t* dst = (uint8_t*)out  + ch * m_inSampleSize;
-      uint8_t* dstend = dst + samples * m_outStride;
-      while (dst < dstend)
-      {
-        *(float*)dst = *(float*)src;
-        src += m_inStride;
-        dst += m_outStride;
-      }
-    }
-    else //needs some volume change or mixing, put into intermediate buffer
-    {
-      for(; info->channel != PCM_INVALID; info++)
-      {
-        uint8_t* src = (uint8_t*)data + info->in_offset;
-        float*   dst = m_buf + ch;
-        float*   dstend = dst + samples * m_outChannels;
-        while (dst < dstend)
-        {
-          *dst += (float)(*(float*)src) * info->level;
-          src += m_inStride;
-          dst += m_outChannels;
-        }
-      }
-    }
-  }
-}
-
-void CPCMRemap::AddGain(float* buf, unsigned int samples, float gain)
-{
-  if (gain != 1.0f) //needs a gain change
-  {
-    float* ptr = m_buf;
-    float* end = m_buf + samples;
-    while (ptr < end)
-      *(ptr++) *= gain;
+    for (unsigned int i = 0; i < m_outChannels * 8; i++)
+      m_gainMatrix[i] = m_mixMatrix[i] * gain;
+    matrix = m_gainMatrix;
   }
+  AudioKernels::Mix((const float*)data, m_inChannels, (float*)out, m_outChannels, matrix, samples);
 }
 
-void CPCMRemap::ProcessLimiter(unsigned int samples, float gain)
+void CPCMRemap::ProcessLimiter(float* buf, unsigned int samples, float gain)
 {
   //check total gain for each output channel
   float highestgain = 1.0f;
@@ -618,13 +577,17 @@ void CPCMRemap::ProcessLimiter(unsigned int samples, float gain)
       m_limiterEnabled = true;
     }
 
+    //nothing near clipping and nothing to release, the per sample pass would not change anything
+    if (m_attenuation == 1.0f && AudioKernels::Peak(buf, samples * m_outChannels) <= 0.95f)
+      return;
+
     for (unsigned int i = 0; i < samples; i++)
     {
       //for each collection of samples, get the highest absolute value
       float maxAbs = 0.0f;
       for (unsigned int outch = 0; outch < m_outChannels; outch++)
       {
-        float absval = fabs(m_buf[i * m_outChannels + outch]) / 32768.0f;
+        float absval = fabs(buf[i * m_outChannels + outch]);
         if (maxAbs < absval)
           maxAbs = absval;
       }
@@ -650,8 +613,9 @@ void CPCMRemap::ProcessLimiter(unsigned int samples, float gain)
       }
 
       //apply attenuation
-      for (unsigned int outch = 0; outch < m_outChannels; outch++)
-        m_buf[i * m_outChannels + outch] *= m_attenuation;
+      if (m_attenuation != 1.0f)
+        for (unsigned int outch = 0; outch < m_outChannels; outch++)
+          buf[i * m_outChannels + outch] *= m_attenuation;
 
       if (m_holdCounter)
       {
@@ -685,34 +649,15 @@ void CPCMRemap::ProcessLimiter(unsigned int samples, float gain)
   }
 }
 
-void CPCMRemap::ProcessOutput(void* out, unsigned int samples, float gain)
+void CPCMRemap::ProcessOutput(float* buf, unsigned int samples)
 {
-  //copy from intermediate buffer to output
-  for (unsigned int ch = 0; ch < m_outChannels; ch++)
-  {
-    struct PCMMapInfo *info = m_lookupMap[m_outMap[ch]];
-    if (info->channel == PCM_INVALID)
-      continue;
-
-    if (!info->copy || gain != 1.0f)
-    {
-      float* src = m_buf + ch;
-      uint8_t* dst = (uint8_t*)out + ch * m_inSampleSize;
-      uint8_t* dstend = dst + samples * m_outStride;
-
-      while(dst < dstend)
-      {
-        *(float*)dst = MathUtils::round_int(std::min(std::max(*src, -1.0f), 1.0f));
-        src += m_outChannels;
-        dst += m_outStride;
-      }
-    }
-  }
+  //the limiter lets through what it could not catch in time
+  AudioKernels::Clip(buf, buf, samples * m_outChannels);
 }
 
 bool CPCMRemap::CanRemap()
 {
-  return (m_inSet && m_outSet);
+  return (m_inSet && m_outSet && m_inSampleSize == sizeof(float) && m_inChannels <= 8 && m_outChannels <= 8);
 }
 
 int CPCMRemap::InBytesToFrames(int bytes)
@@ -729,7 +674,6 @@ int CPCMRemap::FramesToInBytes(int frames)
 {
   return frames * m_inSampleSize * m_inChannels;
 }
-#endif
 CStdString CPCMRemap::PCMChannelStr(enum PCMChannels ename)
 {
   const char* PCMChannelName[] =
@@ -809,3 +753,8 @@ void CPCMRemap::GetDownmixMatrix(float *downmix)
       downmix[8*ch + (info->in_offset>>1)] = info->level;
   }
 }
+
+void CPCMRemap::GetMixMatrix(float *matrix)
+{
+  memcpy(matrix, m_mixMatrix, sizeof(float) * 8 * 8);
+}
@@ -104,8 +104,8 @@ protected:
   struct PCMMapInfo  m_lookupMap[PCM_MAX_CH + 1][PCM_MAX_CH + 1];
   int                m_counts[PCM_MAX_CH];
 
-  float*             m_buf;
-  int                m_bufsize;
+  float              m_mixMatrix[PCM_MAX_CH * 8]; //!< m_outChannels rows of 8 input weights for Remap()
+  float              m_gainMatrix[PCM_MAX_CH * 8];
   float              m_attenuation;
   float              m_attenuationInc;
   float              m_attenuationMin; //lowest attenuation value during a call of Remap(), used for the codec info
@@ -122,11 +122,10 @@ protected:
   CStdString         PCMChannelStr(enum PCMChannels ename);
   CStdString         PCMLayoutStr(enum PCMLayout ename);
 
-  void               CheckBufferSize(int size);
+  void               BuildMixMatrix();
   void               ProcessInput(void* data, void* out, unsigned int samples, float gain);
-  void               AddGain(float* buf, unsigned int samples, float gain);
-  void               ProcessLimiter(unsigned int samples, float gain);
-  void               ProcessOutput(void* out, unsigned int samples, float gain);
+  void               ProcessLimiter(float* buf, unsigned int samples, float gain);
+  void               ProcessOutput(float* buf, unsigned int samples);
 
 public:
 
@@ -136,16 +135,21 @@ public:
   void Reset();
   enum PCMChannels *SetInputFormat (unsigned int channels, enum PCMChannels *channelMap, unsigned int sampleSize, unsigned int sampleRate, enum PCMLayout channelLayout, bool dontnormalize);
   void SetOutputFormat(unsigned int channels, enum PCMChannels *channelMap, bool ignoreLayout = false);
-#if 0
+
+  /* software downmix for outputs without the OMX mixer, data and out are
+     interleaved float (sampleSize 4) and samples counts frames */
   void Remap(void *data, void *out, unsigned int samples, long drc);
   void Remap(void *data, void *out, unsigned int samples, float gain = 1.0f);
   bool CanRemap();
   int  InBytesToFrames (int bytes );
   int  FramesToOutBytes(int frames);
   int  FramesToInBytes (int frames);
-#endif
+  unsigned int GetInputChannels() { return m_inChannels; }
+  unsigned int GetOutputChannels() { return m_outChannels; }
+  bool IsLimiterEnabled() { return m_limiterEnabled; }
   float GetCurrentAttenuation() { return m_attenuationMin; }
   void               GetDownmixMatrix(float *downmix);
+  void               GetMixMatrix(float *matrix); //!< 8x8 as used by Remap(), weights of one input reached over several paths are summed
 };
 
 #endif
@@ -27,132 +27,286 @@
 #include "utils/StdString.h"
 #include "ofLog.h"
 
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+/*
+ * Log() only filters, vsnprintf's into a preallocated ring slot and returns.
+ * Producers claim slots lock-free (bounded MPMC sequence ring), so a thread
+ * logging every packet never waits on the file or on other loggers. The writer
+ * thread adds the prefix, folds repeated lines, trims and aligns newlines, and
+ * writes whole batches before a single fflush. When the ring is full the line
+ * is dropped and counted rather than blocking the caller; lines longer than a
+ * slot are cut, end in "..." and are counted the same way.
+ */
+
+#define LOG_RING_SIZE   1024  // power of two
+#define LOG_LINE_SIZE   512
+#define LOG_PREFIX_SIZE 64
+#define LOG_BATCH_SIZE  (64 * 1024)
+
+struct LogSlot
+{
+  std::atomic<uint32_t> sequence;
+  int                   level;
+  struct timeval        time;
+  char                  text[LOG_LINE_SIZE];
+};
+
+static LogSlot               m_ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> m_enqueuePos(0);
+static uint32_t              m_dequeuePos    = 0;
+static std::atomic<uint32_t> m_dropped(0);
+static std::atomic<uint32_t> m_truncated(0);
+
 static FILE*       m_file           = NULL;
 static int         m_repeatCount    = 0;
 static int         m_repeatLogLevel = -1;
 static std::string m_repeatLine     = "";
-static int         m_logLevel       = LOG_LEVEL_NONE;
+static volatile int m_logLevel      = LOG_LEVEL_NONE;
 static bool  logToOF = false;
 
-static pthread_mutex_t   m_log_mutex;
+static pthread_mutex_t   m_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t         m_writer;
+static pthread_once_t    m_ringOnce = PTHREAD_ONCE_INIT;
+static std::atomic<bool> m_writerRunning(false);
 
 static char levelNames[][8] =
 {"DEBUG", "INFO", "NOTICE", "WARNING", "ERROR", "SEVERE", "FATAL", "NONE"};
 
-CLog::CLog()
+static inline bool IsLogged(int loglevel)
 {
-    
+  if (!m_file)
+    return false;
+#if !(defined(_DEBUG) || defined(PROFILE))
+  if (m_logLevel <= LOG_LEVEL_NONE)
+    return false;
+  if (m_logLevel == LOG_LEVEL_NORMAL && loglevel < LOGNOTICE)
+    return false;
+#endif
+  return true;
 }
 
-CLog::~CLog()
-{}
+static void InitRing()
+{
+  for (uint32_t i = 0; i < LOG_RING_SIZE; i++)
+    m_ring[i].sequence.store(i, std::memory_order_relaxed);
+  m_enqueuePos.store(0, std::memory_order_relaxed);
+  m_dequeuePos = 0;
+}
 
-void CLog::Close()
+static bool Enqueue(int loglevel, const char *format, va_list va)
 {
-  if (m_file)
+  LogSlot *slot;
+  uint32_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+  for (;;)
   {
-    fclose(m_file);
-    m_file = NULL;
+    slot = &m_ring[pos & (LOG_RING_SIZE - 1)];
+    uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+    int32_t dif = (int32_t)seq - (int32_t)pos;
+    if (dif == 0)
+    {
+      if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (dif < 0)
+    {
+      return false; // full
+    }
+    else
+    {
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    }
   }
-  m_repeatLine.clear();
-  pthread_mutex_destroy(&m_log_mutex);
+
+  slot->level = loglevel;
+  gettimeofday(&slot->time, NULL);
+  int n = vsnprintf(slot->text, LOG_LINE_SIZE, format, va);
+  if (n >= LOG_LINE_SIZE)
+  {
+    memcpy(slot->text + LOG_LINE_SIZE - 4, "...", 4);
+    m_truncated.fetch_add(1, std::memory_order_relaxed);
+  }
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
 }
 
-void CLog::Log(int loglevel, const char *format, ... )
+// writer thread only
+static LogSlot *Peek()
 {
-  pthread_mutex_lock(&m_log_mutex);
+  LogSlot *slot = &m_ring[m_dequeuePos & (LOG_RING_SIZE - 1)];
+  if (slot->sequence.load(std::memory_order_acquire) != m_dequeuePos + 1)
+    return NULL;
+  return slot;
+}
 
+static void Release(LogSlot *slot)
+{
+  slot->sequence.store(m_dequeuePos + LOG_RING_SIZE, std::memory_order_release);
+  m_dequeuePos++;
+}
+
+static void FormatPrefix(char *prefix, const struct timeval &now, int loglevel)
+{
   static const char* prefixFormat = "%02.2d:%02.2d:%02.2d T:%" PRIu64 " %7s: ";
-#if !(defined(_DEBUG) || defined(PROFILE))
-  if (m_logLevel > LOG_LEVEL_NORMAL ||
-     (m_logLevel > LOG_LEVEL_NONE && loglevel >= LOGNOTICE))
-#endif
+  uint64_t stamp = now.tv_usec + now.tv_sec * 1000000;
+  snprintf(prefix, LOG_PREFIX_SIZE, prefixFormat,
+           (int)((now.tv_sec/3600) % 24), (int)((now.tv_sec/60) % 60), (int)(now.tv_sec % 60),
+           stamp, levelNames[loglevel]);
+}
+
+// formats one slot into out, returns the number of bytes added
+static size_t FormatSlot(LogSlot *slot, char *out, size_t space)
+{
+  size_t used = 0;
+  char prefix[LOG_PREFIX_SIZE];
+
+  if (m_repeatLogLevel == slot->level && m_repeatLine == slot->text)
   {
-    if (!m_file)
-    {
-      pthread_mutex_unlock(&m_log_mutex);
-      return;
-    }
+    m_repeatCount++;
+    return 0;
+  }
+  else if (m_repeatCount)
+  {
+    FormatPrefix(prefix, slot->time, m_repeatLogLevel);
+    int n = snprintf(out, space, "%sPrevious line repeats %d times." LINE_ENDING, prefix, m_repeatCount);
+    used = std::min((size_t)std::max(n, 0), space);
+    m_repeatCount = 0;
+  }
+
+  m_repeatLine     = slot->text;
+  m_repeatLogLevel = slot->level;
+
+  size_t length = strlen(slot->text);
+  while (length && (slot->text[length-1] == ' ' || slot->text[length-1] == '\n' || slot->text[length-1] == '\r'))
+    length--;
+  if (!length)
+    return used;
 
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    SYSTEMTIME time;
-    time.wHour=(now.tv_sec/3600) % 24;
-    time.wMinute=(now.tv_sec/60) % 60;
-    time.wSecond=now.tv_sec % 60;
-    uint64_t stamp = now.tv_usec + now.tv_sec * 1000000;
-    CStdString strPrefix, strData;
-
-    strData.reserve(16384);
-    va_list va;
-    va_start(va, format);
-    strData.FormatV(format,va);
-    va_end(va);
-
-    if (m_repeatLogLevel == loglevel && m_repeatLine == strData)
+  FormatPrefix(prefix, slot->time, slot->level);
+  size_t start = used;
+  int n = snprintf(out + used, space - used, "%s", prefix);
+  used += std::min((size_t)std::max(n, 0), space - used);
+
+  /* fixup newline alignment, number of spaces should equal prefix length */
+  static const char* continuation = LINE_ENDING"                                            ";
+  static const size_t continuationLength = strlen(continuation);
+  for (size_t i = 0; i < length && used + continuationLength + 2 < space; i++)
+  {
+    if (slot->text[i] == '\n')
     {
-      m_repeatCount++;
-      pthread_mutex_unlock(&m_log_mutex);
-      return;
+      memcpy(out + used, continuation, continuationLength);
+      used += continuationLength;
     }
-    else if (m_repeatCount)
+    else
     {
-      CStdString strData2;
-      strPrefix.Format(prefixFormat, time.wHour, time.wMinute, time.wSecond, stamp, levelNames[m_repeatLogLevel]);
-
-      strData2.Format("Previous line repeats %d times." LINE_ENDING, m_repeatCount);
-      fputs(strPrefix.c_str(), m_file);
-      fputs(strData2.c_str(), m_file);
-      OutputDebugString(strData2);
-      m_repeatCount = 0;
+      out[used++] = slot->text[i];
     }
-    
-    m_repeatLine      = strData;
-    m_repeatLogLevel  = loglevel;
+  }
+  if (used + 1 < space)
+    out[used++] = '\n';
 
-    unsigned int length = 0;
-    while ( length != strData.length() )
-    {
-      length = strData.length();
-      strData.TrimRight(" ");
-      strData.TrimRight('\n');
-      strData.TrimRight("\r");
-    }
+  if (logToOF)
+    ofLog() << std::string(out + start, used - start - 1);
 
-    if (!length)
-    {
-      pthread_mutex_unlock(&m_log_mutex);
-      return;
-    }
-    
-    //OutputDebugString(strData);
+  return used;
+}
 
-    /* fixup newline alignment, number of spaces should equal prefix length */
-    strData.Replace("\n", LINE_ENDING"                                            ");
-    strData += LINE_ENDING;
+// drains everything currently queued, one fwrite/fflush per batch
+static bool Flush()
+{
+  static char batch[LOG_BATCH_SIZE];
+  size_t used = 0;
+  LogSlot *slot;
 
-    strPrefix.Format(prefixFormat, time.wHour, time.wMinute, time.wSecond, stamp, levelNames[loglevel]);
+  while ((slot = Peek()) != NULL)
+  {
+    if (LOG_BATCH_SIZE - used < LOG_LINE_SIZE * 2)
+    {
+      if (m_file)
+        fwrite(batch, 1, used, m_file);
+      used = 0;
+    }
+    used += FormatSlot(slot, batch + used, LOG_BATCH_SIZE - used);
+    Release(slot);
+  }
 
-    fputs(strPrefix.c_str(), m_file);
-    fputs(strData.c_str(), m_file);
-      
-      if(logToOF)
-      {
-          ofLog() << strPrefix << " : " << strData;
+  uint32_t dropped = m_dropped.exchange(0);
+  if (dropped)
+  {
+    int n = snprintf(batch + used, LOG_BATCH_SIZE - used, "Log ring full, dropped %u lines." LINE_ENDING, dropped);
+    used += std::min((size_t)std::max(n, 0), LOG_BATCH_SIZE - used);
+  }
+  uint32_t truncated = m_truncated.exchange(0);
+  if (truncated)
+  {
+    int n = snprintf(batch + used, LOG_BATCH_SIZE - used, "Truncated %u lines longer than %d bytes." LINE_ENDING, truncated, LOG_LINE_SIZE - 1);
+    used += std::min((size_t)std::max(n, 0), LOG_BATCH_SIZE - used);
+  }
 
-      }
-    //fputs(strPrefix.c_str(), stdout);
-    //fputs(strData.c_str(), stdout);
+  if (!used)
+    return false;
+  if (m_file)
+  {
+    fwrite(batch, 1, used, m_file);
     fflush(m_file);
   }
+  return true;
+}
+
+static void *WriterThread(void *)
+{
+  while (m_writerRunning.load())
+  {
+    if (!Flush())
+      usleep(10 * 1000);
+  }
+  Flush();
+  return NULL;
+}
+
+CLog::CLog()
+{
+    
+}
 
+CLog::~CLog()
+{}
+
+void CLog::Close()
+{
+  pthread_mutex_lock(&m_log_mutex);
+  if (m_writerRunning.exchange(false))
+    pthread_join(m_writer, NULL);
+  if (m_file)
+  {
+    fclose(m_file);
+    m_file = NULL;
+  }
+  m_repeatLine.clear();
   pthread_mutex_unlock(&m_log_mutex);
 }
 
+void CLog::Log(int loglevel, const char *format, ... )
+{
+  // filtered lines cost a couple of loads, nothing is formatted
+  if (!IsLogged(loglevel))
+    return;
+
+  va_list va;
+  va_start(va, format);
+  if (!Enqueue(loglevel, format, va))
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+  va_end(va);
+}
+
 bool CLog::Init(const char* path, bool logToOF_)
 {
     logToOF = logToOF_;
-  pthread_mutex_init(&m_log_mutex, NULL);
+  pthread_mutex_lock(&m_log_mutex);
   if (m_logLevel > LOG_LEVEL_NONE) { 
   if (!m_file)
   {
@@ -164,21 +318,37 @@ bool CLog::Init(const char* path, bool logToOF_)
     struct stat info;
     if (stat(strLogFileOld.c_str(),&info) == 0 &&
         remove(strLogFileOld.c_str()) != 0)
+    {
+      pthread_mutex_unlock(&m_log_mutex);
       return false;
+    }
     if (stat(strLogFile.c_str(),&info) == 0 &&
         rename(strLogFile.c_str(),strLogFileOld.c_str()) != 0)
+    {
+      pthread_mutex_unlock(&m_log_mutex);
       return false;
+    }
 
     m_file = fopen(strLogFile.c_str(),"wb");
+
+    if (m_file)
+    {
+      unsigned char BOM[3] = {0xEF, 0xBB, 0xBF};
+      fwrite(BOM, sizeof(BOM), 1, m_file);
+    }
   }
 
-  if (m_file)
+  if (m_file && !m_writerRunning.load())
   {
-    unsigned char BOM[3] = {0xEF, 0xBB, 0xBF};
-    fwrite(BOM, sizeof(BOM), 1, m_file);
+    pthread_once(&m_ringOnce, InitRing);
+    m_writerRunning = true;
+    if (pthread_create(&m_writer, NULL, WriterThread, NULL) != 0)
+      m_writerRunning = false;
   }
   }
-  return m_file != NULL;
+  bool result = m_file != NULL;
+  pthread_mutex_unlock(&m_log_mutex);
+  return result;
 }
 
 void CLog::MemDump(char *pData, int length)